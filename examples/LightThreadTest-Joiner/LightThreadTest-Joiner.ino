@@ -14,8 +14,9 @@ void loop() {
 
       if (!sent && millis() > 3000) {
           std::vector<uint8_t> payload = { 'h', 'e', 'l', 'l', 'o' };
-          bool ok = lightThread.sendUdp(lightThread.getLeaderIp(), true, payload);
-          log_i("JOINER TEST: Sent reliable payload: %s", ok ? "OK" : "FAIL");
+          SendStatus status = lightThread.sendUdp(lightThread.getLeaderAddress(), true, payload);
+          log_i("JOINER TEST: Sent reliable payload: %s",
+                status == SendStatus::OK ? "OK" : "FAIL");
           sent = true;
       }
   }
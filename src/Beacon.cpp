@@ -0,0 +1,152 @@
+#include "LightThread.h"
+#include "esp_random.h"
+
+// A BEACON carries [epoch:16][seq:16][part:8][parts:8] and a Bloom filter of the joiner IDs
+// the leader heard from recently. When the filter would not fit the MTU the joiners are
+// split over several parts by ID, each its own datagram of the same round. Bit positions
+// are salted with epoch and seq, so a joiner falsely listed in one round is unlikely to be
+// again in the next.
+static const size_t kBeaconHeader = 6;
+static const unsigned kBitsPerJoiner = 8; // ~3% false positives with kBeaconHashes
+static const unsigned kBeaconHashes = 3;
+static const unsigned kMaxBeaconParts = 16;
+
+// Joiners heard from within two heartbeat periods are listed
+static const unsigned long kBeaconListedFor = 2 * LT_BEACON_INTERVAL;
+
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// Part of a round that lists `id`; stable across rounds so a joiner knows where to look
+static inline uint8_t beaconPart(uint64_t id, uint8_t parts) {
+    return static_cast<uint8_t>((mix64(id) >> 32) % parts);
+}
+
+// Calls fn(bit) for each of the filter bits of `id`, with `bits` filter bits
+template <typename Fn>
+static inline void forEachBeaconBit(uint64_t id, uint32_t salt, size_t bits, Fn fn) {
+    uint64_t h = mix64(id ^ (static_cast<uint64_t>(salt) * 0x9E3779B97F4A7C15ULL));
+    uint32_t h1 = static_cast<uint32_t>(h);
+    uint32_t h2 = static_cast<uint32_t>(h >> 32) | 1;
+    for(unsigned i = 0; i < kBeaconHashes; ++i)
+        fn((h1 + i * h2) % bits);
+}
+
+// Selects how joiners learn that the leader still hears them (see LivenessMode). Only the
+// leader's setting matters; joiners understand both.
+void LightThread::setLivenessMode(LivenessMode mode) {
+    livenessMode = mode;
+    nextBeaconAt = millis();
+}
+
+// True while this node is a leader sending beacon rounds: beacon mode, network up.
+bool LightThread::sendsBeacons() const {
+    return role == Role::LEADER && livenessMode == LivenessMode::BEACON &&
+           (state == State::STANDBY || state == State::COMMISSIONER_ACTIVE);
+}
+
+// Leader: sends the beacon round when due. Called once per update().
+void LightThread::updateBeacon() {
+    if(!sendsBeacons())
+        return;
+
+    unsigned long now = millis();
+    if(timeBefore(now, nextBeaconAt))
+        return;
+    nextBeaconAt = now + LT_BEACON_INTERVAL;
+
+    while(beaconEpoch == 0)
+        beaconEpoch = static_cast<uint16_t>(esp_random());
+    beaconSeq++;
+
+    size_t listed = 0;
+    joiners.forEach([&](const JoinerInfo &joiner) {
+        if(now - joiner.lastSeen <= kBeaconListedFor)
+            listed++;
+    });
+
+    size_t capacity = udpMtu - 2 - kBeaconHeader;
+    size_t parts = (listed * kBitsPerJoiner / 8 + capacity - 1) / capacity;
+    parts = std::max<size_t>(1, std::min<size_t>(parts, kMaxBeaconParts));
+
+    uint32_t salt = (static_cast<uint32_t>(beaconEpoch) << 16) | beaconSeq;
+    for(size_t part = 0; part < parts; ++part) {
+        size_t inPart = 0;
+        joiners.forEach([&](const JoinerInfo &joiner) {
+            if(now - joiner.lastSeen <= kBeaconListedFor && beaconPart(joiner.id, parts) == part)
+                inPart++;
+        });
+
+        size_t filterLen = std::min(capacity, std::max<size_t>(1, inPart * kBitsPerJoiner / 8));
+        uint8_t buf[LT_MAX_UDP_FRAME] = {};
+        uint8_t *filter = buf + kBeaconHeader;
+        buf[0] = beaconEpoch >> 8;
+        buf[1] = beaconEpoch & 0xFF;
+        buf[2] = beaconSeq >> 8;
+        buf[3] = beaconSeq & 0xFF;
+        buf[4] = part;
+        buf[5] = parts;
+
+        joiners.forEach([&](const JoinerInfo &joiner) {
+            if(now - joiner.lastSeen > kBeaconListedFor || beaconPart(joiner.id, parts) != part)
+                return;
+            forEachBeaconBit(joiner.id, salt, filterLen * 8,
+                             [filter](uint32_t bit) { filter[bit / 8] |= 1 << (bit % 8); });
+        });
+
+        sendUdpPacket(AckType::NONE, MessageType::BEACON, buf, kBeaconHeader + filterLen,
+                      Ip6Address::realmLocalAllNodes(), LT_UDP_PORT);
+        stats.beaconsSent++;
+    }
+
+    LT_LOG(UDP, LT_LOG_INFO, "Beacon: Round %u lists %u joiners in %u parts", beaconSeq,
+           static_cast<unsigned>(listed), static_cast<unsigned>(parts));
+}
+
+// Whether a beacon datagram lists `id`. False for an ID that belongs to another part of the
+// round, so a joiner checks each part it receives.
+bool LightThread::beaconLists(const uint8_t *payload, size_t length, uint64_t id) {
+    if(length <= kBeaconHeader)
+        return false;
+
+    uint32_t salt = (static_cast<uint32_t>(payload[0]) << 24) | (payload[1] << 16) |
+                    (payload[2] << 8) | payload[3];
+    uint8_t part = payload[4];
+    uint8_t parts = payload[5];
+    if(part >= parts || beaconPart(id, parts) != part)
+        return false;
+
+    const uint8_t *filter = payload + kBeaconHeader;
+    bool listed = true;
+    forEachBeaconBit(id, salt, (length - kBeaconHeader) * 8,
+                     [&](uint32_t bit) { listed = listed && (filter[bit / 8] >> (bit % 8)) & 1; });
+    return listed;
+}
+
+// Joiner: a beacon from our leader that lists us counts as a heartbeat echo. A new epoch
+// means the leader restarted with an empty registry, so the next heartbeat goes out now.
+void LightThread::handleBeacon(const Ip6Address &src, const uint8_t *payload, size_t length) {
+    if(length <= kBeaconHeader || leaderIp.isUnspecified() || src != leaderIp)
+        return;
+
+    uint16_t epoch = (payload[0] << 8) | payload[1];
+    uint16_t seq = (payload[2] << 8) | payload[3];
+    if(payload[4] >= payload[5])
+        return;
+
+    if(epoch != beaconEpoch) {
+        beaconEpoch = epoch;
+        lastHeartbeatSent = millis() - 5000; // due on the next update()
+    }
+
+    if(beaconLists(payload, length, generateMacHash())) {
+        lastHeartbeatEcho = millis();
+        LT_LOG(UDP, LT_LOG_VERBOSE, "Beacon: Listed in round %u", seq);
+    }
+}
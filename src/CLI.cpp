@@ -1,140 +1,218 @@
 #include "LightThread.h"
 #include "OThreadCLI.h"
 
-// Executes a command via the OpenThread CLI and waits for a specific string to appear in the
-// output. Parameters:
+// Queues a command for the OpenThread CLI. Never blocks: the command is written to the CLI
+// by pumpCliCommands() once a pipeline slot is free, and `done` is invoked from update()
+// when the command's reply arrives. Parameters:
 //   - command: The CLI command to send (e.g., "dataset commit active").
-//   - mustContain: A substring that must be present in the CLI response (e.g., "Done").
-//   - out: Optional pointer to capture the full CLI response (multi-line).
-//   - timeoutMs: Maximum time to wait for a matching response.
-// Returns true if the match string is found in time, false otherwise.
-bool LightThread::execAndMatch(const String &command, const String &mustContain, String *out,
-                               unsigned long timeoutMs) {
-    logLightThread(LT_LOG_INFO, "CLI: %s", command.c_str());
-    // Send command to OpenThread CLI
-    OThreadCLI.println(command);
-    String response;
-    // Wait for a response that includes the required substring
-    if(!waitForString(response, timeoutMs, mustContain)) {
-        logLightThread(LT_LOG_WARN, "Command '%s' timed out", command.c_str());
-        return false;
-    }
-    // Store the full response if the caller requested it
-    if(out)
-        *out = response;
-    return true;
+//   - done: Optional completion callback. `ok` is true if the CLI answered "Done";
+//           `response` holds every line the command printed (multi-line).
+//   - timeoutMs: Maximum time to wait for the reply once the command has been sent.
+void LightThread::execAsync(const String &command, CliCallback done, unsigned long timeoutMs) {
+    cliQueued.push_back({command, std::move(done), timeoutMs, 0, "", 0});
 }
 
-// Handles a single line of CLI output.
-// loggs an unclaimed (non-parsed) CLI response.
-void LightThread::handleCliLine(const String &line) {
-    // Optional: Add routing logic later if needed
-    logLightThread(LT_LOG_INFO, "CLI Response (unclaimed): %s", line.c_str());
-}
+// Returns true when no CLI command is queued or awaiting its reply.
+bool LightThread::cliIdle() const { return cliQueued.empty() && cliInFlight.empty(); }
 
-// Waits for CLI output to include a specific match string.
-// Collects lines into `responseBuffer`. Returns true if match found.
-bool LightThread::waitForString(String &responseBuffer, unsigned long timeoutMs,
-                                const String &matchStr) {
-    responseBuffer = "";
-    unsigned long start = millis();
-    String line;
-    bool isUDP = false;
-
-    while(millis() - start < timeoutMs) {
-        if(otGetResp(line, isUDP, timeoutMs)) {
-            if(!isUDP) {
-                responseBuffer += line + "\n";
-                log_d("CLI Resp: %s", line.c_str());
-                if(line.indexOf(matchStr) != -1) {
-                    return true;
-                }
-            }
-        }
-    }
+// Writes queued commands to the CLI while pipeline slots are free and fails the oldest
+// in-flight command once its timeout expires. Called once per update().
+void LightThread::pumpCliCommands() {
+    unsigned long now = millis();
 
-    logLightThread(LT_LOG_WARN, "Timeout while waiting for '%s'", matchStr.c_str());
-    return false;
-}
+    if(!cliInFlight.empty() && now - cliInFlight.front().sentAt >= cliInFlight.front().timeoutMs) {
+        CliCommand timedOut = std::move(cliInFlight.front());
+        cliInFlight.pop_front();
 
-// Processes individual characters from the CLI to reconstruct full lines.
-// Recognizes UDP lines and multi-line CLI responses.
-bool LightThread::processCLIChar(char c, String &multiline, bool &isUDP, String &lineOut) {
-    static String buffer = "";
+        // The CLI answers every command eventually; the late reply, and those of the
+        // udp sends written before it, must not be attributed to the command behind it.
+        cliStaleReplies += timedOut.udpRepliesAhead + 1;
+        LT_LOG(CLI, LT_LOG_WARN, "Command '%s' timed out", timedOut.command.c_str());
+        if(timedOut.done)
+            timedOut.done(false, timedOut.response);
+    }
 
-    // End-of-line handling
-    if(c == '\r' || c == '\n') {
-        if(buffer.length() == 0)
-            return false;
+    while(!cliQueued.empty() && cliInFlight.size() < LT_CLI_PIPELINE_DEPTH) {
+        CliCommand &cmd = cliQueued.front();
+        LT_LOG(CLI, LT_LOG_INFO, "CLI: %s", cmd.command.c_str());
+        OThreadCLI.println(cmd.command);
+        cmd.sentAt = now;
+        cmd.udpRepliesAhead = cliUdpReplies;
+        cliUdpReplies = 0;
+        cliInFlight.push_back(std::move(cmd));
+        cliQueued.pop_front();
+    }
+}
 
-        String line = buffer;
-        buffer = "";
+// Runs `commands` one at a time through execAsync(), each once the one before it has
+// answered Done. `done` gets true when all have, or false at the first that fails or times
+// out; the commands after it are never sent.
+void LightThread::execSequence(std::vector<String> commands, std::function<void(bool ok)> done,
+                               size_t next) {
+    if(next == commands.size()) {
+        if(done)
+            done(true);
+        return;
+    }
 
-        // Detect UDP message (OpenThread format with port 12345)
-        if(line.indexOf("bytes from") != -1 && line.indexOf("12345") != -1) {
-            isUDP = true;
-            lineOut = line;
-            multiline = ""; // Clear multiline buffer
-            return true;
+    String command = commands[next];
+    execAsync(command, [this, commands = std::move(commands), done = std::move(done),
+                        next](bool ok, const String &) mutable {
+        if(!ok) {
+            if(done)
+                done(false);
+            return;
         }
+        execSequence(std::move(commands), std::move(done), next + 1);
+    });
+}
 
-        // Accumulate multi-line CLI output
-        multiline += line + "\n";
+// The line a successful command ends with
+static bool isDoneLine(const char *line, size_t length) {
+    return length == 4 && memcmp(line, "Done", 4) == 0;
+}
 
-        // End multi-line output when "Done" is detected
-        if(line.indexOf("Done") != -1) {
-            isUDP = false;
-            lineOut = multiline;
-            multiline = "";
-            return true;
-        }
+// The line a failed command ends with: "Error <n>: <reason>"
+static bool isErrorLine(const char *line, size_t length) {
+    if(length < 6 || memcmp(line, "Error ", 6) != 0)
         return false;
+    size_t i = 6;
+    while(i < length && line[i] >= '0' && line[i] <= '9')
+        ++i;
+    return i > 6 && i < length && line[i] == ':';
+}
+
+// Handles a single line of CLI output.
+// Lines belong to the oldest in-flight command until its "Done"/"Error" terminator, once
+// the terminators owed to timed-out commands and to udp sends written ahead of it are
+// skipped; anything arriving with no command in flight is logged as unclaimed. Output
+// lines that merely contain "Done" or start with "Error" do not end a command.
+void LightThread::handleCliLine(const char *line, size_t length) {
+    bool done = isDoneLine(line, length);
+    bool terminator = done || isErrorLine(line, length);
+
+    // Output of a timed-out command lasts up to the last reply it is owed
+    if(cliStaleReplies > 0) {
+        if(terminator)
+            cliStaleReplies--;
+        LT_LOG(CLI, LT_LOG_INFO, "CLI Response (late, discarded): %.*s", static_cast<int>(length),
+               line);
+        return;
     }
 
-    // Still reading a line — accumulate characters
-    buffer += c;
-    return false;
-}
+    uint32_t *udpReplies = cliInFlight.empty() ? &cliUdpReplies
+                                               : &cliInFlight.front().udpRepliesAhead;
+    if(terminator && *udpReplies > 0) {
+        (*udpReplies)--;
+        if(!done)
+            LT_LOG(UDP, LT_LOG_WARN, "udp send failed: %.*s", static_cast<int>(length), line);
+        return;
+    }
 
-// Fetches a line of CLI or UDP output from the CLI stream.
-// Uses `processCLIChar` to handle parsing logic.
-bool LightThread::otGetResp(String &lineOut, bool &isUDP, unsigned long timeoutMs) {
-    static String buffer = "";
-    static String multiline = "";
-    static String queuedLine = "";
-    static bool queuedIsUDP = false;
-
-    // Priority: Return queued line if present
-    if(queuedLine.length()) {
-        lineOut = queuedLine;
-        isUDP = queuedIsUDP;
-        queuedLine = "";
-        return true;
+    if(cliInFlight.empty()) {
+        LT_LOG(CLI, LT_LOG_INFO, "CLI Response (unclaimed): %.*s", static_cast<int>(length), line);
+        return;
     }
 
-    unsigned long start = millis();
-    isUDP = false;
+    CliCommand &cmd = cliInFlight.front();
+    cmd.response.concat(line, length);
+    cmd.response += '\n';
+    if(!terminator)
+        return;
 
-    while(millis() - start < timeoutMs) {
-        while(OThreadCLI.available()) {
-            char c = OThreadCLI.read();
+    CliCommand finished = std::move(cmd);
+    cliInFlight.pop_front();
+
+    if(!done)
+        LT_LOG(CLI, LT_LOG_WARN, "Command '%s' failed: %.*s", finished.command.c_str(),
+               static_cast<int>(length), line);
+    if(finished.done)
+        finished.done(done, finished.response);
+}
 
-            // If a complete line is assembled, return it
-            if(processCLIChar(c, multiline, isUDP, lineOut)) {
-                return true; // either UDP or CLI complete line
+// Drains the CLI stream and routes every complete line to the UDP or CLI handler.
+void LightThread::readCli() {
+    CliLine line;
+
+    // A burst can exceed the buffer, so keep refilling until the stream is empty
+    while(cliRx.fill(OThreadCLI) > 0) {
+        while(cliRx.next(line)) {
+            if(line.isUdp) {
+                handleUdpLine(line.data, line.length); // Handle incoming UDP
+            } else {
+                handleCliLine(line.data, line.length); // Handle CLI output
             }
         }
+    }
+}
 
-        delay(5); // Yield to avoid tight loop
+// Reads everything the stream currently holds (up to the free space) in one call.
+// Returns the number of bytes added.
+size_t CliLineAssembler::fill(Stream &stream) {
+    int available = stream.available();
+    if(available <= 0)
+        return 0;
+
+    // Reclaim consumed space before reading
+    if(head > 0) {
+        memmove(buffer, buffer + head, tail - head);
+        scan -= head;
+        tail -= head;
+        head = 0;
     }
 
-    // Fallback: If we accumulated some CLI but didn't finish with "Done"
-    if(multiline.length() > 0) {
-        lineOut = multiline;
-        multiline = "";
-        isUDP = false;
-        return true;
+    // No newline anywhere in a full buffer: the line cannot fit, drop it
+    if(tail == sizeof(buffer)) {
+        head = scan = tail = 0;
+        discarding = true;
     }
 
+    size_t want = sizeof(buffer) - tail;
+    if(static_cast<size_t>(available) < want)
+        want = static_cast<size_t>(available);
+
+    size_t got = stream.readBytes(buffer + tail, want);
+    tail += got;
+    return got;
+}
+
+// Finds the next newline with memchr and classifies the line in the same pass.
+bool CliLineAssembler::next(CliLine &line) {
+    static const char kUdpMarker[] = " bytes from ";
+    const size_t markerLen = sizeof(kUdpMarker) - 1;
+
+    while(scan < tail) {
+        const char *nl = static_cast<const char *>(memchr(buffer + scan, '\n', tail - scan));
+        if(!nl) {
+            scan = tail;
+            return false;
+        }
+
+        const char *start = buffer + head;
+        size_t length = nl - start;
+        head = scan = (nl - buffer) + 1;
+
+        if(discarding) {
+            discarding = false; // tail end of an over-long line
+            continue;
+        }
+
+        // Strip the CR of CRLF line endings
+        while(length > 0 && start[length - 1] == '\r')
+            --length;
+        if(length == 0)
+            continue;
+
+        // UDP lines look like "<n> bytes from <ip> <port> <hex>"
+        size_t digits = 0;
+        while(digits < length && start[digits] >= '0' && start[digits] <= '9')
+            ++digits;
+
+        line.data = start;
+        line.length = length;
+        line.isUdp = digits > 0 && length > digits + markerLen &&
+                     memcmp(start + digits, kUdpMarker, markerLen) == 0;
+        return true;
+    }
     return false;
 }
@@ -0,0 +1,116 @@
+#include "LightThread.h"
+
+// Largest batch payload (records only) at the current MTU and flush threshold.
+size_t LightThread::coalesceCapacity() const {
+    size_t capacity = udpMtu - 2;
+    if(coalesceBytes > 0 && coalesceBytes < capacity)
+        capacity = coalesceBytes;
+    return capacity;
+}
+
+// Returns true if an unreliable payload of this size is buffered rather than sent at once.
+bool LightThread::coalesces(size_t length) const {
+    return coalesceWindow > 0 && length > 0 && length <= 0xFF && 1 + length <= coalesceCapacity();
+}
+
+// Appends an unreliable payload to the destination's batch as a [length:8][data] record.
+// The batch is sent once it reaches the flush threshold or has waited coalesceWindow ms,
+// whichever comes first. A destination without a batch takes a free buffer or flushes the
+// oldest one.
+SendStatus LightThread::coalesceUdp(const Ip6Address &dest, const uint8_t *payload,
+                                    size_t length) {
+    if(dest.isUnspecified())
+        return SendStatus::INVALID;
+
+    bool ok = true;
+    CoalesceBuffer *buf = findCoalesceBuffer(dest);
+    if(buf && buf->length + 1 + length > coalesceCapacity())
+        ok = flushCoalesceBuffer(*buf);
+
+    if(!buf) {
+        for(CoalesceBuffer &entry : coalesceBuffers) {
+            if(!entry.inUse) {
+                buf = &entry;
+                break;
+            }
+            if(!buf || timeBefore(entry.firstAt, buf->firstAt))
+                buf = &entry; // older than the current pick
+        }
+        if(buf->inUse)
+            ok = flushCoalesceBuffer(*buf);
+        buf->addr = dest;
+    }
+
+    if(!buf->inUse) {
+        buf->inUse = true;
+        buf->firstAt = millis();
+        buf->length = 0;
+        buf->records = 0;
+    }
+
+    buf->data[buf->length++] = length;
+    memcpy(buf->data + buf->length, payload, length);
+    buf->length += length;
+    buf->records++;
+
+    if(coalesceCapacity() - buf->length < 2) // no room for another non-empty record
+        ok = flushCoalesceBuffer(*buf) && ok;
+    return ok ? SendStatus::OK : SendStatus::SEND_FAILED;
+}
+
+// Returns the batch being filled for a destination, or nullptr.
+LightThread::CoalesceBuffer *LightThread::findCoalesceBuffer(const Ip6Address &addr) {
+    for(CoalesceBuffer &buf : coalesceBuffers) {
+        if(buf.inUse && buf.addr == addr)
+            return &buf;
+    }
+    return nullptr;
+}
+
+// Sends a batch and frees its buffer. A batch holding a single record goes out as a
+// plain NORMAL message, saving the length byte.
+bool LightThread::flushCoalesceBuffer(CoalesceBuffer &buf) {
+    if(!buf.inUse)
+        return true;
+    buf.inUse = false;
+
+    if(buf.records == 1)
+        return sendUdpPacket(AckType::NONE, MessageType::NORMAL, buf.data + 1, buf.length - 1,
+                             buf.addr, LT_UDP_PORT);
+
+    stats.batchesSent++;
+    stats.recordsBatched += buf.records;
+    return sendUdpPacket(AckType::NONE, MessageType::BATCH, buf.data, buf.length, buf.addr,
+                         LT_UDP_PORT);
+}
+
+// Sends any pending batch for `dest`, so a payload that bypasses coalescing is not
+// overtaken by earlier ones.
+void LightThread::flushCoalesced(const Ip6Address &dest) {
+    CoalesceBuffer *buf = findCoalesceBuffer(dest);
+    if(buf)
+        flushCoalesceBuffer(*buf);
+}
+
+// Sends batches whose flush window has elapsed. Called once per update().
+void LightThread::updateCoalescing() {
+    unsigned long now = millis();
+    for(CoalesceBuffer &buf : coalesceBuffers) {
+        if(buf.inUse && now - buf.firstAt >= coalesceWindow)
+            flushCoalesceBuffer(buf);
+    }
+}
+
+// Unpacks a BATCH message and delivers each record as a separate payload.
+void LightThread::handleBatch(const Ip6Address &src, const uint8_t *payload, size_t length) {
+    size_t pos = 0;
+    while(pos < length) {
+        size_t recordLen = payload[pos++];
+        if(recordLen > length - pos) {
+            LT_LOG(UDP, LT_LOG_WARN, "Coalesce: Truncated batch from %s", src.text().c_str());
+            return;
+        }
+        handleNormalUdpMessage(src, payload + pos, recordLen, false);
+        pos += recordLen;
+    }
+}
@@ -0,0 +1,154 @@
+#include "LightThread.h"
+
+// LZ77 codec in the LZF format: a fixed 8 KB window, a match finder hashing 3-byte prefixes
+// into a table on the stack, and no heap use. Encoded data is a sequence of
+//   [000LLLLL] + L+1 literal bytes            (L < 32)
+//   [lllOOOOO][O] or [111OOOOO][l][O]          back-reference
+// where the reference copies l+2 bytes (l from 1, or 7 plus the extra byte) from 13-bit
+// distance O+1 back in the output.
+
+static const unsigned kHashBits = 9; // 1 KB table
+static const size_t kMaxOffset = 1 << 13;
+static const size_t kMaxMatch = 2 + 7 + 255;
+
+static inline uint16_t hash3(const uint8_t *p) {
+    uint32_t v = (static_cast<uint32_t>(p[0]) << 16) | (p[1] << 8) | p[2];
+    return static_cast<uint32_t>(v * 2654435761U) >> (32 - kHashBits);
+}
+
+// Applies setUdpCompression() to an outgoing payload: if compression is on and shrinks it,
+// points `data` at the compressed copy in lzBuffer and returns true. Sends from a callback
+// still reading a payload expanded into lzBuffer go uncompressed.
+bool LightThread::compressForSend(const uint8_t *&data, size_t &size) {
+    if(!udpCompression || size < 2 || lzBufferLent)
+        return false;
+
+    size_t packed = lzCompress(data, size, lzBuffer, size - 1);
+    if(packed == 0)
+        return false;
+
+    data = lzBuffer;
+    size = packed;
+    return true;
+}
+
+// Compresses `in` into `out`. Returns the encoded length, or 0 if it does not fit in
+// `outCap` bytes; callers pass a capacity below the input length to keep only real gains.
+size_t LightThread::lzCompress(const uint8_t *in, size_t inLen, uint8_t *out, size_t outCap) {
+    static_assert(LT_MAX_MESSAGE_SIZE <= 0xFFFF, "hash table stores 16-bit positions");
+
+    uint16_t table[1 << kHashBits] = {};
+    size_t ip = 0;
+    size_t op = 1; // out[0] is reserved for the first literal run's length
+    size_t lit = 0;
+
+    if(outCap < 2)
+        return 0;
+
+    while(ip + 2 < inLen) {
+        uint16_t h = hash3(in + ip);
+        size_t ref = table[h];
+        table[h] = ip;
+
+        size_t off = ip - ref - 1;
+        if(ref < ip && off < kMaxOffset && in[ref] == in[ip] && in[ref + 1] == in[ip + 1] &&
+           in[ref + 2] == in[ip + 2]) {
+            size_t maxLen = std::min(inLen - ip, kMaxMatch);
+            size_t len = 3;
+            while(len < maxLen && in[ref + len] == in[ip + len])
+                ++len;
+
+            // A reference takes up to 3 bytes, plus the next run's length byte
+            if(op + 3 >= outCap)
+                return 0;
+
+            if(lit)
+                out[op - lit - 1] = lit - 1;
+            else
+                --op; // drop the unused run length byte
+
+            size_t l = len - 2;
+            if(l < 7) {
+                out[op++] = (l << 5) | (off >> 8);
+            } else {
+                out[op++] = (7 << 5) | (off >> 8);
+                out[op++] = l - 7;
+            }
+            out[op++] = off & 0xFF;
+            op++;
+            lit = 0;
+
+            // Index the positions the match covered so later data can refer into it
+            size_t end = ip + len;
+            for(++ip; ip < end && ip + 2 < inLen; ++ip)
+                table[hash3(in + ip)] = ip;
+            ip = end;
+            continue;
+        }
+
+        if(op + 2 > outCap)
+            return 0;
+        out[op++] = in[ip++];
+        if(++lit == 32) {
+            out[op - lit - 1] = lit - 1;
+            lit = 0;
+            op++;
+        }
+    }
+
+    while(ip < inLen) {
+        if(op + 2 > outCap)
+            return 0;
+        out[op++] = in[ip++];
+        if(++lit == 32) {
+            out[op - lit - 1] = lit - 1;
+            lit = 0;
+            op++;
+        }
+    }
+
+    if(lit)
+        out[op - lit - 1] = lit - 1;
+    else
+        --op;
+    return op;
+}
+
+// Decompresses `in` into `out`. Returns the decoded length, or 0 if the input is malformed
+// or would decode to more than `outCap` bytes.
+size_t LightThread::lzDecompress(const uint8_t *in, size_t inLen, uint8_t *out, size_t outCap) {
+    size_t ip = 0;
+    size_t op = 0;
+
+    while(ip < inLen) {
+        size_t c = in[ip++];
+
+        if(c < 32) {
+            size_t n = c + 1;
+            if(n > inLen - ip || n > outCap - op)
+                return 0;
+            memcpy(out + op, in + ip, n);
+            ip += n;
+            op += n;
+            continue;
+        }
+
+        size_t len = c >> 5;
+        if(len == 7) {
+            if(ip >= inLen)
+                return 0;
+            len += in[ip++];
+        }
+        if(ip >= inLen)
+            return 0;
+        size_t off = (((c & 0x1F) << 8) | in[ip++]) + 1;
+        len += 2;
+        if(off > op || len > outCap - op)
+            return 0;
+
+        // Byte by byte: the source may overlap the bytes being written
+        for(size_t i = 0; i < len; ++i, ++op)
+            out[op] = out[op - off];
+    }
+    return op;
+}
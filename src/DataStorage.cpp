@@ -8,13 +8,13 @@
 // Returns true if config was loaded successfully.
 bool LightThread::loadNetworkConfig() {
     if(!SD.begin()) {
-        logLightThread(LT_LOG_ERROR, "SD card mount failed");
+        LT_LOG(STORAGE, LT_LOG_ERROR, "SD card mount failed");
         return false;
     }
 
     File configFile = SD.open("/LightThread/network.json");
     if(!configFile) {
-        logLightThread(LT_LOG_WARN, "/LightThread/network.json not found. Creating default.");
+        LT_LOG(STORAGE, LT_LOG_WARN, "/LightThread/network.json not found. Creating default.");
         createDefaultNetworkConfig();
         return false;
     }
@@ -35,13 +35,13 @@ bool LightThread::parseNetworkJson(const String &jsonStr) {
     StaticJsonDocument<512> doc;
     DeserializationError err = deserializeJson(doc, jsonStr);
     if(err) {
-        logLightThread(LT_LOG_ERROR, "JSON parse error: %s", err.c_str());
+        LT_LOG(STORAGE, LT_LOG_ERROR, "JSON parse error: %s", err.c_str());
         return false;
     }
 
     // Parse identity → role
     if(!doc.containsKey("identity") || !doc["identity"].containsKey("role")) {
-        logLightThread(LT_LOG_ERROR, "Missing 'identity.role' in network.json");
+        LT_LOG(STORAGE, LT_LOG_ERROR, "Missing 'identity.role' in network.json");
         return false;
     }
 
@@ -56,7 +56,7 @@ bool LightThread::parseNetworkJson(const String &jsonStr) {
         role = Role::JOINER;
         roleLoadedFromConfig = true;
     } else {
-        logLightThread(LT_LOG_ERROR, "Invalid role '%s' in network.json", roleStr.c_str());
+        LT_LOG(STORAGE, LT_LOG_ERROR, "Invalid role '%s' in network.json", roleStr.c_str());
         return false;
     }
 
@@ -64,7 +64,7 @@ bool LightThread::parseNetworkJson(const String &jsonStr) {
     JsonObject network = doc["network"];
     if(!network.containsKey("channel") || !network.containsKey("meshlocalprefix") ||
        !network.containsKey("panid")) {
-        logLightThread(LT_LOG_ERROR, "Missing required network keys");
+        LT_LOG(STORAGE, LT_LOG_ERROR, "Missing required network keys");
         return false;
     }
 
@@ -72,9 +72,18 @@ bool LightThread::parseNetworkJson(const String &jsonStr) {
     configuredPrefix = (const char *)network["meshlocalprefix"];
     configuredPanid = (const char *)network["panid"];
 
-    logLightThread(LT_LOG_INFO, "Config loaded: role=%s, channel=%d, prefix=%s, panid=%s",
-                   roleStr.c_str(), configuredChannel, configuredPrefix.c_str(),
-                   configuredPanid.c_str());
+    // Optional: "echo" (default) or "beacon", see LivenessMode
+    String liveness = network.containsKey("liveness") ? (const char *)network["liveness"] : "echo";
+    liveness.toLowerCase();
+    if(liveness == "beacon") {
+        setLivenessMode(LivenessMode::BEACON);
+    } else if(liveness != "echo") {
+        LT_LOG(STORAGE, LT_LOG_WARN, "Unknown liveness '%s' in network.json, using echo",
+               liveness.c_str());
+    }
+
+    LT_LOG(STORAGE, LT_LOG_INFO, "Config loaded: role=%s, channel=%d, prefix=%s, panid=%s",
+           roleStr.c_str(), configuredChannel, configuredPrefix.c_str(), configuredPanid.c_str());
 
     return true;
 }
@@ -96,19 +105,19 @@ void LightThread::createDefaultNetworkConfig() {
 
     File file = SD.open("/LightThread/network.json", FILE_WRITE);
     if(!file) {
-        logLightThread(LT_LOG_ERROR, "Failed to create default /LightThread/network.json");
+        LT_LOG(STORAGE, LT_LOG_ERROR, "Failed to create default /LightThread/network.json");
         return;
     }
 
     serializeJsonPretty(doc, file);
     file.close();
 
-    logLightThread(LT_LOG_WARN, "Default /network.json created");
+    LT_LOG(STORAGE, LT_LOG_WARN, "Default /network.json created");
 }
 
 // Writes the current leader IP and hashmac to leader.json.
 // Used by joiners to store their commissioner.
-bool LightThread::saveLeaderInfo(const String &ip, const String &hashmac) {
+bool LightThread::saveLeaderInfo(const Ip6Address &ip, const String &hashmac) {
     if(!SD.begin())
         return false;
 
@@ -117,12 +126,12 @@ bool LightThread::saveLeaderInfo(const String &ip, const String &hashmac) {
     }
 
     StaticJsonDocument<256> doc;
-    doc["leader_ip"] = ip;
+    doc["leader_ip"] = ip.text().c_str();
     doc["leader_hash"] = hashmac;
 
     File file = SD.open("/LightThread/leader.json", FILE_WRITE);
     if(!file) {
-        logLightThread(LT_LOG_ERROR, "Failed to write leader.json");
+        LT_LOG(STORAGE, LT_LOG_ERROR, "Failed to write leader.json");
         return false;
     }
 
@@ -133,7 +142,7 @@ bool LightThread::saveLeaderInfo(const String &ip, const String &hashmac) {
 
 // Reads stored leader info back into out parameters.
 // Returns false if not found or parse error.
-bool LightThread::loadLeaderInfo(String &outIp, String &outHashmac) {
+bool LightThread::loadLeaderInfo(Ip6Address &outIp, String &outHashmac) {
     File file = SD.open("/LightThread/leader.json");
     if(!file)
         return false;
@@ -144,7 +153,9 @@ bool LightThread::loadLeaderInfo(String &outIp, String &outHashmac) {
     if(err)
         return false;
 
-    outIp = (const char *)doc["leader_ip"];
+    const char *ip = doc["leader_ip"];
+    if(!ip || !Ip6Address::parse(ip, outIp))
+        return false;
     outHashmac = (const char *)doc["hashmac"];
     return true;
 }
@@ -152,7 +163,7 @@ bool LightThread::loadLeaderInfo(String &outIp, String &outHashmac) {
 // Removes all persistent config and joiner/leader tracking files.
 // Useful for full reset via long-press or factory wipe.
 void LightThread::clearPersistentState() {
-    logLightThread(LT_LOG_WARN, "WIPING all stored configuration");
+    LT_LOG(STORAGE, LT_LOG_WARN, "WIPING all stored configuration");
 
     SD.remove("/LightThread/network.json");
     SD.remove("/LightThread/leader.json");
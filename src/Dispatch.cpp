@@ -0,0 +1,211 @@
+#include "LightThread.h"
+
+static constexpr int8_t kAny = -1;
+
+static constexpr int8_t only(Role role) { return static_cast<int8_t>(role); }
+static constexpr int8_t only(State state) { return static_cast<int8_t>(state); }
+
+// Column of kRoutes for an ack kind, or -1 if the byte is not one
+static inline int ackColumn(AckType ack) {
+    switch(ack) {
+    case AckType::NONE:
+        return 0;
+    case AckType::REQUEST:
+        return 1;
+    case AckType::RESPONSE:
+        return 2;
+    }
+    return -1;
+}
+
+static_assert(MessageType::NORMAL == 0 && MessageType::PUBLISH == 10,
+              "kRoutes rows follow the MessageType codes");
+
+// Constant-initialized, so the table is fixed at compile time and costs no RAM.
+const LightThread::Route LightThread::kRoutes[kRoutedTypes][3] = {
+    // NORMAL
+    {{&LightThread::rxUnreliable, kAny, kAny},
+     {&LightThread::rxReliableData, kAny, kAny},
+     {&LightThread::rxReliableAck, kAny, kAny}},
+    // PAIRING
+    {{&LightThread::rxPairingBroadcast, kAny, only(State::JOINER_WAIT_BROADCAST)},
+     {&LightThread::rxPairingRequest, kAny, only(State::COMMISSIONER_ACTIVE)},
+     {&LightThread::rxPairingResponse, kAny, only(State::JOINER_WAIT_ACK)}},
+    // RECONNECT
+    {{nullptr, kAny, kAny},
+     {&LightThread::rxReconnectRequest, only(Role::LEADER), only(State::STANDBY)},
+     {&LightThread::rxReconnectResponse, only(Role::JOINER), kAny}},
+    // HEARTBEAT
+    {{&LightThread::rxHeartbeat, only(Role::LEADER), kAny},
+     {nullptr, kAny, kAny},
+     {&LightThread::rxHeartbeatEcho, only(Role::JOINER), kAny}},
+    // FRAGMENT
+    {{&LightThread::rxFragment, kAny, kAny},
+     {&LightThread::rxReliableData, kAny, kAny},
+     {&LightThread::rxReliableAck, kAny, kAny}},
+    // BATCH
+    {{&LightThread::rxBatch, kAny, kAny},
+     {nullptr, kAny, kAny},
+     {nullptr, kAny, kAny}},
+    // GROUP
+    {{&LightThread::rxGroupData, kAny, kAny},
+     {&LightThread::rxGroupData, kAny, kAny},
+     {&LightThread::rxGroupAck, kAny, kAny}},
+    // BEACON
+    {{&LightThread::rxBeacon, only(Role::JOINER), kAny},
+     {nullptr, kAny, kAny},
+     {nullptr, kAny, kAny}},
+    // CHANNEL, unwrapped by parseIncomingPayload()
+    {{nullptr, kAny, kAny},
+     {nullptr, kAny, kAny},
+     {nullptr, kAny, kAny}},
+    // SUBSCRIBE
+    {{&LightThread::rxSubscribeResync, only(Role::JOINER), only(State::JOINER_PAIRED)},
+     {&LightThread::rxSubscribe, only(Role::LEADER), kAny},
+     {&LightThread::rxSubscribeAck, only(Role::JOINER), kAny}},
+    // PUBLISH
+    {{&LightThread::rxPublish, only(Role::JOINER), kAny},
+     {&LightThread::rxPublishRelay, only(Role::LEADER), kAny},
+     {nullptr, kAny, kAny}},
+};
+
+// Dispatches a received datagram (2-byte header + payload), independent of the backend
+// it arrived on: one table lookup for built-in types, one for application types.
+void LightThread::handleUdpPacket(const Ip6Address &src, const uint8_t *frame, size_t length) {
+    AckType ack;
+    MessageType msg;
+    uint8_t channel;
+    bool compressed;
+    const uint8_t *payload;
+    size_t payloadLen;
+
+    if(!parseIncomingPayload(frame, length, ack, msg, channel, compressed, payload, payloadLen)) {
+        LT_LOG(UDP, LT_LOG_WARN, "Failed to parse UDP payload from %s", src.text().c_str());
+        stats.framesDropped++;
+        return;
+    }
+
+    LT_LOG(UDP, LT_LOG_VERBOSE, "Parsed UDP msg %02x ack %02x, payload %d bytes",
+           static_cast<int>(msg), static_cast<int>(ack), static_cast<int>(payloadLen));
+
+    int column = ackColumn(ack);
+    if(column < 0) {
+        stats.framesDropped++;
+        return;
+    }
+
+    RxPacket rx = {src, ack, msg, channel, compressed, payload, payloadLen};
+    if(static_cast<size_t>(msg) < kRoutedTypes) {
+        const Route &route = kRoutes[msg][column];
+        if(route.handler && (route.role == kAny || route.role == only(role)) &&
+           (route.state == kAny || route.state == only(state)))
+            (this->*route.handler)(rx);
+        else
+            stats.framesDropped++;
+    } else if(msg >= MessageType::USER_FIRST && msg <= MessageType::USER_LAST) {
+        rxUserMessage(rx);
+    } else {
+        stats.framesDropped++;
+    }
+}
+
+void LightThread::rxUnreliable(const RxPacket &rx) {
+    handleNormalUdpMessage(rx.src, rx.payload, rx.length, false, rx.compressed, rx.channel);
+}
+
+void LightThread::rxReliableData(const RxPacket &rx) {
+    handleReliableData(rx.src, rx.channel, rx.type, rx.compressed, rx.payload, rx.length);
+}
+
+void LightThread::rxReliableAck(const RxPacket &rx) {
+    handleReliableAck(rx.src, rx.channel, rx.payload, rx.length);
+}
+
+void LightThread::rxFragment(const RxPacket &rx) {
+    handleFragment(rx.src, rx.channel, rx.payload, rx.length, false, rx.compressed);
+}
+
+void LightThread::rxBatch(const RxPacket &rx) { handleBatch(rx.src, rx.payload, rx.length); }
+
+// A REQUEST is a unicast retransmission, ACKed at once
+void LightThread::rxGroupData(const RxPacket &rx) {
+    handleGroupData(rx.src, rx.ack == AckType::REQUEST, rx.compressed, rx.payload, rx.length);
+}
+
+void LightThread::rxGroupAck(const RxPacket &rx) { handleGroupAck(rx.src, rx.payload, rx.length); }
+
+void LightThread::rxBeacon(const RxPacket &rx) { handleBeacon(rx.src, rx.payload, rx.length); }
+
+// Hands an application message to its handler, in place unless it has to be decompressed.
+void LightThread::rxUserMessage(const RxPacket &rx) {
+    uint8_t slot = userRoutes[rx.type - MessageType::USER_FIRST];
+    if(slot == 0) {
+        LT_LOG(UDP, LT_LOG_WARN, "Dispatch: No handler for message type %02x from %s",
+               static_cast<unsigned>(rx.type), rx.src.text().c_str());
+        stats.framesDropped++;
+        return;
+    }
+
+    const uint8_t *payload = rx.payload;
+    size_t length = rx.length;
+    if(rx.compressed) {
+        length = lzDecompress(payload, length, lzBuffer, sizeof(lzBuffer));
+        if(length == 0) {
+            LT_LOG(UDP, LT_LOG_WARN, "Dispatch: Corrupt compressed payload from %s",
+                   rx.src.text().c_str());
+            return;
+        }
+        payload = lzBuffer;
+    }
+
+    lzBufferLent = rx.compressed;
+    messageHandlers[slot - 1](rx.src, rx.ack, payload, length);
+    lzBufferLent = false;
+}
+
+// Registers `fn` for an application message type (MessageType::USER_FIRST to USER_LAST).
+// Messages of that type are passed to it without copying. Registering again replaces the
+// handler; nullptr removes it. Returns false if the type is not an application type or
+// all LT_MESSAGE_HANDLERS handlers are taken.
+bool LightThread::registerMessageHandler(uint8_t type, MessageHandler fn) {
+    if(type < MessageType::USER_FIRST || type > MessageType::USER_LAST)
+        return false;
+
+    uint8_t &route = userRoutes[type - MessageType::USER_FIRST];
+    if(!fn) {
+        if(route != 0)
+            messageHandlers[route - 1] = nullptr;
+        route = 0;
+        return true;
+    }
+
+    if(route == 0) {
+        uint8_t slot = 0;
+        while(slot < LT_MESSAGE_HANDLERS && messageHandlers[slot])
+            ++slot;
+        if(slot == LT_MESSAGE_HANDLERS)
+            return false;
+        route = slot + 1;
+    }
+    messageHandlers[route - 1] = fn;
+    return true;
+}
+
+// Sends one datagram of an application message type, unreliably and unfragmented; `ack`
+// is passed to the receiver's handler as is. Compressed if setUdpCompression() is on.
+// Call it from the task running update() only: unlike sendUdp(), it has no queue for
+// other tasks.
+SendStatus LightThread::sendMessage(const Ip6Address &dest, uint8_t type, const uint8_t *payload,
+                                    size_t length, AckType ack) {
+    if(type < MessageType::USER_FIRST || type > MessageType::USER_LAST || dest.isUnspecified())
+        return SendStatus::INVALID;
+
+    bool compressed = compressForSend(payload, length);
+    if(2 + length > udpMtu)
+        return SendStatus::TOO_LARGE;
+
+    if(!sendUdpPacket(ack, static_cast<MessageType>(type), payload, length, dest, LT_UDP_PORT,
+                      compressed))
+        return SendStatus::SEND_FAILED;
+    return SendStatus::OK;
+}
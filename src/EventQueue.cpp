@@ -0,0 +1,141 @@
+#include "LightThread.h"
+#include <new>
+
+static_assert((LT_EVENT_BYTES & (LT_EVENT_BYTES - 1)) == 0, "LT_EVENT_BYTES is a power of two");
+static_assert(LT_EVENT_BYTES >= LT_MAX_MESSAGE_SIZE, "the largest message must fit");
+static_assert(LT_EVENT_SLOTS >= 2 && LT_EVENT_SLOTS <= 255, "event indices are uint8_t");
+
+// With deferred delivery on, the receive, reliable and group status, join, leave and
+// publish callbacks no longer run inside update(): their events are queued, payload
+// included, and the callbacks run when the application calls poll(), typically from its
+// own task. update() then never waits on the application, so ACKs go out and the CLI is
+// drained at the same pace however slow the handlers are. Events that find the queue full
+// are dropped and counted in Stats::eventsDropped. Events already queued when it is
+// turned off are still delivered by poll(). The queue, about LT_EVENT_BYTES, is allocated
+// the first time it is turned on; returns false, leaving it off, if that fails.
+bool LightThread::setDeferredDelivery(bool enabled) {
+    if(enabled && !eventRing) {
+        eventRing.reset(new(std::nothrow) EventRing);
+        if(!eventRing) {
+            LT_LOG(UDP, LT_LOG_ERROR, "EventQueue: No memory for %u bytes of events",
+                   static_cast<unsigned>(sizeof(EventRing)));
+            return false;
+        }
+    }
+    deferredDelivery = enabled;
+    return true;
+}
+
+// Runs the callbacks of up to `maxEvents` queued events, oldest first, in the calling task.
+// Returns how many ran. Only one task may poll. A view callback's payload lies in the
+// queue and is valid for the duration of the call. Callbacks that call back into
+// LightThread must not do so while update() runs in another task, sendUdp() excepted.
+size_t LightThread::poll(size_t maxEvents) {
+    size_t count = 0;
+    uint8_t tail = eventTail.load(std::memory_order_relaxed);
+
+    while(count < maxEvents && tail != eventHead.load(std::memory_order_acquire)) {
+        const Event &event = eventRing->events[tail];
+        deliverEvent(event, eventRing->data + (event.dataStart & (LT_EVENT_BYTES - 1)));
+
+        eventDataTail.store(event.dataStart + event.length, std::memory_order_release);
+        tail = (tail + 1) % LT_EVENT_SLOTS;
+        eventTail.store(tail, std::memory_order_release);
+        count++;
+    }
+    return count;
+}
+
+// Queues one callback event. Its data is copied contiguously, skipping the end of the ring
+// if it would wrap. Returns false, counting the drop, if there is no room.
+bool LightThread::pushEvent(EventKind kind, uint8_t channel, bool flag, uint16_t id,
+                            const Ip6Address &addr, const uint8_t *data, size_t length) {
+    uint8_t head = eventHead.load(std::memory_order_relaxed);
+    uint8_t next = (head + 1) % LT_EVENT_SLOTS;
+    uint8_t tail = eventTail.load(std::memory_order_acquire);
+
+    uint32_t start = eventDataHead;
+    size_t pos = start & (LT_EVENT_BYTES - 1);
+    if(pos + length > LT_EVENT_BYTES)
+        start += LT_EVENT_BYTES - pos;
+
+    if(next == tail ||
+       start + length - eventDataTail.load(std::memory_order_acquire) > LT_EVENT_BYTES) {
+        stats.eventsDropped++;
+        LT_LOG(UDP, LT_LOG_WARN, "EventQueue: Full, dropped event %u from %s",
+               static_cast<unsigned>(kind), addr.text().c_str());
+        return false;
+    }
+
+    if(length > 0)
+        memcpy(eventRing->data + (start & (LT_EVENT_BYTES - 1)), data, length);
+    Event &event = eventRing->events[head];
+    event.kind = kind;
+    event.channel = channel;
+    event.flag = flag;
+    event.id = id;
+    event.length = length;
+    event.dataStart = start;
+    event.addr = addr;
+    eventDataHead = start + length;
+    eventHead.store(next, std::memory_order_release);
+
+    uint32_t depth = (next + LT_EVENT_SLOTS - tail) % LT_EVENT_SLOTS;
+    if(depth > stats.eventQueueHighWater)
+        stats.eventQueueHighWater = depth;
+    return true;
+}
+
+// Runs the callback an event stands for.
+void LightThread::deliverEvent(const Event &event, const uint8_t *data) {
+    switch(event.kind) {
+    case EventKind::RECEIVE: {
+        UdpViewCallback &callback =
+            event.channel == 0 ? udpCallback : channelCallbacks[event.channel - 1].receive;
+        if(callback)
+            callback(event.addr, event.flag, data, event.length);
+        break;
+    }
+    case EventKind::RELIABLE_STATUS: {
+        StatusCallback &callback =
+            event.channel == 0 ? reliableCallback : channelCallbacks[event.channel - 1].status;
+        if(callback)
+            callback(event.id, event.addr, event.flag);
+        break;
+    }
+    case EventKind::GROUP_STATUS:
+        if(groupCallback)
+            groupCallback(event.id, event.addr, event.flag);
+        break;
+    case EventKind::JOIN:
+        if(joinCallback)
+            joinCallback(event.addr, String(reinterpret_cast<const char *>(data)));
+        break;
+    case EventKind::LEAVE:
+        if(leaveCallback)
+            leaveCallback(event.addr, String(reinterpret_cast<const char *>(data)));
+        break;
+    case EventKind::PUBLISH:
+        if(publishCallback)
+            publishCallback(event.id, event.addr, data, event.length);
+        break;
+    }
+}
+
+// Fires the join callback now, or queues it in deferred mode. The hash is queued with its
+// terminator.
+void LightThread::notifyJoin(const Ip6Address &ip, const String &hashmac) {
+    if(deferredDelivery)
+        pushEvent(EventKind::JOIN, 0, false, 0, ip,
+                  reinterpret_cast<const uint8_t *>(hashmac.c_str()), hashmac.length() + 1);
+    else if(joinCallback)
+        joinCallback(ip, hashmac);
+}
+
+void LightThread::notifyLeave(const Ip6Address &ip, const String &hashmac) {
+    if(deferredDelivery)
+        pushEvent(EventKind::LEAVE, 0, false, 0, ip,
+                  reinterpret_cast<const uint8_t *>(hashmac.c_str()), hashmac.length() + 1);
+    else if(leaveCallback)
+        leaveCallback(ip, hashmac);
+}
@@ -0,0 +1,274 @@
+#include "LightThread.h"
+#include "esp_random.h"
+
+static const size_t kFragmentHeader = 6;   // tag:16, index:8, count:8, offset:16
+static const size_t kReliableOverhead = 3; // seq:16, flags:8 of the reliable stream
+
+static_assert(LT_MAX_MESSAGE_SIZE <= 0xFFFF, "fragment offsets are 16-bit");
+static_assert(LT_RELIABLE_PAYLOAD_SIZE > kFragmentHeader, "a reliable slot must hold a fragment");
+
+static void writeFragmentHeader(uint8_t *buf, uint16_t tag, uint8_t index, uint8_t count,
+                                uint16_t offset) {
+    buf[0] = tag >> 8;
+    buf[1] = tag & 0xFF;
+    buf[2] = index;
+    buf[3] = count;
+    buf[4] = offset >> 8;
+    buf[5] = offset & 0xFF;
+}
+
+// Data bytes one fragment on `channel` carries at the current MTU.
+size_t LightThread::fragmentChunk(bool reliable, uint8_t channel) const {
+    size_t chunk = udpMtu - frameOverhead(channel) - kFragmentHeader;
+    if(reliable)
+        chunk -= kReliableOverhead;
+    if(reliable && chunk > LT_RELIABLE_PAYLOAD_SIZE - kFragmentHeader)
+        chunk = LT_RELIABLE_PAYLOAD_SIZE - kFragmentHeader;
+    return chunk;
+}
+
+// Returns a fresh message tag. Tags start at a random value so a restarted sender does not
+// reuse tags a receiver still remembers; 0 is never used.
+uint16_t LightThread::nextFragmentTag() {
+    while(fragmentTag == 0)
+        fragmentTag = static_cast<uint16_t>(esp_random());
+
+    uint16_t tag = fragmentTag++;
+    if(fragmentTag == 0)
+        fragmentTag = 1;
+    return tag;
+}
+
+// Sends an unreliable payload as a burst of fragments. Losing any fragment loses the
+// message; the receiver discards the rest after LT_REASSEMBLY_TIMEOUT.
+SendStatus LightThread::sendFragmented(const Ip6Address &dest, uint8_t channel,
+                                       const uint8_t *payload, size_t length, bool compressed) {
+    size_t chunk = fragmentChunk(false, channel);
+    size_t count = (length + chunk - 1) / chunk;
+    if(count > 255)
+        return SendStatus::TOO_LARGE;
+
+    uint16_t tag = nextFragmentTag();
+    uint8_t frame[LT_MAX_UDP_FRAME];
+
+    for(size_t i = 0; i < count; ++i) {
+        size_t offset = i * chunk;
+        size_t n = std::min(chunk, length - offset);
+        writeFragmentHeader(frame, tag, i, count, offset);
+        memcpy(frame + kFragmentHeader, payload + offset, n);
+        if(!sendUdpPacket(AckType::NONE, MessageType::FRAGMENT, frame, kFragmentHeader + n,
+                          dest, LT_UDP_PORT, compressed, channel))
+            return SendStatus::SEND_FAILED;
+        stats.fragmentsSent++;
+    }
+    return SendStatus::OK;
+}
+
+// Copies a reliable payload into a fragment send buffer. Its fragments are fed into the
+// destination's reliable stream by pumpFragmentTx(), a window at a time, and the status
+// callback fires once for the whole payload.
+SendStatus LightThread::queueFragmented(const Ip6Address &dest, uint8_t channel,
+                                        const uint8_t *payload, size_t length, bool compressed) {
+    if(dest.isUnspecified()) {
+        LT_LOG(UDP, LT_LOG_WARN, "Fragment: Invalid destination %s", dest.text().c_str());
+        return SendStatus::INVALID;
+    }
+
+    size_t chunk = fragmentChunk(true, channel);
+    size_t count = (length + chunk - 1) / chunk;
+    if(count > 255)
+        return SendStatus::TOO_LARGE;
+
+    FragmentTx *tx = nullptr;
+    for(FragmentTx &entry : fragmentTx) {
+        if(!entry.inUse) {
+            tx = &entry;
+            break;
+        }
+    }
+    if(!tx || reliableSlotsUsed == LT_RELIABLE_SLOTS)
+        return SendStatus::QUEUE_FULL;
+
+    ReliablePeer *peer = reliablePeer(dest, channel);
+    if(!peer) {
+        LT_LOG(UDP, LT_LOG_WARN, "Fragment: No free peer entry for %s", dest.text().c_str());
+        return SendStatus::QUEUE_FULL;
+    }
+
+    tx->inUse = true;
+    tx->failed = false;
+    tx->compressed = compressed;
+    tx->peer = peer - reliablePeers;
+    tx->count = count;
+    tx->nextIndex = 0;
+    tx->outstanding = 0;
+    tx->acked = 0;
+    tx->tag = nextFragmentTag();
+    tx->chunk = chunk;
+    tx->length = length;
+    memcpy(tx->data, payload, length);
+
+    LT_LOG(UDP, LT_LOG_INFO, "Fragment: Sending %u bytes to %s in %u fragments",
+           static_cast<unsigned>(length), dest.text().c_str(), static_cast<unsigned>(count));
+
+    pumpFragmentTx(); // queues the first fragment now, which assigns the msgId
+    return SendStatus::OK;
+}
+
+// Queues further fragments of each fragmented send while reliable slots are free, keeping
+// at most a window of them queued so other messages still find slots. Reports sends whose
+// fragments have all settled.
+void LightThread::pumpFragmentTx() {
+    for(uint8_t i = 0; i < LT_FRAGMENT_TX_SLOTS; ++i) {
+        FragmentTx &tx = fragmentTx[i];
+        if(!tx.inUse)
+            continue;
+
+        ReliablePeer &peer = reliablePeers[tx.peer];
+        while(!tx.failed && tx.nextIndex < tx.count && tx.outstanding < reliableWindow &&
+              reliableSlotsUsed < LT_RELIABLE_SLOTS) {
+            uint8_t buf[LT_RELIABLE_PAYLOAD_SIZE];
+            size_t offset = tx.nextIndex * tx.chunk;
+            size_t n = std::min<size_t>(tx.chunk, tx.length - offset);
+            writeFragmentHeader(buf, tx.tag, tx.nextIndex, tx.count, offset);
+            memcpy(buf + kFragmentHeader, tx.data + offset, n);
+
+            uint16_t seq = appendReliable(peer, MessageType::FRAGMENT, tx.compressed, buf,
+                                          kFragmentHeader + n, i);
+            if(tx.nextIndex == 0)
+                tx.msgId = seq;
+            tx.nextIndex++;
+            tx.outstanding++;
+            stats.fragmentsSent++;
+        }
+
+        bool delivered = tx.acked == tx.count;
+        if(!delivered && !(tx.failed && tx.outstanding == 0))
+            continue;
+
+        tx.inUse = false; // free before the callback, which may send again
+        LT_LOG(UDP, LT_LOG_INFO, "Fragment: msgId %u to %s %s", tx.msgId, peer.addr.text().c_str(),
+               delivered ? "delivered" : "failed");
+        reportReliable(peer.channel, tx.msgId, peer.addr, delivered);
+    }
+}
+
+// Records the outcome of one reliable fragment. A dropped fragment fails the whole payload.
+void LightThread::fragmentSettled(uint8_t fragTx, bool acked) {
+    FragmentTx &tx = fragmentTx[fragTx];
+    tx.outstanding--;
+    if(acked)
+        tx.acked++;
+    else
+        tx.failed = true;
+}
+
+// Returns the reassembly slot for the message a fragment belongs to, claiming one if this
+// is its first fragment. Free slots are used first, then the oldest completed or timed-out
+// one. Returns nullptr if every slot holds a message still being reassembled.
+LightThread::ReassemblySlot *LightThread::reassemblySlot(const Ip6Address &src, uint8_t channel,
+                                                         const uint8_t *fragment,
+                                                         size_t length) {
+    if(length < kFragmentHeader)
+        return nullptr;
+
+    uint16_t tag = (fragment[0] << 8) | fragment[1];
+    uint8_t count = fragment[3];
+    unsigned long now = millis();
+    ReassemblySlot *victim = nullptr;
+
+    for(ReassemblySlot &slot : reassembly) {
+        if(slot.inUse && slot.tag == tag && slot.channel == channel && slot.src == src) {
+            if(slot.count == count)
+                return &slot;
+            victim = &slot; // same tag, different message: start over
+            break;
+        }
+    }
+
+    for(ReassemblySlot &slot : reassembly) {
+        if(victim)
+            break;
+        if(!slot.inUse) {
+            victim = &slot;
+            break;
+        }
+    }
+
+    if(!victim) {
+        for(ReassemblySlot &slot : reassembly) {
+            bool stale = slot.complete || now - slot.lastUpdate >= LT_REASSEMBLY_TIMEOUT;
+            if(stale && (!victim || timeBefore(slot.lastUpdate, victim->lastUpdate)))
+                victim = &slot;
+        }
+    }
+
+    if(!victim)
+        return nullptr;
+
+    if(victim->inUse && !victim->complete) {
+        stats.reassemblyDropped++;
+        LT_LOG(UDP, LT_LOG_WARN, "Fragment: Abandoned incomplete message (%u of %u fragments)",
+               victim->received, victim->count);
+    }
+
+    victim->inUse = true;
+    victim->complete = false;
+    victim->src = src;
+    victim->channel = channel;
+    victim->tag = tag;
+    victim->count = count;
+    victim->received = 0;
+    victim->length = 0;
+    victim->lastUpdate = now;
+    memset(victim->have, 0, sizeof(victim->have));
+    return victim;
+}
+
+// Stores one fragment and delivers the payload once every fragment has arrived.
+void LightThread::handleFragment(const Ip6Address &src, uint8_t channel, const uint8_t *payload,
+                                 size_t length, bool reliable, bool compressed) {
+    if(length < kFragmentHeader) {
+        LT_LOG(UDP, LT_LOG_WARN, "Fragment: Too short from %s", src.text().c_str());
+        return;
+    }
+
+    uint8_t index = payload[2];
+    uint8_t count = payload[3];
+    uint16_t offset = (payload[4] << 8) | payload[5];
+    const uint8_t *data = payload + kFragmentHeader;
+    size_t dataLen = length - kFragmentHeader;
+
+    if(count == 0 || index >= count || offset + dataLen > LT_MAX_MESSAGE_SIZE) {
+        LT_LOG(UDP, LT_LOG_WARN, "Fragment: Malformed fragment from %s", src.text().c_str());
+        return;
+    }
+
+    ReassemblySlot *slot = reassemblySlot(src, channel, payload, length);
+    if(!slot) {
+        LT_LOG(UDP, LT_LOG_WARN, "Fragment: No reassembly slot free, dropping fragment from %s",
+               src.text().c_str());
+        return;
+    }
+
+    slot->lastUpdate = millis();
+    uint32_t bit = 1UL << (index % 32);
+    uint32_t &word = slot->have[index / 32];
+    if(slot->complete || (word & bit))
+        return; // duplicate
+
+    word |= bit;
+    memcpy(slot->data + offset, data, dataLen);
+    slot->received++;
+    if(index == count - 1)
+        slot->length = offset + dataLen;
+
+    if(slot->received < slot->count)
+        return;
+
+    slot->complete = true;
+    stats.messagesReassembled++;
+    LT_LOG(UDP, LT_LOG_INFO, "Fragment: Reassembled %u bytes from %s", slot->length,
+           src.text().c_str());
+    handleNormalUdpMessage(src, slot->data, slot->length, reliable, compressed, channel);
+}
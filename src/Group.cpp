@@ -0,0 +1,273 @@
+#include "LightThread.h"
+#include "esp_random.h"
+#include <new>
+
+static const size_t kGroupHeader = 4; // id:16, ACK window:16
+
+static_assert(LT_GROUP_MEMBERS <= 0xFFFF, "member counts are 16-bit");
+static_assert(LT_GROUP_MEMBERS >= LT_MAX_JOINERS, "a group send covers every joiner");
+
+static void writeGroupHeader(uint8_t *buf, uint16_t id, uint16_t ackWindow) {
+    buf[0] = id >> 8;
+    buf[1] = id & 0xFF;
+    buf[2] = ackWindow >> 8;
+    buf[3] = ackWindow & 0xFF;
+}
+
+// Sends one payload to every joiner in the registry with a single multicast
+// datagram, then tracks an ACK from each of them. Receivers spread their ACKs over a window
+// that grows with the group size; members that have not ACKed once it has passed get
+// unicast retransmissions until reliableDeadline. The group status callback reports each
+// member's outcome. `groupId`, if given, receives the id passed to that callback.
+// The payload must fit in one frame (no fragmentation). Only for the task running update();
+// other tasks cannot hand a group send over the way they can a sendUdp().
+SendStatus LightThread::sendGroup(const std::vector<uint8_t> &payload, uint16_t *groupId) {
+    const uint8_t *data = payload.data();
+    size_t size = payload.size();
+    bool compressed = compressForSend(data, size);
+
+    if(2 + kGroupHeader + size > udpMtu || size > LT_RELIABLE_PAYLOAD_SIZE)
+        return SendStatus::TOO_LARGE;
+    if(joiners.size() == 0) {
+        LT_LOG(UDP, LT_LOG_WARN, "Group: No joiners known, nothing to send");
+        return SendStatus::INVALID;
+    }
+
+    if(!groupSends) {
+        groupSends.reset(new(std::nothrow) GroupSend[LT_GROUP_SENDS]);
+        if(!groupSends) {
+            LT_LOG(UDP, LT_LOG_ERROR, "Group: No memory for the group send table");
+            return SendStatus::QUEUE_FULL;
+        }
+    }
+
+    GroupSend *group = nullptr;
+    for(size_t i = 0; i < LT_GROUP_SENDS && !group; ++i) {
+        if(!groupSends[i].inUse)
+            group = &groupSends[i];
+    }
+    if(!group)
+        return SendStatus::QUEUE_FULL;
+
+    group->memberCount = 0;
+    joiners.forEach([group](const JoinerInfo &joiner) {
+        GroupMember &member = group->members[group->memberCount++];
+        member.addr = joiner.addr;
+        member.acked = false;
+    });
+
+    while(groupSeq == 0)
+        groupSeq = static_cast<uint16_t>(esp_random());
+
+    unsigned long ackWindow = group->memberCount * LT_GROUP_ACK_SPACING;
+    if(ackWindow > 0xFFFF)
+        ackWindow = 0xFFFF;
+
+    unsigned long now = millis();
+    group->inUse = true;
+    group->compressed = compressed;
+    group->id = groupSeq++;
+    group->ackWindow = ackWindow;
+    group->pending = group->memberCount;
+    group->rto = LT_RELIABLE_INITIAL_RTO;
+    // ACKs are spread over the window; allow one more minimum RTO for the last to arrive
+    group->retryAt = now + ackWindow + LT_RELIABLE_MIN_RTO;
+    group->deadline = now + ackWindow + reliableDeadline;
+    group->length = size;
+    memcpy(group->payload, data, size);
+    if(groupId)
+        *groupId = group->id;
+
+    LT_LOG(UDP, LT_LOG_INFO, "Group: Sending id %u to %u joiners", group->id, group->memberCount);
+
+    uint8_t buf[LT_MAX_UDP_FRAME];
+    writeGroupHeader(buf, group->id, group->ackWindow);
+    memcpy(buf + kGroupHeader, group->payload, group->length);
+    if(!sendUdpPacket(AckType::NONE, MessageType::GROUP, buf, kGroupHeader + group->length,
+                      Ip6Address::realmLocalAllNodes(), LT_UDP_PORT, compressed)) {
+        group->inUse = false;
+        return SendStatus::SEND_FAILED;
+    }
+
+    if(compressed) {
+        stats.messagesCompressed++;
+        stats.compressionSaved += payload.size() - size;
+    }
+    return SendStatus::OK;
+}
+
+// Retransmits group messages by unicast to members that have not ACKed, fails members
+// still silent at the deadline, and sends delayed ACKs that are due. Called once per
+// update().
+void LightThread::updateGroups() {
+    unsigned long now = millis();
+
+    for(GroupAck &ack : groupAcks) {
+        if(ack.inUse && !timeBefore(now, ack.dueAt)) {
+            ack.inUse = false;
+            sendGroupAck(ack.dest, ack.id);
+        }
+    }
+
+    if(!groupSends)
+        return; // no group sent yet
+
+    for(size_t g = 0; g < LT_GROUP_SENDS; ++g) {
+        GroupSend &group = groupSends[g];
+        if(!group.inUse)
+            continue;
+
+        if(!timeBefore(now, group.deadline)) {
+            LT_LOG(UDP, LT_LOG_WARN, "Group: id %u undelivered to %u of %u joiners", group.id,
+                   group.pending, group.memberCount);
+            // Counted down rather than checking inUse: the last callback may reuse the entry
+            for(uint16_t i = 0, left = group.pending; left > 0; ++i) {
+                if(!group.members[i].acked) {
+                    left--;
+                    settleGroupMember(group, group.members[i], false);
+                }
+            }
+            continue;
+        }
+
+        if(timeBefore(now, group.retryAt))
+            continue;
+
+        uint8_t buf[LT_MAX_UDP_FRAME];
+        writeGroupHeader(buf, group.id, 0);
+        memcpy(buf + kGroupHeader, group.payload, group.length);
+
+        for(uint16_t i = 0; i < group.memberCount; ++i) {
+            const GroupMember &member = group.members[i];
+            if(member.acked)
+                continue;
+
+            sendUdpPacket(AckType::REQUEST, MessageType::GROUP, buf, kGroupHeader + group.length,
+                          member.addr, LT_UDP_PORT, group.compressed);
+            stats.retransmissions++;
+            stats.retransmittedBytes += 2 + kGroupHeader + group.length;
+        }
+
+        group.retryAt = now + group.rto;
+        group.rto = std::min<unsigned long>(group.rto * 2, LT_RELIABLE_MAX_RTO);
+    }
+}
+
+// Records a member's outcome and reports it. The group is freed once every member has
+// settled.
+void LightThread::settleGroupMember(GroupSend &group, GroupMember &member, bool success) {
+    member.acked = true; // settled either way
+    group.pending--;
+    if(group.pending == 0)
+        group.inUse = false; // free before the callback, which may send again
+
+    if(deferredDelivery)
+        pushEvent(EventKind::GROUP_STATUS, 0, success, group.id, member.addr, nullptr, 0);
+    else if(groupCallback)
+        groupCallback(group.id, member.addr, success);
+}
+
+// Handles a member's ACK of a group message.
+void LightThread::handleGroupAck(const Ip6Address &src, const uint8_t *payload, size_t length) {
+    if(length < 2 || !groupSends)
+        return;
+
+    uint16_t id = (payload[0] << 8) | payload[1];
+    for(size_t g = 0; g < LT_GROUP_SENDS; ++g) {
+        GroupSend &group = groupSends[g];
+        if(!group.inUse || group.id != id)
+            continue;
+
+        for(uint16_t i = 0; i < group.memberCount; ++i) {
+            GroupMember &member = group.members[i];
+            if(!member.acked && member.addr == src) {
+                settleGroupMember(group, member, true);
+                return;
+            }
+        }
+    }
+}
+
+// Handles a group message: delivers it unless already seen, then ACKs it. A multicast copy
+// is ACKed after a random delay within the sender's window so members do not all answer at
+// once; a unicast retransmission is ACKed immediately.
+void LightThread::handleGroupData(const Ip6Address &src, bool unicast, bool compressed,
+                                  const uint8_t *payload, size_t length) {
+    if(length < kGroupHeader) {
+        LT_LOG(UDP, LT_LOG_WARN, "Group: Message too short from %s", src.text().c_str());
+        return;
+    }
+
+    uint16_t id = (payload[0] << 8) | payload[1];
+    uint16_t ackWindow = (payload[2] << 8) | payload[3];
+
+    if(groupSeen(src, id))
+        stats.duplicatesSuppressed++;
+    else
+        handleNormalUdpMessage(src, payload + kGroupHeader, length - kGroupHeader, true,
+                               compressed);
+
+    if(unicast || ackWindow == 0) {
+        sendGroupAck(src, id);
+        return;
+    }
+
+    GroupAck *slot = nullptr;
+    for(GroupAck &ack : groupAcks) {
+        if(ack.inUse && ack.id == id && ack.dest == src)
+            return; // already scheduled
+        if(!ack.inUse && !slot)
+            slot = &ack;
+    }
+    if(!slot) {
+        sendGroupAck(src, id);
+        return;
+    }
+
+    slot->inUse = true;
+    slot->dest = src;
+    slot->id = id;
+    slot->dueAt = millis() + esp_random() % (ackWindow + 1UL);
+}
+
+// Returns true if the group message was seen before; otherwise remembers it.
+bool LightThread::groupSeen(const Ip6Address &src, uint16_t id) {
+    for(const SeenGroup &seen : seenGroups) {
+        if(seen.valid && seen.id == id && seen.src == src)
+            return true;
+    }
+
+    SeenGroup &entry = seenGroups[seenGroupNext];
+    seenGroupNext = (seenGroupNext + 1) % LT_GROUP_HISTORY;
+    entry.valid = true;
+    entry.src = src;
+    entry.id = id;
+    return false;
+}
+
+void LightThread::sendGroupAck(const Ip6Address &dest, uint16_t id) {
+    uint8_t buf[2] = {static_cast<uint8_t>(id >> 8), static_cast<uint8_t>(id & 0xFF)};
+    sendUdpPacket(AckType::RESPONSE, MessageType::GROUP, buf, sizeof(buf), dest, LT_UDP_PORT);
+}
+
+// Earliest time group work is due (a retransmission, deadline or delayed ACK).
+// Returns false if nothing is scheduled.
+bool LightThread::nextGroupEvent(unsigned long &due) const {
+    bool any = false;
+    auto consider = [&](unsigned long t) {
+        if(!any || timeBefore(t, due))
+            due = t;
+        any = true;
+    };
+
+    for(const GroupAck &ack : groupAcks) {
+        if(ack.inUse)
+            consider(ack.dueAt);
+    }
+    for(size_t g = 0; groupSends && g < LT_GROUP_SENDS; ++g) {
+        const GroupSend &group = groupSends[g];
+        if(group.inUse)
+            consider(timeBefore(group.deadline, group.retryAt) ? group.deadline : group.retryAt);
+    }
+    return any;
+}
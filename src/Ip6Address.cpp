@@ -0,0 +1,214 @@
+#include "Ip6Address.h"
+#include <array>
+
+static const char kHexDigits[] = "0123456789abcdef";
+
+// Maps an ASCII character to its nibble value, or -1 if it is not a hex digit.
+static constexpr std::array<int8_t, 256> makeHexTable() {
+    std::array<int8_t, 256> table = {};
+    for(int c = 0; c < 256; ++c) {
+        if(c >= '0' && c <= '9')
+            table[c] = c - '0';
+        else if(c >= 'a' && c <= 'f')
+            table[c] = c - 'a' + 10;
+        else if(c >= 'A' && c <= 'F')
+            table[c] = c - 'A' + 10;
+        else
+            table[c] = -1;
+    }
+    return table;
+}
+
+static constexpr std::array<int8_t, 256> kHexValue = makeHexTable();
+
+// Parses a dotted-quad IPv4 address filling the whole of `text` into 4 bytes.
+static bool parseIp4(const char *text, size_t length, uint8_t *out) {
+    size_t i = 0;
+    for(int octet = 0; octet < 4; ++octet) {
+        if(octet > 0) {
+            if(i >= length || text[i] != '.')
+                return false;
+            ++i;
+        }
+
+        size_t start = i;
+        unsigned value = 0;
+        while(i < length && i - start < 3 && text[i] >= '0' && text[i] <= '9')
+            value = value * 10 + (text[i++] - '0');
+        if(i == start || value > 255 || (text[start] == '0' && i - start > 1))
+            return false; // empty, too large, or a leading zero (octal to some parsers)
+        out[octet] = value;
+    }
+    return i == length;
+}
+
+// Single pass over the text: groups are written in order and the bytes after a "::" are
+// moved to the end once their count is known.
+bool Ip6Address::parse(const char *text, size_t length, Ip6Address &out) {
+    uint8_t bytes[16];
+    size_t n = 0; // bytes written
+    int gap = -1; // position of "::"
+    size_t i = 0;
+
+    if(length >= 2 && text[0] == ':' && text[1] == ':') {
+        gap = 0;
+        i = 2;
+    }
+
+    while(i < length) {
+        size_t start = i;
+        unsigned group = 0;
+        while(i < length && i - start < 4) {
+            int digit = kHexValue[static_cast<uint8_t>(text[i])];
+            if(digit < 0)
+                break;
+            group = (group << 4) | digit;
+            ++i;
+        }
+        if(i == start)
+            return false;
+
+        if(i < length && text[i] == '.') {
+            // Embedded IPv4 address: must be the last 4 bytes
+            if(n > 12 || !parseIp4(text + start, length - start, bytes + n))
+                return false;
+            n += 4;
+            break;
+        }
+
+        if(n == 16)
+            return false;
+        bytes[n++] = group >> 8;
+        bytes[n++] = group & 0xFF;
+
+        if(i == length)
+            break;
+        if(text[i++] != ':' || i == length)
+            return false;
+        if(text[i] == ':') {
+            if(gap >= 0)
+                return false;
+            gap = n;
+            ++i;
+        }
+    }
+
+    if(gap < 0) {
+        if(n != 16)
+            return false;
+    } else {
+        if(n > 14) // "::" stands for at least one group
+            return false;
+        size_t tail = n - gap;
+        memmove(bytes + 16 - tail, bytes + gap, tail);
+        memset(bytes + gap, 0, 16 - n);
+    }
+
+    memcpy(out.bytes, bytes, sizeof(bytes));
+    return true;
+}
+
+bool Ip6Address::parse(const char *text, Ip6Address &out) {
+    return parse(text, strlen(text), out);
+}
+
+size_t Ip6Address::format(char *out, size_t outCap) const {
+    uint16_t groups[8];
+    for(int g = 0; g < 8; ++g)
+        groups[g] = (bytes[2 * g] << 8) | bytes[2 * g + 1];
+
+    // Longest run of two or more zero groups, the first one on a tie
+    int zeroStart = -1;
+    int zeroLen = 1;
+    for(int g = 0; g < 8;) {
+        int run = 0;
+        while(g + run < 8 && groups[g + run] == 0)
+            ++run;
+        if(run > zeroLen) {
+            zeroStart = g;
+            zeroLen = run;
+        }
+        g += run > 0 ? run : 1;
+    }
+
+    // IPv4-mapped (::ffff:0:0/96) and IPv4-compatible addresses end in dotted decimal,
+    // chosen the way glibc's inet_ntop chooses it
+    bool ip4Tail = zeroStart == 0 && (zeroLen == 6 || (zeroLen == 5 && groups[5] == 0xFFFF));
+
+    // Written in place when the longest form fits, so the common call copies nothing
+    char scratch[kStringSize];
+    char *text = outCap >= kStringSize ? out : scratch;
+    size_t pos = 0;
+    for(int g = 0; g < 8; ++g) {
+        if(g == 6 && ip4Tail) {
+            for(int i = 12; i < 16; ++i) {
+                unsigned v = bytes[i];
+                if(v >= 100)
+                    text[pos++] = '0' + v / 100;
+                if(v >= 10)
+                    text[pos++] = '0' + v / 10 % 10;
+                text[pos++] = '0' + v % 10;
+                if(i < 15)
+                    text[pos++] = '.';
+            }
+            break;
+        }
+        if(g == zeroStart) {
+            text[pos++] = ':';
+            if(g == 0)
+                text[pos++] = ':';
+            g += zeroLen - 1;
+            continue;
+        }
+
+        unsigned v = groups[g];
+        int shift = v >= 0x1000 ? 12 : v >= 0x100 ? 8 : v >= 0x10 ? 4 : 0;
+        for(; shift >= 0; shift -= 4)
+            text[pos++] = kHexDigits[(v >> shift) & 0xF];
+        if(g < 7)
+            text[pos++] = ':';
+    }
+
+    if(text == scratch) {
+        if(pos + 1 > outCap)
+            return 0;
+        memcpy(out, scratch, pos);
+    }
+    out[pos] = '\0';
+    return pos;
+}
+
+Ip6Address::Text Ip6Address::text() const {
+    Text text;
+    format(text.data, sizeof(text.data));
+    return text;
+}
+
+String Ip6Address::toString() const { return String(text().c_str()); }
+
+Ip6Address Ip6Address::fromOt(const otIp6Address &addr) {
+    Ip6Address out;
+    memcpy(out.bytes, addr.mFields.m8, sizeof(out.bytes));
+    return out;
+}
+
+otIp6Address Ip6Address::toOt() const {
+    otIp6Address out;
+    memcpy(out.mFields.m8, bytes, sizeof(bytes));
+    return out;
+}
+
+bool Ip6Address::isUnspecified() const { return *this == Ip6Address{}; }
+
+// Folds the four 32-bit words through a multiplicative mix; the interface identifier in
+// the low bytes varies most between mesh peers, so every byte contributes.
+uint32_t Ip6Address::hash() const {
+    uint32_t h = 0;
+    for(size_t i = 0; i < sizeof(bytes); i += 4) {
+        uint32_t word;
+        memcpy(&word, bytes + i, 4);
+        h = (h ^ word) * 0x9E3779B1U;
+        h ^= h >> 15;
+    }
+    return h;
+}
@@ -0,0 +1,70 @@
+#ifndef LIGHTTHREAD_IP6ADDRESS_H
+#define LIGHTTHREAD_IP6ADDRESS_H
+
+#include <Arduino.h>
+#include <functional>
+#include <openthread/ip6.h>
+
+// An IPv6 address as its 16 network-order bytes (Ip6Address.cpp). A plain value: copying,
+// comparing and hashing never allocate, so addresses can be stored in fixed tables and
+// passed through the receive path without going through String.
+struct Ip6Address {
+    uint8_t bytes[16];
+
+    // Longest textual form, NUL included
+    static constexpr size_t kStringSize = 40;
+
+    // Textual form held on the stack, e.g. for log lines: addr.text().c_str()
+    struct Text {
+        char data[kStringSize];
+        const char *c_str() const { return data; }
+    };
+
+    // Parses textual notation ("fd00::1", "::ffff:192.0.2.1", ...). `text` need not be
+    // NUL-terminated. Returns false, leaving `out` untouched, if it is not an address.
+    static bool parse(const char *text, size_t length, Ip6Address &out);
+    static bool parse(const char *text, Ip6Address &out);
+
+    // Writes the RFC 5952 form (lowercase, longest zero run as "::", IPv4-mapped addresses
+    // as "::ffff:192.0.2.1") and a NUL; the same text as inet_ntop in glibc.
+    // Returns the length written, or 0 if `outCap` is too small.
+    size_t format(char *out, size_t outCap) const;
+    Text text() const;
+    String toString() const;
+
+    static Ip6Address fromOt(const otIp6Address &addr);
+    otIp6Address toOt() const;
+
+    bool isUnspecified() const; // "::", used as "no address"
+    bool isMulticast() const { return bytes[0] == 0xFF; }
+    uint32_t hash() const;
+
+    // ff03::1, every Thread node in the realm
+    static constexpr Ip6Address realmLocalAllNodes() {
+        return {{0xFF, 0x03, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01}};
+    }
+};
+
+static_assert(sizeof(Ip6Address) == 16, "Ip6Address must stay a bare 16-byte value");
+
+// Compares word by word without branching on the contents
+inline bool operator==(const Ip6Address &a, const Ip6Address &b) {
+    uint32_t diff = 0;
+    for(size_t i = 0; i < sizeof(a.bytes); i += 4) {
+        uint32_t x, y;
+        memcpy(&x, a.bytes + i, 4);
+        memcpy(&y, b.bytes + i, 4);
+        diff |= x ^ y;
+    }
+    return diff == 0;
+}
+
+inline bool operator!=(const Ip6Address &a, const Ip6Address &b) { return !(a == b); }
+
+namespace std {
+template <> struct hash<Ip6Address> {
+    size_t operator()(const Ip6Address &addr) const { return addr.hash(); }
+};
+} // namespace std
+
+#endif // LIGHTTHREAD_IP6ADDRESS_H
@@ -0,0 +1,157 @@
+#include "LightThread.h"
+#include <new>
+
+static_assert(LT_MAX_JOINERS > 0, "the registry needs at least one entry");
+
+// Fibonacci hashing: the top bits of the product spread MAC hashes evenly over the table.
+size_t JoinerRegistry::home(uint64_t id) const {
+    return static_cast<size_t>((id * 0x9E3779B97F4A7C15ULL) >> (64 - kTableBits));
+}
+
+// Returns the entry for a device ID, or nullptr.
+JoinerInfo *JoinerRegistry::find(uint64_t id) {
+    if(id == 0 || !table)
+        return nullptr;
+
+    JoinerInfo *slots = table->slots;
+    for(size_t i = home(id);; i = (i + 1) & (kTableSize - 1)) {
+        if(slots[i].id == id)
+            return &slots[i];
+        if(slots[i].id == 0)
+            return nullptr; // end of the probe run
+    }
+}
+
+// Returns the entry whose latest heartbeat came from `addr`, or nullptr.
+JoinerInfo *JoinerRegistry::findByAddress(const Ip6Address &addr) {
+    if(!table)
+        return nullptr;
+    for(JoinerInfo &entry : table->slots) {
+        if(entry.id != 0 && entry.addr == addr)
+            return &entry;
+    }
+    return nullptr;
+}
+
+// Returns the entry for a device ID, adding a zeroed one (id set) if it is new. Returns
+// nullptr if the registry is full, or its table cannot be allocated.
+JoinerInfo *JoinerRegistry::insert(uint64_t id) {
+    if(id == 0)
+        return nullptr;
+    if(!table)
+        table.reset(new(std::nothrow) Table);
+    if(!table)
+        return nullptr;
+
+    JoinerInfo *slots = table->slots;
+    Expiry *expiry = table->expiry;
+    size_t i = home(id);
+    for(; slots[i].id != 0; i = (i + 1) & (kTableSize - 1)) {
+        if(slots[i].id == id)
+            return &slots[i];
+    }
+    if(count == LT_MAX_JOINERS)
+        return nullptr;
+
+    slots[i] = {};
+    slots[i].id = id;
+
+    // Due at once: the first poll arms it from the lastSeen and timeout the caller sets
+    expiry[count] = {millis(), id};
+    expirySift(count);
+    count++;
+    return &slots[i];
+}
+
+// Empties a slot, moving later entries of the same probe run back so lookups never stop
+// early at the gap.
+void JoinerRegistry::removeAt(size_t hole) {
+    JoinerInfo *slots = table->slots;
+    const size_t mask = kTableSize - 1;
+    for(size_t i = (hole + 1) & mask; slots[i].id != 0; i = (i + 1) & mask) {
+        // An entry may fill the hole unless its home lies between the hole and itself
+        size_t fromHome = (i - home(slots[i].id)) & mask;
+        if(fromHome >= ((i - hole) & mask)) {
+            slots[hole] = slots[i];
+            hole = i;
+        }
+    }
+    slots[hole].id = 0;
+    count--;
+}
+
+// Moves heap entry `pos` up or down to its place.
+void JoinerRegistry::expirySift(size_t pos) {
+    Expiry *expiry = table->expiry;
+    Expiry entry = expiry[pos];
+
+    while(pos > 0) {
+        size_t parent = (pos - 1) / 2;
+        if(!timeBefore(entry.due, expiry[parent].due))
+            break;
+        expiry[pos] = expiry[parent];
+        pos = parent;
+    }
+
+    for(;;) {
+        size_t child = 2 * pos + 1;
+        if(child >= count)
+            break;
+        if(child + 1 < count && timeBefore(expiry[child + 1].due, expiry[child].due))
+            child++;
+        if(!timeBefore(expiry[child].due, entry.due))
+            break;
+        expiry[pos] = expiry[child];
+        pos = child;
+    }
+
+    expiry[pos] = entry;
+}
+
+// Removes the first joiner silent for its whole timeout at `now`, copying it to `out`.
+// Entries that come due for joiners heard from since are re-armed on the way. Returns
+// false once no joiner has expired.
+bool JoinerRegistry::popExpired(unsigned long now, JoinerInfo &out) {
+    while(count > 0 && !timeBefore(now, table->expiry[0].due)) {
+        Expiry *expiry = table->expiry;
+        JoinerInfo *joiner = find(expiry[0].id);
+        unsigned long deadline = joiner->lastSeen + joiner->timeout;
+        if(timeBefore(now, deadline)) {
+            expiry[0].due = deadline;
+            expirySift(0);
+            continue;
+        }
+
+        out = *joiner;
+        expiry[0] = expiry[count - 1];
+        removeAt(joiner - table->slots); // drops count, so the moved entry is sifted within it
+        if(count > 0)
+            expirySift(0);
+        return true;
+    }
+    return false;
+}
+
+// Earliest time a joiner may expire (or needs re-arming). Returns false if there are none.
+bool JoinerRegistry::nextExpiry(unsigned long &due) const {
+    if(count == 0)
+        return false;
+    due = table->expiry[0].due;
+    return true;
+}
+
+// Re-arms a joiner whose timeout changed; a linear search, as it is a configuration call.
+void JoinerRegistry::rearm(uint64_t id) {
+    const JoinerInfo *joiner = find(id);
+    if(!joiner)
+        return;
+
+    Expiry *expiry = table->expiry;
+    for(size_t pos = 0; pos < count; ++pos) {
+        if(expiry[pos].id == id) {
+            expiry[pos].due = joiner->lastSeen + joiner->timeout;
+            expirySift(pos);
+            return;
+        }
+    }
+}
@@ -1,16 +1,255 @@
 #ifndef LIGHTTHREAD_H
 #define LIGHTTHREAD_H
 
+#include "Ip6Address.h"
 #include <Arduino.h>
 #include <OThreadCLI.h> // must include full header
-#include <optional>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <openthread/udp.h>
 
 #define BUTTON_PIN 9
-#include <map>
+
+// CLI commands written ahead of their replies (CLI.cpp)
+#ifndef LT_CLI_PIPELINE_DEPTH
+#define LT_CLI_PIPELINE_DEPTH 4
+#endif
+
+// Bytes of CLI output buffered while lines are assembled (CLI.cpp). Must hold the
+// longest line, i.e. a received datagram hex-encoded with its "bytes from" prefix.
+#ifndef LT_CLI_RX_BUFFER_SIZE
+#define LT_CLI_RX_BUFFER_SIZE 1024
+#endif
+
+// Lowest log level compiled in (LT_LOG); calls below it cost nothing. Defaults to the
+// lowest level the Arduino core prints, since its log_x macros drop the rest anyway.
+#ifndef LT_LOG_MIN_LEVEL
+#if !defined(CORE_DEBUG_LEVEL) || CORE_DEBUG_LEVEL >= 5
+#define LT_LOG_MIN_LEVEL LT_LOG_VERBOSE
+#elif CORE_DEBUG_LEVEL == 4
+#define LT_LOG_MIN_LEVEL LT_LOG_DEBUG
+#elif CORE_DEBUG_LEVEL == 3
+#define LT_LOG_MIN_LEVEL LT_LOG_INFO
+#elif CORE_DEBUG_LEVEL == 2
+#define LT_LOG_MIN_LEVEL LT_LOG_WARN
+#elif CORE_DEBUG_LEVEL == 1
+#define LT_LOG_MIN_LEVEL LT_LOG_ERROR
+#else
+#define LT_LOG_MIN_LEVEL LT_LOG_NONE
+#endif
+#endif
+
+// UDP port every LightThread node listens and sends on
+#define LT_UDP_PORT 12345
+
+// Largest datagram (header + payload) LightThread sends or receives
+#ifndef LT_MAX_UDP_FRAME
+#define LT_MAX_UDP_FRAME 384
+#endif
+
+// Reliable streams (ReliableUDP.cpp). The window can be raised at runtime up to
+// LT_RELIABLE_WINDOW_MAX, which is bounded by the 32-bit selective-ACK bitmap.
+#define LT_RELIABLE_WINDOW_MAX 32
+#ifndef LT_RELIABLE_DEFAULT_WINDOW
+#define LT_RELIABLE_DEFAULT_WINDOW 8
+#endif
+
+// Retransmission timeout bounds and default delivery deadline, in ms (ReliableUDP.cpp).
+// The timeout adapts to each peer's measured round-trip time between the two bounds.
+#ifndef LT_RELIABLE_MIN_RTO
+#define LT_RELIABLE_MIN_RTO 200
+#endif
+#ifndef LT_RELIABLE_MAX_RTO
+#define LT_RELIABLE_MAX_RTO 8000
+#endif
+#ifndef LT_RELIABLE_INITIAL_RTO
+#define LT_RELIABLE_INITIAL_RTO 1000
+#endif
+#ifndef LT_RELIABLE_DEFAULT_DEADLINE
+#define LT_RELIABLE_DEFAULT_DEADLINE 10000
+#endif
+
+// Reliable messages that can be pending (queued or unacknowledged) at once across all
+// peers, and the largest payload each can hold. Slots are allocated inline, so the send
+// queue uses a fixed LT_RELIABLE_SLOTS * LT_RELIABLE_PAYLOAD_SIZE bytes or so.
+#ifndef LT_RELIABLE_SLOTS
+#define LT_RELIABLE_SLOTS 16
+#endif
+#ifndef LT_RELIABLE_PAYLOAD_SIZE
+#define LT_RELIABLE_PAYLOAD_SIZE (LT_MAX_UDP_FRAME - 5)
+#endif
+
+// Peers with reliable stream state; idle peers are recycled when the table is full
+#ifndef LT_RELIABLE_PEERS
+#define LT_RELIABLE_PEERS 8
+#endif
+
+// Channels a sendUdp() payload can be addressed to, channel 0 included. Each channel has
+// its own receive callback and its own reliable stream to every peer.
+#ifndef LT_CHANNELS
+#define LT_CHANNELS 16
+#endif
+
+// Out-of-order messages held for in-order delivery, shared by all peers
+#ifndef LT_REORDER_SLOTS
+#define LT_REORDER_SLOTS 8
+#endif
+
+// Payloads whose frame would exceed the MTU are split into fragments (Fragment.cpp).
+// The MTU counts LightThread frame bytes (before hex encoding) and can be changed at runtime
+// with setUdpMtu().
+#ifndef LT_DEFAULT_MTU
+#define LT_DEFAULT_MTU 128
+#endif
+
+// Largest payload sendUdp() accepts and a receiver reassembles. Each reassembly slot and
+// each fragmented reliable send buffers a whole message.
+#ifndef LT_MAX_MESSAGE_SIZE
+#define LT_MAX_MESSAGE_SIZE 4096
+#endif
+#ifndef LT_REASSEMBLY_SLOTS
+#define LT_REASSEMBLY_SLOTS 2
+#endif
+#ifndef LT_FRAGMENT_TX_SLOTS
+#define LT_FRAGMENT_TX_SLOTS 1
+#endif
+
+// An incomplete message is abandoned if no fragment of it arrives for this long (ms)
+#ifndef LT_REASSEMBLY_TIMEOUT
+#define LT_REASSEMBLY_TIMEOUT 10000
+#endif
+
+// Destinations that can have a batch of coalesced sends pending at once
+#ifndef LT_COALESCE_SLOTS
+#define LT_COALESCE_SLOTS 4
+#endif
+
+// Joiners the leader's registry can hold (JoinerRegistry.cpp)
+#ifndef LT_MAX_JOINERS
+#define LT_MAX_JOINERS 64
+#endif
+
+// Group sends (Group.cpp): joiners a group message can track, at least every joiner the
+// registry holds, and group messages in progress at once. The entries are allocated by the
+// first sendGroup(), so joiners do not pay for them.
+#ifndef LT_GROUP_MEMBERS
+#define LT_GROUP_MEMBERS LT_MAX_JOINERS
+#endif
+#ifndef LT_GROUP_SENDS
+#define LT_GROUP_SENDS 1
+#endif
+
+// Members spread their ACKs of a group message over this many ms per member
+#ifndef LT_GROUP_ACK_SPACING
+#define LT_GROUP_ACK_SPACING 5
+#endif
+
+// Receiver side: delayed group ACKs pending at once, and group messages remembered for
+// duplicate suppression
+#ifndef LT_GROUP_PENDING_ACKS
+#define LT_GROUP_PENDING_ACKS 4
+#endif
+#ifndef LT_GROUP_HISTORY
+#define LT_GROUP_HISTORY 8
+#endif
+
+// Publish/subscribe (PubSub.cpp): topics one node can subscribe to, which is also what the
+// leader keeps per joiner; subscriber count from which the leader relays a publish as one
+// multicast instead of a unicast per subscriber; and the joiner's retry period for a
+// subscription update the leader has not confirmed, in ms
+#ifndef LT_PUBSUB_TOPICS
+#define LT_PUBSUB_TOPICS 4
+#endif
+#ifndef LT_PUBSUB_MULTICAST_MIN
+#define LT_PUBSUB_MULTICAST_MIN 4
+#endif
+#ifndef LT_PUBSUB_RETRY
+#define LT_PUBSUB_RETRY 1000
+#endif
+
+// Handlers applications can register for their own message types (Dispatch.cpp)
+#ifndef LT_MESSAGE_HANDLERS
+#define LT_MESSAGE_HANDLERS 8
+#endif
+
+// Silence in ms after which the leader drops a joiner and fires the leave callback, unless
+// changed with setJoinerTimeout()
+#ifndef LT_JOINER_TIMEOUT
+#define LT_JOINER_TIMEOUT 15000
+#endif
+
+// Period of the leader's liveness beacon in LivenessMode::BEACON, in ms (Beacon.cpp)
+#ifndef LT_BEACON_INTERVAL
+#define LT_BEACON_INTERVAL 5000
+#endif
+
+// Deferred delivery (EventQueue.cpp): callback events queued between update() and poll(),
+// and the bytes of payload they can hold in total (a power of two, at least one
+// LT_MAX_MESSAGE_SIZE message). The queue is allocated when deferred delivery is first
+// turned on.
+#ifndef LT_EVENT_SLOTS
+#define LT_EVENT_SLOTS 16
+#endif
+#ifndef LT_EVENT_BYTES
+#define LT_EVENT_BYTES LT_MAX_MESSAGE_SIZE
+#endif
+
+// Task mode (Task.cpp): defaults for TaskConfig, and the longest the task sleeps with no
+// deadline due, which bounds the latency of the button, the state machine timers and CLI
+// command timeouts, none of which wake the task
+#ifndef LT_TASK_PRIORITY
+#define LT_TASK_PRIORITY 2
+#endif
+#ifndef LT_TASK_STACK
+#define LT_TASK_STACK 6144
+#endif
+#ifndef LT_TASK_MAX_SLEEP
+#define LT_TASK_MAX_SLEEP 50
+#endif
+
+// sendUdp() calls from tasks other than the one running update(), queued until its next
+// run (SendQueue.cpp): slots (a power of two) and the largest payload a slot holds
+#ifndef LT_SEND_SLOTS
+#define LT_SEND_SLOTS 8
+#endif
+#ifndef LT_SEND_SLOT_BYTES
+#define LT_SEND_SLOT_BYTES LT_MAX_UDP_FRAME
+#endif
+
+// Datagrams buffered between the OpenThread task and update() (native backend)
+#ifndef LT_NATIVE_RX_SLOTS
+#define LT_NATIVE_RX_SLOTS 4
+#endif
 
 // --- ENUM DEFINITIONS ---
 enum class Role { LEADER, JOINER };
 
+// Selects how UDP payloads reach the Thread stack.
+//   CLI:    "udp send"/"udp open" commands over OThreadCLI, payload hex-encoded
+//   NATIVE: socket opened directly through the OpenThread UDP API, raw bytes
+// The CLI backend carries the hex text on air, so every node of a network must use
+// the same backend.
+enum class UdpBackend { CLI, NATIVE };
+
+// How a joiner learns that the leader still hears its heartbeats.
+//   ECHO:   the leader answers every heartbeat with a unicast echo
+//   BEACON: the leader multicasts one beacon per LT_BEACON_INTERVAL listing the joiners it
+//           heard from recently, so its traffic no longer grows with the number of joiners
+// Chosen by the leader ("liveness" in network.json, or setLivenessMode()).
+enum class LivenessMode { ECHO, BEACON };
+
+// Result of sendUdp()
+enum class SendStatus {
+    OK,          // sent, or queued for reliable delivery
+    QUEUE_FULL,  // no free reliable slot: retry once pending messages are ACKed or dropped
+    TOO_LARGE,   // payload exceeds LT_MAX_MESSAGE_SIZE (LT_SEND_SLOT_BYTES when sendUdp() is
+                 // called from another task), or one frame where there is no fragmentation
+    INVALID,     // destination is not an IPv6 address
+    SEND_FAILED, // the datagram could not be handed to the Thread stack
+    WOULD_BLOCK, // called from another task and the send queue is full: retry later
+};
+
 enum class State {
     INIT,
     STANDBY,
@@ -34,48 +273,294 @@ enum class State {
 
 enum AckType { NONE = 0x00, REQUEST = 0x99, RESPONSE = 0x98 };
 
-enum MessageType { NORMAL = 0x00, PAIRING = 0x01, RECONNECT = 0x02, HEARTBEAT = 0x03 };
+enum MessageType {
+    NORMAL = 0x00,
+    PAIRING = 0x01,
+    RECONNECT = 0x02,
+    HEARTBEAT = 0x03,
+    FRAGMENT = 0x04, // one piece of a payload larger than the MTU
+    BATCH = 0x05,    // several small payloads as [length:8][data] records
+    GROUP = 0x06,    // multicast to every known joiner, ACKed by each
+    BEACON = 0x07,   // leader's periodic list of the joiners it hears
+    CHANNEL = 0x08,  // [channel:8][type byte] then a NORMAL or FRAGMENT frame's payload
+    SUBSCRIBE = 0x09, // a joiner's topic list, confirmed by the leader
+    PUBLISH = 0x0A,   // a payload for one topic, relayed by the leader to its subscribers
+
+    // Codes applications may claim with registerMessageHandler(); the library's own types
+    // stay below USER_FIRST. The top bit of the type byte is the compression flag.
+    USER_FIRST = 0x40,
+    USER_LAST = 0x7F,
+};
+
+// DEBUG is for per-packet events such as ACKs and retries; VERBOSE adds whole frames
+enum LightThreadLogLevel {
+    LT_LOG_VERBOSE,
+    LT_LOG_DEBUG,
+    LT_LOG_INFO,
+    LT_LOG_WARN,
+    LT_LOG_ERROR,
+    LT_LOG_NONE
+};
+
+// Parts of the library whose log level is set separately (setLogLevel)
+enum class LogSubsystem : uint8_t { CLI, UDP, FSM, STORAGE };
+static constexpr size_t kLogSubsystems = 4;
+
+// Logs a printf-style message at `level` for a LogSubsystem, from a LightThread member.
+// Calls below LT_LOG_MIN_LEVEL compile to nothing, format string included, at any
+// optimization level; the others are formatted, and their arguments evaluated, only if the
+// subsystem's runtime level lets them through.
+#define LT_LOG(subsystem, level, ...)                                                          \
+    do {                                                                                       \
+        if constexpr(logCompiledIn<level>()) {                                                 \
+            if(logEnabled(LogSubsystem::subsystem, level))                                     \
+                logLightThread(level, __VA_ARGS__);                                            \
+        }                                                                                      \
+    } while(0)
+
+// Non-owning view of one line of CLI output. Points into the CliLineAssembler buffer and
+// is only valid until the assembler is refilled.
+struct CliLine {
+    const char *data;
+    size_t length;
+    bool isUdp; // "<n> bytes from <ip> <port> <hex>" datagram line
+};
+
+// Splits the CLI output stream into lines without allocating (CLI.cpp).
+// Bytes are bulk-read into a fixed buffer; consumed lines are reclaimed by sliding the
+// unconsumed tail to the front, so every line stays contiguous and can be handed out as
+// a view. A line longer than the buffer is dropped up to its newline.
+class CliLineAssembler {
+  public:
+    size_t fill(Stream &stream); // reads whatever the stream has available
+    bool next(CliLine &line);    // pops the next complete, non-empty line
+
+  private:
+    char buffer[LT_CLI_RX_BUFFER_SIZE];
+    size_t head = 0; // first unconsumed byte
+    size_t scan = 0; // first byte not yet searched for a newline
+    size_t tail = 0; // one past the last buffered byte
+    bool discarding = false;
+};
+
+// True if millis() timestamp `a` is earlier than `b`, across wraparound
+inline bool timeBefore(unsigned long a, unsigned long b) { return static_cast<long>(a - b) < 0; }
+
+// A joiner known to the leader, identified by the MAC hash it sends in its heartbeats.
+struct JoinerInfo {
+    uint64_t id;             // MAC hash, never 0
+    Ip6Address addr;         // source of the latest heartbeat
+    unsigned long lastSeen;  // millis() of the latest heartbeat
+    unsigned long timeout;   // removed once silent this long (ms)
+    uint32_t rtt;            // smoothed RTT of the reliable stream to it (ms), 0 if unknown
+    Role role;
+    uint8_t topicCount;      // topics it subscribed to (PubSub.cpp)
+    uint8_t topicVersion;    // version of that list, if topicsSet
+    bool topicsSet;          // a list has been received; only newer versions replace it
+    uint16_t topics[LT_PUBSUB_TOPICS];
+};
+
+// Smallest b with 2^b >= n
+constexpr size_t ceilLog2(size_t n) { return n <= 1 ? 0 : 1 + ceilLog2((n + 1) / 2); }
+
+// Leader's table of joiners keyed by device ID (JoinerRegistry.cpp). Open addressing with
+// linear probing over a fixed array kept at most half full, so heartbeats are handled
+// without allocating or comparing strings. Removal shifts the rest of a probe run back
+// instead of leaving tombstones.
+//
+// Expiry is ordered by a binary min-heap holding one entry per joiner. A heartbeat only
+// moves lastSeen; an entry found due is re-armed at lastSeen + timeout if the joiner was
+// heard from since, so the heap is touched about once per timeout, not per heartbeat.
+//
+// The table is allocated by the first insert(), so only a leader that hears from a joiner
+// pays for it.
+class JoinerRegistry {
+  public:
+    JoinerInfo *find(uint64_t id);
+    JoinerInfo *findByAddress(const Ip6Address &addr); // linear scan
+    JoinerInfo *insert(uint64_t id); // existing or new entry; nullptr if full or id is 0
+    size_t size() const { return count; }
+
+    // Calls fn(const JoinerInfo &) for every entry.
+    template <typename Fn> void forEach(Fn fn) const {
+        if(!table)
+            return;
+        for(const JoinerInfo &entry : table->slots) {
+            if(entry.id != 0)
+                fn(entry);
+        }
+    }
+
+    bool popExpired(unsigned long now, JoinerInfo &out); // removes one, copied to `out`
+    bool nextExpiry(unsigned long &due) const;
+    void rearm(uint64_t id); // after its timeout changed
+
+  private:
+    static constexpr size_t kTableBits = ceilLog2(2 * LT_MAX_JOINERS);
+    static constexpr size_t kTableSize = size_t(1) << kTableBits;
 
-enum LightThreadLogLevel { LT_LOG_VERBOSE, LT_LOG_INFO, LT_LOG_WARN, LT_LOG_ERROR };
+    struct Expiry {
+        unsigned long due; // lastSeen + timeout when armed; the insertion time for a new entry
+        uint64_t id;
+    };
+
+    size_t home(uint64_t id) const;
+    void removeAt(size_t slot);
+    void expirySift(size_t pos);
+
+    struct Table {
+        JoinerInfo slots[kTableSize] = {};
+        Expiry expiry[LT_MAX_JOINERS]; // heap on due, `count` entries
+    };
+
+    std::unique_ptr<Table> table; // nullptr until the first insert()
+    size_t count = 0;
+};
 
 class LightThread {
   public:
     LightThread();
+    ~LightThread(); // Task.cpp
+
+    // Round-trip estimate of a reliable peer, all in ms (getPeerRtt)
+    struct PeerRtt {
+        uint32_t srtt;   // smoothed round-trip time, 0 until the first sample
+        uint32_t rttVar; // round-trip time variation
+        uint32_t rto;    // current retransmission timeout, backoff included
+    };
+
+    // Transport counters since boot (getStats)
+    struct Stats {
+        uint32_t retransmissions;      // reliable frames sent again after a timeout
+        uint32_t retransmittedBytes;   // frame bytes of those retransmissions
+        uint32_t fragmentsSent;        // fragments handed to the stack, first copies only
+        uint32_t messagesReassembled;  // fragmented payloads delivered complete
+        uint32_t reassemblyDropped;    // fragmented payloads abandoned incomplete
+        uint32_t batchesSent;          // BATCH datagrams sent by coalescing
+        uint32_t recordsBatched;       // payloads carried in those batches
+        uint32_t messagesCompressed;   // payloads sent compressed
+        uint32_t compressionSaved;     // bytes those payloads shrank by
+        uint32_t duplicatesSuppressed; // reliable or group messages received again, not delivered
+        uint32_t beaconsSent;          // BEACON datagrams, one per part of each round
+        uint32_t publishesRelayed;     // PUBLISH datagrams the leader sent to subscribers
+        uint32_t eventsDropped;        // deferred callback events lost to a full queue
+        uint32_t eventQueueHighWater;  // most deferred events queued at once
+        uint32_t queuedSendsFailed;    // sendUdp() calls from other tasks that failed when sent
+        uint32_t framesDropped;        // received frames no handler takes: malformed, unknown
+                                       // type or ack byte, or not for this role or state
+    };
 
-    void begin();  // LightThreadCore.cpp
+    // Dedicated task that runs update() on its own (begin(backend, TaskConfig))
+    struct TaskConfig {
+        UBaseType_t priority = LT_TASK_PRIORITY;
+        uint32_t stackSize = LT_TASK_STACK; // bytes
+    };
+
+    void begin(UdpBackend backend = UdpBackend::CLI); // LightThreadCore.cpp
+    void begin(UdpBackend backend, const TaskConfig &task); // Task.cpp
+    void end();                                             // Task.cpp
     void update(); // LightThreadCore.cpp
 
     bool inState(State expected) const; // LightThreadCore.cpp
-    String getLeaderIp() const { return leaderIp; }
 
     // ------------------------
     // exposedUDP.cpp
     // ------------------------
-    // Exposed UDP (public-facing interface)
+    // Exposed UDP (public-facing interface). Addresses are Ip6Address values; the String
+    // overloads parse or format at the boundary and are kept for existing sketches.
+    using UdpReceiveCallback =
+        std::function<void(const Ip6Address &src, bool reliable, const std::vector<uint8_t> &)>;
+    // Payload in place in the receive buffer; only valid for the duration of the call
+    using UdpViewCallback = std::function<void(const Ip6Address &src, bool reliable,
+                                               const uint8_t *payload, size_t length)>;
+    using StatusCallback = std::function<void(uint16_t id, const Ip6Address &ip, bool success)>;
+    using JoinCallback = std::function<void(const Ip6Address &ip, const String &hashmac)>;
+    using LeaveCallback = std::function<void(const Ip6Address &ip, const String &hashmac)>;
+    using PublishCallback = std::function<void(uint16_t topic, const Ip6Address &publisher,
+                                               const std::vector<uint8_t> &payload)>;
+    // Published payload in place; only valid for the duration of the call
+    using PublishViewCallback = std::function<void(uint16_t topic, const Ip6Address &publisher,
+                                                   const uint8_t *payload, size_t length)>;
+    // Payload of an application message type; only valid for the duration of the call
+    using MessageHandler = std::function<void(const Ip6Address &src, AckType ack,
+                                              const uint8_t *payload, size_t length)>;
+
+    void registerUdpReceiveCallback(UdpReceiveCallback fn);
     void registerUdpReceiveCallback(
         std::function<void(const String &, bool reliable, const std::vector<uint8_t> &)> fn);
+    void registerUdpViewCallback(UdpViewCallback fn);
+    void registerReliableUdpStatusCallback(StatusCallback cb);
     void registerReliableUdpStatusCallback(
         std::function<void(uint16_t msgId, const String &ip, bool success)> cb);
+    void registerJoinCallback(JoinCallback cb);
     void registerJoinCallback(std::function<void(const String &ip, const String &hashmac)> cb);
+    void registerLeaveCallback(LeaveCallback cb);
+    void registerLeaveCallback(std::function<void(const String &ip, const String &hashmac)> cb);
 
-    bool sendUdp(const String &destIp, bool reliable, const std::vector<uint8_t> &payload);
+    SendStatus sendUdp(const Ip6Address &dest, bool reliable, const std::vector<uint8_t> &payload);
+    SendStatus sendUdp(const String &destIp, bool reliable, const std::vector<uint8_t> &payload);
+    SendStatus sendUdp(const Ip6Address &dest, uint8_t channel, bool reliable,
+                       const std::vector<uint8_t> &payload);
+    SendStatus sendUdp(const String &destIp, uint8_t channel, bool reliable,
+                       const std::vector<uint8_t> &payload);
+    bool registerChannel(uint8_t channel, UdpReceiveCallback receive,
+                         StatusCallback status = nullptr);
+    uint8_t freeReliableSlots() const;
+    void setReliableWindow(uint8_t window);
+    void setReliableInOrder(bool inOrder);
+    void setReliableDeadline(unsigned long deadlineMs);
+    void setUdpMtu(uint16_t mtu);
+    void setUdpCoalescing(unsigned long windowMs, uint16_t flushBytes = 0);
+    void flush();
+    void setUdpCompression(bool enabled);
+    bool registerMessageHandler(uint8_t type, MessageHandler fn); // Dispatch.cpp
+    SendStatus sendMessage(const Ip6Address &dest, uint8_t type, const uint8_t *payload,
+                           size_t length, AckType ack = AckType::NONE); // Dispatch.cpp
+    SendStatus sendGroup(const std::vector<uint8_t> &payload, uint16_t *groupId = nullptr);
+    void registerGroupStatusCallback(StatusCallback cb);
+    void registerGroupStatusCallback(
+        std::function<void(uint16_t groupId, const String &ip, bool success)> cb);
+    bool subscribe(uint16_t topic);                                          // PubSub.cpp
+    void unsubscribe(uint16_t topic);                                        // PubSub.cpp
+    SendStatus publish(uint16_t topic, const std::vector<uint8_t> &payload); // PubSub.cpp
+    void registerPublishCallback(PublishCallback cb);                        // PubSub.cpp
+    void registerPublishViewCallback(PublishViewCallback cb);                // PubSub.cpp
+    bool setDeferredDelivery(bool enabled);                                  // EventQueue.cpp
+    size_t poll(size_t maxEvents = SIZE_MAX);                                // EventQueue.cpp
+    void setLogLevel(LightThreadLogLevel level);                             // Utils.cpp
+    void setLogLevel(LogSubsystem subsystem, LightThreadLogLevel level);     // Utils.cpp
+    const Stats &getStats() const { return stats; }
+    bool getPeerRtt(const Ip6Address &ip, PeerRtt &rtt);
+    bool getPeerRtt(const String &ip, PeerRtt &rtt);
+    unsigned long msUntilNextDeadline() const;
+    unsigned long getLastEchoTime(const Ip6Address &ip);
     unsigned long getLastEchoTime(const String &ip);
+    size_t joinerCount() const { return joiners.size(); }
+    void setJoinerTimeout(unsigned long timeoutMs);
+    bool setJoinerTimeout(uint64_t id, unsigned long timeoutMs);
+    void forEachJoiner(std::function<void(const JoinerInfo &joiner)> fn) const;
     bool isReady() const;
     Role getRole() const { return role; }
+    void setLivenessMode(LivenessMode mode); // Beacon.cpp
+    Ip6Address getMyAddress();
     String getMyIp();
-    String getLeaderIp();
+    const Ip6Address &getLeaderAddress() const { return leaderIp; } // "::" if none
+    String getLeaderIp() const;
 
   private:
+    friend struct LightThreadTest; // host tests (test/)
+
     // ------------------------
     // Variables: LightThread.h
     // ------------------------
     Role role = Role::JOINER; // default fallback
     bool roleLoadedFromConfig = false;
+    uint8_t buttonPin;
     State state;
     unsigned long stateEntryTime = 0;
     bool justEntered = true;
-    uint8_t buttonPin;
-    String leaderIp = ""; // Joiner: IP of the leader to reconnect to
+    Ip6Address leaderIp = {}; // Joiner: IP of the leader to reconnect to, "::" if none
+    UdpBackend udpBackend = UdpBackend::CLI;
 
     // Data loaded from /network.json (DataStorage.cpp)
     int configuredChannel = -1;
@@ -87,23 +572,342 @@ class LightThread {
     unsigned long lastHeartbeatEcho = 0;
 
     // Heartbeat tracking (Leader)
-    std::map<String, unsigned long> joinerHeartbeatMap;
+    JoinerRegistry joiners;
+    unsigned long joinerTimeout = LT_JOINER_TIMEOUT; // given to joiners as they appear
+
+    // Liveness beacons (Beacon.cpp). The leader picks a random epoch at its first round;
+    // a joiner remembers the last epoch it saw to notice a leader restart.
+    LivenessMode livenessMode = LivenessMode::ECHO;
+    unsigned long nextBeaconAt = 0;
+    uint16_t beaconEpoch = 0;
+    uint16_t beaconSeq = 0;
 
-    uint16_t nextMessageId = 0;
+    // Reliable delivery (ReliableUDP.cpp): one sequenced stream per peer.
+    // Data frames carry [seq:16][flags:8] before the payload; ACK frames carry the next
+    // sequence expected (cumulative) and a bitmap of the 32 sequences after it.
+    // All state lives in fixed tables, so reliable traffic never touches the heap.
+    static constexpr uint8_t kNoSlot = 0xFF;
+
+    // Set in the type byte of a message whose payload is LZ-compressed (Compress.cpp)
+    static constexpr uint8_t kCompressedFlag = 0x80;
 
     struct PendingReliableUdp {
-        String destIp;
-        std::vector<uint8_t> payload; // Includes messageId prepended
-        unsigned long timeSent;
+        bool inUse = false;
+        bool sent;
+        MessageType type; // NORMAL or FRAGMENT
+        bool compressed;
+        uint8_t fragTx; // fragmentTx entry this fragment belongs to, or kNoSlot
+        uint8_t peer;     // index in reliablePeers
+        uint8_t next;    // next slot of the same peer, in sequence order, or kNoSlot
+        uint8_t heapPos; // position in reliableHeap
         uint8_t retryCount;
+        uint16_t seq;
+        uint16_t length;
+        unsigned long deadline; // give up if still unacknowledged at this time
+        unsigned long timeSent; // last transmission
+        unsigned long retryAt;  // next retransmission
+        uint8_t payload[LT_RELIABLE_PAYLOAD_SIZE];
     };
 
-    std::map<uint16_t, PendingReliableUdp> pendingReliableMessages;
+    struct ReorderedUdp {
+        bool inUse = false;
+        MessageType type;
+        bool compressed;
+        uint8_t peer;
+        uint16_t seq;
+        uint16_t length;
+        uint8_t payload[LT_RELIABLE_PAYLOAD_SIZE];
+    };
+
+    struct ReliablePeer {
+        bool inUse = false;
+        Ip6Address addr;
+        uint8_t channel = 0;
+        unsigned long lastActive = 0;
+
+        // Sender side
+        uint16_t nextSeq = 0;     // assigned to the next sendUdp()
+        bool established = false; // peer has ACKed; until then one message in flight
+        uint8_t txHead = kNoSlot; // unacknowledged messages, in sequence order
+        uint8_t txTail = kNoSlot;
+        uint32_t srtt = 0;   // smoothed RTT, 0 until the first sample
+        uint32_t rttVar = 0; // RTT variation
+        uint32_t rto = LT_RELIABLE_INITIAL_RTO;
+        uint8_t backoff = 0; // timeouts of the oldest message since the last ACK
+
+        // Receiver side
+        bool rxSynced = false;
+        uint16_t rxStart = 0; // first sequence of the stream, from its start frame
+        uint16_t rcvNext = 0; // next in-order sequence expected
+        uint32_t rcvMask = 0; // bit i set: rcvNext + i already received
+        uint8_t held = 0;     // entries in reorderSlots
+    };
 
-    std::function<void(uint16_t, const String &, bool)> reliableCallback = nullptr;
-    std::function<void(const String &srcIp, bool reliable, const std::vector<uint8_t> &payload)>
-        udpCallback = nullptr;
-    std::function<void(const String &, const String &)> joinCallback = nullptr;
+    ReliablePeer reliablePeers[LT_RELIABLE_PEERS];
+    PendingReliableUdp reliableSlots[LT_RELIABLE_SLOTS];
+    uint8_t reliableSlotsUsed = 0;
+    ReorderedUdp reorderSlots[LT_REORDER_SLOTS];
+
+    // Slots in use, as a binary min-heap on each slot's next due time (retransmission or
+    // deadline), so update() only touches messages that are due.
+    uint8_t reliableHeap[LT_RELIABLE_SLOTS];
+    uint8_t reliableHeapSize = 0;
+
+    // Fragmentation (Fragment.cpp). A fragment carries [tag:16][index:8][count:8][offset:16]
+    // before its data. Reliable fragments ride the peer's reliable stream, so only the
+    // missing ones are retransmitted.
+    struct FragmentTx {
+        bool inUse = false;
+        bool failed;      // a fragment was dropped: stop feeding, report failure
+        bool compressed;  // the buffered payload is compressed
+        uint8_t peer;     // index in reliablePeers
+        uint8_t count;
+        uint8_t nextIndex;   // next fragment to queue
+        uint8_t outstanding; // fragments queued and not yet ACKed or dropped
+        uint8_t acked;
+        uint16_t tag;
+        uint16_t msgId; // sequence of the first fragment, reported to reliableCallback
+        uint16_t chunk; // data bytes per fragment
+        uint16_t length;
+        uint8_t data[LT_MAX_MESSAGE_SIZE];
+    };
+
+    struct ReassemblySlot {
+        bool inUse = false;
+        bool complete; // kept after delivery so late duplicates are ignored
+        Ip6Address src;
+        uint8_t channel;
+        uint16_t tag;
+        uint8_t count;
+        uint8_t received;
+        uint16_t length; // known once the last fragment arrives
+        unsigned long lastUpdate;
+        uint32_t have[8]; // bit per fragment index
+        uint8_t data[LT_MAX_MESSAGE_SIZE];
+    };
+
+    FragmentTx fragmentTx[LT_FRAGMENT_TX_SLOTS];
+    ReassemblySlot reassembly[LT_REASSEMBLY_SLOTS];
+    uint16_t fragmentTag = 0; // 0: not yet seeded
+    uint16_t udpMtu = LT_DEFAULT_MTU;
+
+    // Coalescing (Coalesce.cpp): small unreliable sends to one destination are packed into
+    // a single BATCH datagram. Off while coalesceWindow is 0.
+    struct CoalesceBuffer {
+        bool inUse = false;
+        Ip6Address addr;
+        unsigned long firstAt; // when the first record was buffered
+        uint16_t length;
+        uint8_t records;
+        uint8_t data[LT_MAX_UDP_FRAME - 2];
+    };
+
+    CoalesceBuffer coalesceBuffers[LT_COALESCE_SLOTS];
+    unsigned long coalesceWindow = 0;
+    uint16_t coalesceBytes = 0; // flush threshold, 0: as much as fits the MTU
+
+    // Compression (Compress.cpp). The buffer holds the compressed payload while sendUdp()
+    // routes it, and a decompressed payload while it is delivered.
+    bool udpCompression = false;
+    uint8_t lzBuffer[LT_MAX_MESSAGE_SIZE];
+    bool lzBufferLent = false; // holds a payload a callback is reading: sends stay uncompressed
+
+    // Group sends (Group.cpp). A GROUP message carries [id:16][ACK window:16] before the
+    // payload; the ACK carries the id.
+    struct GroupMember {
+        Ip6Address addr;
+        bool acked; // ACKed or failed
+    };
+
+    struct GroupSend {
+        bool inUse = false;
+        bool compressed;
+        uint16_t id;
+        uint16_t ackWindow; // ms over which members spread their ACKs
+        uint16_t memberCount;
+        uint16_t pending; // members not yet settled
+        unsigned long rto;
+        unsigned long retryAt; // next unicast round to members that have not ACKed
+        unsigned long deadline;
+        uint16_t length;
+        uint8_t payload[LT_RELIABLE_PAYLOAD_SIZE];
+        GroupMember members[LT_GROUP_MEMBERS];
+    };
+
+    struct GroupAck {
+        bool inUse = false;
+        Ip6Address dest;
+        uint16_t id;
+        unsigned long dueAt;
+    };
+
+    struct SeenGroup {
+        bool valid = false;
+        Ip6Address src;
+        uint16_t id;
+    };
+
+    std::unique_ptr<GroupSend[]> groupSends; // LT_GROUP_SENDS, from the first sendGroup()
+    GroupAck groupAcks[LT_GROUP_PENDING_ACKS];
+    SeenGroup seenGroups[LT_GROUP_HISTORY];
+    uint8_t seenGroupNext = 0;
+    uint16_t groupSeq = 0; // 0: not yet seeded
+
+    // Publish/subscribe (PubSub.cpp). This node's own topics; a joiner sends the whole list
+    // to the leader whenever it changes, numbered by subscriptionVersion, and resends it
+    // every LT_PUBSUB_RETRY ms until the leader confirms that version.
+    uint16_t topics[LT_PUBSUB_TOPICS];
+    uint8_t topicCount = 0;
+    uint8_t subscriptionVersion = 0;
+    bool subscriptionPending = false;
+    unsigned long subscriptionSentAt = 0;
+    PublishViewCallback publishCallback = nullptr; // the vector callback is wrapped into a view
+    // Leader: a topic list, a publish or a subscription of its own has been seen, so joiners
+    // new to the registry are asked for their lists
+    bool pubSubInUse = false;
+    // This node's mesh-local interface identifier, read once a relayed publish needs it and
+    // read again after a state change
+    uint8_t meshLocalIid[8];
+    bool meshLocalIidKnown = false;
+
+    Stats stats = {};
+
+    uint8_t reliableWindow = LT_RELIABLE_DEFAULT_WINDOW;
+    bool reliableInOrder = false;
+    unsigned long reliableDeadline = LT_RELIABLE_DEFAULT_DEADLINE;
+
+    StatusCallback reliableCallback = nullptr;
+    UdpViewCallback udpCallback = nullptr; // the vector callbacks are wrapped into views
+    JoinCallback joinCallback = nullptr;
+    LeaveCallback leaveCallback = nullptr;
+    StatusCallback groupCallback = nullptr;
+
+    // Callbacks of channels 1..LT_CHANNELS-1 (exposedUDP.cpp); channel 0 uses udpCallback
+    // and reliableCallback. Channel frames travel in a CHANNEL envelope, so channel 0 frames
+    // are unchanged on air.
+    struct ChannelCallbacks {
+        UdpViewCallback receive;
+        StatusCallback status;
+    };
+
+    ChannelCallbacks channelCallbacks[LT_CHANNELS - 1];
+
+    // Receive dispatch (Dispatch.cpp). Built-in types are routed by a constant table indexed
+    // by message type and ack kind; each route may require a role and a state. Application
+    // types map through userRoutes (slot + 1, 0 if unregistered) to messageHandlers.
+    struct RxPacket {
+        const Ip6Address &src;
+        AckType ack;
+        MessageType type;
+        uint8_t channel;
+        bool compressed;
+        const uint8_t *payload;
+        size_t length;
+    };
+
+    using RxHandler = void (LightThread::*)(const RxPacket &rx);
+
+    struct Route {
+        RxHandler handler; // nullptr: dropped
+        int8_t role;       // Role required, -1 for any
+        int8_t state;      // State required, -1 for any
+    };
+
+    static constexpr size_t kRoutedTypes = MessageType::PUBLISH + 1;
+    static const Route kRoutes[kRoutedTypes][3]; // [type][NONE, REQUEST, RESPONSE]
+
+    uint8_t userRoutes[MessageType::USER_LAST - MessageType::USER_FIRST + 1] = {};
+    MessageHandler messageHandlers[LT_MESSAGE_HANDLERS];
+
+    // Asynchronous CLI commands (CLI.cpp). Replies arrive in the order lines were written,
+    // so the oldest in-flight command owns every CLI line until its Done/Error terminator.
+    // "udp send" lines of the CLI backend are not queued but answer with a terminator too;
+    // they are counted where they fall between commands, and their replies skipped.
+    using CliCallback = std::function<void(bool ok, const String &response)>;
+
+    struct CliCommand {
+        String command;
+        CliCallback done;
+        unsigned long timeoutMs;
+        unsigned long sentAt;
+        String response;
+        uint32_t udpRepliesAhead; // "udp send" replies due before this command's own
+    };
+
+    CliLineAssembler cliRx;
+    std::deque<CliCommand> cliQueued;   // waiting for a pipeline slot
+    std::deque<CliCommand> cliInFlight; // written to the CLI, awaiting a reply
+    uint32_t cliStaleReplies = 0;       // replies still owed to timed-out commands
+    uint32_t cliUdpReplies = 0;         // "udp send" replies due after the last command's
+
+    // Runtime log level of each LogSubsystem (Utils.cpp)
+    LightThreadLogLevel logLevels[kLogSubsystems] = {LT_LOG_VERBOSE, LT_LOG_VERBOSE,
+                                                     LT_LOG_VERBOSE, LT_LOG_VERBOSE};
+
+    // Deferred delivery (EventQueue.cpp). update() is the only producer and poll() the only
+    // consumer, so both rings are lock-free: events[] holds one entry per callback to make,
+    // data the payloads, copied contiguously at free-running offsets. Allocated by the first
+    // setDeferredDelivery(true) and kept, as events may be queued after it is turned off.
+    enum class EventKind : uint8_t { RECEIVE, RELIABLE_STATUS, GROUP_STATUS, JOIN, LEAVE, PUBLISH };
+
+    struct Event {
+        EventKind kind;
+        uint8_t channel;
+        bool flag;   // reliable (RECEIVE) or success (the status kinds)
+        uint16_t id; // msgId, groupId or topic
+        uint16_t length;
+        uint32_t dataStart; // free-running offset in data
+        Ip6Address addr;
+    };
+
+    struct EventRing {
+        Event events[LT_EVENT_SLOTS];
+        uint8_t data[LT_EVENT_BYTES];
+    };
+
+    bool deferredDelivery = false;
+    std::unique_ptr<EventRing> eventRing;
+    std::atomic<uint8_t> eventHead{0}; // written by update()
+    std::atomic<uint8_t> eventTail{0}; // written by poll()
+    uint32_t eventDataHead = 0;
+    std::atomic<uint32_t> eventDataTail{0}; // written by poll()
+
+    // Native data plane (NativeUDP.cpp). The receive callback runs in the OpenThread
+    // task, so datagrams are copied into a single-producer ring and drained by update().
+    struct NativeRxSlot {
+        Ip6Address srcAddr;
+        uint16_t length;
+        uint8_t data[LT_MAX_UDP_FRAME];
+    };
+
+    otUdpSocket nativeSocket = {};
+    bool nativeSocketOpen = false;
+    NativeRxSlot nativeRx[LT_NATIVE_RX_SLOTS];
+    std::atomic<uint8_t> nativeRxHead{0}; // written by the OpenThread task
+    std::atomic<uint8_t> nativeRxTail{0}; // written by update()
+    std::atomic<uint32_t> nativeRxDropped{0};
+
+    // Task mode (Task.cpp): the task running update(), nullptr when the application does.
+    // end() sets taskStopper to itself; the task clears it as it exits.
+    std::atomic<TaskHandle_t> task{nullptr};
+    std::atomic<TaskHandle_t> taskStopper{nullptr};
+
+    // Cross-task sends (SendQueue.cpp). Any number of tasks claim slots with a compare-and-swap
+    // on sendEnqueuePos and publish them through the slot's sequence number; update() is the
+    // only consumer. A slot is free for position p when seq == p, and filled when seq == p + 1.
+    struct SendSlot {
+        std::atomic<uint32_t> seq;
+        Ip6Address dest;
+        uint8_t channel;
+        bool reliable;
+        uint16_t length;
+        uint8_t data[LT_SEND_SLOT_BYTES];
+    };
+
+    SendSlot sendSlots[LT_SEND_SLOTS];
+    std::atomic<uint32_t> sendEnqueuePos{0};
+    uint32_t sendDequeuePos = 0;
+    std::atomic<TaskHandle_t> updateOwner{nullptr}; // task that called begin() or ran update()
 
     // ------------------------
     // LightThreadCore.cpp
@@ -115,6 +919,7 @@ class LightThread {
     void handleInit();
     void handleStandby();
     void handleError();
+    void expireJoiners();
 
     void handleButton();
     void updateLighting();
@@ -125,6 +930,7 @@ class LightThread {
     void handleLeaderWaitNetwork();
     void handleCommissionerStart();
     void handleCommissionerActive();
+    void bootstrapLeaderNetwork();
 
     // ------------------------
     // StateHandlers_Joiner.cpp
@@ -147,51 +953,212 @@ class LightThread {
     bool loadNetworkConfig();
     bool parseNetworkJson(const String &jsonStr);
     void createDefaultNetworkConfig();
-    bool saveLeaderInfo(const String &ip, const String &hashmac);
-    bool loadLeaderInfo(String &outIp, String &outHashmac);
+    bool saveLeaderInfo(const Ip6Address &ip, const String &hashmac);
+    bool loadLeaderInfo(Ip6Address &outIp, String &outHashmac);
     void clearPersistentState();
 
     // ------------------------
     // CLI.cpp
     // ------------------------
-    bool execAndMatch(const String &command, const String &mustContain = "", String *out = nullptr,
-                      unsigned long timeoutMs = 1000);
-    bool otGetResp(String &lineOut, bool &isUDP, unsigned long timeoutMs = 100);
-    bool waitForString(String &responseBuffer, unsigned long timeoutMs,
-                       const String &matchStr = "Done");
-    void handleCliLine(const String &line);
-    bool processCLIChar(char c, String &multiline, bool &isUDP, String &lineOut);
+    void execAsync(const String &command, CliCallback done = nullptr,
+                   unsigned long timeoutMs = 1000);
+    void execSequence(std::vector<String> commands, std::function<void(bool ok)> done,
+                      size_t next = 0);
+    bool cliIdle() const;
+    void pumpCliCommands();
+    void readCli();
+    void handleCliLine(const char *line, size_t length);
 
     // ------------------------
     // UDPComm.cpp
     // ------------------------
-    void handleUdpLine(const String &line);
+    void handleUdpLine(const char *line, size_t length);
+    void rxPairingBroadcast(const RxPacket &rx);
+    void rxPairingResponse(const RxPacket &rx);
+    void rxPairingRequest(const RxPacket &rx);
+    void rxReconnectRequest(const RxPacket &rx);
+    void rxReconnectResponse(const RxPacket &rx);
+    void rxHeartbeat(const RxPacket &rx);
+    void rxHeartbeatEcho(const RxPacket &rx);
+    bool openUdpSocket();
+    bool transmitFrame(const Ip6Address &dest, uint16_t destPort, const uint8_t *frame,
+                       size_t length);
     bool sendUdpPacket(AckType ack, MessageType type, const uint8_t *payload, size_t length,
-                       const String &destIp, uint16_t destPort,
-                       std::optional<uint16_t> messageId = std::nullopt);
+                       const Ip6Address &dest, uint16_t destPort, bool compressed = false,
+                       uint8_t channel = 0);
+    static size_t frameOverhead(uint8_t channel) { return channel ? 4 : 2; } // header bytes
     bool sendUdpPacket(AckType ack, MessageType type, const std::vector<uint8_t> &payload,
-                       const String &destIp, uint16_t destPort,
-                       std::optional<uint16_t> messageId = std::nullopt);
-    String extractUdpSourceIp(const String &line);
+                       const Ip6Address &dest, uint16_t destPort);
+    bool extractUdpSourceIp(const char *line, size_t length, Ip6Address &src, size_t &end);
     uint16_t packMessage(AckType ack, MessageType type);
     void unpackMessage(uint16_t raw, AckType &ack, MessageType &type);
-    bool parseIncomingPayload(const String &hex, AckType &ack, MessageType &type,
-                              std::vector<uint8_t> &payloadOut);
+    bool parseIncomingPayload(const uint8_t *frame, size_t length, AckType &ack,
+                              MessageType &type, uint8_t &channel, bool &compressed,
+                              const uint8_t *&payload, size_t &payloadLen);
     uint64_t generateMacHash();
+
+    // ------------------------
+    // ReliableUDP.cpp
+    // ------------------------
+    ReliablePeer *reliablePeer(const Ip6Address &addr, uint8_t channel = 0);
+    ReliablePeer *findReliablePeer(const Ip6Address &addr, uint8_t channel = 0);
+    SendStatus queueReliable(const Ip6Address &dest, uint8_t channel, const uint8_t *payload,
+                             size_t length, bool compressed);
+    uint16_t appendReliable(ReliablePeer &peer, MessageType type, bool compressed,
+                            const uint8_t *payload, size_t length, uint8_t fragTx);
+    void pumpReliablePeer(ReliablePeer &peer);
+    void releaseReliableSlot(ReliablePeer &peer, uint8_t slot, uint8_t prev);
+    void expireReliable(ReliablePeer &peer);
+    unsigned long reliableDue(uint8_t slot) const;
+    bool reliableDueBefore(uint8_t a, uint8_t b) const;
+    void reliableHeapMove(uint8_t pos, uint8_t slot);
+    void reliableHeapUpdate(uint8_t slot);
+    void reliableHeapRemove(uint8_t slot);
+    bool transmitReliable(ReliablePeer &peer, PendingReliableUdp &msg);
+    void handleReliableAck(const Ip6Address &src, uint8_t channel, const uint8_t *payload,
+                           size_t length);
+    void handleReliableData(const Ip6Address &src, uint8_t channel, MessageType type,
+                            bool compressed, const uint8_t *payload, size_t length);
+    void deliverReliable(const Ip6Address &src, uint8_t channel, MessageType type,
+                         bool compressed, const uint8_t *data, size_t length);
+    void sendReliableAck(const ReliablePeer &peer);
+    void reportReliable(uint8_t channel, uint16_t msgId, const Ip6Address &addr, bool success);
+    void sampleRtt(ReliablePeer &peer, uint32_t rtt);
+    unsigned long retransmitTimeout(const ReliablePeer &peer);
     void updateReliableUdp();
+    // ------------------------
+    // Fragment.cpp
+    // ------------------------
+    size_t fragmentChunk(bool reliable, uint8_t channel) const;
+    uint16_t nextFragmentTag();
+    SendStatus sendFragmented(const Ip6Address &dest, uint8_t channel, const uint8_t *payload,
+                              size_t length, bool compressed);
+    SendStatus queueFragmented(const Ip6Address &dest, uint8_t channel, const uint8_t *payload,
+                               size_t length, bool compressed);
+    void pumpFragmentTx();
+    void fragmentSettled(uint8_t fragTx, bool acked);
+    ReassemblySlot *reassemblySlot(const Ip6Address &src, uint8_t channel,
+                                   const uint8_t *fragment, size_t length);
+    void handleFragment(const Ip6Address &src, uint8_t channel, const uint8_t *payload,
+                        size_t length, bool reliable, bool compressed);
+    // ------------------------
+    // Coalesce.cpp
+    // ------------------------
+    size_t coalesceCapacity() const;
+    bool coalesces(size_t length) const;
+    SendStatus coalesceUdp(const Ip6Address &dest, const uint8_t *payload, size_t length);
+    CoalesceBuffer *findCoalesceBuffer(const Ip6Address &addr);
+    bool flushCoalesceBuffer(CoalesceBuffer &buf);
+    void flushCoalesced(const Ip6Address &dest);
+    void updateCoalescing();
+    void handleBatch(const Ip6Address &src, const uint8_t *payload, size_t length);
+    // ------------------------
+    // Group.cpp
+    // ------------------------
+    void updateGroups();
+    void settleGroupMember(GroupSend &group, GroupMember &member, bool success);
+    void handleGroupAck(const Ip6Address &src, const uint8_t *payload, size_t length);
+    void handleGroupData(const Ip6Address &src, bool unicast, bool compressed,
+                         const uint8_t *payload, size_t length);
+    bool groupSeen(const Ip6Address &src, uint16_t id);
+    void sendGroupAck(const Ip6Address &dest, uint16_t id);
+    bool nextGroupEvent(unsigned long &due) const;
+    // ------------------------
+    // Beacon.cpp
+    // ------------------------
+    bool sendsBeacons() const;
+    void updateBeacon();
+    void handleBeacon(const Ip6Address &src, const uint8_t *payload, size_t length);
+    static bool beaconLists(const uint8_t *payload, size_t length, uint64_t id);
+    // ------------------------
+    // PubSub.cpp
+    // ------------------------
+    bool subscribed(uint16_t topic) const;
+    void resubscribe();
+    void sendSubscriptions();
+    void usePubSub();
+    bool isMeshLocalIid(const uint8_t *iid);
+    void updatePubSub();
+    void relayPublish(const Ip6Address &origin, bool fromSelf, uint16_t topic, bool compressed,
+                      const uint8_t *data, size_t length);
+    void deliverPublish(uint16_t topic, const Ip6Address &publisher, bool compressed,
+                        const uint8_t *data, size_t length);
+    void rxSubscribe(const RxPacket &rx);
+    void rxSubscribeAck(const RxPacket &rx);
+    void rxSubscribeResync(const RxPacket &rx);
+    void rxPublish(const RxPacket &rx);
+    void rxPublishRelay(const RxPacket &rx);
+    // ------------------------
+    // EventQueue.cpp
+    // ------------------------
+    bool pushEvent(EventKind kind, uint8_t channel, bool flag, uint16_t id,
+                   const Ip6Address &addr, const uint8_t *data, size_t length);
+    void deliverEvent(const Event &event, const uint8_t *data);
+    void notifyJoin(const Ip6Address &ip, const String &hashmac);
+    void notifyLeave(const Ip6Address &ip, const String &hashmac);
+    // ------------------------
+    // Dispatch.cpp
+    // ------------------------
+    void handleUdpPacket(const Ip6Address &src, const uint8_t *frame, size_t length);
+    void rxUnreliable(const RxPacket &rx);
+    void rxReliableData(const RxPacket &rx);
+    void rxReliableAck(const RxPacket &rx);
+    void rxFragment(const RxPacket &rx);
+    void rxBatch(const RxPacket &rx);
+    void rxGroupData(const RxPacket &rx);
+    void rxGroupAck(const RxPacket &rx);
+    void rxBeacon(const RxPacket &rx);
+    void rxUserMessage(const RxPacket &rx);
+    // ------------------------
+    // Compress.cpp
+    // ------------------------
+    bool compressForSend(const uint8_t *&data, size_t &size);
+    static size_t lzCompress(const uint8_t *in, size_t inLen, uint8_t *out, size_t outCap);
+    static size_t lzDecompress(const uint8_t *in, size_t inLen, uint8_t *out, size_t outCap);
+    // ------------------------
+    // NativeUDP.cpp
+    // ------------------------
+    bool openNativeUdp();
+    void closeNativeUdp();
+    bool sendNativeUdp(const Ip6Address &dest, uint16_t destPort, const uint8_t *frame,
+                       size_t length);
+    void drainNativeUdp();
+    static void nativeUdpReceive(void *context, otMessage *message, const otMessageInfo *info);
+    // ------------------------
+    // SendQueue.cpp
+    // ------------------------
+    bool onUpdateTask() const;
+    SendStatus queueSend(const Ip6Address &dest, uint8_t channel, bool reliable,
+                         const uint8_t *data, size_t size);
+    void drainSendQueue();
+    // ------------------------
+    // Task.cpp
+    // ------------------------
+    static void taskMain(void *context);
+    void wakeTask();
+
     // ------------------------
     // Utils.cpp
     // ------------------------
-    bool convertHexToBytes(const String &hex, std::vector<uint8_t> &out);
-    String convertBytesToHex(const uint8_t *data, size_t len);
+    static bool convertHexToBytes(const char *hex, size_t hexLen, uint8_t *out, size_t outCap,
+                                  size_t &outLen);
+    static size_t convertBytesToHex(const uint8_t *data, size_t len, char *out, size_t outCap);
     void logLightThread(LightThreadLogLevel level, const char *fmt, ...);
+    template <LightThreadLogLevel level> static constexpr bool logCompiledIn() {
+        return level >= LT_LOG_MIN_LEVEL;
+    }
+    bool logEnabled(LogSubsystem subsystem, LightThreadLogLevel level) const {
+        return level >= logLevels[static_cast<size_t>(subsystem)];
+    }
 
     // ------------------------
     // exposedUDP.cpp
     // ------------------------
     // Exposed UDP (public-facing interface)
-    void handleNormalUdpMessage(const String &srcIp, const std::vector<uint8_t> &payload,
-                                AckType ack);
+    void handleNormalUdpMessage(const Ip6Address &src, const uint8_t *payload, size_t length,
+                                bool reliable, bool compressed = false, uint8_t channel = 0);
+    SendStatus sendPayload(const Ip6Address &dest, uint8_t channel, bool reliable,
+                           const uint8_t *data, size_t size);
 };
 
 #endif // LIGHTTHREAD_H
@@ -3,11 +3,20 @@
 // Constructor: sets initial state and configures button pin
 LightThread::LightThread() : buttonPin(BUTTON_PIN), state(State::INIT) {
     pinMode(buttonPin, INPUT_PULLUP);
+    for(uint32_t i = 0; i < LT_SEND_SLOTS; ++i)
+        sendSlots[i].seq.store(i, std::memory_order_relaxed);
 }
 
-// Begin routine: initializes CLI, resets state machine
-void LightThread::begin() {
-    logLightThread(LT_LOG_INFO, "LightThread begin()");
+// Begin routine: initializes CLI, resets state machine.
+// `backend` selects whether UDP data goes through the CLI or a native OpenThread socket;
+// the CLI is used for control commands either way. The calling task is taken to be the one
+// that runs update(): from then on, sendUdp() from any other task is queued, even before
+// the first update().
+void LightThread::begin(UdpBackend backend) {
+    updateOwner.store(xTaskGetCurrentTaskHandle(), std::memory_order_relaxed);
+    LT_LOG(FSM, LT_LOG_INFO, "LightThread begin() using %s UDP backend",
+           backend == UdpBackend::NATIVE ? "native" : "CLI");
+    udpBackend = backend;
     OThread.begin(false);    // Start CLI interface (non-blocking)
     OThreadCLI.begin();
     OThreadCLI.setTimeout(250); // Set CLI read timeout
@@ -16,39 +25,38 @@ void LightThread::begin() {
 
 // Main loop update: handles input and state transitions
 void LightThread::update() {
+    updateOwner.store(xTaskGetCurrentTaskHandle(), std::memory_order_relaxed);
+
     handleButton(); // Check for button presses
     processState(); // Call the handler for current state
 
-    String cliBuffer;
-    String udpLine;
-    bool isUDP;
+    readCli(); // Dispatch complete CLI / UDP lines
 
-    // Read characters from CLI and process full lines
-    while(OThreadCLI.available()) {
-        char c = OThreadCLI.read();
+    pumpCliCommands(); // Send queued CLI commands, expire stale ones
 
-        if(processCLIChar(c, cliBuffer, isUDP, udpLine)) {
-            if(isUDP) {
-                handleUdpLine(udpLine); // Handle incoming UDP
-            } else {
-                handleCliLine(cliBuffer); // Handle CLI output
-                cliBuffer = "";           // Clear buffer
-            }
-        }
-    }
+    if(udpBackend == UdpBackend::NATIVE)
+        drainNativeUdp(); // Datagrams received on the native socket
+
+    drainSendQueue(); // sendUdp() calls made from other tasks
 
     updateLighting();    // Update RGB LED
+    expireJoiners();     // Leader: drop joiners silent past their timeout
+    updateBeacon();      // Leader: liveness beacon round when due
+    updateCoalescing();  // Send batches whose flush window has elapsed
+    updateGroups();      // Group retransmissions and delayed group ACKs
+    updatePubSub();      // Joiner: resend an unconfirmed topic list
     updateReliableUdp(); // Retry pending reliable messages
 }
 
 // Sets the current FSM state and resets its entry timer
 void LightThread::setState(State newState) {
     if(state != newState) {
-        logLightThread(LT_LOG_INFO, "State transition: %d → %d", static_cast<int>(state),
-                       static_cast<int>(newState));
+        LT_LOG(FSM, LT_LOG_INFO, "State transition: %d → %d", static_cast<int>(state),
+               static_cast<int>(newState));
         state = newState;
         stateEntryTime = millis();
         justEntered = true; // <- Set on entry
+        meshLocalIidKnown = false;
     }
 }
 
@@ -103,7 +111,7 @@ void LightThread::processState() {
         handleError();
         break;
     default:
-        logLightThread(LT_LOG_WARN, "Unknown state");
+        LT_LOG(FSM, LT_LOG_WARN, "Unknown state");
         break;
     }
 }
@@ -121,49 +129,39 @@ void LightThread::handleInit() {
         String tmp;
         if(role == Role::LEADER) {
             // Setup the Thread network from scratch
-            logLightThread(LT_LOG_INFO, "LEADER detected. Bootstrapping network setup...");
-
-            execAndMatch("dataset init new", "Done");
-            execAndMatch("dataset channel " + String(configuredChannel), "Done");
-            execAndMatch("dataset panid " + configuredPanid, "Done");
-            execAndMatch("dataset networkkey 00112233445566778899aabbccddeeff", "Done");
-            execAndMatch("dataset meshlocalprefix " + configuredPrefix, "Done");
-            execAndMatch("dataset commit active", "Done");
-            execAndMatch("ifconfig up", "Done");
-            execAndMatch("thread start", "Done");
-
-            setState(State::LEADER_WAIT_NETWORK);
+            LT_LOG(FSM, LT_LOG_INFO, "LEADER detected. Bootstrapping network setup...");
+            bootstrapLeaderNetwork(); // Moves on to LEADER_WAIT_NETWORK, or ERROR
         } else {
             if(loadLeaderInfo(leaderIp, tmp)) {
-                logLightThread(LT_LOG_INFO, "INIT: Joiner has saved leader info: %s",
-                               leaderIp.c_str());
+                LT_LOG(FSM, LT_LOG_INFO, "INIT: Joiner has saved leader info: %s",
+                       leaderIp.text().c_str());
                 setState(State::JOINER_RECONNECT);
             } else {
-                logLightThread(LT_LOG_INFO, "INIT: No saved leader info, standby");
+                LT_LOG(FSM, LT_LOG_INFO, "INIT: No saved leader info, standby");
                 setState(State::STANDBY);
             }
         }
     }
 }
 
-// Leader standby: monitor joiner heartbeats and remove stale entries
-void LightThread::handleStandby() {
+// Leader standby: nothing to do between commissioning rounds. Joiner expiry runs in every
+// state from update() (expireJoiners).
+void LightThread::handleStandby() {}
+
+// Leader: drops each joiner silent for its timeout and fires the leave callback. Only
+// joiners that are due are looked at, so the cost does not grow with the registry.
+void LightThread::expireJoiners() {
     if(role != Role::LEADER)
         return;
 
-    static unsigned long lastCheck = 0;
-    if(millis() - lastCheck < 5000)
-        return;
-    lastCheck = millis();
-
-    unsigned long now = millis();
-    for(auto it = joinerHeartbeatMap.begin(); it != joinerHeartbeatMap.end();) {
-        if(now - it->second > 15000) {
-            logLightThread(LT_LOG_WARN, "Joiner %s timed out — removing from heartbeat map",
-                           it->first.c_str());
-            it = joinerHeartbeatMap.erase(it);
-        } else {
-            ++it;
+    JoinerInfo joiner;
+    while(joiners.popExpired(millis(), joiner)) {
+        LT_LOG(FSM, LT_LOG_WARN, "Joiner %s [%016llx] timed out — removing from registry",
+               joiner.addr.text().c_str(), joiner.id);
+        if(leaveCallback) {
+            String hashStr = String((uint32_t)(joiner.id >> 32), HEX) +
+                             String((uint32_t)(joiner.id & 0xFFFFFFFF), HEX);
+            notifyLeave(joiner.addr, hashStr);
         }
     }
 }
@@ -181,27 +179,27 @@ void LightThread::handleButton() {
     if(isPressed && !buttonPressed) {
         buttonPressed = true;
         pressStart = millis();
-        logLightThread(LT_LOG_INFO, "Button press started");
+        LT_LOG(FSM, LT_LOG_INFO, "Button press started");
 
     } else if(!isPressed && buttonPressed) {
         buttonPressed = false;
         unsigned long duration = millis() - pressStart;
 
         if(duration < 50) {
-            logLightThread(LT_LOG_INFO, "Ignored press (debounce)");
+            LT_LOG(FSM, LT_LOG_INFO, "Ignored press (debounce)");
             return;
         }
 
         if(duration >= 3000) {
             // Long press = factory reset (for joiners only)
-            logLightThread(LT_LOG_INFO, "Long press");
+            LT_LOG(FSM, LT_LOG_INFO, "Long press");
             if(role == Role::JOINER) {
                 clearPersistentState();
                 setState(State::STANDBY);
             }
         } else {
             // Short press = trigger pairing
-            logLightThread(LT_LOG_INFO, "Short press");
+            LT_LOG(FSM, LT_LOG_INFO, "Short press");
             if(state == State::STANDBY) {
                 setState(role == Role::LEADER ? State::COMMISSIONER_START : State::JOINER_START);
             }
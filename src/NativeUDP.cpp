@@ -0,0 +1,134 @@
+#include "LightThread.h"
+#include "esp_openthread.h"
+#include "esp_openthread_lock.h"
+#include <openthread/message.h>
+
+static_assert(LT_NATIVE_RX_SLOTS >= 2 && LT_NATIVE_RX_SLOTS <= 255, "ring indices are uint8_t");
+
+// Opens and binds the LightThread socket directly on the OpenThread stack.
+// Replaces the "udp open" / "udp bind" CLI commands when the NATIVE backend is selected.
+bool LightThread::openNativeUdp() {
+    otInstance *instance = esp_openthread_get_instance();
+    if(!instance) {
+        LT_LOG(UDP, LT_LOG_ERROR, "NativeUDP: OpenThread instance not available");
+        return false;
+    }
+
+    closeNativeUdp(); // rebinding (e.g. joiner re-setup) starts from a clean socket
+
+    esp_openthread_lock_acquire(portMAX_DELAY);
+    otError err = otUdpOpen(instance, &nativeSocket, &LightThread::nativeUdpReceive, this);
+    if(err == OT_ERROR_NONE) {
+        otSockAddr sockName = {};
+        sockName.mPort = LT_UDP_PORT;
+        err = otUdpBind(instance, &nativeSocket, &sockName, OT_NETIF_THREAD);
+        if(err != OT_ERROR_NONE)
+            otUdpClose(instance, &nativeSocket);
+    }
+    esp_openthread_lock_release();
+
+    if(err != OT_ERROR_NONE) {
+        LT_LOG(UDP, LT_LOG_ERROR, "NativeUDP: Failed to open socket (error %d)",
+               static_cast<int>(err));
+        return false;
+    }
+
+    nativeSocketOpen = true;
+    LT_LOG(UDP, LT_LOG_INFO, "NativeUDP: Socket bound to port %u", LT_UDP_PORT);
+    return true;
+}
+
+// Closes the native socket if it is open.
+void LightThread::closeNativeUdp() {
+    if(!nativeSocketOpen)
+        return;
+
+    esp_openthread_lock_acquire(portMAX_DELAY);
+    otUdpClose(esp_openthread_get_instance(), &nativeSocket);
+    esp_openthread_lock_release();
+    nativeSocketOpen = false;
+}
+
+// Sends an already framed datagram (header + payload) through the native socket.
+bool LightThread::sendNativeUdp(const Ip6Address &dest, uint16_t destPort, const uint8_t *frame,
+                                size_t length) {
+    if(!nativeSocketOpen) {
+        LT_LOG(UDP, LT_LOG_WARN, "NativeUDP: Socket not open, dropping send to %s",
+               dest.text().c_str());
+        return false;
+    }
+
+    otMessageInfo info = {};
+    info.mPeerAddr = dest.toOt();
+    info.mPeerPort = destPort;
+
+    otInstance *instance = esp_openthread_get_instance();
+    esp_openthread_lock_acquire(portMAX_DELAY);
+
+    otError err = OT_ERROR_NO_BUFS;
+    otMessage *message = otUdpNewMessage(instance, nullptr);
+    if(message) {
+        err = otMessageAppend(message, frame, static_cast<uint16_t>(length));
+        if(err == OT_ERROR_NONE)
+            err = otUdpSend(instance, &nativeSocket, message, &info);
+        // otUdpSend takes ownership of the message only on success
+        if(err != OT_ERROR_NONE)
+            otMessageFree(message);
+    }
+
+    esp_openthread_lock_release();
+
+    if(err != OT_ERROR_NONE) {
+        LT_LOG(UDP, LT_LOG_WARN, "NativeUDP: Send to %s failed (error %d)", dest.text().c_str(),
+               static_cast<int>(err));
+        return false;
+    }
+
+    LT_LOG(UDP, LT_LOG_VERBOSE, "NativeUDP: Sent %u bytes to %s", static_cast<unsigned>(length),
+           dest.text().c_str());
+    return true;
+}
+
+// OpenThread receive callback. Runs in the OpenThread task with the stack lock held,
+// so it only copies the datagram into the ring and wakes the task; dispatch happens in
+// update().
+void LightThread::nativeUdpReceive(void *context, otMessage *message,
+                                   const otMessageInfo *info) {
+    LightThread *self = static_cast<LightThread *>(context);
+
+    uint16_t offset = otMessageGetOffset(message);
+    uint16_t length = otMessageGetLength(message) - offset;
+
+    uint8_t head = self->nativeRxHead.load(std::memory_order_relaxed);
+    uint8_t next = (head + 1) % LT_NATIVE_RX_SLOTS;
+    if(next == self->nativeRxTail.load(std::memory_order_acquire) || length > LT_MAX_UDP_FRAME) {
+        self->nativeRxDropped++;
+        return;
+    }
+
+    NativeRxSlot &slot = self->nativeRx[head];
+    slot.srcAddr = Ip6Address::fromOt(info->mPeerAddr);
+    slot.length = otMessageRead(message, offset, slot.data, length);
+
+    self->nativeRxHead.store(next, std::memory_order_release);
+    self->wakeTask();
+}
+
+// Dispatches datagrams queued by nativeUdpReceive() to the regular UDP handling.
+void LightThread::drainNativeUdp() {
+    uint8_t tail = nativeRxTail.load(std::memory_order_relaxed);
+
+    while(tail != nativeRxHead.load(std::memory_order_acquire)) {
+        NativeRxSlot &slot = nativeRx[tail];
+        handleUdpPacket(slot.srcAddr, slot.data, slot.length);
+
+        tail = (tail + 1) % LT_NATIVE_RX_SLOTS;
+        nativeRxTail.store(tail, std::memory_order_release);
+    }
+
+    uint32_t dropped = nativeRxDropped.exchange(0);
+    if(dropped) {
+        LT_LOG(UDP, LT_LOG_WARN, "NativeUDP: Dropped %u datagrams (ring full or oversized)",
+               static_cast<unsigned>(dropped));
+    }
+}
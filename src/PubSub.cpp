@@ -0,0 +1,355 @@
+#include "LightThread.h"
+
+// Joiners talk to each other through the leader. A joiner sends its topic list to the
+// leader in a SUBSCRIBE request, [id:64][version:8][topic:16]..., which replaces the list
+// the leader holds for it and is confirmed with a SUBSCRIBE response carrying the version.
+// Versions count modulo 256; a list older than the one held is answered with the held
+// version, so a joiner that restarted numbers its next list past it.
+// A SUBSCRIBE without ack asks a joiner to send its list again, e.g. after the leader lost
+// it; the leader sends none until pub/sub is in use (usePubSub()). A joiner publishes with
+// a PUBLISH request to the leader, [topic:16][data]; the leader relays it to the
+// subscribers as [topic:16][publisher IID:64][data], where an all-zero interface
+// identifier means the leader itself published. Mesh-local addresses share the
+// leader's prefix, so the IID is all a subscriber needs to name the publisher.
+static const size_t kSubscribeHeader = 9;       // id:64, version:8
+static const size_t kPublishHeader = 2;         // topic:16
+static const size_t kRelayedPublishHeader = 10; // topic:16, publisher IID:64
+
+static_assert(LT_PUBSUB_TOPICS <= 255, "topic counts are uint8_t");
+static_assert(kSubscribeHeader + 2 * LT_PUBSUB_TOPICS + 2 <= LT_MAX_UDP_FRAME,
+              "a topic list must fit in one frame");
+
+// True if this node subscribed to `topic`.
+bool LightThread::subscribed(uint16_t topic) const {
+    for(uint8_t i = 0; i < topicCount; ++i) {
+        if(topics[i] == topic)
+            return true;
+    }
+    return false;
+}
+
+// Subscribes this node to `topic`: publishes to it from other nodes reach the publish
+// callback. On a joiner the leader learns of it as soon as the joiner is paired.
+// Returns false if LT_PUBSUB_TOPICS topics are already subscribed.
+bool LightThread::subscribe(uint16_t topic) {
+    if(subscribed(topic))
+        return true;
+    if(topicCount == LT_PUBSUB_TOPICS)
+        return false;
+
+    topics[topicCount++] = topic;
+    resubscribe();
+    usePubSub();
+    return true;
+}
+
+void LightThread::unsubscribe(uint16_t topic) {
+    for(uint8_t i = 0; i < topicCount; ++i) {
+        if(topics[i] == topic) {
+            topics[i] = topics[--topicCount];
+            resubscribe();
+            return;
+        }
+    }
+}
+
+// Registers a callback for publishes to the topics this node subscribed to. The payload
+// is copied into a vector for every publish; registerPublishViewCallback() avoids that.
+void LightThread::registerPublishCallback(PublishCallback cb) {
+    if(!cb)
+        return registerPublishViewCallback(nullptr);
+    registerPublishViewCallback([cb](uint16_t topic, const Ip6Address &publisher,
+                                     const uint8_t *payload, size_t length) {
+        cb(topic, publisher, std::vector<uint8_t>(payload, payload + length));
+    });
+}
+
+// Registers a callback that gets each publish where it lies in the receive buffer, or in
+// the event queue in deferred mode, without copying or allocating. The view is only valid
+// during the call. Replaces a registerPublishCallback() callback.
+void LightThread::registerPublishViewCallback(PublishViewCallback cb) {
+    publishCallback = cb;
+    LT_LOG(UDP, LT_LOG_INFO, "PubSub: Publish callback registered");
+}
+
+// Sends `payload` to every subscriber of `topic` but this node, unreliably. A joiner hands
+// it to the leader, which relays it; the payload must fit in one frame along with the
+// relay header. Compressed if setUdpCompression() is on. Not safe from other tasks, unlike
+// sendUdp(): call it from the one running update().
+SendStatus LightThread::publish(uint16_t topic, const std::vector<uint8_t> &payload) {
+    const uint8_t *data = payload.data();
+    size_t size = payload.size();
+    bool compressed = compressForSend(data, size);
+    if(2 + kRelayedPublishHeader + size > udpMtu)
+        return SendStatus::TOO_LARGE;
+
+    if(role == Role::LEADER) {
+        usePubSub();
+        relayPublish(Ip6Address{}, true, topic, compressed, data, size);
+        return SendStatus::OK;
+    }
+    if(leaderIp.isUnspecified())
+        return SendStatus::INVALID;
+
+    uint8_t buf[LT_MAX_UDP_FRAME];
+    buf[0] = topic >> 8;
+    buf[1] = topic & 0xFF;
+    memcpy(buf + kPublishHeader, data, size);
+    if(!sendUdpPacket(AckType::REQUEST, MessageType::PUBLISH, buf, kPublishHeader + size,
+                      leaderIp, LT_UDP_PORT, compressed))
+        return SendStatus::SEND_FAILED;
+    return SendStatus::OK;
+}
+
+// Marks the topic list as changed and sends it to the leader now if there is one.
+void LightThread::resubscribe() {
+    subscriptionVersion++;
+    subscriptionPending = true;
+    sendSubscriptions();
+}
+
+// Joiner: sends the topic list to the leader. It stays pending, and is resent from
+// updatePubSub(), until the leader confirms this version.
+void LightThread::sendSubscriptions() {
+    if(role != Role::JOINER || leaderIp.isUnspecified() || state != State::JOINER_PAIRED)
+        return;
+
+    uint64_t id = generateMacHash();
+    uint8_t buf[kSubscribeHeader + 2 * LT_PUBSUB_TOPICS];
+    for(int i = 0; i < 8; ++i)
+        buf[i] = (id >> ((7 - i) * 8)) & 0xFF;
+    buf[8] = subscriptionVersion;
+    for(uint8_t i = 0; i < topicCount; ++i) {
+        buf[kSubscribeHeader + 2 * i] = topics[i] >> 8;
+        buf[kSubscribeHeader + 2 * i + 1] = topics[i] & 0xFF;
+    }
+
+    sendUdpPacket(AckType::REQUEST, MessageType::SUBSCRIBE, buf,
+                  kSubscribeHeader + 2 * topicCount, leaderIp, LT_UDP_PORT);
+    subscriptionSentAt = millis();
+}
+
+// Leader: notes that pub/sub is in use, on the first topic list, publish or subscription.
+// Lists held before a restart of this leader are gone, so the first time every joiner is
+// asked, by one multicast, to send its list again; from then on rxHeartbeat() asks each
+// joiner new to the registry. A mesh without pub/sub never sees a SUBSCRIBE.
+void LightThread::usePubSub() {
+    if(role != Role::LEADER || pubSubInUse)
+        return;
+    pubSubInUse = true;
+    uint8_t none = 0;
+    sendUdpPacket(AckType::NONE, MessageType::SUBSCRIBE, &none, 0,
+                  Ip6Address::realmLocalAllNodes(), LT_UDP_PORT);
+}
+
+// True if `iid` is the interface identifier of this node's mesh-local address. Read from
+// the stack once, not for every relayed publish.
+bool LightThread::isMeshLocalIid(const uint8_t *iid) {
+    if(!meshLocalIidKnown) {
+        Ip6Address self = getMyAddress();
+        if(self.isUnspecified())
+            return false;
+        memcpy(meshLocalIid, self.bytes + 8, 8);
+        meshLocalIidKnown = true;
+    }
+    return memcmp(iid, meshLocalIid, 8) == 0;
+}
+
+// Joiner: resends an unconfirmed topic list. Called once per update().
+void LightThread::updatePubSub() {
+    if(role == Role::JOINER && subscriptionPending &&
+       millis() - subscriptionSentAt >= LT_PUBSUB_RETRY)
+        sendSubscriptions();
+}
+
+// Leader: sends a publish to the subscribers of its topic other than its publisher, by
+// multicast once there are LT_PUBSUB_MULTICAST_MIN of them and by unicast below that. A
+// multicast reaches every node, and those that did not subscribe drop it. The leader's own
+// publish callback gets it last, since it may publish again.
+void LightThread::relayPublish(const Ip6Address &origin, bool fromSelf, uint16_t topic,
+                               bool compressed, const uint8_t *data, size_t length) {
+    size_t subscribers = 0;
+    joiners.forEach([&](const JoinerInfo &joiner) {
+        for(uint8_t i = 0; i < joiner.topicCount; ++i) {
+            if(joiner.topics[i] == topic && (fromSelf || joiner.addr != origin)) {
+                subscribers++;
+                break;
+            }
+        }
+    });
+
+    if(subscribers > 0) {
+        uint8_t buf[LT_MAX_UDP_FRAME];
+        buf[0] = topic >> 8;
+        buf[1] = topic & 0xFF;
+        memset(buf + kPublishHeader, 0, 8);
+        if(!fromSelf)
+            memcpy(buf + kPublishHeader, origin.bytes + 8, 8);
+        memcpy(buf + kRelayedPublishHeader, data, length);
+        size_t frameLen = kRelayedPublishHeader + length;
+
+        if(subscribers >= LT_PUBSUB_MULTICAST_MIN) {
+            sendUdpPacket(AckType::NONE, MessageType::PUBLISH, buf, frameLen,
+                          Ip6Address::realmLocalAllNodes(), LT_UDP_PORT, compressed);
+            stats.publishesRelayed++;
+        } else {
+            joiners.forEach([&](const JoinerInfo &joiner) {
+                for(uint8_t i = 0; i < joiner.topicCount; ++i) {
+                    if(joiner.topics[i] == topic && (fromSelf || joiner.addr != origin)) {
+                        sendUdpPacket(AckType::NONE, MessageType::PUBLISH, buf, frameLen,
+                                      joiner.addr, LT_UDP_PORT, compressed);
+                        stats.publishesRelayed++;
+                        break;
+                    }
+                }
+            });
+        }
+    }
+
+    LT_LOG(UDP, LT_LOG_INFO, "PubSub: Topic %u relayed to %u subscribers", topic,
+           static_cast<unsigned>(subscribers));
+
+    if(!fromSelf && subscribed(topic))
+        deliverPublish(topic, origin, compressed, data, length);
+}
+
+// Hands a publish to the publish callback, expanding it first if it is compressed.
+void LightThread::deliverPublish(uint16_t topic, const Ip6Address &publisher, bool compressed,
+                                 const uint8_t *data, size_t length) {
+    if(compressed) {
+        length = lzDecompress(data, length, lzBuffer, sizeof(lzBuffer));
+        if(length == 0) {
+            LT_LOG(UDP, LT_LOG_WARN, "PubSub: Corrupt compressed payload from %s",
+                   publisher.text().c_str());
+            return;
+        }
+        data = lzBuffer;
+    }
+
+    if(deferredDelivery) {
+        pushEvent(EventKind::PUBLISH, 0, false, topic, publisher, data, length);
+    } else if(publishCallback) {
+        lzBufferLent = data == lzBuffer;
+        publishCallback(topic, publisher, data, length);
+        lzBufferLent = false;
+    }
+}
+
+// True if subscription version `a` is later than `b`, modulo 256.
+static inline bool versionAfter(uint8_t a, uint8_t b) { return static_cast<int8_t>(a - b) > 0; }
+
+// Leader: a joiner's topic list replaces the one held for it, unless it is older, e.g. a
+// retry overtaken by a later list. Only joiners in the registry are confirmed, and only
+// from the address their heartbeats come from; others retry, and an unknown joiner is
+// asked to resend once its heartbeat adds it.
+void LightThread::rxSubscribe(const RxPacket &rx) {
+    if(rx.length < kSubscribeHeader || (rx.length - kSubscribeHeader) % 2 != 0) {
+        LT_LOG(UDP, LT_LOG_WARN, "PubSub: Invalid subscription from %s", rx.src.text().c_str());
+        return;
+    }
+
+    uint64_t id = 0;
+    for(int i = 0; i < 8; ++i)
+        id = (id << 8) | rx.payload[i];
+
+    usePubSub();
+    JoinerInfo *joiner = joiners.find(id);
+    if(!joiner) {
+        LT_LOG(UDP, LT_LOG_INFO, "PubSub: Subscription from unknown joiner %s",
+               rx.src.text().c_str());
+        return;
+    }
+
+    if(joiner->addr != rx.src) {
+        LT_LOG(UDP, LT_LOG_WARN, "PubSub: Subscription for %s sent from %s, ignored",
+               joiner->addr.text().c_str(), rx.src.text().c_str());
+        return;
+    }
+
+    uint8_t version = rx.payload[8];
+    if(joiner->topicsSet && versionAfter(joiner->topicVersion, version)) {
+        LT_LOG(UDP, LT_LOG_INFO, "PubSub: Stale subscription %u from %s, holding %u", version,
+               rx.src.text().c_str(), joiner->topicVersion);
+        sendUdpPacket(AckType::RESPONSE, MessageType::SUBSCRIBE, &joiner->topicVersion, 1,
+                      rx.src, LT_UDP_PORT);
+        return;
+    }
+
+    size_t count = (rx.length - kSubscribeHeader) / 2;
+    if(count > LT_PUBSUB_TOPICS) {
+        LT_LOG(UDP, LT_LOG_WARN, "PubSub: %s subscribed to %u topics, keeping %u",
+               rx.src.text().c_str(), static_cast<unsigned>(count), LT_PUBSUB_TOPICS);
+        count = LT_PUBSUB_TOPICS;
+    }
+
+    const uint8_t *list = rx.payload + kSubscribeHeader;
+    joiner->topicCount = count;
+    joiner->topicVersion = version;
+    joiner->topicsSet = true;
+    for(size_t i = 0; i < count; ++i)
+        joiner->topics[i] = (list[2 * i] << 8) | list[2 * i + 1];
+
+    sendUdpPacket(AckType::RESPONSE, MessageType::SUBSCRIBE, &version, 1, rx.src, LT_UDP_PORT);
+    LT_LOG(UDP, LT_LOG_INFO, "PubSub: %s subscribed to %u topics", rx.src.text().c_str(),
+           static_cast<unsigned>(count));
+}
+
+// Joiner: the leader confirmed a topic list. An older version leaves the current one
+// pending. A version not older than ours is a list the leader kept from before we
+// restarted: ours is renumbered past it and sent again.
+void LightThread::rxSubscribeAck(const RxPacket &rx) {
+    if(rx.length != 1 || rx.src != leaderIp)
+        return;
+    uint8_t held = rx.payload[0];
+    if(held == subscriptionVersion) {
+        subscriptionPending = false;
+    } else if(!versionAfter(subscriptionVersion, held)) {
+        subscriptionVersion = held;
+        resubscribe();
+    }
+}
+
+// Joiner: the leader has no topic list for us.
+void LightThread::rxSubscribeResync(const RxPacket &rx) {
+    if(topicCount > 0 && rx.src == leaderIp)
+        resubscribe();
+}
+
+// A publish relayed by the leader. Nodes that did not subscribe drop the multicast copies,
+// and a publisher drops its own.
+void LightThread::rxPublish(const RxPacket &rx) {
+    if(rx.length < kRelayedPublishHeader)
+        return;
+
+    uint16_t topic = (rx.payload[0] << 8) | rx.payload[1];
+    if(!subscribed(topic))
+        return;
+
+    Ip6Address publisher = rx.src;
+    static const uint8_t kSelf[8] = {};
+    const uint8_t *iid = rx.payload + kPublishHeader;
+    if(memcmp(iid, kSelf, 8) != 0) {
+        if(isMeshLocalIid(iid))
+            return;
+        memcpy(publisher.bytes + 8, iid, 8);
+    }
+
+    deliverPublish(topic, publisher, rx.compressed, rx.payload + kRelayedPublishHeader,
+                   rx.length - kRelayedPublishHeader);
+}
+
+// Leader: a joiner's publish to relay. Dropped if the relayed frame would exceed the MTU,
+// the limit publish() applies to the leader's own.
+void LightThread::rxPublishRelay(const RxPacket &rx) {
+    if(rx.length < kPublishHeader ||
+       2 + kRelayedPublishHeader + rx.length - kPublishHeader > udpMtu) {
+        LT_LOG(UDP, LT_LOG_WARN, "PubSub: Publish from %s too large to relay",
+               rx.src.text().c_str());
+        return;
+    }
+
+    usePubSub();
+    uint16_t topic = (rx.payload[0] << 8) | rx.payload[1];
+    relayPublish(rx.src, false, topic, rx.compressed, rx.payload + kPublishHeader,
+                 rx.length - kPublishHeader);
+}
@@ -0,0 +1,581 @@
+#include "LightThread.h"
+#include "esp_random.h"
+
+static_assert(LT_RELIABLE_SLOTS < 255, "slot indices are uint8_t, 0xFF means none");
+static_assert(LT_RELIABLE_PEERS <= 255, "peer indices are uint8_t");
+static_assert(LT_RELIABLE_PAYLOAD_SIZE + 5 <= LT_MAX_UDP_FRAME,
+              "a reliable payload and its headers must fit in one frame");
+
+// Flags byte of a reliable data frame
+#define LT_RELIABLE_FLAG_BASE 0x01 // frame is the sender's oldest unacknowledged message
+#define LT_RELIABLE_FLAG_SKIP 0x02 // no payload: sender abandoned everything before seq
+#define LT_RELIABLE_FLAG_START 0x04 // sender has had no ACK yet: seq starts a new stream
+
+static const size_t kReliableDataHeader = 3; // seq:16, flags:8
+static const size_t kReliableAckLength = 6;  // next expected seq:16, bitmap:32
+
+// Serial-number distance from b to a; negative when a is older than b.
+static inline int16_t seqDiff(uint16_t a, uint16_t b) { return static_cast<int16_t>(a - b); }
+
+// Returns the stream state for `addr` on `channel`, or nullptr if none exists yet. Each
+// channel to a peer is its own stream, so a loss on one does not hold up the others.
+LightThread::ReliablePeer *LightThread::findReliablePeer(const Ip6Address &addr,
+                                                         uint8_t channel) {
+    for(ReliablePeer &peer : reliablePeers) {
+        if(peer.inUse && peer.channel == channel && peer.addr == addr)
+            return &peer;
+    }
+    return nullptr;
+}
+
+// Returns the stream state for `addr`, creating it on first use. When the table is full
+// the least recently active peer with nothing queued or held is recycled; returns nullptr
+// if every peer is busy. New streams start at a random sequence so a restarted sender is
+// not mistaken for its previous incarnation.
+LightThread::ReliablePeer *LightThread::reliablePeer(const Ip6Address &addr, uint8_t channel) {
+    if(ReliablePeer *peer = findReliablePeer(addr, channel))
+        return peer;
+
+    ReliablePeer *entry = nullptr;
+    for(ReliablePeer &peer : reliablePeers) {
+        if(!peer.inUse) {
+            entry = &peer;
+            break;
+        }
+        bool busy = peer.txHead != kNoSlot || peer.held > 0;
+        for(const FragmentTx &tx : fragmentTx)
+            busy = busy || (tx.inUse && &reliablePeers[tx.peer] == &peer);
+        if(!busy && (!entry || timeBefore(peer.lastActive, entry->lastActive)))
+            entry = &peer;
+    }
+    if(!entry)
+        return nullptr;
+
+    if(entry->inUse)
+        LT_LOG(UDP, LT_LOG_INFO, "ReliableUDP: Recycling stream state of %s",
+               entry->addr.text().c_str());
+
+    *entry = ReliablePeer();
+    entry->inUse = true;
+    entry->addr = addr;
+    entry->channel = channel;
+    entry->lastActive = millis();
+    entry->nextSeq = static_cast<uint16_t>(esp_random());
+    return entry;
+}
+
+// Queues a payload on the destination's reliable stream. Fails with QUEUE_FULL rather than
+// growing the queue.
+SendStatus LightThread::queueReliable(const Ip6Address &dest, uint8_t channel,
+                                      const uint8_t *payload, size_t length, bool compressed) {
+    if(dest.isUnspecified()) {
+        LT_LOG(UDP, LT_LOG_WARN, "ReliableUDP: Invalid destination %s", dest.text().c_str());
+        return SendStatus::INVALID;
+    }
+    if(length > LT_RELIABLE_PAYLOAD_SIZE) {
+        LT_LOG(UDP, LT_LOG_WARN, "ReliableUDP: Payload too large (%u bytes)",
+               static_cast<unsigned>(length));
+        return SendStatus::TOO_LARGE;
+    }
+    if(reliableSlotsUsed == LT_RELIABLE_SLOTS)
+        return SendStatus::QUEUE_FULL;
+
+    ReliablePeer *peer = reliablePeer(dest, channel);
+    if(!peer) {
+        LT_LOG(UDP, LT_LOG_WARN, "ReliableUDP: No free peer entry for %s", dest.text().c_str());
+        return SendStatus::QUEUE_FULL;
+    }
+
+    appendReliable(*peer, MessageType::NORMAL, compressed, payload, length, kNoSlot);
+    return SendStatus::OK;
+}
+
+// Copies a message into a free slot at the end of the peer's stream and sends it if the
+// window allows. The caller checks that a slot is free. Returns the message's sequence.
+uint16_t LightThread::appendReliable(ReliablePeer &peer, MessageType type, bool compressed,
+                                     const uint8_t *payload, size_t length, uint8_t fragTx) {
+    uint8_t slot = 0;
+    while(reliableSlots[slot].inUse)
+        ++slot;
+
+    // Deadlines never decrease along a stream, so messages always expire oldest first
+    unsigned long deadline = millis() + reliableDeadline;
+    if(peer.txTail != kNoSlot && timeBefore(deadline, reliableSlots[peer.txTail].deadline))
+        deadline = reliableSlots[peer.txTail].deadline;
+
+    PendingReliableUdp &msg = reliableSlots[slot];
+    msg.inUse = true;
+    msg.sent = false;
+    msg.type = type;
+    msg.compressed = compressed;
+    msg.fragTx = fragTx;
+    msg.peer = &peer - reliablePeers;
+    msg.next = kNoSlot;
+    msg.retryCount = 0;
+    msg.seq = peer.nextSeq++;
+    msg.length = length;
+    msg.deadline = deadline;
+    memcpy(msg.payload, payload, length);
+
+    if(peer.txTail == kNoSlot)
+        peer.txHead = slot;
+    else
+        reliableSlots[peer.txTail].next = slot;
+    peer.txTail = slot;
+    reliableSlotsUsed++;
+
+    msg.heapPos = reliableHeapSize++;
+    reliableHeap[msg.heapPos] = slot;
+    reliableHeapUpdate(slot);
+
+    uint16_t seq = msg.seq;
+    pumpReliablePeer(peer);
+    return seq;
+}
+
+// Unlinks `slot` from the peer's queue (`prev` is the slot before it, or kNoSlot) and
+// returns it to the pool.
+void LightThread::releaseReliableSlot(ReliablePeer &peer, uint8_t slot, uint8_t prev) {
+    PendingReliableUdp &msg = reliableSlots[slot];
+    if(prev == kNoSlot)
+        peer.txHead = msg.next;
+    else
+        reliableSlots[prev].next = msg.next;
+    if(peer.txTail == slot)
+        peer.txTail = prev;
+
+    reliableHeapRemove(slot);
+    msg.inUse = false;
+    reliableSlotsUsed--;
+}
+
+// Next time a slot needs attention: its retransmission once sent, otherwise its deadline.
+unsigned long LightThread::reliableDue(uint8_t slot) const {
+    const PendingReliableUdp &msg = reliableSlots[slot];
+    return (msg.sent && timeBefore(msg.retryAt, msg.deadline)) ? msg.retryAt : msg.deadline;
+}
+
+bool LightThread::reliableDueBefore(uint8_t a, uint8_t b) const {
+    return timeBefore(reliableDue(a), reliableDue(b));
+}
+
+void LightThread::reliableHeapMove(uint8_t pos, uint8_t slot) {
+    reliableHeap[pos] = slot;
+    reliableSlots[slot].heapPos = pos;
+}
+
+// Restores heap order after the due time of `slot` changed.
+void LightThread::reliableHeapUpdate(uint8_t slot) {
+    size_t pos = reliableSlots[slot].heapPos;
+
+    while(pos > 0) {
+        size_t parent = (pos - 1) / 2;
+        if(!reliableDueBefore(slot, reliableHeap[parent]))
+            break;
+        reliableHeapMove(pos, reliableHeap[parent]);
+        pos = parent;
+    }
+
+    for(;;) {
+        size_t child = 2 * pos + 1;
+        if(child >= reliableHeapSize)
+            break;
+        if(child + 1 < reliableHeapSize &&
+           reliableDueBefore(reliableHeap[child + 1], reliableHeap[child]))
+            child++;
+        if(!reliableDueBefore(reliableHeap[child], slot))
+            break;
+        reliableHeapMove(pos, reliableHeap[child]);
+        pos = child;
+    }
+
+    reliableHeapMove(pos, slot);
+}
+
+void LightThread::reliableHeapRemove(uint8_t slot) {
+    uint8_t last = reliableHeap[--reliableHeapSize];
+    if(last == slot)
+        return;
+    reliableHeapMove(reliableSlots[slot].heapPos, last);
+    reliableHeapUpdate(last);
+}
+
+// Sends every queued message that fits in the window. The window is measured from the
+// oldest unacknowledged message; a peer that has never ACKed gets one message at a time
+// so its receiver can synchronise on the first sequence number.
+void LightThread::pumpReliablePeer(ReliablePeer &peer) {
+    if(peer.txHead == kNoSlot)
+        return;
+
+    uint16_t base = reliableSlots[peer.txHead].seq;
+    uint8_t window = peer.established ? reliableWindow : 1;
+
+    for(uint8_t slot = peer.txHead; slot != kNoSlot; slot = reliableSlots[slot].next) {
+        PendingReliableUdp &msg = reliableSlots[slot];
+        if(seqDiff(msg.seq, base) >= window)
+            break;
+        if(!msg.sent)
+            transmitReliable(peer, msg);
+    }
+}
+
+// Frames and sends (or resends) one reliable message.
+bool LightThread::transmitReliable(ReliablePeer &peer, PendingReliableUdp &msg) {
+    uint8_t slot = &msg - reliableSlots;
+    uint8_t buf[LT_MAX_UDP_FRAME];
+    buf[0] = (msg.seq >> 8) & 0xFF;
+    buf[1] = msg.seq & 0xFF;
+    buf[2] = (slot == peer.txHead) ? LT_RELIABLE_FLAG_BASE : 0;
+    if(!peer.established)
+        buf[2] |= LT_RELIABLE_FLAG_START;
+    memcpy(buf + kReliableDataHeader, msg.payload, msg.length);
+
+    // Jitter keeps messages that timed out together from being resent together again
+    unsigned long timeout = retransmitTimeout(peer);
+    msg.sent = true;
+    msg.timeSent = millis();
+    msg.retryAt = msg.timeSent + timeout + esp_random() % (timeout / 4 + 1);
+    reliableHeapUpdate(slot);
+
+    return sendUdpPacket(AckType::REQUEST, msg.type, buf, kReliableDataHeader + msg.length,
+                         peer.addr, LT_UDP_PORT, msg.compressed, peer.channel);
+}
+
+// Handles an ACK: everything before the cumulative sequence, plus every sequence flagged
+// in the selective bitmap, is delivered and leaves the send queue.
+void LightThread::handleReliableAck(const Ip6Address &src, uint8_t channel, const uint8_t *payload,
+                                    size_t length) {
+    if(length < kReliableAckLength) {
+        LT_LOG(UDP, LT_LOG_WARN, "ReliableUDP: Short ACK from %s", src.text().c_str());
+        return;
+    }
+
+    ReliablePeer *peer = findReliablePeer(src, channel);
+    if(!peer) {
+        LT_LOG(UDP, LT_LOG_WARN, "ReliableUDP: Unexpected ACK from %s", src.text().c_str());
+        return;
+    }
+    if(peer->txHead == kNoSlot) {
+        // A late or duplicate ACK for messages already settled, normal with selective ACKs
+        LT_LOG(UDP, LT_LOG_VERBOSE, "ReliableUDP: Stale ACK from %s", src.text().c_str());
+        return;
+    }
+
+    uint16_t cumulative = (payload[0] << 8) | payload[1];
+    uint32_t bitmap = (static_cast<uint32_t>(payload[2]) << 24) |
+                      (static_cast<uint32_t>(payload[3]) << 16) |
+                      (static_cast<uint32_t>(payload[4]) << 8) | payload[5];
+
+    unsigned long now = millis();
+    peer->established = true;
+    peer->lastActive = now;
+
+    // Callbacks run after the queue is updated, since they may send again
+    uint16_t acked[LT_RELIABLE_WINDOW_MAX];
+    size_t ackedCount = 0;
+    long rtt = -1;
+    bool progress = false;
+
+    uint8_t prev = kNoSlot;
+    for(uint8_t slot = peer->txHead; slot != kNoSlot;) {
+        PendingReliableUdp &msg = reliableSlots[slot];
+        uint8_t next = msg.next;
+        int16_t d = seqDiff(msg.seq, cumulative);
+        bool isAcked = d < 0 || (d > 0 && d <= 32 && ((bitmap >> (d - 1)) & 1));
+        bool fragment = msg.fragTx != kNoSlot;
+        if(isAcked && msg.sent && (fragment || ackedCount < LT_RELIABLE_WINDOW_MAX)) {
+            // Karn's rule: a retransmitted message cannot tell which copy was ACKed
+            if(msg.retryCount == 0 && (rtt < 0 || static_cast<long>(now - msg.timeSent) < rtt))
+                rtt = now - msg.timeSent;
+            if(fragment)
+                fragmentSettled(msg.fragTx, true);
+            else
+                acked[ackedCount++] = msg.seq;
+            progress = true;
+            releaseReliableSlot(*peer, slot, prev);
+        } else {
+            prev = slot;
+        }
+        slot = next;
+    }
+
+    // Any progress shows the path works again; only a clean sample moves the estimate
+    if(progress)
+        peer->backoff = 0;
+    if(rtt >= 0)
+        sampleRtt(*peer, rtt);
+    pumpReliablePeer(*peer);
+    pumpFragmentTx();
+
+    for(size_t i = 0; i < ackedCount; ++i) {
+        LT_LOG(UDP, LT_LOG_DEBUG, "ReliableUDP: ACK received for msgId %u from %s", acked[i],
+               src.text().c_str());
+        reportReliable(channel, acked[i], src, true);
+    }
+}
+
+// Handles a reliable data frame: updates the receive window, ACKs, then delivers.
+// In in-order mode messages ahead of a gap wait in the shared reorder slots; otherwise they
+// are delivered on arrival. Either way each message is delivered once: a retry after a lost
+// ACK is recognised from the receive window (everything behind rcvNext, plus rcvMask) and
+// only ACKed again.
+void LightThread::handleReliableData(const Ip6Address &src, uint8_t channel, MessageType type,
+                                     bool compressed, const uint8_t *payload, size_t length) {
+    if(length < kReliableDataHeader) {
+        LT_LOG(UDP, LT_LOG_WARN, "ReliableUDP: Reliable message too short from %s",
+               src.text().c_str());
+        return;
+    }
+
+    ReliablePeer *entry = reliablePeer(src, channel);
+    if(!entry) {
+        LT_LOG(UDP, LT_LOG_WARN, "ReliableUDP: No free peer entry for %s, not ACKed",
+               src.text().c_str());
+        return;
+    }
+    ReliablePeer &peer = *entry;
+    uint8_t peerIndex = entry - reliablePeers;
+    peer.lastActive = millis();
+
+    uint16_t seq = (payload[0] << 8) | payload[1];
+    uint8_t flags = payload[2];
+    const uint8_t *data = payload + kReliableDataHeader;
+    size_t dataLen = length - kReliableDataHeader;
+    bool skip = flags & LT_RELIABLE_FLAG_SKIP;
+    bool base = skip || (flags & LT_RELIABLE_FLAG_BASE);
+    bool start = flags & LT_RELIABLE_FLAG_START;
+
+    // A receiver only learns where a stream starts from a base frame
+    if(!peer.rxSynced) {
+        if(!base) {
+            LT_LOG(UDP, LT_LOG_INFO, "ReliableUDP: Waiting for stream start from %s",
+                   src.text().c_str());
+            return;
+        }
+        peer.rxSynced = true;
+        peer.rcvNext = seq;
+        peer.rcvMask = 0;
+        peer.rxStart = seq;
+    }
+
+    // Messages to deliver, in order: reorder slot indices, or kNoSlot for this frame
+    uint8_t ready[LT_REORDER_SLOTS + 1];
+    size_t readyCount = 0;
+
+    // Moves the window forward to `target`, releasing held messages in order; gaps the
+    // sender has abandoned are skipped.
+    auto advanceTo = [&](uint16_t target) {
+        while(seqDiff(target, peer.rcvNext) > 0) {
+            if(peer.rcvMask & 1) {
+                for(uint8_t i = 0; i < LT_REORDER_SLOTS; ++i) {
+                    const ReorderedUdp &held = reorderSlots[i];
+                    if(held.inUse && held.peer == peerIndex && held.seq == peer.rcvNext) {
+                        ready[readyCount++] = i;
+                        break;
+                    }
+                }
+            }
+            peer.rcvMask >>= 1;
+            peer.rcvNext++;
+        }
+    };
+
+    int16_t d = seqDiff(seq, peer.rcvNext);
+
+    if((start && seq != peer.rxStart) || (base && d < -LT_RELIABLE_WINDOW_MAX)) {
+        // The sender restarted with a new stream. Its random start may land anywhere,
+        // including just behind the window, so a start frame is trusted over its distance;
+        // only a retry of the frame this stream began with is a duplicate.
+        LT_LOG(UDP, LT_LOG_INFO, "ReliableUDP: New stream from %s", src.text().c_str());
+        advanceTo(peer.rcvNext + LT_RELIABLE_WINDOW_MAX);
+        peer.rcvNext = seq;
+        peer.rcvMask = 0;
+        peer.rxStart = seq;
+        d = 0;
+    } else if(base && d > 0) {
+        // Everything before a base frame is either received or abandoned
+        advanceTo(seq);
+        d = 0;
+    }
+
+    if(skip) {
+        // Control frame only moves the window
+    } else if(d < 0 || (d < LT_RELIABLE_WINDOW_MAX && ((peer.rcvMask >> d) & 1))) {
+        // Duplicate, typically a retry after a lost ACK
+        stats.duplicatesSuppressed++;
+    } else if(d >= LT_RELIABLE_WINDOW_MAX) {
+        LT_LOG(UDP, LT_LOG_WARN, "ReliableUDP: msgId %u from %s is beyond the window", seq,
+               src.text().c_str());
+    } else if(type == MessageType::FRAGMENT && !reassemblySlot(src, channel, data, dataLen)) {
+        // Nowhere to reassemble: leave it un-ACKed so the sender retries
+    } else if(!reliableInOrder || d == 0) {
+        peer.rcvMask |= 1UL << d;
+        ready[readyCount++] = kNoSlot;
+    } else {
+        uint8_t slot = 0;
+        while(slot < LT_REORDER_SLOTS && reorderSlots[slot].inUse)
+            ++slot;
+        // No room (or too large to hold): leave it un-ACKed so the sender retries
+        if(slot < LT_REORDER_SLOTS && dataLen <= LT_RELIABLE_PAYLOAD_SIZE) {
+            ReorderedUdp &held = reorderSlots[slot];
+            held.inUse = true;
+            held.type = type;
+            held.compressed = compressed;
+            held.peer = peerIndex;
+            held.seq = seq;
+            held.length = dataLen;
+            memcpy(held.payload, data, dataLen);
+            peer.held++;
+            peer.rcvMask |= 1UL << d;
+        }
+    }
+
+    // Slide past everything that is now contiguous
+    while(peer.rcvMask & 1)
+        advanceTo(peer.rcvNext + 1);
+
+    sendReliableAck(peer);
+
+    for(size_t i = 0; i < readyCount; ++i) {
+        if(ready[i] == kNoSlot) {
+            deliverReliable(src, channel, type, compressed, data, dataLen);
+            continue;
+        }
+        ReorderedUdp &held = reorderSlots[ready[i]];
+        deliverReliable(src, channel, held.type, held.compressed, held.payload, held.length);
+        held.inUse = false;
+        peer.held--;
+    }
+}
+
+// Hands a reliable message to the layer above: reassembly for fragments, otherwise the
+// application.
+void LightThread::deliverReliable(const Ip6Address &src, uint8_t channel, MessageType type,
+                                  bool compressed, const uint8_t *data, size_t length) {
+    if(type == MessageType::FRAGMENT)
+        handleFragment(src, channel, data, length, true, compressed);
+    else
+        handleNormalUdpMessage(src, data, length, true, compressed, channel);
+}
+
+// Reports the outcome of a reliable send to the status callback of its channel.
+void LightThread::reportReliable(uint8_t channel, uint16_t msgId, const Ip6Address &addr,
+                                 bool success) {
+    if(deferredDelivery) {
+        pushEvent(EventKind::RELIABLE_STATUS, channel, success, msgId, addr, nullptr, 0);
+        return;
+    }
+
+    StatusCallback &callback =
+        channel == 0 ? reliableCallback : channelCallbacks[channel - 1].status;
+    if(callback)
+        callback(msgId, addr, success);
+}
+
+// Sends the receiver's window state: the next sequence expected and a bitmap of the
+// 32 sequences after it that have already arrived.
+void LightThread::sendReliableAck(const ReliablePeer &peer) {
+    uint32_t bitmap = peer.rcvMask >> 1;
+    uint8_t buf[kReliableAckLength] = {
+        static_cast<uint8_t>(peer.rcvNext >> 8), static_cast<uint8_t>(peer.rcvNext & 0xFF),
+        static_cast<uint8_t>(bitmap >> 24),      static_cast<uint8_t>((bitmap >> 16) & 0xFF),
+        static_cast<uint8_t>((bitmap >> 8) & 0xFF), static_cast<uint8_t>(bitmap & 0xFF)};
+
+    sendUdpPacket(AckType::RESPONSE, MessageType::NORMAL, buf, sizeof(buf), peer.addr,
+                  LT_UDP_PORT, false, peer.channel);
+}
+
+// Folds one round-trip measurement into the peer's estimate (RFC 6298 smoothing).
+void LightThread::sampleRtt(ReliablePeer &peer, uint32_t rtt) {
+    if(peer.srtt == 0) {
+        peer.srtt = rtt > 0 ? rtt : 1;
+        peer.rttVar = rtt / 2;
+    } else {
+        uint32_t delta = rtt > peer.srtt ? rtt - peer.srtt : peer.srtt - rtt;
+        peer.rttVar = (3 * peer.rttVar + delta) / 4;
+        peer.srtt = (7 * peer.srtt + rtt) / 8;
+    }
+
+    uint32_t rto = peer.srtt + 4 * peer.rttVar;
+    rto = std::max<uint32_t>(rto, LT_RELIABLE_MIN_RTO);
+    peer.rto = std::min<uint32_t>(rto, LT_RELIABLE_MAX_RTO);
+}
+
+// Returns the peer's retransmission timeout, doubled for every timeout of its oldest
+// message since the last ACK and capped at LT_RELIABLE_MAX_RTO.
+unsigned long LightThread::retransmitTimeout(const ReliablePeer &peer) {
+    unsigned long rto = peer.rto;
+    for(uint8_t i = 0; i < peer.backoff && rto < LT_RELIABLE_MAX_RTO; ++i)
+        rto *= 2;
+    return std::min<unsigned long>(rto, LT_RELIABLE_MAX_RTO);
+}
+
+// Drops every message at the front of the queue whose deadline has passed. Expiring from
+// the front only means one skip frame covers everything dropped, so an in-order receiver
+// does not wait for it forever.
+void LightThread::expireReliable(ReliablePeer &peer) {
+    unsigned long now = millis();
+    uint16_t dropped[LT_RELIABLE_WINDOW_MAX];
+    size_t droppedCount = 0;
+    bool any = false;
+
+    while(peer.txHead != kNoSlot && droppedCount < LT_RELIABLE_WINDOW_MAX &&
+          !timeBefore(now, reliableSlots[peer.txHead].deadline)) {
+        PendingReliableUdp &msg = reliableSlots[peer.txHead];
+        LT_LOG(UDP, LT_LOG_INFO, "ReliableUDP: Dropping msgId %u to %s after %u attempts", msg.seq,
+               peer.addr.text().c_str(), msg.retryCount + (msg.sent ? 1 : 0));
+        if(msg.fragTx != kNoSlot)
+            fragmentSettled(msg.fragTx, false);
+        else
+            dropped[droppedCount++] = msg.seq;
+        any = true;
+        releaseReliableSlot(peer, peer.txHead, kNoSlot);
+    }
+
+    if(!any)
+        return;
+
+    uint16_t skipTo = peer.txHead == kNoSlot ? peer.nextSeq : reliableSlots[peer.txHead].seq;
+    uint8_t skipFrame[kReliableDataHeader] = {static_cast<uint8_t>(skipTo >> 8),
+                                              static_cast<uint8_t>(skipTo & 0xFF),
+                                              LT_RELIABLE_FLAG_SKIP};
+    sendUdpPacket(AckType::REQUEST, MessageType::NORMAL, skipFrame, sizeof(skipFrame),
+                  peer.addr, LT_UDP_PORT, false, peer.channel);
+
+    pumpReliablePeer(peer);
+    pumpFragmentTx();
+
+    // The entry may be recycled by a callback that sends to another peer
+    Ip6Address addr = peer.addr;
+    uint8_t channel = peer.channel;
+    for(size_t i = 0; i < droppedCount; ++i)
+        reportReliable(channel, dropped[i], addr, false);
+}
+
+// Runs the retransmissions and deadlines that are due, in due order. Only due messages
+// are touched, so the cost does not grow with the number of messages in flight.
+// Each timeout of the oldest message doubles the peer's timeout until an ACK arrives.
+void LightThread::updateReliableUdp() {
+    unsigned long now = millis();
+
+    while(reliableHeapSize > 0 && !timeBefore(now, reliableDue(reliableHeap[0]))) {
+        PendingReliableUdp &msg = reliableSlots[reliableHeap[0]];
+        ReliablePeer &peer = reliablePeers[msg.peer];
+
+        if(!timeBefore(now, msg.deadline)) {
+            expireReliable(peer); // deadlines are ordered, so this drops at least msg
+            continue;
+        }
+
+        // The oldest message timing out means the path, not one datagram, is in trouble
+        if(reliableHeap[0] == peer.txHead && peer.backoff < 8)
+            peer.backoff++;
+
+        msg.retryCount++;
+        stats.retransmissions++;
+        stats.retransmittedBytes += frameOverhead(peer.channel) + kReliableDataHeader + msg.length;
+        LT_LOG(UDP, LT_LOG_DEBUG, "ReliableUDP: Retrying msgId %u to %s (attempt %u)", msg.seq,
+               peer.addr.text().c_str(), msg.retryCount + 1);
+        transmitReliable(peer, msg);
+    }
+}
@@ -0,0 +1,73 @@
+#include "LightThread.h"
+
+static_assert((LT_SEND_SLOTS & (LT_SEND_SLOTS - 1)) == 0, "LT_SEND_SLOTS is a power of two");
+static_assert(LT_SEND_SLOT_BYTES <= UINT16_MAX, "slot lengths are uint16_t");
+
+// True if the caller may send directly: it is the task that called begin() or last ran
+// update(). Before begin() no task is known, and every caller sends directly.
+bool LightThread::onUpdateTask() const {
+    TaskHandle_t owner = updateOwner.load(std::memory_order_relaxed);
+    return !owner || owner == xTaskGetCurrentTaskHandle();
+}
+
+// Copies a send into a free slot for drainSendQueue(). Lock-free: concurrent callers each
+// claim a position of their own, so payloads are never interleaved, and a caller never
+// waits for another one or for update().
+SendStatus LightThread::queueSend(const Ip6Address &dest, uint8_t channel, bool reliable,
+                                  const uint8_t *data, size_t size) {
+    if(channel >= LT_CHANNELS || dest.isUnspecified())
+        return SendStatus::INVALID;
+    if(size > LT_SEND_SLOT_BYTES)
+        return SendStatus::TOO_LARGE;
+
+    uint32_t pos = sendEnqueuePos.load(std::memory_order_relaxed);
+    SendSlot *slot;
+    for(;;) {
+        slot = &sendSlots[pos & (LT_SEND_SLOTS - 1)];
+        int32_t diff = static_cast<int32_t>(slot->seq.load(std::memory_order_acquire) - pos);
+        if(diff == 0) {
+            if(sendEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        } else if(diff < 0) {
+            return SendStatus::WOULD_BLOCK; // not yet consumed a lap ago
+        } else {
+            pos = sendEnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->dest = dest;
+    slot->channel = channel;
+    slot->reliable = reliable;
+    slot->length = size;
+    memcpy(slot->data, data, size);
+    slot->seq.store(pos + 1, std::memory_order_release);
+    wakeTask();
+    return SendStatus::OK;
+}
+
+// Sends what other tasks queued, in the order they claimed their slots. Called once per
+// update(). Stops at a slot still being filled, or one that found the reliable slots full;
+// it goes out on a later run. A reliable send failing otherwise is reported as failed, with
+// msgId 0, to its channel's status callback, since its producer only saw OK.
+void LightThread::drainSendQueue() {
+    for(;;) {
+        SendSlot &slot = sendSlots[sendDequeuePos & (LT_SEND_SLOTS - 1)];
+        if(slot.seq.load(std::memory_order_acquire) != sendDequeuePos + 1)
+            return;
+
+        SendStatus status =
+            sendPayload(slot.dest, slot.channel, slot.reliable, slot.data, slot.length);
+        if(status == SendStatus::QUEUE_FULL)
+            return;
+        if(status != SendStatus::OK) {
+            stats.queuedSendsFailed++;
+            LT_LOG(UDP, LT_LOG_WARN, "SendQueue: Send to %s failed (status %d)",
+                   slot.dest.text().c_str(), static_cast<int>(status));
+            if(slot.reliable)
+                reportReliable(slot.channel, 0, slot.dest, false);
+        }
+
+        slot.seq.store(sendDequeuePos + LT_SEND_SLOTS, std::memory_order_release);
+        sendDequeuePos++;
+    }
+}
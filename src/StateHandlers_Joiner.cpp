@@ -4,17 +4,17 @@
 void LightThread::handleJoinerStart() {
     if(justEntered) {
         justEntered = false;
-        logLightThread(LT_LOG_INFO, "JOINER_START: initializing joiner...");
+        LT_LOG(FSM, LT_LOG_INFO, "JOINER_START: initializing joiner...");
 
-        setupJoinerDataset();                        // Sets network parameters
-        setupJoinerThreadDefaults();                 // Configures thread options
-        execAndMatch("joiner start J01NME", "Done"); // Start joiner role
+        setupJoinerDataset();             // Sets network parameters
+        setupJoinerThreadDefaults();      // Configures thread options
+        execAsync("joiner start J01NME"); // Start joiner role
     }
 
-    // After a brief delay, start Thread stack
+    // After a brief delay, start Thread stack (queued behind the setup commands)
     if(timeInState() > 500) {
-        execAndMatch("thread start", "Done");
-        logLightThread(LT_LOG_INFO, "JOINER_START: Thread start issued");
+        execAsync("thread start");
+        LT_LOG(FSM, LT_LOG_INFO, "JOINER_START: Thread start issued");
         setState(State::JOINER_SCAN);
     }
 }
@@ -22,51 +22,69 @@ void LightThread::handleJoinerStart() {
 // Checks for joiner success/failure and transitions accordingly
 void LightThread::handleJoinerScan() {
     static unsigned long lastCheck = 0;
+    static bool queryPending = false;
 
     if(justEntered) {
         justEntered = false;
-        logLightThread(LT_LOG_INFO, "JOINER_SCAN: checking joiner state...");
+        LT_LOG(FSM, LT_LOG_INFO, "JOINER_SCAN: checking joiner state...");
         lastCheck = 0;
     }
 
-    if(timeInState() - lastCheck < 1000)
+    if(queryPending || timeInState() - lastCheck < 1000)
         return;
     lastCheck = timeInState();
+    queryPending = true;
 
-    String response;
-    if(execAndMatch("joiner state", "", &response, 2000)) {
-        logLightThread(LT_LOG_INFO, "Joiner state response: %s", response.c_str());
-        if(response.indexOf("Join failed") == -1 &&
-           (response.indexOf("success") != -1 || response.indexOf("Idle") != -1)) {
-            logLightThread(LT_LOG_INFO, "JOINER_SCAN: Joiner successfully paired");
-            setState(State::JOINER_WAIT_BROADCAST);
-        }
-    } else {
-        logLightThread(LT_LOG_WARN, "JOINER_SCAN: Failed to get joiner state");
-    }
+    execAsync(
+        "joiner state",
+        [this](bool ok, const String &response) {
+            queryPending = false;
+            if(!inState(State::JOINER_SCAN))
+                return;
+
+            if(!ok) {
+                LT_LOG(FSM, LT_LOG_WARN, "JOINER_SCAN: Failed to get joiner state");
+                return;
+            }
+
+            LT_LOG(FSM, LT_LOG_INFO, "Joiner state response: %s", response.c_str());
+            if(response.indexOf("Join failed") == -1 &&
+               (response.indexOf("success") != -1 || response.indexOf("Idle") != -1)) {
+                LT_LOG(FSM, LT_LOG_INFO, "JOINER_SCAN: Joiner successfully paired");
+                setState(State::JOINER_WAIT_BROADCAST);
+            }
+        },
+        2000);
 }
 
 // Waits for leader’s WHOAMI broadcast
 void LightThread::handleJoinerWaitBroadcast() {
+    static unsigned long lastLog = 0;
+
     if(justEntered) {
         justEntered = false;
-        logLightThread(LT_LOG_INFO, "JOINER_WAIT_BROADCAST: Listening for leader broadcast...");
+        LT_LOG(FSM, LT_LOG_INFO, "JOINER_WAIT_BROADCAST: Listening for leader broadcast...");
+        lastLog = 0;
     }
 
     if(!inState(State::JOINER_WAIT_BROADCAST))
         return;
 
     // Log current state every ~5 seconds
-    if(timeInState() % 5000 < 50) {
-        String stateResp;
-        execAndMatch("state", "", &stateResp, 500);
-        logLightThread(LT_LOG_INFO, "JOINER_WAIT_BROADCAST: current Thread state: %s",
+    if(timeInState() - lastLog >= 5000) {
+        lastLog = timeInState();
+        execAsync(
+            "state",
+            [this](bool ok, const String &stateResp) {
+                LT_LOG(FSM, LT_LOG_INFO, "JOINER_WAIT_BROADCAST: current Thread state: %s",
                        stateResp.c_str());
+            },
+            500);
     }
 
     // Timeout fallback
     if(millis() - stateEntryTime > 20000) {
-        logLightThread(LT_LOG_WARN, "JOINER_WAIT_BROADCAST: Timed out waiting for broadcast.");
+        LT_LOG(FSM, LT_LOG_WARN, "JOINER_WAIT_BROADCAST: Timed out waiting for broadcast.");
         setState(State::STANDBY);
         return;
     }
@@ -76,11 +94,11 @@ void LightThread::handleJoinerWaitBroadcast() {
 void LightThread::handleJoinerWaitAck() {
     if(justEntered) {
         justEntered = false;
-        logLightThread(LT_LOG_INFO, "JOINER_WAIT_ACK: Waiting for PAIR_ACK...");
+        LT_LOG(FSM, LT_LOG_INFO, "JOINER_WAIT_ACK: Waiting for PAIR_ACK...");
     }
 
     if(timeInState() > 10000) { // 10s timeout
-        logLightThread(LT_LOG_WARN, "JOINER_WAIT_ACK: Timed out waiting for ACK");
+        LT_LOG(FSM, LT_LOG_WARN, "JOINER_WAIT_ACK: Timed out waiting for ACK");
         setState(State::STANDBY);
     }
 }
@@ -88,93 +106,112 @@ void LightThread::handleJoinerWaitAck() {
 // Fully paired state — sends heartbeat, escalates if needed
 void LightThread::handleJoinerPaired() {
     static bool escalated = false;
+    static bool escalationPending = false;
     static unsigned long lastCheck = 0;
 
     if(justEntered) {
         justEntered = false;
         escalated = false;
         lastCheck = millis(); // time marker
-        logLightThread(LT_LOG_INFO, "JOINER_PAIRED: storing configuration and entering standby");
+        LT_LOG(FSM, LT_LOG_INFO, "JOINER_PAIRED: storing configuration and entering standby");
         if(joinCallback) {
             uint64_t myHash = generateMacHash();
             String hashStr = String((uint32_t)(myHash >> 32), HEX) +
                              String((uint32_t)(myHash & 0xFFFFFFFF), HEX);
-            joinCallback(leaderIp, hashStr);
-            logLightThread(LT_LOG_INFO, "JOINER_PAIRED: Fired joinCallback with IP %s and hash %s",
-                           leaderIp.c_str(), hashStr.c_str());
+            notifyJoin(leaderIp, hashStr);
+            LT_LOG(FSM, LT_LOG_INFO, "JOINER_PAIRED: Fired joinCallback with IP %s and hash %s",
+                   leaderIp.text().c_str(), hashStr.c_str());
         }
     }
 
     sendHeartbeatIfDue();
 
     // Optional escalation to router-delegation-node (rdn)
-    if(!escalated && millis() - lastCheck > 5000) {
-        String stateResp;
-        if(execAndMatch("state", "", &stateResp, 1000)) {
-            stateResp.toLowerCase();
-
-            if(stateResp.indexOf("child") != -1) {
-                String modeResp;
-                if(execAndMatch("mode", "", &modeResp, 500)) {
-                    modeResp.toLowerCase();
-                    if(modeResp.indexOf("d") == -1) {
-                        // Only switch if we're not already in 'd'
-                        execAndMatch("mode rdn", "Done");
-                        logLightThread(LT_LOG_INFO,
-                                       "JOINER_PAIRED: Escalated to rdn (Thread state: child)");
-                    } else {
-                        logLightThread(LT_LOG_INFO, "JOINER_PAIRED: Already in rdn mode");
-                    }
-                }
-                escalated = true;
-            } else {
-                logLightThread(LT_LOG_INFO, "JOINER_PAIRED: Still waiting for child state: %s",
-                               stateResp.c_str());
-            }
+    if(escalated || escalationPending || millis() - lastCheck <= 5000)
+        return;
+    lastCheck = millis();
+    escalationPending = true;
+
+    execAsync("state", [this](bool ok, const String &response) {
+        if(!ok || !inState(State::JOINER_PAIRED)) {
+            escalationPending = false;
+            return;
         }
-    }
+
+        String stateResp = response;
+        stateResp.toLowerCase();
+        if(stateResp.indexOf("child") == -1) {
+            LT_LOG(FSM, LT_LOG_INFO, "JOINER_PAIRED: Still waiting for child state: %s",
+                   stateResp.c_str());
+            escalationPending = false;
+            return;
+        }
+
+        escalated = true;
+        execAsync(
+            "mode",
+            [this](bool ok, const String &response) {
+                escalationPending = false;
+                if(!ok)
+                    return;
+
+                // Only the first line holds the mode flags; "Done" follows it
+                String modeResp = response.substring(0, response.indexOf('\n'));
+                modeResp.toLowerCase();
+                if(modeResp.indexOf("d") == -1) {
+                    // Only switch if we're not already in 'd'
+                    execAsync("mode rdn");
+                    LT_LOG(FSM, LT_LOG_INFO,
+                           "JOINER_PAIRED: Escalated to rdn (Thread state: child)");
+                } else {
+                    LT_LOG(FSM, LT_LOG_INFO, "JOINER_PAIRED: Already in rdn mode");
+                }
+            },
+            500);
+    });
 }
 
 // Attempt to reconnect to last known leader
 void LightThread::handleJoinerReconnect() {
-    static bool stackStarted = false;
     static unsigned long lastCheck = 0;
-    static bool reconnectBroadcastSent = false;
+    static bool queryPending = false;
 
     if(justEntered) {
         justEntered = false;
-        logLightThread(LT_LOG_INFO, "JOINER_RECONNECT: bringing up stack for auto-heal");
+        LT_LOG(FSM, LT_LOG_INFO, "JOINER_RECONNECT: bringing up stack for auto-heal");
 
         setupJoinerDataset();
         setupJoinerThreadDefaults();
-        execAndMatch("thread start", "Done");
+        execAsync("thread start");
 
-        stackStarted = true;
         lastHeartbeatSent = 0;
         lastHeartbeatEcho = 0;
         lastCheck = 0;
-        reconnectBroadcastSent = false;
     }
 
     sendHeartbeatIfDue();
 
     // Check if we're reattached to the mesh
-    if(millis() - lastCheck > 2000) {
+    if(!queryPending && millis() - lastCheck > 2000) {
         lastCheck = millis();
-        String resp;
-        if(execAndMatch("state", "", &resp, 1000)) {
+        queryPending = true;
+        execAsync("state", [this](bool ok, const String &response) {
+            queryPending = false;
+            if(!ok || !inState(State::JOINER_RECONNECT))
+                return;
+
+            String resp = response;
             resp.toLowerCase();
             if(resp.indexOf("child") != -1 || resp.indexOf("router") != -1) {
-                logLightThread(LT_LOG_INFO, "JOINER_RECONNECT: back in mesh as %s", resp.c_str());
+                LT_LOG(FSM, LT_LOG_INFO, "JOINER_RECONNECT: back in mesh as %s", resp.c_str());
                 setState(State::JOINER_PAIRED);
-                return;
             }
-        }
+        });
     }
 
     // Timeout and fallback
     if(timeInState() > 120000) {
-        logLightThread(LT_LOG_WARN, "JOINER_RECONNECT: Timeout — going to standby");
+        LT_LOG(FSM, LT_LOG_WARN, "JOINER_RECONNECT: Timeout — going to standby");
         setState(State::STANDBY);
     }
 }
@@ -184,7 +221,7 @@ void LightThread::handleJoinerSeekingLeader() { sendHeartbeatIfDue(); }
 
 // Heartbeat logic for JOINER: sends echo, triggers reconnect on timeout
 void LightThread::sendHeartbeatIfDue() {
-    if(leaderIp.isEmpty())
+    if(leaderIp.isUnspecified())
         return;
 
     // Send every 5 seconds
@@ -193,7 +230,7 @@ void LightThread::sendHeartbeatIfDue() {
 
     // No echo in 15s → assume leader is dead and trigger reconnect
     if(millis() - lastHeartbeatEcho > 15000) {
-        logLightThread(LT_LOG_WARN, "HEARTBEAT: Leader not responding. Broadcasting reconnect.");
+        LT_LOG(FSM, LT_LOG_WARN, "HEARTBEAT: Leader not responding. Broadcasting reconnect.");
 
         // Send RECONNECT request over multicast with own hashMAC
         uint64_t myHash = generateMacHash();
@@ -201,7 +238,8 @@ void LightThread::sendHeartbeatIfDue() {
         for(int i = 7; i >= 0; --i)
             payload.push_back((myHash >> (i * 8)) & 0xFF);
 
-        sendUdpPacket(AckType::REQUEST, MessageType::RECONNECT, payload, "ff03::1", 12345);
+        sendUdpPacket(AckType::REQUEST, MessageType::RECONNECT, payload,
+                      Ip6Address::realmLocalAllNodes(), LT_UDP_PORT);
         lastHeartbeatSent = millis(); // Rate-limit retries
         setState(State::JOINER_SEEKING_LEADER);
         return;
@@ -215,39 +253,40 @@ void LightThread::sendHeartbeatIfDue() {
     for(int i = 7; i >= 0; --i)
         payload.push_back((id >> (i * 8)) & 0xFF);
 
-    bool ok = sendUdpPacket(AckType::NONE, MessageType::HEARTBEAT, payload, leaderIp, 12345);
+    bool ok = sendUdpPacket(AckType::NONE, MessageType::HEARTBEAT, payload, leaderIp, LT_UDP_PORT);
     if(ok) {
-        logLightThread(LT_LOG_INFO, "HEARTBEAT: Sent to leader");
+        LT_LOG(FSM, LT_LOG_INFO, "HEARTBEAT: Sent to leader");
     } else {
-        logLightThread(LT_LOG_WARN, "HEARTBEAT: Failed to send");
+        LT_LOG(FSM, LT_LOG_WARN, "HEARTBEAT: Failed to send");
     }
 }
 
 // Prepares default dataset for joiner
 void LightThread::setupJoinerDataset() {
-    execAndMatch("dataset clear", "Done");
-    execAndMatch("dataset init new", "Done"); // REQUIRED
-    execAndMatch("dataset panid " + configuredPanid, "Done");
-    execAndMatch("dataset channel " + String(configuredChannel), "Done");
-    execAndMatch("dataset meshlocalprefix " + configuredPrefix, "Done");
-    execAndMatch("dataset networkkey 00112233445566778899aabbccddeeff", "Done");
-    execAndMatch("dataset networkname OpenThreadMesh", "Done"); // REQUIRED
+    execAsync("dataset clear");
+    execAsync("dataset init new"); // REQUIRED
+    execAsync("dataset panid " + configuredPanid);
+    execAsync("dataset channel " + String(configuredChannel));
+    execAsync("dataset meshlocalprefix " + configuredPrefix);
+    execAsync("dataset networkkey 00112233445566778899aabbccddeeff");
+    execAsync("dataset networkname OpenThreadMesh"); // REQUIRED
 }
 
 // Applies default network and routing settings for joiners
 void LightThread::setupJoinerThreadDefaults() {
-    String resp;
-    execAndMatch("mode rn", "Done");                 // Full router-capable node
-    execAndMatch("routerselectionjitter 0", "Done"); // Never auto-promote to leader
-    execAndMatch("routerupgradethreshold 255", "Done");
-    execAndMatch("routerdowngradethreshold 1",
-                 "Done"); // So it never tries to stick as router if it ever gets one
-    execAndMatch("dataset commit active", "Done");
-    execAndMatch("dataset active", "", &resp, 1000);
-    logLightThread(LT_LOG_INFO, "DATASET: %s", resp.c_str());
-
-    execAndMatch("ifconfig up", "Done");
-    execAndMatch("udp close", "Done");
-    execAndMatch("udp open", "Done");
-    execAndMatch("udp bind :: 12345", "Done");
+    execAsync("mode rn");                 // Full router-capable node
+    execAsync("routerselectionjitter 0"); // Never auto-promote to leader
+    execAsync("routerupgradethreshold 255");
+    execAsync("routerdowngradethreshold 1"); // Never stick as router if it ever gets one
+    execAsync("dataset commit active");
+    execAsync("dataset active", [this](bool ok, const String &resp) {
+        LT_LOG(FSM, LT_LOG_INFO, "DATASET: %s", resp.c_str());
+    });
+
+    // The socket is opened once the interface is up, as the commands before it have run
+    execAsync("ifconfig up", [this](bool ok, const String &) {
+        if(!ok)
+            LT_LOG(FSM, LT_LOG_WARN, "JOINER: ifconfig up failed");
+        openUdpSocket();
+    });
 }
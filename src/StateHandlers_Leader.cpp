@@ -1,44 +1,73 @@
 #include "LightThread.h"
 
+// Creates the leader's dataset and starts Thread, one command after another. Enters
+// LEADER_WAIT_NETWORK once every command has answered Done, or ERROR at the first that has
+// not (e.g. "dataset commit active" rejected), without sending the rest.
+void LightThread::bootstrapLeaderNetwork() {
+    execSequence({"dataset init new", "dataset channel " + String(configuredChannel),
+                  "dataset panid " + configuredPanid,
+                  "dataset networkkey 00112233445566778899aabbccddeeff",
+                  "dataset meshlocalprefix " + configuredPrefix, "dataset commit active",
+                  "ifconfig up", "thread start"},
+                 [this](bool ok) {
+                     if(!inState(State::INIT))
+                         return;
+                     if(!ok) {
+                         LT_LOG(FSM, LT_LOG_ERROR, "INIT: Network bootstrap failed");
+                         setState(State::ERROR);
+                         return;
+                     }
+                     setState(State::LEADER_WAIT_NETWORK);
+                 });
+}
+
 // Waits for the Thread network to come up and become a leader or router.
 // Once stable, binds the UDP socket and transitions to STANDBY.
 void LightThread::handleLeaderWaitNetwork() {
     static unsigned long lastCheck = 0;
+    static bool queryPending = false;
 
     if(justEntered) {
         justEntered = false;
-        logLightThread(LT_LOG_INFO, "LEADER_WAIT_NETWORK: Waiting for Thread network...");
+        LT_LOG(FSM, LT_LOG_INFO, "LEADER_WAIT_NETWORK: Waiting for Thread network...");
         lastCheck = 0; // Reset check timer
     }
 
+    // Timeout if leader state isn't achieved in 50 seconds
+    if(timeInState() > 50000) {
+        LT_LOG(FSM, LT_LOG_ERROR, "LEADER_WAIT_NETWORK: Timed out waiting for leader state");
+        setState(State::ERROR);
+        return;
+    }
+
     // Check every 5 seconds
-    if(timeInState() - lastCheck < 5000)
+    if(queryPending || timeInState() - lastCheck < 5000)
         return;
     lastCheck = timeInState();
+    queryPending = true;
+
+    execAsync("state", [this](bool ok, const String &response) {
+        queryPending = false;
+        if(!inState(State::LEADER_WAIT_NETWORK))
+            return;
+
+        if(!ok) {
+            LT_LOG(FSM, LT_LOG_WARN, "LEADER_WAIT_NETWORK: Failed to query state");
+            return;
+        }
 
-    String response;
-    if(execAndMatch("state", "", &response, 1000)) {
         if(response.indexOf("leader") != -1 || response.indexOf("router") != -1) {
-            logLightThread(LT_LOG_INFO, "LEADER_WAIT_NETWORK: Thread is up in state: %s",
-                           response.c_str());
+            LT_LOG(FSM, LT_LOG_INFO, "LEADER_WAIT_NETWORK: Thread is up in state: %s",
+                   response.c_str());
 
-            // Open UDP communication and bind to port 12345
-            execAndMatch("udp open", "Done");
-            execAndMatch("udp bind :: 12345", "Done");
+            // Open UDP communication and bind to LT_UDP_PORT
+            openUdpSocket();
 
             setState(State::STANDBY);
         } else {
-            logLightThread(LT_LOG_INFO, "LEADER_WAIT_NETWORK: Not a leader yet");
+            LT_LOG(FSM, LT_LOG_INFO, "LEADER_WAIT_NETWORK: Not a leader yet");
         }
-    } else {
-        logLightThread(LT_LOG_WARN, "LEADER_WAIT_NETWORK: Failed to query state");
-    }
-
-    // Timeout if leader state isn't achieved in 50 seconds
-    if(timeInState() > 50000) {
-        logLightThread(LT_LOG_ERROR, "LEADER_WAIT_NETWORK: Timed out waiting for leader state");
-        setState(State::ERROR);
-    }
+    });
 }
 
 // Begins the commissioner role and adds a wildcard joiner filter.
@@ -46,15 +75,15 @@ void LightThread::handleCommissionerStart() {
     if(justEntered) {
         justEntered = false;
         // Start the commissioner
-        execAndMatch("commissioner start", "Commissioner: active");
+        execAsync("commissioner start");
         // Add wildcard joiner (everyone can join)
-        execAndMatch("commissioner joiner add * J01NME", "Done");
+        execAsync("commissioner joiner add * J01NME");
     }
 
     // Short delay before moving to broadcast phase
     if(timeInState() > 1000) {
-        logLightThread(LT_LOG_INFO,
-                       "COMMISSIONER_START: Setup complete. Transitioning to COMMISSIONER_ACTIVE");
+        LT_LOG(FSM, LT_LOG_INFO,
+               "COMMISSIONER_START: Setup complete. Transitioning to COMMISSIONER_ACTIVE");
         setState(State::COMMISSIONER_ACTIVE);
     }
 }
@@ -71,21 +100,21 @@ void LightThread::handleCommissionerActive() {
 
         std::vector<uint8_t> emptyPayload;
         bool ok = sendUdpPacket(AckType::NONE, MessageType::PAIRING, emptyPayload,
-                                "ff03::1", // multicast all nodes
-                                12345);
+                                Ip6Address::realmLocalAllNodes(), // multicast all nodes
+                                LT_UDP_PORT);
 
         if(ok) {
-            logLightThread(LT_LOG_INFO, "COMMISSIONER_ACTIVE: Sent PAIR_REQUEST broadcast");
+            LT_LOG(FSM, LT_LOG_INFO, "COMMISSIONER_ACTIVE: Sent PAIR_REQUEST broadcast");
         } else {
-            logLightThread(LT_LOG_WARN, "COMMISSIONER_ACTIVE: Failed to send PAIR_REQUEST");
+            LT_LOG(FSM, LT_LOG_WARN, "COMMISSIONER_ACTIVE: Failed to send PAIR_REQUEST");
         }
     }
 
     // End commissioning after 60 seconds
     if(timeInState() > 60000) {
-        logLightThread(LT_LOG_INFO,
-                       "COMMISSIONER_ACTIVE: Pairing Timed out. Transitioning to STANDBY");
-        execAndMatch("commissioner stop", "Done");
+        LT_LOG(FSM, LT_LOG_INFO,
+               "COMMISSIONER_ACTIVE: Pairing Timed out. Transitioning to STANDBY");
+        execAsync("commissioner stop");
         setState(State::STANDBY);
     }
 }
@@ -0,0 +1,75 @@
+#include "LightThread.h"
+
+// Begins as begin(backend) does, then starts a task that runs update() so the application
+// no longer has to call it from loop(). The task sleeps until a datagram or CLI output
+// arrives or the next deadline (msUntilNextDeadline()) is due, at most LT_TASK_MAX_SLEEP.
+// Callbacks run in that task; with setDeferredDelivery() the application runs them with
+// poll() from its own task instead. Calls other than sendUdp() must not overlap update().
+// end(), or destroying the LightThread, stops the task.
+void LightThread::begin(UdpBackend backend, const TaskConfig &config) {
+    begin(backend);
+    if(task.load(std::memory_order_relaxed))
+        return;
+
+    OThreadCLI.onReceive([this] { wakeTask(); });
+    TaskHandle_t created = nullptr;
+    if(xTaskCreate(&LightThread::taskMain, "LightThread", config.stackSize, this, config.priority,
+                   &created) != pdPASS) {
+        OThreadCLI.onReceive(nullptr);
+        LT_LOG(FSM, LT_LOG_ERROR, "Task: Failed to create the LightThread task");
+        return;
+    }
+    task.store(created, std::memory_order_release);
+    updateOwner.store(created, std::memory_order_relaxed);
+    LT_LOG(FSM, LT_LOG_INFO, "Task: Started with priority %u and %u bytes of stack",
+           static_cast<unsigned>(config.priority), static_cast<unsigned>(config.stackSize));
+}
+
+// Stops the task begin(backend, TaskConfig) started and waits until it has finished the
+// update() it was running. The application may then call update() itself again, from the
+// task that called end(), or destroy the LightThread. Call it from another task, not from a callback the task runs.
+// Does nothing without task mode.
+void LightThread::end() {
+    TaskHandle_t running = task.load(std::memory_order_acquire);
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    if(!running || running == self)
+        return;
+
+    // No more wakeups from the CLI, the OpenThread task or cross-task sends
+    OThreadCLI.onReceive(nullptr);
+    task.store(nullptr, std::memory_order_release);
+    taskStopper.store(self, std::memory_order_release);
+    xTaskNotifyGive(running);
+    while(taskStopper.load(std::memory_order_acquire))
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LT_TASK_MAX_SLEEP));
+
+    updateOwner.store(self, std::memory_order_relaxed); // update() is ours again
+    LT_LOG(FSM, LT_LOG_INFO, "Task: Stopped");
+}
+
+// The task must not outlive the object it runs update() on
+LightThread::~LightThread() { end(); }
+
+void LightThread::taskMain(void *context) {
+    LightThread *self = static_cast<LightThread *>(context);
+    while(!self->taskStopper.load(std::memory_order_acquire)) {
+        self->update();
+        unsigned long wait =
+            std::min<unsigned long>(self->msUntilNextDeadline(), LT_TASK_MAX_SLEEP);
+        // Wakeups given while update() ran are counted, so none is lost
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait));
+    }
+
+    // end() is waiting; once taskStopper is cleared the object may be gone
+    TaskHandle_t stopper = self->taskStopper.load(std::memory_order_acquire);
+    self->taskStopper.store(nullptr, std::memory_order_release);
+    xTaskNotifyGive(stopper);
+    vTaskDelete(nullptr);
+}
+
+// Wakes the task early, e.g. because input arrived. Safe from any task; does nothing
+// without task mode.
+void LightThread::wakeTask() {
+    if(TaskHandle_t running = task.load(std::memory_order_acquire))
+        xTaskNotifyGive(running);
+}
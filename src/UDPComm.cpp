@@ -1,234 +1,248 @@
 #include "LightThread.h"
 #include "esp_mac.h"
 
-// Parses a line from the CLI to see if it's a UDP message and attempts to parse it.
-void LightThread::handleUdpLine(const String &line) {
-    logLightThread(LT_LOG_INFO, "UDP Received: %s", line.c_str());
-
-    String srcIp = extractUdpSourceIp(line);
-    if(srcIp.isEmpty()) {
-        logLightThread(LT_LOG_WARN, "UDP message missing source IP.");
+// Parses a "<n> bytes from <ip> <port> <hex>" line from the CLI and dispatches the datagram.
+void LightThread::handleUdpLine(const char *line, size_t length) {
+    LT_LOG(UDP, LT_LOG_VERBOSE, "UDP Received: %.*s", static_cast<int>(length), line);
+
+    size_t ipEnd = 0;
+    Ip6Address src;
+    if(!extractUdpSourceIp(line, length, src, ipEnd)) {
+        LT_LOG(UDP, LT_LOG_WARN, "UDP message missing source IP.");
         return;
     }
 
-    int hexStart = line.lastIndexOf(' ');
-    if(hexStart == -1 || hexStart + 1 >= line.length()) {
-        logLightThread(LT_LOG_WARN, "UDP message missing payload: %s", line.c_str());
+    // Payload is the last space-separated token (after the source port)
+    size_t hexStart = length;
+    while(hexStart > ipEnd && line[hexStart - 1] != ' ')
+        --hexStart;
+    if(hexStart == ipEnd || hexStart >= length) {
+        LT_LOG(UDP, LT_LOG_WARN, "UDP message missing payload: %.*s", static_cast<int>(length),
+               line);
         return;
     }
 
-    String hexPayload = line.substring(hexStart + 1);
-    hexPayload.trim();
-
-    AckType ack;
-    MessageType msg;
-    std::vector<uint8_t> payload;
-
-    if(!parseIncomingPayload(hexPayload, ack, msg, payload)) {
-        logLightThread(LT_LOG_WARN, "Failed to parse UDP payload: %s", hexPayload.c_str());
+    uint8_t frame[LT_MAX_UDP_FRAME];
+    size_t frameLen = 0;
+    if(!convertHexToBytes(line + hexStart, length - hexStart, frame, sizeof(frame), frameLen)) {
+        LT_LOG(UDP, LT_LOG_WARN, "Invalid or oversized hex in UDP payload: %.*s",
+               static_cast<int>(length - hexStart), line + hexStart);
         return;
     }
 
-    logLightThread(LT_LOG_INFO, "Parsed UDP msg %02x ack %02x, payload %d bytes",
-                   static_cast<int>(msg), static_cast<int>(ack), static_cast<int>(payload.size()));
+    handleUdpPacket(src, frame, frameLen);
+}
 
-    if(ack == AckType::NONE && msg == MessageType::PAIRING &&
-       inState(State::JOINER_WAIT_BROADCAST)) {
-        logLightThread(LT_LOG_INFO, "JOINER_WAIT_BROADCAST: Got PAIRING broadcast from %s",
-                       srcIp.c_str());
+// Joiner waiting to pair: a leader's PAIRING broadcast. Answers with our ID.
+void LightThread::rxPairingBroadcast(const RxPacket &rx) {
+    LT_LOG(UDP, LT_LOG_INFO, "JOINER_WAIT_BROADCAST: Got PAIRING broadcast from %s",
+           rx.src.text().c_str());
 
-        // Respond with ID to leader directly
-        std::vector<uint8_t> idBytes;
-        uint64_t id = generateMacHash();
-        for(int i = 7; i >= 0; --i)
-            idBytes.push_back((id >> (i * 8)) & 0xFF);
+    // Respond with ID to leader directly
+    std::vector<uint8_t> idBytes;
+    uint64_t id = generateMacHash();
+    for(int i = 7; i >= 0; --i)
+        idBytes.push_back((id >> (i * 8)) & 0xFF);
 
-        sendUdpPacket(AckType::REQUEST, MessageType::PAIRING, idBytes, srcIp, 12345);
-        setState(State::JOINER_WAIT_ACK);
-    }
+    sendUdpPacket(AckType::REQUEST, MessageType::PAIRING, idBytes, rx.src, LT_UDP_PORT);
+    setState(State::JOINER_WAIT_ACK);
+}
 
-    else if(ack == AckType::RESPONSE && msg == MessageType::PAIRING &&
-            inState(State::JOINER_WAIT_ACK)) {
-        logLightThread(LT_LOG_INFO, "JOINER_WAIT_ACK: Got PAIRING RESPONSE from %s", srcIp.c_str());
+// Joiner: the leader accepted our pairing request; remember it.
+void LightThread::rxPairingResponse(const RxPacket &rx) {
+    LT_LOG(UDP, LT_LOG_INFO, "JOINER_WAIT_ACK: Got PAIRING RESPONSE from %s",
+           rx.src.text().c_str());
 
-        if(payload.size() != 8) {
-            logLightThread(LT_LOG_ERROR, "JOINER_WAIT_ACK: Expected 8-byte hashmac in response");
-            setState(State::ERROR);
-            return;
-        }
+    if(rx.length != 8) {
+        LT_LOG(UDP, LT_LOG_ERROR, "JOINER_WAIT_ACK: Expected 8-byte hashmac in response");
+        setState(State::ERROR);
+        return;
+    }
 
-        leaderIp = srcIp;
+    leaderIp = rx.src;
 
-        uint64_t leaderHash = 0;
-        for(int i = 0; i < 8; ++i) {
-            leaderHash <<= 8;
-            leaderHash |= payload[i];
-        }
+    uint64_t leaderHash = 0;
+    for(int i = 0; i < 8; ++i) {
+        leaderHash <<= 8;
+        leaderHash |= rx.payload[i];
+    }
 
-        String hashStr = String((uint32_t)(leaderHash >> 32), HEX) +
-                         String((uint32_t)(leaderHash & 0xFFFFFFFF), HEX);
-        saveLeaderInfo(leaderIp, hashStr);
+    String hashStr = String((uint32_t)(leaderHash >> 32), HEX) +
+                     String((uint32_t)(leaderHash & 0xFFFFFFFF), HEX);
+    saveLeaderInfo(leaderIp, hashStr);
 
-        setState(State::JOINER_PAIRED);
+    setState(State::JOINER_PAIRED);
+}
+
+// Commissioning leader: a joiner's pairing request. Answers with our ID and ends
+// commissioning.
+void LightThread::rxPairingRequest(const RxPacket &rx) {
+    uint64_t id = 0;
+    for(size_t i = 0; i < rx.length && i < 8; ++i) {
+        id <<= 8;
+        id |= rx.payload[i];
     }
 
-    else if(ack == AckType::REQUEST && msg == MessageType::PAIRING &&
-            inState(State::COMMISSIONER_ACTIVE)) {
-        uint64_t id = 0;
-        for(size_t i = 0; i < payload.size() && i < 8; ++i) {
-            id <<= 8;
-            id |= payload[i];
-        }
+    String hashStr =
+        String((uint32_t)(id >> 32), HEX) + String((uint32_t)(id & 0xFFFFFFFF), HEX);
 
-        String hashStr =
-            String((uint32_t)(id >> 32), HEX) + String((uint32_t)(id & 0xFFFFFFFF), HEX);
+    LT_LOG(UDP, LT_LOG_INFO,
+           "COMMISSIONER_ACTIVE: Got joiner ID %016llx from %s — sending direct RESPONSE", id,
+           rx.src.text().c_str());
 
-        logLightThread(
-            LT_LOG_INFO,
-            "COMMISSIONER_ACTIVE: Got joiner ID %016llx from %s — sending direct RESPONSE", id,
-            srcIp.c_str());
+    uint64_t selfHash = generateMacHash();
+    std::vector<uint8_t> hashBytes;
+    for(int i = 7; i >= 0; --i) {
+        hashBytes.push_back((selfHash >> (i * 8)) & 0xFF);
+    }
+    sendUdpPacket(AckType::RESPONSE, MessageType::PAIRING, hashBytes, rx.src, LT_UDP_PORT);
 
-        uint64_t selfHash = generateMacHash();
-        std::vector<uint8_t> hashBytes;
-        for(int i = 7; i >= 0; --i) {
-            hashBytes.push_back((selfHash >> (i * 8)) & 0xFF);
-        }
-        sendUdpPacket(AckType::RESPONSE, MessageType::PAIRING, hashBytes, srcIp, 12345);
+    LT_LOG(UDP, LT_LOG_INFO, "COMMISSIONER_ACTIVE: Pairing complete, exiting commissioning");
+    setState(State::STANDBY);
+}
 
-        logLightThread(LT_LOG_INFO, "COMMISSIONER_ACTIVE: Pairing complete, exiting commissioning");
-        setState(State::STANDBY);
+// Leader: a joiner that lost us is looking for the leader; answer so it learns our address.
+void LightThread::rxReconnectRequest(const RxPacket &rx) {
+    if(rx.length != 8) {
+        LT_LOG(UDP, LT_LOG_WARN, "RECONNECT: Invalid payload from %s", rx.src.text().c_str());
+        return;
     }
 
-    else if(ack == AckType::REQUEST && msg == MessageType::RECONNECT && role == Role::LEADER &&
-            inState(State::STANDBY)) {
-        if(payload.size() != 8) {
-            logLightThread(LT_LOG_WARN, "RECONNECT: Invalid payload from %s", srcIp.c_str());
-            return;
-        }
+    uint64_t joinerId = 0;
+    for(int i = 0; i < 8; ++i)
+        joinerId = (joinerId << 8) | rx.payload[i];
 
-        uint64_t joinerId = 0;
-        for(int i = 0; i < 8; ++i)
-            joinerId = (joinerId << 8) | payload[i];
+    String hashStr = String((uint32_t)(joinerId >> 32), HEX) +
+                     String((uint32_t)(joinerId & 0xFFFFFFFF), HEX);
 
-        String hashStr = String((uint32_t)(joinerId >> 32), HEX) +
-                         String((uint32_t)(joinerId & 0xFFFFFFFF), HEX);
+    LT_LOG(UDP, LT_LOG_INFO, "RECONNECT: Joiner %s [%s] is trying to find the leader",
+           rx.src.text().c_str(), hashStr.c_str());
 
-        logLightThread(LT_LOG_INFO, "RECONNECT: Joiner %s [%s] is trying to find the leader",
-                       srcIp.c_str(), hashStr.c_str());
+    uint64_t selfHash = generateMacHash();
+    std::vector<uint8_t> hashBytes;
+    for(int i = 7; i >= 0; --i)
+        hashBytes.push_back((selfHash >> (i * 8)) & 0xFF);
 
-        uint64_t selfHash = generateMacHash();
-        std::vector<uint8_t> hashBytes;
-        for(int i = 7; i >= 0; --i)
-            hashBytes.push_back((selfHash >> (i * 8)) & 0xFF);
+    sendUdpPacket(AckType::RESPONSE, MessageType::RECONNECT, hashBytes, rx.src, LT_UDP_PORT);
+}
 
-        sendUdpPacket(AckType::RESPONSE, MessageType::RECONNECT, hashBytes, srcIp, 12345);
+// Joiner: the leader answered our reconnect request, possibly from a new address.
+void LightThread::rxReconnectResponse(const RxPacket &rx) {
+    if(rx.length != 8) {
+        LT_LOG(UDP, LT_LOG_WARN, "RECONNECT: Invalid leader hash from %s", rx.src.text().c_str());
+        return;
     }
 
-    else if(ack == AckType::RESPONSE && msg == MessageType::RECONNECT && role == Role::JOINER) {
-        if(payload.size() != 8) {
-            logLightThread(LT_LOG_WARN, "RECONNECT: Invalid leader hash from %s", srcIp.c_str());
-            return;
-        }
+    uint64_t receivedLeaderHash = 0;
+    for(int i = 0; i < 8; ++i)
+        receivedLeaderHash = (receivedLeaderHash << 8) | rx.payload[i];
 
-        uint64_t receivedLeaderHash = 0;
-        for(int i = 0; i < 8; ++i)
-            receivedLeaderHash = (receivedLeaderHash << 8) | payload[i];
+    String receivedStr = String((uint32_t)(receivedLeaderHash >> 32), HEX) +
+                         String((uint32_t)(receivedLeaderHash & 0xFFFFFFFF), HEX);
 
-        uint64_t expectedHash =
-            generateMacHash(); // Joiner's view of the leader hash (loaded at boot)
-        String receivedStr = String((uint32_t)(receivedLeaderHash >> 32), HEX) +
-                             String((uint32_t)(receivedLeaderHash & 0xFFFFFFFF), HEX);
+    leaderIp = rx.src;
+    lastHeartbeatEcho = millis();
 
-        String oldIp = leaderIp;
-        leaderIp = srcIp;
-        lastHeartbeatEcho = millis();
+    LT_LOG(UDP, LT_LOG_INFO, "RECONNECT: Leader responded from new IP %s [%s]",
+           rx.src.text().c_str(), receivedStr.c_str());
 
-        logLightThread(LT_LOG_INFO, "RECONNECT: Leader responded from new IP %s [%s]",
-                       srcIp.c_str(), receivedStr.c_str());
+    // Save new leader IP to disk
+    saveLeaderInfo(leaderIp, receivedStr);
+    if(joinCallback) {
+        notifyJoin(leaderIp, receivedStr);
+        LT_LOG(UDP, LT_LOG_INFO, "RECONNECT: Fired joinCallback with IP %s and hash %s",
+               leaderIp.text().c_str(), receivedStr.c_str());
+    }
 
-        // Save new leader IP to disk
-        saveLeaderInfo(leaderIp, receivedStr);
-        if(joinCallback) {
-            joinCallback(leaderIp, receivedStr);
-            logLightThread(LT_LOG_INFO, "RECONNECT: Fired joinCallback with IP %s and hash %s",
-                           leaderIp.c_str(), receivedStr.c_str());
-        }
+    setState(State::JOINER_PAIRED);
+
+    // The leader may have dropped our topic list while we were away
+    if(topicCount > 0)
+        resubscribe();
+}
 
-        setState(State::JOINER_PAIRED);
+// Leader: a joiner's heartbeat. Registers or refreshes the joiner and echoes it.
+void LightThread::rxHeartbeat(const RxPacket &rx) {
+    if(rx.length != 8) {
+        LT_LOG(UDP, LT_LOG_WARN, "HEARTBEAT: Invalid payload from %s", rx.src.text().c_str());
+        return;
     }
 
-    else if(ack == AckType::NONE && msg == MessageType::HEARTBEAT && role == Role::LEADER) {
-        if(payload.size() != 8) {
-            logLightThread(LT_LOG_WARN, "HEARTBEAT: Invalid payload from %s", srcIp.c_str());
-            return;
-        }
+    // Parse hashMAC from payload
+    uint64_t id = 0;
+    for(int i = 0; i < 8; ++i)
+        id = (id << 8) | rx.payload[i];
 
-        // Parse hashMAC from payload
-        uint64_t id = 0;
-        for(int i = 0; i < 8; ++i)
-            id = (id << 8) | payload[i];
+    JoinerInfo *joiner = joiners.insert(id);
+    if(!joiner) {
+        LT_LOG(UDP, LT_LOG_WARN, "HEARTBEAT: No registry entry, ignoring joiner %s [%016llx]",
+               rx.src.text().c_str(), id);
+        return;
+    }
 
+    // A new entry has lastSeen 0; an existing one may have a new address
+    bool appeared = joiner->lastSeen == 0;
+    bool moved = !appeared && joiner->addr != rx.src;
+    if(appeared)
+        joiner->timeout = joinerTimeout;
+    joiner->addr = rx.src;
+    joiner->lastSeen = millis();
+    joiner->role = Role::JOINER;
+    if(const ReliablePeer *peer = findReliablePeer(rx.src))
+        joiner->rtt = peer->srtt;
+
+    LT_LOG(UDP, LT_LOG_INFO, "HEARTBEAT: Joiner %s [%016llx] is alive", rx.src.text().c_str(), id);
+
+    // Echo heartbeat back, unless the next beacon round answers it
+    if(livenessMode == LivenessMode::ECHO)
+        sendUdpPacket(AckType::RESPONSE, MessageType::HEARTBEAT, rx.payload, rx.length, rx.src,
+                      LT_UDP_PORT);
+
+    // Trigger joinCallback if the joiner is new (again, after expiring) or changed address
+    if(appeared || moved) {
         String hashStr =
             String((uint32_t)(id >> 32), HEX) + String((uint32_t)(id & 0xFFFFFFFF), HEX);
-
-        unsigned long now = millis();
-        unsigned long lastSeen;
-        if(joinerHeartbeatMap.count(srcIp)) {
-            lastSeen = joinerHeartbeatMap[srcIp];
-        } else {
-            lastSeen = 0;
-        }
-        joinerHeartbeatMap[srcIp] = now;
-
-        logLightThread(LT_LOG_INFO, "HEARTBEAT: Joiner %s [%s] is alive", srcIp.c_str(),
-                       hashStr.c_str());
-
-        // Echo heartbeat back
-        sendUdpPacket(AckType::RESPONSE, MessageType::HEARTBEAT, payload, srcIp, 12345);
-
-        // Trigger joinCallback if this is a reappearance
-        const unsigned long silenceThreshold = 10000;
-        if(lastSeen == 0 || now - lastSeen > silenceThreshold) {
-            if(joinCallback)
-                joinCallback(srcIp, hashStr);
-            logLightThread(LT_LOG_INFO, "HEARTBEAT: Joiner %s [%s] reappeared — callback fired",
-                           srcIp.c_str(), hashStr.c_str());
-        }
+        if(joinCallback)
+            notifyJoin(rx.src, hashStr);
+        LT_LOG(UDP, LT_LOG_INFO, "HEARTBEAT: Joiner %s [%s] %s — callback fired",
+               rx.src.text().c_str(), hashStr.c_str(), moved ? "moved" : "reappeared");
     }
 
-    else if(ack == AckType::RESPONSE && msg == MessageType::HEARTBEAT && role == Role::JOINER) {
-        lastHeartbeatEcho = millis(); // mark as acknowledged
-        logLightThread(LT_LOG_INFO, "HEARTBEAT: Echo received from leader");
+    // A joiner new to the registry has no topic list here yet: ask for it, if pub/sub is
+    // in use at all
+    if(appeared && pubSubInUse) {
+        uint8_t none = 0;
+        sendUdpPacket(AckType::NONE, MessageType::SUBSCRIBE, &none, 0, rx.src, LT_UDP_PORT);
     }
+}
 
-    else if(msg == MessageType::NORMAL) {
-        // Handle ACK first
-        if(ack == AckType::RESPONSE && payload.size() >= 2) {
-            uint16_t ackedId = (payload[0] << 8) | payload[1];
-            if(pendingReliableMessages.erase(ackedId)) {
-                if(reliableCallback)
-                    reliableCallback(ackedId, srcIp, true);
-                logLightThread(LT_LOG_INFO, "ReliableUDP: ACK received for msgId %u", ackedId);
-            } else {
-                logLightThread(LT_LOG_WARN, "ReliableUDP: Unexpected ACK for msgId %u", ackedId);
-            }
-        }
-
-        handleNormalUdpMessage(srcIp, payload, ack);
-    }
+// Joiner: the leader echoed our heartbeat.
+void LightThread::rxHeartbeatEcho(const RxPacket &rx) {
+    lastHeartbeatEcho = millis(); // mark as acknowledged
+    LT_LOG(UDP, LT_LOG_INFO, "HEARTBEAT: Echo received from leader");
 }
 
-String LightThread::extractUdpSourceIp(const String &line) {
-    int fromIndex = line.indexOf("from ");
-    if(fromIndex == -1)
-        return "";
+// Parses the address following "from " in a CLI UDP line into `src`; `end` is set to the
+// index just past it. Returns false if the line has no valid source address.
+bool LightThread::extractUdpSourceIp(const char *line, size_t length, Ip6Address &src,
+                                     size_t &end) {
+    static const char kFrom[] = "from ";
+    const size_t fromLen = sizeof(kFrom) - 1;
+
+    size_t ipStart = 0;
+    while(ipStart + fromLen <= length && memcmp(line + ipStart, kFrom, fromLen) != 0)
+        ++ipStart;
+    if(ipStart + fromLen > length)
+        return false;
+    ipStart += fromLen;
 
-    int ipStart = fromIndex + 5;
-    int ipEnd = line.indexOf(' ', ipStart);
-    if(ipEnd == -1)
-        return "";
+    end = ipStart;
+    while(end < length && line[end] != ' ')
+        ++end;
+    if(end == length)
+        return false;
 
-    return line.substring(ipStart, ipEnd);
+    return Ip6Address::parse(line + ipStart, end - ipStart, src);
 }
 
 uint16_t LightThread::packMessage(AckType ack, MessageType type) {
@@ -240,18 +254,43 @@ void LightThread::unpackMessage(uint16_t raw, AckType &ack, MessageType &type) {
     type = static_cast<MessageType>(raw & 0x00FF);
 }
 
-bool LightThread::parseIncomingPayload(const String &hex, AckType &ack, MessageType &type,
-                                       std::vector<uint8_t> &payloadOut) {
-    std::vector<uint8_t> bytes;
-    if(!convertHexToBytes(hex, bytes) || bytes.size() < 2) {
-        logLightThread(LT_LOG_WARN, "Invalid or too short UDP payload: %s", hex.c_str());
+// Splits a frame into its header fields and payload, unwrapping a CHANNEL envelope so
+// `type` is always the type of the message inside; `channel` is 0 without one.
+bool LightThread::parseIncomingPayload(const uint8_t *frame, size_t length, AckType &ack,
+                                       MessageType &type, uint8_t &channel, bool &compressed,
+                                       const uint8_t *&payload, size_t &payloadLen) {
+    if(length < 2) {
+        LT_LOG(UDP, LT_LOG_WARN, "Too short UDP payload: %u bytes", static_cast<unsigned>(length));
         return false;
     }
 
-    ack = static_cast<AckType>(bytes[0]);
-    type = static_cast<MessageType>(bytes[1]);
+    ack = static_cast<AckType>(frame[0]);
+    type = static_cast<MessageType>(frame[1] & ~kCompressedFlag);
+    compressed = frame[1] & kCompressedFlag;
 
-    payloadOut.assign(bytes.begin() + 2, bytes.end()); // rest is data
+    payload = frame + 2; // rest is data, left in place
+    payloadLen = length - 2;
+    channel = 0;
+
+    if(type == MessageType::CHANNEL) {
+        if(payloadLen < 2) {
+            LT_LOG(UDP, LT_LOG_WARN, "Too short channel frame: %u bytes",
+                   static_cast<unsigned>(length));
+            return false;
+        }
+        channel = payload[0];
+        type = static_cast<MessageType>(payload[1] & ~kCompressedFlag);
+        compressed = payload[1] & kCompressedFlag;
+        payload += 2;
+        payloadLen -= 2;
+
+        if(channel == 0 || channel >= LT_CHANNELS ||
+           (type != MessageType::NORMAL && type != MessageType::FRAGMENT)) {
+            LT_LOG(UDP, LT_LOG_WARN, "Unsupported channel %u / type %02x", channel,
+                   static_cast<unsigned>(type));
+            return false;
+        }
+    }
     return true;
 }
 
@@ -269,67 +308,78 @@ uint64_t LightThread::generateMacHash() {
 
 // Overload of sending a UDP UDP packet for a vector.
 bool LightThread::sendUdpPacket(AckType ack, MessageType type, const std::vector<uint8_t> &payload,
-                                const String &destIp, uint16_t destPort,
-                                std::optional<uint16_t> messageId) {
-    return sendUdpPacket(ack, type, payload.data(), payload.size(), destIp, destPort, messageId);
+                                const Ip6Address &dest, uint16_t destPort) {
+    return sendUdpPacket(ack, type, payload.data(), payload.size(), dest, destPort);
 }
 
-// Sends a UDP packet with the given header and payload.
-// Optionally enables reliable delivery (retry until ACK received).
+// Sends a UDP packet with the given header and payload. `compressed` flags a payload
+// produced by lzCompress() in the type byte. A nonzero `channel` wraps the message in a
+// CHANNEL envelope.
 bool LightThread::sendUdpPacket(AckType ack, MessageType type, const uint8_t *payload,
-                                size_t length, const String &destIp, uint16_t destPort,
-                                std::optional<uint16_t> messageId) {
-    if(destIp.isEmpty() || destPort == 0) {
-        logLightThread(LT_LOG_WARN, "Invalid UDP destination");
+                                size_t length, const Ip6Address &dest, uint16_t destPort,
+                                bool compressed, uint8_t channel) {
+    if(dest.isUnspecified() || destPort == 0) {
+        LT_LOG(UDP, LT_LOG_WARN, "Invalid UDP destination");
         return false;
     }
 
-    std::vector<uint8_t> fullMsg;
-    fullMsg.push_back(static_cast<uint8_t>(ack));
-    fullMsg.push_back(static_cast<uint8_t>(type));
-
-    // Optional: messageId (2 bytes)
-    if(messageId.has_value()) {
-        fullMsg.push_back((messageId.value() >> 8) & 0xFF);
-        fullMsg.push_back(messageId.value() & 0xFF);
+    const size_t headerLen = frameOverhead(channel);
+    if(headerLen + length > LT_MAX_UDP_FRAME) {
+        LT_LOG(UDP, LT_LOG_WARN, "UDP payload too large (%u bytes, max %u)",
+               static_cast<unsigned>(length), static_cast<unsigned>(LT_MAX_UDP_FRAME - headerLen));
+        return false;
     }
 
-    fullMsg.insert(fullMsg.end(), payload, payload + length);
-
-    String hex = convertBytesToHex(fullMsg.data(), fullMsg.size());
+    uint8_t frame[LT_MAX_UDP_FRAME];
+    uint8_t typeByte = static_cast<uint8_t>(type) | (compressed ? kCompressedFlag : 0);
+    frame[0] = static_cast<uint8_t>(ack);
+    if(channel == 0) {
+        frame[1] = typeByte;
+    } else {
+        frame[1] = MessageType::CHANNEL;
+        frame[2] = channel;
+        frame[3] = typeByte;
+    }
+    memcpy(frame + headerLen, payload, length);
 
-    String cmd = "udp send " + destIp + " " + String(destPort) + " " + hex;
-    logLightThread(LT_LOG_INFO, "sendUdpPacket: %s", cmd.c_str());
+    return transmitFrame(dest, destPort, frame, headerLen + length);
+}
 
-    OThreadCLI.println(cmd);
+// Hands a framed datagram to the selected backend.
+bool LightThread::transmitFrame(const Ip6Address &dest, uint16_t destPort, const uint8_t *frame,
+                                size_t length) {
+    if(udpBackend == UdpBackend::NATIVE)
+        return sendNativeUdp(dest, destPort, frame, length);
+
+    char hex[LT_MAX_UDP_FRAME * 2 + 1];
+    size_t hexLen = convertBytesToHex(frame, length, hex, sizeof(hex) - 1);
+    hex[hexLen] = '\0';
+
+    Ip6Address::Text destIp = dest.text();
+    LT_LOG(UDP, LT_LOG_VERBOSE, "sendUdpPacket: udp send %s %u %s", destIp.c_str(), destPort,
+           hex);
+
+    // Written piecewise; the CLI only acts on the line once the newline arrives
+    OThreadCLI.print("udp send ");
+    OThreadCLI.print(destIp.c_str());
+    OThreadCLI.print(' ');
+    OThreadCLI.print(destPort);
+    OThreadCLI.print(' ');
+    OThreadCLI.print(hex);
+    OThreadCLI.println();
+    cliUdpReplies++; // its Done/Error is not a reply to a command (handleCliLine)
     return true;
 }
 
-void LightThread::updateReliableUdp() {
-    unsigned long now = millis();
-
-    for(auto it = pendingReliableMessages.begin(); it != pendingReliableMessages.end();) {
-        uint16_t msgId = it->first;
-        PendingReliableUdp &msg = it->second;
-
-        if(now - msg.timeSent >= 2000) {
-            if(msg.retryCount >= 5) {
-                logLightThread(LT_LOG_INFO, "ReliableUDP: Dropping msgId %u to %s", msgId,
-                               msg.destIp.c_str());
-                if(reliableCallback)
-                    reliableCallback(msgId, msg.destIp, false);
-                it = pendingReliableMessages.erase(it);
-                continue;
-            }
-
-            logLightThread(LT_LOG_INFO, "ReliableUDP: Retrying msgId %u to %s (attempt %u)", msgId,
-                           msg.destIp.c_str(), msg.retryCount + 1);
-            sendUdpPacket(AckType::REQUEST, MessageType::NORMAL, msg.payload, msg.destIp, 12345,
-                          msgId);
-            msg.timeSent = now;
-            msg.retryCount++;
-        }
+// Opens the LightThread UDP socket on port LT_UDP_PORT using the selected backend.
+// The CLI backend queues commands to reopen the CLI socket; the native backend binds
+// its own socket immediately.
+bool LightThread::openUdpSocket() {
+    if(udpBackend == UdpBackend::NATIVE)
+        return openNativeUdp();
 
-        ++it;
-    }
+    execAsync("udp close");
+    execAsync("udp open");
+    execAsync("udp bind :: " + String(LT_UDP_PORT));
+    return true;
 }
@@ -1,39 +1,154 @@
 #include "LightThread.h"
+#include <array>
 
-// Converts a buffer to a hex string (e.g. {0xAB, 0x01} → "AB01")
-String LightThread::convertBytesToHex(const uint8_t *data, size_t len) {
-    String hex;
-    const char hexChars[] = "0123456789abcdef";
-    for(size_t i = 0; i < len; ++i) {
-        hex += hexChars[(data[i] >> 4) & 0xF];
-        hex += hexChars[data[i] & 0xF];
+// Hex codec. Both directions work on caller-provided buffers and convert 8 bytes
+// (16 hex characters) per step using SWAR arithmetic on 64-bit words; the remainder
+// goes through lookup tables.
+
+static const char kHexDigits[] = "0123456789abcdef";
+
+// Maps an ASCII character to its nibble value, or -1 if it is not a hex digit.
+static constexpr std::array<int8_t, 256> makeHexDecodeTable() {
+    std::array<int8_t, 256> table = {};
+    for(int c = 0; c < 256; ++c) {
+        if(c >= '0' && c <= '9')
+            table[c] = c - '0';
+        else if(c >= 'a' && c <= 'f')
+            table[c] = c - 'a' + 10;
+        else if(c >= 'A' && c <= 'F')
+            table[c] = c - 'A' + 10;
+        else
+            table[c] = -1;
     }
-    return hex;
+    return table;
+}
+
+static constexpr std::array<int8_t, 256> kHexDecode = makeHexDecodeTable();
+
+static constexpr uint64_t kOnes = 0x0101010101010101ULL;
+static constexpr uint64_t kHighBits = 0x8080808080808080ULL;
+
+// Byte order independent loads/stores; compilers reduce these to single accesses.
+static inline uint64_t load64le(const char *p) {
+    uint64_t v = 0;
+    for(int i = 7; i >= 0; --i)
+        v = (v << 8) | static_cast<uint8_t>(p[i]);
+    return v;
+}
+
+static inline void store64le(char *p, uint64_t v) {
+    for(int i = 0; i < 8; ++i, v >>= 8)
+        p[i] = static_cast<char>(v & 0xFF);
+}
+
+// Per byte of `v` (all bytes < 0x80): high bit set where the byte is >= `lo`.
+static inline uint64_t bytesAtLeast(uint64_t v, uint8_t lo) {
+    return (v + kOnes * static_cast<uint8_t>(0x80 - lo)) & kHighBits;
+}
+
+// Turns 8 nibble values (one per byte, 0..15) into their ASCII hex digits.
+static inline uint64_t nibblesToAscii(uint64_t n) {
+    uint64_t letters = ((n + kOnes * 0x76) >> 7) & kOnes; // 1 where the nibble is >= 10
+    return n + kOnes * '0' + letters * ('a' - '0' - 10);
 }
 
-// Converts hex string back to bytes (e.g. "AB01" → {0xAB, 0x01})
-bool LightThread::convertHexToBytes(const String &hexStr, std::vector<uint8_t> &out) {
-    out.clear();
-    if(hexStr.length() % 2 != 0)
+// Decodes 8 hex characters into 4 bytes. Returns false if any character is not a hex digit.
+static inline bool decodeHex8(const char *in, uint8_t *out) {
+    uint64_t v = load64le(in);
+    if(v & kHighBits)
+        return false;
+
+    uint64_t digit = bytesAtLeast(v, '0') & ~bytesAtLeast(v, '9' + 1);
+    uint64_t folded = v | (kOnes * 0x20); // 'A'-'F' -> 'a'-'f'
+    uint64_t alpha = bytesAtLeast(folded, 'a') & ~bytesAtLeast(folded, 'f' + 1);
+    if((digit | alpha) != kHighBits)
         return false;
 
-    for(size_t i = 0; i < hexStr.length(); i += 2) {
-        char high = hexStr[i];
-        char low = hexStr[i + 1];
-        uint8_t byte = strtol((String("") + high + low).c_str(), nullptr, 16);
-        out.push_back(byte);
+    uint64_t nibbles = (v & (kOnes * 0x0F)) + (alpha >> 7) * 9;
+    // Characters come in (high, low) pairs: fold each pair into the low byte of its lane
+    const uint64_t lowByte = 0x00FF00FF00FF00FFULL;
+    uint64_t lanes = ((nibbles & lowByte) << 4) | ((nibbles >> 8) & lowByte);
+    out[0] = static_cast<uint8_t>(lanes);
+    out[1] = static_cast<uint8_t>(lanes >> 16);
+    out[2] = static_cast<uint8_t>(lanes >> 32);
+    out[3] = static_cast<uint8_t>(lanes >> 48);
+    return true;
+}
+
+// Encodes 4 bytes into 8 hex characters.
+static inline void encodeHex4(const uint8_t *in, char *out) {
+    uint64_t lanes = static_cast<uint64_t>(in[0]) | (static_cast<uint64_t>(in[1]) << 16) |
+                     (static_cast<uint64_t>(in[2]) << 32) | (static_cast<uint64_t>(in[3]) << 48);
+    const uint64_t lowNibble = 0x000F000F000F000FULL;
+    uint64_t nibbles = ((lanes >> 4) & lowNibble) | ((lanes & lowNibble) << 8);
+    store64le(out, nibblesToAscii(nibbles));
+}
+
+// Converts a buffer to hex (e.g. {0xAB, 0x01} → "ab01") into `out`.
+// Returns the number of characters written (2 * len), or 0 if `outCap` is too small.
+// The output is not NUL-terminated.
+size_t LightThread::convertBytesToHex(const uint8_t *data, size_t len, char *out,
+                                      size_t outCap) {
+    if(outCap < len * 2)
+        return 0;
+
+    size_t i = 0;
+    for(; i + 8 <= len; i += 8) {
+        encodeHex4(data + i, out + i * 2);
+        encodeHex4(data + i + 4, out + i * 2 + 8);
+    }
+    for(; i < len; ++i) {
+        out[i * 2] = kHexDigits[data[i] >> 4];
+        out[i * 2 + 1] = kHexDigits[data[i] & 0xF];
+    }
+    return len * 2;
+}
+
+// Converts hex back to bytes (e.g. "AB01" → {0xAB, 0x01}) into `out`.
+// Fails on odd length, on any non-hex character, or if `outCap` is too small.
+bool LightThread::convertHexToBytes(const char *hex, size_t hexLen, uint8_t *out, size_t outCap,
+                                    size_t &outLen) {
+    outLen = 0;
+    if(hexLen % 2 != 0 || hexLen / 2 > outCap)
+        return false;
+
+    size_t i = 0;
+    for(; i + 16 <= hexLen; i += 16) {
+        if(!decodeHex8(hex + i, out + i / 2) || !decodeHex8(hex + i + 8, out + i / 2 + 4))
+            return false;
+    }
+    for(; i < hexLen; i += 2) {
+        int8_t high = kHexDecode[static_cast<uint8_t>(hex[i])];
+        int8_t low = kHexDecode[static_cast<uint8_t>(hex[i + 1])];
+        if(high < 0 || low < 0)
+            return false;
+        out[i / 2] = static_cast<uint8_t>((high << 4) | low);
     }
+
+    outLen = hexLen / 2;
     return true;
 }
 
-String LightThread::getLeaderIp() {
-    if(getRole() == Role::LEADER) {
+// String form of getLeaderAddress(); empty on the leader or while no leader is known.
+String LightThread::getLeaderIp() const {
+    if(role == Role::LEADER || leaderIp.isUnspecified())
         return "";
-    } else if(getRole() == Role::JOINER) {
-        return leaderIp;
-    }
+    return leaderIp.toString();
+}
+
+// Sets the lowest level logged by every subsystem. Levels below LT_LOG_MIN_LEVEL stay
+// compiled out.
+void LightThread::setLogLevel(LightThreadLogLevel level) {
+    for(LightThreadLogLevel &subsystemLevel : logLevels)
+        subsystemLevel = level;
 }
 
+// Sets the lowest level logged by one subsystem; LT_LOG_NONE silences it.
+void LightThread::setLogLevel(LogSubsystem subsystem, LightThreadLogLevel level) {
+    logLevels[static_cast<size_t>(subsystem)] = level;
+}
+
+// Formats and prints a message that passed the LT_LOG filters. Use LT_LOG, not this.
 void LightThread::logLightThread(LightThreadLogLevel level, const char *fmt, ...) {
     char buffer[256];
     va_list args;
@@ -45,6 +160,9 @@ void LightThread::logLightThread(LightThreadLogLevel level, const char *fmt, ...
     case LT_LOG_VERBOSE:
         log_v("[LightThread] %s", buffer);
         break;
+    case LT_LOG_DEBUG:
+        log_d("[LightThread] %s", buffer);
+        break;
     case LT_LOG_INFO:
         log_i("[LightThread] %s", buffer);
         break;
@@ -54,5 +172,7 @@ void LightThread::logLightThread(LightThreadLogLevel level, const char *fmt, ...
     case LT_LOG_ERROR:
         log_e("[LightThread] %s", buffer);
         break;
+    case LT_LOG_NONE:
+        break;
     }
 }
@@ -1,106 +1,416 @@
 #include "LightThread.h"
+#include "esp_openthread.h"
+#include "esp_openthread_lock.h"
 #include <FS.h>
 #include <SD.h>
+#include <climits>
+#include <openthread/thread.h>
 
-// Handles incoming UDP message of type NORMAL.
-// If the message is marked as reliable (AckType::REQUEST), an ACK is sent.
-// Otherwise, it calls the registered UDP callback.
-void LightThread::handleNormalUdpMessage(const String &srcIp,
-                                         const std::vector<uint8_t> &payload,
-                                         AckType ack) {
-    if (payload.empty()) return;
-
-    if(ack == AckType::RESPONSE) return;
-    bool reliable = (ack == AckType::REQUEST);
-
-    // Non-reliable: payload already IS the app payload (e.g., Beeton packet)
-    // Reliable: payload begins with 2-byte messageId followed by app payload
-    const std::vector<uint8_t>* forwarded = &payload;
-    std::vector<uint8_t> strippedPayload;
-
-    if (reliable) {
-        if (payload.size() < 2) {
-            logLightThread(LT_LOG_WARN, "ExposedUDP: Reliable message too short for messageId");
+// Delivers the application payload of a NORMAL message to the receive callback of its
+// channel, in place. Reliable messages arrive here from the reliable stream, already ACKed,
+// with the payload pointer moved past their stream header. Compressed payloads are
+// expanded into lzBuffer first.
+void LightThread::handleNormalUdpMessage(const Ip6Address &src, const uint8_t *payload,
+                                         size_t length, bool reliable, bool compressed,
+                                         uint8_t channel) {
+    if(compressed) {
+        length = lzDecompress(payload, length, lzBuffer, sizeof(lzBuffer));
+        if(length == 0) {
+            LT_LOG(UDP, LT_LOG_WARN, "ExposedUDP: Corrupt compressed payload from %s",
+                   src.text().c_str());
             return;
         }
+        payload = lzBuffer;
+    }
 
-        // Here messageId is at payload[0..1] because ack/type were already stripped
-        uint16_t messageId = (static_cast<uint16_t>(payload[0]) << 8) | payload[1];
-
-        std::vector<uint8_t> ackPayload = {
-            static_cast<uint8_t>((messageId >> 8) & 0xFF),
-            static_cast<uint8_t>(messageId & 0xFF)
-        };
-
-        sendUdpPacket(AckType::RESPONSE, MessageType::NORMAL,
-                      ackPayload, srcIp, 12345);
-
-        logLightThread(LT_LOG_INFO, "ExposedUDP: Sent ACK for messageId %u to %s",
-                       messageId, srcIp.c_str());
+    if(length == 0)
+        return;
 
-        // Strip messageId before forwarding to app
-        strippedPayload.assign(payload.begin() + 2, payload.end());
-        forwarded = &strippedPayload;
+    if(deferredDelivery) {
+        pushEvent(EventKind::RECEIVE, channel, reliable, 0, src, payload, length);
+        return;
     }
 
-
-    if (udpCallback) {
-        udpCallback(srcIp, reliable, *forwarded);
+    UdpViewCallback &callback = channel == 0 ? udpCallback : channelCallbacks[channel - 1].receive;
+    if(callback) {
+        lzBufferLent = payload == lzBuffer;
+        callback(src, reliable, payload, length);
+        lzBufferLent = false;
     } else {
-        logLightThread(LT_LOG_WARN, "ExposedUDP: No handler registered for NORMAL packets");
+        LT_LOG(UDP, LT_LOG_WARN, "ExposedUDP: No handler registered for channel %u", channel);
     }
 }
 
+// Wraps a vector receive callback for the view one; the payload is copied per message.
+static LightThread::UdpViewCallback wrapReceiveCallback(LightThread::UdpReceiveCallback fn) {
+    if(!fn)
+        return nullptr;
+    return [fn](const Ip6Address &src, bool reliable, const uint8_t *payload, size_t length) {
+        fn(src, reliable, std::vector<uint8_t>(payload, payload + length));
+    };
+}
 
 // Registers a callback to receive parsed incoming UDP payloads (after stripping headers).
+void LightThread::registerUdpReceiveCallback(UdpReceiveCallback fn) {
+    registerUdpViewCallback(wrapReceiveCallback(fn));
+}
+
+// String form of the above: the source is formatted for every message.
 void LightThread::registerUdpReceiveCallback(
     std::function<void(const String &, bool reliable, const std::vector<uint8_t> &)> fn) {
+    if(!fn)
+        return registerUdpReceiveCallback(UdpReceiveCallback());
+    registerUdpReceiveCallback(
+        [fn](const Ip6Address &src, bool reliable, const std::vector<uint8_t> &payload) {
+            fn(src.toString(), reliable, payload);
+        });
+}
+
+// Registers a callback that gets each incoming payload where it lies in the receive
+// buffer, without copying or allocating. The view is only valid during the call; copy
+// what is needed later. Replaces a registerUdpReceiveCallback() callback.
+void LightThread::registerUdpViewCallback(UdpViewCallback fn) {
     udpCallback = fn;
-    logLightThread(LT_LOG_INFO, "ExposedUDP: UDP callback registered");
+    LT_LOG(UDP, LT_LOG_INFO, "ExposedUDP: UDP callback registered");
 }
 
 // Registers a callback that is triggered when a new joiner is detected.
 // Used in pairing flows.
+void LightThread::registerJoinCallback(JoinCallback cb) {
+    joinCallback = cb;
+    LT_LOG(UDP, LT_LOG_INFO, "Join callback registered");
+}
+
 void LightThread::registerJoinCallback(
     std::function<void(const String &ip, const String &hashmac)> cb) {
-    joinCallback = cb;
-    logLightThread(LT_LOG_INFO, "Join callback registered");
+    if(!cb)
+        return registerJoinCallback(JoinCallback());
+    registerJoinCallback(
+        [cb](const Ip6Address &ip, const String &hashmac) { cb(ip.toString(), hashmac); });
+}
+
+// Registers a callback fired on the leader when a joiner is dropped for silence, the
+// counterpart of the join callback. Gets the joiner's last address and its hash.
+void LightThread::registerLeaveCallback(LeaveCallback cb) {
+    leaveCallback = cb;
+    LT_LOG(UDP, LT_LOG_INFO, "Leave callback registered");
+}
+
+void LightThread::registerLeaveCallback(
+    std::function<void(const String &ip, const String &hashmac)> cb) {
+    if(!cb)
+        return registerLeaveCallback(LeaveCallback());
+    registerLeaveCallback(
+        [cb](const Ip6Address &ip, const String &hashmac) { cb(ip.toString(), hashmac); });
+}
+
+// Wraps a String status callback for the Ip6Address one.
+static LightThread::StatusCallback wrapStatusCallback(
+    std::function<void(uint16_t id, const String &ip, bool success)> cb) {
+    if(!cb)
+        return nullptr;
+    return [cb](uint16_t id, const Ip6Address &ip, bool success) {
+        cb(id, ip.toString(), success);
+    };
+}
+
+// Registers the callbacks of one channel: `receive` gets the payloads sent to it and
+// `status` the outcome of reliable sends on it. Channel 0 is the default channel of the
+// udp receive and reliable status callbacks. Returns false if `channel` is not below
+// LT_CHANNELS.
+bool LightThread::registerChannel(uint8_t channel, UdpReceiveCallback receive,
+                                  StatusCallback status) {
+    if(channel >= LT_CHANNELS)
+        return false;
+
+    if(channel == 0) {
+        udpCallback = wrapReceiveCallback(receive);
+        reliableCallback = status;
+    } else {
+        channelCallbacks[channel - 1].receive = wrapReceiveCallback(receive);
+        channelCallbacks[channel - 1].status = status;
+    }
+    LT_LOG(UDP, LT_LOG_INFO, "ExposedUDP: Channel %u callbacks registered", channel);
+    return true;
 }
 
 // Registers a callback that is invoked upon delivery success/failure
 // of a reliable UDP message.
+void LightThread::registerReliableUdpStatusCallback(StatusCallback cb) {
+    reliableCallback = cb;
+    LT_LOG(UDP, LT_LOG_INFO, "Reliable UDP status callback registered");
+}
+
 void LightThread::registerReliableUdpStatusCallback(
     std::function<void(uint16_t msgId, const String &ip, bool success)> cb) {
-    reliableCallback = cb;
-    logLightThread(LT_LOG_INFO, "Reliable UDP status callback registered");
+    registerReliableUdpStatusCallback(wrapStatusCallback(cb));
+}
+
+// Registers a callback that reports, once per member, whether a group message sent with
+// sendGroup() reached that joiner.
+void LightThread::registerGroupStatusCallback(StatusCallback cb) {
+    groupCallback = cb;
+    LT_LOG(UDP, LT_LOG_INFO, "Group status callback registered");
+}
+
+void LightThread::registerGroupStatusCallback(
+    std::function<void(uint16_t groupId, const String &ip, bool success)> cb) {
+    registerGroupStatusCallback(wrapStatusCallback(cb));
 }
 
 // Sends a UDP packet to the destination IP.
-// If reliable is true, adds it to the retry queue and assigns a messageId.
-bool LightThread::sendUdp(const String &destIp, bool reliable,
-                          const std::vector<uint8_t> &userPayload) {
-    if(!reliable) {
-        return sendUdpPacket(AckType::NONE, MessageType::NORMAL, userPayload, destIp, 12345);
+// If reliable is true, the payload is copied into a free slot of the destination's reliable
+// stream and retried until ACKed; it may wait there for room in the send window. When every
+// slot is taken the call fails with QUEUE_FULL instead of queueing without bound.
+// Payloads that do not fit the UDP MTU (see setUdpMtu()) are split into fragments and
+// reassembled by the receiver; up to LT_MAX_MESSAGE_SIZE bytes can be sent this way.
+// With coalescing enabled (setUdpCoalescing()), small unreliable payloads are buffered and
+// sent later in a batch; OK then means the payload was buffered. With compression enabled
+// (setUdpCompression()), other payloads are sent compressed whenever that makes them smaller.
+SendStatus LightThread::sendUdp(const Ip6Address &dest, bool reliable,
+                                const std::vector<uint8_t> &payload) {
+    return sendUdp(dest, 0, reliable, payload);
+}
+
+// Sends to one channel of the destination (below LT_CHANNELS): the payload goes to that
+// channel's receive callback, and reliable sends get a stream of their own, so a loss on
+// one channel does not delay another. Frames on channels other than 0 carry two more
+// header bytes and are never coalesced.
+// Safe to call from any task. Outside the task running update() the payload is queued and
+// sent by the next update(); OK then means it was queued, and WOULD_BLOCK that the queue is
+// full. A queued reliable send waits in the queue while the reliable slots are full, and
+// one that fails when sent is reported to the status callback with msgId 0. A queued
+// payload must fit one send slot, LT_SEND_SLOT_BYTES (one frame, 384 bytes by default),
+// rather than LT_MAX_MESSAGE_SIZE, so a payload in between is sent from the update() task
+// but TOO_LARGE from any other.
+SendStatus LightThread::sendUdp(const Ip6Address &dest, uint8_t channel, bool reliable,
+                                const std::vector<uint8_t> &payload) {
+    if(!onUpdateTask())
+        return queueSend(dest, channel, reliable, payload.data(), payload.size());
+    return sendPayload(dest, channel, reliable, payload.data(), payload.size());
+}
+
+// sendUdp() on the task running update()
+SendStatus LightThread::sendPayload(const Ip6Address &dest, uint8_t channel, bool reliable,
+                                    const uint8_t *data, size_t size) {
+    size_t userSize = size;
+    if(channel >= LT_CHANNELS)
+        return SendStatus::INVALID;
+    if(size > LT_MAX_MESSAGE_SIZE)
+        return SendStatus::TOO_LARGE;
+
+    if(channel == 0 && !reliable && coalesces(size))
+        return coalesceUdp(dest, data, size);
+    if(channel == 0 && !reliable && coalesceWindow > 0)
+        flushCoalesced(dest);
+
+    bool compressed = compressForSend(data, size);
+    size_t overhead = frameOverhead(channel);
+
+    SendStatus status;
+    if(reliable) {
+        bool fits = overhead + 3 + size <= udpMtu && size <= LT_RELIABLE_PAYLOAD_SIZE;
+        status = fits ? queueReliable(dest, channel, data, size, compressed)
+                      : queueFragmented(dest, channel, data, size, compressed);
+    } else if(overhead + size > udpMtu) {
+        status = sendFragmented(dest, channel, data, size, compressed);
+    } else {
+        status = sendUdpPacket(AckType::NONE, MessageType::NORMAL, data, size, dest,
+                               LT_UDP_PORT, compressed, channel)
+                     ? SendStatus::OK
+                     : SendStatus::SEND_FAILED;
     }
 
-    // Generate a new message ID
-    uint16_t msgId = nextMessageId++;
+    if(compressed && status == SendStatus::OK) {
+        stats.messagesCompressed++;
+        stats.compressionSaved += userSize - size;
+    }
+    return status;
+}
 
-    // Track this reliable message for retry and acknowledgment
-    pendingReliableMessages[msgId] = {
-        .destIp = destIp, .payload = userPayload, .timeSent = millis(), .retryCount = 0};
+// String form of sendUdp(); INVALID if `destIp` is not an IPv6 address.
+SendStatus LightThread::sendUdp(const String &destIp, bool reliable,
+                                const std::vector<uint8_t> &payload) {
+    Ip6Address dest;
+    if(!Ip6Address::parse(destIp.c_str(), destIp.length(), dest)) {
+        LT_LOG(UDP, LT_LOG_WARN, "ExposedUDP: Invalid destination %s", destIp.c_str());
+        return SendStatus::INVALID;
+    }
+    return sendUdp(dest, reliable, payload);
+}
 
-    // Send with ACK request
-    return sendUdpPacket(AckType::REQUEST, MessageType::NORMAL, userPayload, destIp, 12345, msgId);
+SendStatus LightThread::sendUdp(const String &destIp, uint8_t channel, bool reliable,
+                                const std::vector<uint8_t> &payload) {
+    Ip6Address dest;
+    if(!Ip6Address::parse(destIp.c_str(), destIp.length(), dest)) {
+        LT_LOG(UDP, LT_LOG_WARN, "ExposedUDP: Invalid destination %s", destIp.c_str());
+        return SendStatus::INVALID;
+    }
+    return sendUdp(dest, channel, reliable, payload);
+}
+
+// Sets the largest datagram sendUdp() sends unfragmented, headers included
+// (32..LT_MAX_UDP_FRAME). Smaller values mean fewer 802.15.4 frames per datagram, so a lost
+// frame costs less to retransmit.
+void LightThread::setUdpMtu(uint16_t mtu) {
+    if(mtu < 32)
+        mtu = 32;
+    if(mtu > LT_MAX_UDP_FRAME)
+        mtu = LT_MAX_UDP_FRAME;
+    flush(); // pending batches were sized for the old MTU
+    udpMtu = mtu;
+}
+
+// Enables coalescing of small unreliable sends. Payloads to the same destination are
+// packed into one datagram, sent once it holds `flushBytes` bytes of records (0: as many
+// as fit the MTU) or `windowMs` after its first payload was buffered. Trades up to
+// `windowMs` of latency for fewer frames on air. A window of 0 disables coalescing.
+void LightThread::setUdpCoalescing(unsigned long windowMs, uint16_t flushBytes) {
+    if(windowMs == 0)
+        flush();
+    coalesceWindow = windowMs;
+    coalesceBytes = flushBytes;
+}
+
+// Enables LZ compression of sendUdp() payloads. A payload is sent compressed only if that
+// makes it smaller; the type byte flags it and the receiver expands it before udpCallback.
+// Receivers must run a version that understands the flag.
+void LightThread::setUdpCompression(bool enabled) { udpCompression = enabled; }
+
+// Sends every pending coalesced batch now.
+void LightThread::flush() {
+    for(CoalesceBuffer &buf : coalesceBuffers)
+        flushCoalesceBuffer(buf);
+}
+
+// Returns how many more reliable messages can be queued before sendUdp() reports
+// QUEUE_FULL.
+uint8_t LightThread::freeReliableSlots() const { return LT_RELIABLE_SLOTS - reliableSlotsUsed; }
+
+// Sets how many reliable messages may be in flight per peer (1..LT_RELIABLE_WINDOW_MAX).
+void LightThread::setReliableWindow(uint8_t window) {
+    if(window < 1)
+        window = 1;
+    if(window > LT_RELIABLE_WINDOW_MAX)
+        window = LT_RELIABLE_WINDOW_MAX;
+    reliableWindow = window;
+}
+
+// When enabled, reliable messages from each peer reach the callback in send order;
+// out-of-order arrivals wait in a bounded reorder buffer.
+void LightThread::setReliableInOrder(bool inOrder) { reliableInOrder = inOrder; }
+
+// Sets how long a reliable message may stay unacknowledged before it is reported as failed.
+// Applies to messages sent after the call.
+void LightThread::setReliableDeadline(unsigned long deadlineMs) { reliableDeadline = deadlineMs; }
+
+// Copies the round-trip estimate kept for a reliable peer.
+// Returns false if no reliable traffic has been exchanged with `ip` yet.
+bool LightThread::getPeerRtt(const Ip6Address &ip, PeerRtt &rtt) {
+    ReliablePeer *peer = findReliablePeer(ip);
+    if(!peer)
+        return false;
+
+    rtt.srtt = peer->srtt;
+    rtt.rttVar = peer->rttVar;
+    rtt.rto = retransmitTimeout(*peer);
+    return true;
+}
+
+bool LightThread::getPeerRtt(const String &ip, PeerRtt &rtt) {
+    Ip6Address addr;
+    return Ip6Address::parse(ip.c_str(), ip.length(), addr) && getPeerRtt(addr, rtt);
+}
+
+// Returns the time in ms until the next reliable or group retransmission, deadline, delayed
+// ACK, batch flush, beacon round, joiner expiry or subscription retry is due, 0 if one is
+// already due, or ULONG_MAX if nothing is scheduled.
+// Calling update() earlier than this has no delivery work to do.
+unsigned long LightThread::msUntilNextDeadline() const {
+    unsigned long now = millis();
+    unsigned long next = ULONG_MAX;
+
+    if(reliableHeapSize > 0) {
+        long wait = static_cast<long>(reliableDue(reliableHeap[0]) - now);
+        next = wait > 0 ? static_cast<unsigned long>(wait) : 0;
+    }
+
+    unsigned long groupDue;
+    if(nextGroupEvent(groupDue)) {
+        long wait = static_cast<long>(groupDue - now);
+        if(wait <= 0)
+            return 0;
+        if(static_cast<unsigned long>(wait) < next)
+            next = wait;
+    }
+
+    if(sendsBeacons()) {
+        long wait = static_cast<long>(nextBeaconAt - now);
+        if(wait <= 0)
+            return 0;
+        if(static_cast<unsigned long>(wait) < next)
+            next = wait;
+    }
+
+    unsigned long expiryDue;
+    if(role == Role::LEADER && joiners.nextExpiry(expiryDue)) {
+        long wait = static_cast<long>(expiryDue - now);
+        if(wait <= 0)
+            return 0;
+        if(static_cast<unsigned long>(wait) < next)
+            next = wait;
+    }
+
+    if(role == Role::JOINER && subscriptionPending && state == State::JOINER_PAIRED) {
+        long wait = static_cast<long>(subscriptionSentAt + LT_PUBSUB_RETRY - now);
+        if(wait <= 0)
+            return 0;
+        if(static_cast<unsigned long>(wait) < next)
+            next = wait;
+    }
+
+    for(const CoalesceBuffer &buf : coalesceBuffers) {
+        if(!buf.inUse)
+            continue;
+        long wait = static_cast<long>(buf.firstAt + coalesceWindow - now);
+        if(wait <= 0)
+            return 0;
+        if(static_cast<unsigned long>(wait) < next)
+            next = wait;
+    }
+    return next;
 }
 
 // Returns the last time (in millis) a heartbeat was received from the given IP.
 // Used to detect lost joiners.
+unsigned long LightThread::getLastEchoTime(const Ip6Address &ip) {
+    JoinerInfo *joiner = joiners.findByAddress(ip);
+    return joiner ? joiner->lastSeen : 0; // never heard from, return 0
+}
+
 unsigned long LightThread::getLastEchoTime(const String &ip) {
-    if(joinerHeartbeatMap.count(ip)) {
-        return joinerHeartbeatMap[ip];
-    }
-    return 0; // never heard from, return 0
+    Ip6Address addr;
+    return Ip6Address::parse(ip.c_str(), ip.length(), addr) ? getLastEchoTime(addr) : 0;
+}
+
+// Sets the silence after which joiners are dropped, for joiners that appear from now on.
+void LightThread::setJoinerTimeout(unsigned long timeoutMs) { joinerTimeout = timeoutMs; }
+
+// Sets the timeout of one known joiner, e.g. a sleepy device from the join callback.
+// Returns false if the leader has no such joiner.
+bool LightThread::setJoinerTimeout(uint64_t id, unsigned long timeoutMs) {
+    JoinerInfo *joiner = joiners.find(id);
+    if(!joiner)
+        return false;
+    joiner->timeout = timeoutMs;
+    joiners.rearm(id);
+    return true;
+}
+
+// Calls `fn` for every joiner in the leader's registry, in no particular order.
+// The registry must not be changed from inside `fn`.
+void LightThread::forEachJoiner(std::function<void(const JoinerInfo &joiner)> fn) const {
+    joiners.forEach(fn);
 }
 
 // Returns true if the system is in a ready state (based on role and state).
@@ -114,18 +424,22 @@ bool LightThread::isReady() const {
     return false;
 }
 
+// Returns this node's mesh-local EID, read straight from the OpenThread stack so the
+// call never waits on the CLI. "::" if the stack is not running.
+Ip6Address LightThread::getMyAddress() {
+    otInstance *instance = esp_openthread_get_instance();
+    if(!instance)
+        return Ip6Address{};
+
+    esp_openthread_lock_acquire(portMAX_DELAY);
+    Ip6Address addr = Ip6Address::fromOt(*otThreadGetMeshLocalEid(instance));
+    esp_openthread_lock_release();
+    return addr;
+}
+
+// String form of getMyAddress(); empty if the stack is not running.
 String LightThread::getMyIp() {
-    String response;
-    if (execAndMatch("ipaddr mleid", "Done", &response)) {
-        // The CLI output will look like:
-        // "fd00:db8:abcd::1234\nDone"
-        // Let's strip the trailing "Done" and whitespace
-        int end = response.indexOf("Done");
-        if (end > 0) response = response.substring(0, end);
-        response.trim();
-        return response;
-    } else {
-        return "";
-    }
+    Ip6Address addr = getMyAddress();
+    return addr.isUnspecified() ? String("") : addr.toString();
 }
 
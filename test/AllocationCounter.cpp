@@ -0,0 +1,47 @@
+// Replaces the global operator new, single and array, plain and nothrow, and every operator
+// delete form that pairs with them, so the library's new(std::nothrow) tables are counted
+// too and all of them are freed by the allocator that made them, a sanitizer's included.
+// The aligned forms keep their defaults; nothing here allocates over-aligned types.
+#include "AllocationCounter.h"
+#include "Host.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<bool> counting{false};
+static std::atomic<size_t> allocations{0};
+static std::atomic<size_t> allocatedBytes{0};
+
+void countAllocations(bool on) { counting = on; }
+
+AllocationCount allocationsCounted() { return {allocations, allocatedBytes}; }
+
+static void *allocate(size_t size) noexcept {
+    if(counting && host::harnessDepth == 0) {
+        allocations++;
+        allocatedBytes += size;
+    }
+    return malloc(size ? size : 1);
+}
+
+void *operator new(size_t size) {
+    if(void *p = allocate(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) {
+    if(void *p = allocate(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return allocate(size); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return allocate(size); }
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { free(p); }
@@ -0,0 +1,24 @@
+// Heap allocations counted by the global operator new that AllocationCounter.cpp replaces,
+// for the tests linked with it. Only allocations made while counting, outside the fake
+// radio and OpenThread messages (host::HarnessScope), are the library's and are counted.
+#pragma once
+
+#include <cstddef>
+
+struct AllocationCount {
+    size_t count;
+    size_t bytes;
+};
+
+void countAllocations(bool on);
+AllocationCount allocationsCounted(); // since the test started
+
+// Allocations made while `fn` runs
+template <typename Fn> AllocationCount allocationsDuring(Fn fn) {
+    AllocationCount before = allocationsCounted();
+    countAllocations(true);
+    fn();
+    countAllocations(false);
+    AllocationCount after = allocationsCounted();
+    return {after.count - before.count, after.bytes - before.bytes};
+}
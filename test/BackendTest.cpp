@@ -0,0 +1,132 @@
+// The CLI and native UDP backends side by side: the same traffic is echoed back by a fake
+// peer through the fake CLI (hex text lines) and through the fake OpenThread socket API,
+// and both must deliver the same payloads. Host CPU per message and bytes crossing each
+// interface are printed for comparison; this is not a measurement of the real stack.
+#include "LightThreadTest.h"
+#include <OThreadCLI.h>
+#include <chrono>
+
+static const Ip6Address kPeer = address("fd00::2");
+static const int kMessages = 2000;
+
+static std::vector<uint8_t> payloadOf(int i) {
+    std::vector<uint8_t> payload(1 + (i * 37) % 100);
+    for(size_t j = 0; j < payload.size(); ++j)
+        payload[j] = static_cast<uint8_t>(i * 7 + j);
+    return payload;
+}
+
+struct Result {
+    std::vector<std::vector<uint8_t>> received;
+    double usPerMessage;
+    size_t interfaceBytes; // written to the CLI, or handed to otUdpSend
+};
+
+// Sends kMessages payloads, running update() after each, and collects what comes back
+static Result run(LightThread &lt) {
+    Result result;
+    lt.registerUdpViewCallback(
+        [&](const Ip6Address &src, bool, const uint8_t *payload, size_t length) {
+            CHECK(src == kPeer);
+            result.received.emplace_back(payload, payload + length);
+        });
+
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < kMessages; ++i) {
+        CHECK(lt.sendUdp(kPeer, false, payloadOf(i)) == SendStatus::OK);
+        lt.update();
+    }
+    lt.update();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    result.usPerMessage =
+        std::chrono::duration<double, std::micro>(elapsed).count() / kMessages;
+    return result;
+}
+
+static void checkEchoed(const Result &result) {
+    CHECK(result.received.size() == static_cast<size_t>(kMessages));
+    for(size_t i = 0; i < result.received.size(); ++i)
+        CHECK(result.received[i] == payloadOf(i));
+}
+
+static Result cliResult, nativeResult;
+
+static void testCliBackendEcho() {
+    LightThread lt;
+    LightThreadTest::useBackend(lt, UdpBackend::CLI);
+
+    // The peer answers "udp send <ip> <port> <hex>" with Done, then echoes the datagram
+    size_t written = 0;
+    OThreadCLI.reset();
+    OThreadCLI.setLineHandler([&](const std::string &line) {
+        written += line.size() + 2;
+        char ip[64], hex[1024];
+        unsigned port;
+        if(sscanf(line.c_str(), "udp send %63s %u %1023s", ip, &port, hex) != 3)
+            return;
+        OThreadCLI.feed("Done\r\n" + std::to_string(strlen(hex) / 2) + " bytes from " + ip +
+                        " 12345 " + hex + "\r\n");
+    });
+
+    cliResult = run(lt);
+    cliResult.interfaceBytes = written;
+    checkEchoed(cliResult);
+    OThreadCLI.reset();
+}
+
+static void testNativeBackendEcho() {
+    LightThread lt;
+    LightThreadTest::useBackend(lt, UdpBackend::NATIVE);
+
+    size_t sent = 0;
+    host::setSendHandler([&](const host::Datagram &datagram) {
+        CHECK(Ip6Address::fromOt(datagram.peer) == kPeer);
+        CHECK(datagram.port == LT_UDP_PORT);
+        sent += datagram.data.size();
+        host::deliver(LightThreadTest::socket(lt), datagram.peer, datagram.data.data(),
+                      datagram.data.size());
+    });
+
+    nativeResult = run(lt);
+    nativeResult.interfaceBytes = sent;
+    checkEchoed(nativeResult);
+    host::setSendHandler(nullptr);
+
+    // Hex doubles the payload, and the command text comes on top
+    CHECK(cliResult.interfaceBytes > 2 * nativeResult.interfaceBytes);
+    printf("  CLI:    %6.2f us/message, %zu bytes written to the CLI\n", cliResult.usPerMessage,
+           cliResult.interfaceBytes);
+    printf("  native: %6.2f us/message, %zu bytes handed to otUdpSend\n",
+           nativeResult.usPerMessage, nativeResult.interfaceBytes);
+}
+
+// Datagrams arriving faster than update() drains them are dropped once the ring is full,
+// never overwritten
+static void testNativeRingOverflow() {
+    LightThread lt;
+    LightThreadTest::useBackend(lt, UdpBackend::NATIVE);
+
+    std::vector<uint8_t> order;
+    lt.registerUdpViewCallback([&](const Ip6Address &, bool, const uint8_t *payload, size_t) {
+        order.push_back(payload[0]);
+    });
+
+    otIp6Address peer = kPeer.toOt();
+    for(uint8_t i = 0; i < LT_NATIVE_RX_SLOTS + 2; ++i) {
+        uint8_t frame[] = {AckType::NONE, MessageType::NORMAL, i};
+        host::deliver(LightThreadTest::socket(lt), peer, frame, sizeof(frame));
+    }
+    lt.update();
+
+    // One slot stays empty to tell a full ring from an empty one
+    REQUIRE(order.size() == LT_NATIVE_RX_SLOTS - 1);
+    for(size_t i = 0; i < order.size(); ++i)
+        CHECK(order[i] == i);
+}
+
+int main() {
+    RUN_TEST(testCliBackendEcho);
+    RUN_TEST(testNativeBackendEcho);
+    RUN_TEST(testNativeRingOverflow);
+    return testResult();
+}
@@ -0,0 +1,224 @@
+// Liveness beacons, with a registry built for 512 joiners. The Bloom filter of a beacon
+// round lists every joiner heard recently and, at 8 bits per joiner and 3 hashes, about 3%
+// of the rest; since bit positions are salted per round, an ID falsely listed once is
+// rarely listed again in the next. A joiner listed by its leader counts it as an echo, and
+// a new epoch makes it send a heartbeat at once. Then a leader and 20, 100 and 300 joiners
+// on TestMesh for a simulated minute in each mode: frames per minute, in all and from the
+// leader.
+#include "LightThreadTest.h"
+#include <random>
+
+static_assert(LT_MAX_JOINERS >= 300, "built with the large registry");
+
+static const Ip6Address kLeader = address("fd00::1000");
+
+static std::vector<uint8_t> heartbeatFrame(uint64_t id) {
+    std::vector<uint8_t> frame = {AckType::NONE, MessageType::HEARTBEAT};
+    for(int i = 7; i >= 0; --i)
+        frame.push_back(static_cast<uint8_t>(id >> (i * 8)));
+    return frame;
+}
+
+static bool isBeacon(const host::Datagram &datagram) {
+    return datagram.data.size() >= 2 && datagram.data[1] == MessageType::BEACON;
+}
+
+// The payloads of one beacon round
+using Round = std::vector<std::vector<uint8_t>>;
+
+static bool listed(const Round &round, uint64_t id) {
+    for(const std::vector<uint8_t> &payload : round) {
+        if(LightThreadTest::beaconLists(payload.data(), payload.size(), id))
+            return true;
+    }
+    return false;
+}
+
+// A leader in beacon mode with `members` registered by heartbeat; each round refreshes
+// them all but the last, which falls silent after the first round
+static void falsePositives(size_t members) {
+    const int kRounds = 20;
+    const size_t kProbes = 20000;
+    host::useSimulatedClock();
+    std::vector<host::Datagram> sent;
+    host::setSendHandler([&](const host::Datagram &datagram) { sent.push_back(datagram); });
+    LightThread leader;
+    LightThreadTest::useBackend(leader, UdpBackend::NATIVE);
+    LightThreadTest::makeLeader(leader);
+    leader.setLivenessMode(LivenessMode::BEACON);
+
+    std::mt19937_64 rng(16 + members);
+    std::vector<uint64_t> ids(members), probes(kProbes);
+    for(uint64_t &id : ids)
+        id = rng() | 1;
+    for(uint64_t &id : probes)
+        id = rng() | 1;
+
+    std::vector<bool> wasListed(kProbes, false);
+    size_t falseNegatives = 0, falsePositives = 0, repeated = 0, silentListed = 0;
+    size_t parts = 0, bytes = 0;
+    for(int r = 0; r < kRounds; ++r) {
+        for(size_t i = 0; i < members; ++i) {
+            if(i + 1 < members || r == 0) {
+                std::vector<uint8_t> frame = heartbeatFrame(ids[i]);
+                LightThreadTest::receive(leader, address("fd00::1"), frame.data(), frame.size());
+            }
+        }
+        sent.clear();
+        host::advance(LT_BEACON_INTERVAL);
+        leader.update();
+
+        Round round;
+        for(const host::Datagram &datagram : sent) {
+            CHECK(isBeacon(datagram));
+            CHECK(Ip6Address::fromOt(datagram.peer) == Ip6Address::realmLocalAllNodes());
+            round.emplace_back(datagram.data.begin() + 2, datagram.data.end());
+            bytes += datagram.data.size();
+        }
+        REQUIRE(!round.empty());
+        parts = round.size();
+
+        for(size_t i = 0; i + 1 < members; ++i)
+            falseNegatives += !listed(round, ids[i]);
+        // Heard from two intervals ago; from the third round on it is no longer listed
+        if(r >= 2)
+            silentListed += listed(round, ids.back());
+        for(size_t p = 0; p < kProbes; ++p) {
+            bool now = listed(round, probes[p]);
+            falsePositives += now;
+            repeated += now && wasListed[p];
+            wasListed[p] = now;
+        }
+    }
+    host::setSendHandler(nullptr);
+
+    double fpRate = 100.0 * falsePositives / (kProbes * kRounds);
+    double repeatRate = 100.0 * repeated / (kProbes * (kRounds - 1));
+    printf("  %7zu  %5zu  %6zu B  %5.2f%%  %6.3f%%  %zu of %d\n", members, parts,
+           bytes / kRounds, fpRate, repeatRate, silentListed, kRounds - 2);
+    CHECK(falseNegatives == 0);
+    CHECK(fpRate < 5);
+    CHECK(repeatRate < fpRate * fpRate / 100 * 3 + 0.05);
+    CHECK(silentListed <= 3);
+    // A byte per joiner, in parts of what fits the MTU after the headers
+    CHECK(parts == (members + LT_DEFAULT_MTU - 9) / (LT_DEFAULT_MTU - 8));
+}
+
+static void testFalsePositives() {
+    printf("  members  parts  bytes    false+  repeated  silent listed\n");
+    for(size_t members : {1, 20, 100, 300})
+        falsePositives(members);
+}
+
+// A joiner takes a beacon listing it for an echo, but only from its own leader; a beacon
+// with a new epoch makes its next heartbeat due at once
+static void testJoinerSide() {
+    host::useSimulatedClock();
+    std::vector<host::Datagram> sent;
+    host::setSendHandler([&](const host::Datagram &datagram) { sent.push_back(datagram); });
+    host::setIdentity(address("fd00::1").toOt());
+    LightThread joiner;
+    LightThreadTest::useBackend(joiner, UdpBackend::NATIVE);
+    LightThreadTest::makePairedJoiner(joiner, kLeader);
+    uint64_t self = LightThreadTest::macHash(joiner);
+    joiner.update(); // first heartbeat
+    LightThreadTest::setHeartbeatTimes(joiner, millis(), millis());
+    host::advance(1000);
+
+    // [epoch:16][seq:16][part:8][parts:8], then a one-joiner filter built by a leader
+    host::setIdentity(kLeader.toOt());
+    LightThread leader;
+    LightThreadTest::useBackend(leader, UdpBackend::NATIVE);
+    LightThreadTest::makeLeader(leader);
+    leader.setLivenessMode(LivenessMode::BEACON);
+    std::vector<uint8_t> heartbeat = heartbeatFrame(self);
+    LightThreadTest::receive(leader, address("fd00::1"), heartbeat.data(), heartbeat.size());
+    sent.clear();
+    leader.update();
+    REQUIRE(sent.size() == 1 && isBeacon(sent[0]));
+    std::vector<uint8_t> beacon = sent[0].data;
+    CHECK(LightThreadTest::beaconLists(beacon.data() + 2, beacon.size() - 2, self));
+
+    host::setIdentity(address("fd00::1").toOt());
+    LightThreadTest::receive(joiner, address("fd00::2000"), beacon.data(), beacon.size());
+    CHECK(LightThreadTest::lastHeartbeatEcho(joiner) == millis() - 1000);
+
+    sent.clear();
+    LightThreadTest::receive(joiner, kLeader, beacon.data(), beacon.size());
+    CHECK(LightThreadTest::lastHeartbeatEcho(joiner) == millis());
+    // The epoch was new to the joiner: its next heartbeat goes out without waiting 5 s
+    joiner.update();
+    REQUIRE(sent.size() == 1);
+    CHECK(sent[0].data[1] == MessageType::HEARTBEAT);
+
+    // Not listed: nothing changes
+    host::advance(1000);
+    for(size_t i = 2 + 6; i < beacon.size(); ++i)
+        beacon[i] = 0;
+    LightThreadTest::receive(joiner, kLeader, beacon.data(), beacon.size());
+    CHECK(LightThreadTest::lastHeartbeatEcho(joiner) == millis() - 1000);
+    host::setSendHandler(nullptr);
+}
+
+struct FrameCount {
+    size_t total;
+    size_t fromLeader;
+    size_t reconnects;
+};
+
+// A leader and `joinerCount` paired joiners; frames counted over one minute after the
+// first heartbeats have registered everyone
+static FrameCount framesPerMinute(size_t joinerCount, LivenessMode mode) {
+    TestMesh mesh;
+    LightThread leader;
+    std::vector<LightThread> joiners(joinerCount);
+    mesh.add(leader, "fd00::1000");
+    LightThreadTest::makeLeader(leader);
+    leader.setLogLevel(LT_LOG_WARN);
+    leader.setLivenessMode(mode);
+    for(size_t i = 0; i < joinerCount; ++i) {
+        std::string ip = "fd00::" + std::to_string(i + 1);
+        size_t node = mesh.add(joiners[i], ip.c_str());
+        LightThreadTest::makePairedJoiner(mesh.as(node), mesh.addressOf(0));
+        joiners[i].setLogLevel(LT_LOG_WARN);
+    }
+    mesh.run(LT_BEACON_INTERVAL);
+    CHECK(leader.joinerCount() == joinerCount);
+
+    FrameCount count = {};
+    mesh.drop = [&](const host::Datagram &datagram, size_t from, size_t to) {
+        // A multicast is one frame on air however many receive it
+        if(!Ip6Address::fromOt(datagram.peer).isMulticast() || to == (from == 0 ? 1 : 0)) {
+            count.total++;
+            count.fromLeader += from == 0;
+            count.reconnects += datagram.data[1] == MessageType::RECONNECT;
+        }
+        return false;
+    };
+    mesh.run(60000);
+    for(LightThread &joiner : joiners)
+        CHECK(joiner.inState(State::JOINER_PAIRED));
+    return count;
+}
+
+static void testFramesPerMinute() {
+    printf("  joiners  echo total (leader)  beacon total (leader)\n");
+    for(size_t joiners : {20, 100, 300}) {
+        FrameCount echo = framesPerMinute(joiners, LivenessMode::ECHO);
+        FrameCount beacon = framesPerMinute(joiners, LivenessMode::BEACON);
+        printf("  %7zu  %10zu (%5zu)  %12zu (%5zu)\n", joiners, echo.total, echo.fromLeader,
+               beacon.total, beacon.fromLeader);
+        CHECK(echo.reconnects == 0 && beacon.reconnects == 0);
+        // A heartbeat per joiner every 5 s, then an echo each, or a beacon round
+        CHECK(echo.fromLeader + joiners >= echo.total / 2);
+        CHECK(beacon.total < echo.total * 6 / 10);
+        CHECK(beacon.fromLeader <= 12 * ((joiners + LT_DEFAULT_MTU - 9) / (LT_DEFAULT_MTU - 8)));
+    }
+}
+
+int main() {
+    RUN_TEST(testFalsePositives);
+    RUN_TEST(testJoinerSide);
+    RUN_TEST(testFramesPerMinute);
+    return testResult();
+}
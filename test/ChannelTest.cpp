@@ -0,0 +1,182 @@
+// Channels over the one UDP port, between two nodes on TestMesh: a payload sent to a channel
+// reaches that channel's receive callback and no other, and the outcome of a reliable send
+// is reported to the status callback of its channel only. Each channel has its own reliable
+// stream, so with in-order delivery a loss on one channel does not hold up another. Then
+// the time handleUdpPacket() takes to deliver a frame with 1 and with 16 channels
+// registered.
+#include "LightThreadTest.h"
+#include <chrono>
+
+struct Pair {
+    TestMesh mesh;
+    LightThread a, b;
+    size_t nodeA, nodeB;
+
+    Pair() {
+        nodeA = mesh.add(a, "fd00::a");
+        nodeB = mesh.add(b, "fd00::b");
+    }
+
+    // Waits out QUEUE_FULL, as an application would
+    SendStatus send(uint8_t channel, bool reliable, const std::vector<uint8_t> &payload) {
+        SendStatus status;
+        while((status = mesh.as(nodeA).sendUdp(mesh.addressOf(nodeB), channel, reliable,
+                                               payload)) == SendStatus::QUEUE_FULL)
+            mesh.step();
+        return status;
+    }
+};
+
+// [channel][index], then filler up to `length`
+static std::vector<uint8_t> tagged(uint8_t channel, uint8_t index, size_t length = 8) {
+    std::vector<uint8_t> payload(length, static_cast<uint8_t>(channel * 16 + index));
+    payload[0] = channel;
+    payload[1] = index;
+    return payload;
+}
+
+static void testCallbackIsolation() {
+    Pair p;
+    std::vector<std::vector<std::vector<uint8_t>>> received(LT_CHANNELS);
+    std::vector<std::vector<uint16_t>> reported(LT_CHANNELS);
+    for(uint8_t channel = 0; channel < LT_CHANNELS; ++channel) {
+        CHECK(p.b.registerChannel(channel, [&received, channel](const Ip6Address &src, bool,
+                                                                const std::vector<uint8_t> &data) {
+            CHECK(src == address("fd00::a"));
+            received[channel].push_back(data);
+        }));
+        CHECK(p.a.registerChannel(channel, nullptr,
+                                  [&reported, channel](uint16_t id, const Ip6Address &, bool ok) {
+                                      CHECK(ok);
+                                      reported[channel].push_back(id);
+                                  }));
+    }
+    CHECK(!p.b.registerChannel(LT_CHANNELS, nullptr));
+
+    // Two unreliable and one reliable payload per channel, and one too large for a frame.
+    // Stream state for each channel to b takes an entry of the peer table.
+    for(uint8_t channel = 0; channel < LT_CHANNELS; ++channel) {
+        CHECK(p.send(channel, false, tagged(channel, 0)) == SendStatus::OK);
+        CHECK(p.send(channel, true, tagged(channel, 1)) == SendStatus::OK);
+        CHECK(p.send(channel, false, tagged(channel, 2)) == SendStatus::OK);
+    }
+    CHECK(p.send(5, true, tagged(5, 3, 300)) == SendStatus::OK);
+    CHECK(p.send(LT_CHANNELS, false, tagged(0, 0)) != SendStatus::OK);
+    p.mesh.runUntil([&] { return p.a.freeReliableSlots() == LT_RELIABLE_SLOTS; }, 5000);
+
+    for(uint8_t channel = 0; channel < LT_CHANNELS; ++channel) {
+        std::vector<std::vector<uint8_t>> expected = {tagged(channel, 0), tagged(channel, 1),
+                                                      tagged(channel, 2)};
+        if(channel == 5)
+            expected.push_back(tagged(5, 3, 300));
+        std::sort(received[channel].begin(), received[channel].end());
+        CHECK(received[channel] == expected);
+        CHECK(reported[channel].size() == (channel == 5 ? 2u : 1u));
+    }
+}
+
+// Two streams of reliable sends, every 150 ms each, with in-order delivery; the first copy
+// of stream 0's first message is lost. Returns the worst latency of stream 1. The slot pool
+// and the reorder slots are shared, so the interval leaves room in both for what stream 0
+// holds until the retransmission.
+static unsigned long otherStreamWorstMs(uint8_t channel0, uint8_t channel1) {
+    const int kMessages = 20;
+    Pair p;
+    p.b.setReliableInOrder(true);
+    p.a.setReliableInOrder(true);
+    bool lost = false;
+    p.mesh.drop = [&](const host::Datagram &datagram, size_t from, size_t) {
+        const std::vector<uint8_t> &data = datagram.data;
+        bool first = from == p.nodeA && data[0] == AckType::REQUEST && data.size() >= 6 &&
+                     data[data.size() - 6] == 0 && data[data.size() - 5] == 0;
+        if(first && !lost)
+            return lost = true;
+        return false;
+    };
+
+    // [stream][index][sent at:32]
+    unsigned long worst = 0;
+    size_t delivered = 0;
+    auto onReceive = [&](const Ip6Address &, bool, const std::vector<uint8_t> &data) {
+        delivered++;
+        uint32_t sentAt;
+        memcpy(&sentAt, data.data() + 2, sizeof(sentAt));
+        if(data[0] == 1)
+            worst = std::max(worst, millis() - sentAt);
+    };
+    p.b.registerChannel(channel0, onReceive);
+    p.b.registerChannel(channel1, onReceive);
+
+    for(int i = 0; i < kMessages; ++i) {
+        for(uint8_t stream : {0, 1}) {
+            std::vector<uint8_t> payload = {stream, static_cast<uint8_t>(i), 0, 0, 0, 0};
+            uint32_t now = millis();
+            memcpy(payload.data() + 2, &now, sizeof(now));
+            CHECK(p.send(stream ? channel1 : channel0, true, payload) == SendStatus::OK);
+        }
+        p.mesh.run(150);
+    }
+    CHECK(p.mesh.runUntil([&] { return delivered == 2 * kMessages; }, 10000));
+    CHECK(lost);
+    return worst;
+}
+
+static void testNoHeadOfLineBlocking() {
+    unsigned long shared = otherStreamWorstMs(0, 0);
+    unsigned long separate = otherStreamWorstMs(1, 2);
+    printf("  both streams on channel 0:    other stream worst latency %5lu ms\n", shared);
+    printf("  streams on channels 1 and 2:  other stream worst latency %5lu ms\n", separate);
+    CHECK(shared >= LT_RELIABLE_INITIAL_RTO);
+    CHECK(separate < LT_RELIABLE_MIN_RTO);
+}
+
+// ns per handleUdpPacket() for an unreliable frame to `channel`, with that channel alone or
+// all LT_CHANNELS registered
+static double deliveryNs(uint8_t channel, bool all) {
+    using Clock = std::chrono::steady_clock;
+    const int kFrames = 200000;
+    host::useSimulatedClock();
+    std::vector<uint8_t> frame;
+    host::setSendHandler([&](const host::Datagram &datagram) { frame = datagram.data; });
+    LightThread a, b;
+    LightThreadTest::useBackend(a, UdpBackend::NATIVE);
+    LightThreadTest::useBackend(b, UdpBackend::NATIVE);
+    CHECK(a.sendUdp(address("fd00::b"), channel, false, tagged(channel, 0)) == SendStatus::OK);
+    host::setSendHandler(nullptr);
+    // Two more header bytes off channel 0
+    CHECK(frame.size() == (channel ? 4u : 2u) + 8);
+
+    b.setLogLevel(LT_LOG_NONE);
+    size_t delivered = 0;
+    for(uint8_t c = 0; c < LT_CHANNELS; ++c) {
+        if(!all && c != channel)
+            continue;
+        b.registerChannel(c, [&delivered, c, channel](const Ip6Address &, bool,
+                                                      const std::vector<uint8_t> &) {
+            CHECK(c == channel);
+            delivered++;
+        });
+    }
+    auto start = Clock::now();
+    for(int i = 0; i < kFrames; ++i)
+        LightThreadTest::receive(b, address("fd00::a"), frame.data(), frame.size());
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    CHECK(delivered == kFrames);
+    return ns / kFrames;
+}
+
+static void testDispatchCost() {
+    printf("  channel  registered  ns/frame\n");
+    for(bool all : {false, true}) {
+        for(uint8_t channel : {0, 1, LT_CHANNELS - 1})
+            printf("  %7u  %10d  %8.1f\n", channel, all ? LT_CHANNELS : 1,
+                   deliveryNs(channel, all));
+    }
+}
+
+int main() {
+    RUN_TEST(testCallbackIsolation);
+    RUN_TEST(testNoHeadOfLineBlocking);
+    RUN_TEST(testDispatchCost);
+    return testResult();
+}
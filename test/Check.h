@@ -0,0 +1,39 @@
+// Minimal checks for the host tests. A failed CHECK prints where and carries on; a failed
+// REQUIRE also returns from the test function. main() returns testResult().
+#pragma once
+
+#include <cstdio>
+
+inline int &testFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond)                                                                            \
+    do {                                                                                       \
+        if(!(cond)) {                                                                          \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);           \
+            testFailures()++;                                                                  \
+        }                                                                                      \
+    } while(0)
+
+#define REQUIRE(cond)                                                                          \
+    do {                                                                                       \
+        if(!(cond)) {                                                                          \
+            fprintf(stderr, "%s:%d: REQUIRE(%s) failed\n", __FILE__, __LINE__, #cond);         \
+            testFailures()++;                                                                  \
+            return;                                                                            \
+        }                                                                                      \
+    } while(0)
+
+#define RUN_TEST(fn)                                                                           \
+    do {                                                                                       \
+        int before = testFailures();                                                           \
+        printf("[ RUN  ] %s\n", #fn);                                                          \
+        fflush(stdout);                                                                        \
+        fn();                                                                                  \
+        printf("[ %s ] %s\n", testFailures() == before ? " OK " : "FAIL", #fn);                \
+        fflush(stdout);                                                                        \
+    } while(0)
+
+inline int testResult() { return testFailures() == 0 ? 0 : 1; }
@@ -0,0 +1,169 @@
+// CliLineAssembler: line splitting, UDP line classification and over-long lines, plus heap
+// allocations and lines/s over a stream of mixed CLI output, next to the per-character
+// String assembly it replaced.
+#include "AllocationCounter.h"
+#include "LightThreadTest.h"
+#include <chrono>
+
+// Serves a fixed text, at most `chunk` bytes per readBytes() call
+struct TextStream : Stream {
+    const char *text;
+    size_t length;
+    size_t pos = 0;
+    size_t chunk;
+
+    TextStream(const char *text, size_t length, size_t chunk = SIZE_MAX)
+        : text(text), length(length), chunk(chunk) {}
+
+    size_t write(uint8_t) override { return 0; }
+    int available() override { return static_cast<int>(std::min(length - pos, chunk)); }
+    int read() override { return pos < length ? static_cast<unsigned char>(text[pos++]) : -1; }
+    size_t readBytes(char *buffer, size_t n) override {
+        n = std::min(n, length - pos);
+        memcpy(buffer, text + pos, n);
+        pos += n;
+        return n;
+    }
+};
+
+struct Line {
+    std::string text;
+    bool isUdp;
+};
+
+static std::vector<Line> split(const std::string &text, size_t chunk) {
+    CliLineAssembler assembler;
+    TextStream stream(text.data(), text.size(), chunk);
+    std::vector<Line> lines;
+    CliLine line;
+    while(assembler.fill(stream) > 0) {
+        while(assembler.next(line))
+            lines.push_back({std::string(line.data, line.length), line.isUdp});
+    }
+    return lines;
+}
+
+static void testSplitsAndClassifies() {
+    const std::string text = "Done\r\n"
+                             "\r\n"
+                             "8 bytes from fd00:0:0:0:0:ff:fe00:fc00 12345 0000aabbccdd\r\n"
+                             "child\n"
+                             "bytes from nowhere\r\n"
+                             "12 bytes fromage\r\n"
+                             "Error 7: InvalidArgs\r\n"
+                             "partial";
+
+    // Byte by byte, in odd chunks, and all at once give the same lines
+    for(size_t chunk : {size_t(1), size_t(7), SIZE_MAX}) {
+        std::vector<Line> lines = split(text, chunk);
+        REQUIRE(lines.size() == 6);
+        CHECK(lines[0].text == "Done" && !lines[0].isUdp);
+        CHECK(lines[1].text == "8 bytes from fd00:0:0:0:0:ff:fe00:fc00 12345 0000aabbccdd");
+        CHECK(lines[1].isUdp);
+        CHECK(lines[2].text == "child" && !lines[2].isUdp);
+        CHECK(lines[3].text == "bytes from nowhere" && !lines[3].isUdp);
+        CHECK(lines[4].text == "12 bytes fromage" && !lines[4].isUdp);
+        CHECK(lines[5].text == "Error 7: InvalidArgs");
+    }
+}
+
+// A line that cannot fit the buffer is dropped up to its newline; the next one survives
+static void testOverlongLineDropped() {
+    std::string text = "before\n" + std::string(LT_CLI_RX_BUFFER_SIZE * 2 + 5, 'x') + "\nafter\n";
+    for(size_t chunk : {size_t(100), SIZE_MAX}) {
+        std::vector<Line> lines = split(text, chunk);
+        REQUIRE(lines.size() == 2);
+        CHECK(lines[0].text == "before");
+        CHECK(lines[1].text == "after");
+    }
+
+    // The longest line that fits still comes out whole
+    std::string longest(LT_CLI_RX_BUFFER_SIZE - 1, 'y');
+    std::vector<Line> lines = split("a\n" + longest + "\n", 64);
+    REQUIRE(lines.size() == 2);
+    CHECK(lines[1].text == longest);
+}
+
+// The assembly CliLineAssembler replaced (processCLIChar): a String grown per character,
+// copied out per line and searched twice to classify it. The host String is a std::string
+// that keeps its capacity, so its allocation count here understates the Arduino String's.
+static bool processCliChar(char c, bool &isUdp, String &lineOut) {
+    static String buffer = "";
+    if(c == '\r' || c == '\n') {
+        if(buffer.length() == 0)
+            return false;
+        lineOut = buffer;
+        buffer = "";
+        isUdp = lineOut.indexOf("bytes from") != -1 && lineOut.indexOf("12345") != -1;
+        return true;
+    }
+    buffer += c;
+    return false;
+}
+
+struct Rate {
+    size_t lines = 0;
+    size_t udpLines = 0;
+    size_t allocations = 0;
+    double seconds = 0;
+};
+
+template <typename Pass> static Rate measure(int passes, Pass pass) {
+    Rate rate;
+    auto start = std::chrono::steady_clock::now();
+    rate.allocations = allocationsDuring([&] {
+                           for(int i = 0; i < passes; ++i)
+                               pass(rate);
+                       }).count;
+    rate.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return rate;
+}
+
+static void testNoAllocationsPerLine() {
+    std::string text;
+    for(int i = 0; i < 1000; ++i) {
+        text += "64 bytes from fd00::" + std::to_string(i) + " 12345 " + std::string(128, 'a') +
+                "\r\nDone\r\n";
+    }
+    const size_t kLinesPerPass = 2000;
+    const int kPasses = 200;
+
+    CliLineAssembler assembler;
+    Rate assembled = measure(kPasses, [&](Rate &rate) {
+        TextStream stream(text.data(), text.size());
+        CliLine line;
+        while(assembler.fill(stream) > 0) {
+            while(assembler.next(line)) {
+                rate.lines++;
+                rate.udpLines += line.isUdp;
+            }
+        }
+    });
+    Rate perChar = measure(kPasses, [&](Rate &rate) {
+        TextStream stream(text.data(), text.size());
+        String line;
+        bool isUdp;
+        for(int c; (c = stream.read()) >= 0;) {
+            if(processCliChar(static_cast<char>(c), isUdp, line)) {
+                rate.lines++;
+                rate.udpLines += isUdp;
+            }
+        }
+    });
+
+    CHECK(assembled.lines == kLinesPerPass * kPasses);
+    CHECK(assembled.udpLines == assembled.lines / 2);
+    CHECK(assembled.allocations == 0);
+    CHECK(perChar.lines == assembled.lines && perChar.udpLines == assembled.udpLines);
+    for(auto [name, rate] : {std::make_pair("assembler", assembled), {"per-char", perChar}}) {
+        printf("  %-9s %6.1f M lines/s, %.2f heap allocations/line\n", name,
+               rate.lines / rate.seconds / 1e6, double(rate.allocations) / rate.lines);
+    }
+}
+
+int main() {
+    RUN_TEST(testSplitsAndClassifies);
+    RUN_TEST(testOverlongLineDropped);
+    RUN_TEST(testNoAllocationsPerLine);
+    return testResult();
+}
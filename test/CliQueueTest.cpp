@@ -0,0 +1,306 @@
+// The asynchronous CLI command queue against a scripted CLI: replies go to the command
+// they answer even when "udp send" lines of the CLI backend, which answer with a Done of
+// their own, are written between commands, and update() never waits for the CLI.
+#include "LightThreadTest.h"
+#include <OThreadCLI.h>
+#include <chrono>
+#include <deque>
+#include <map>
+
+static const Ip6Address kPeer = address("fd00::2");
+
+// Answers every line written, in order: "udp send" with Done, a scripted command with its
+// output and Done, or with its error line, anything else with Done. Answers are held until
+// release(), so a test can interleave them with further writes.
+struct ScriptedCli {
+    std::map<std::string, std::string> output;
+    std::map<std::string, std::string> errors;
+    std::deque<std::string> pending;
+    std::vector<std::string> written;
+    std::string udpReply = "Done";
+
+    ScriptedCli() {
+        OThreadCLI.reset();
+        OThreadCLI.setLineHandler([this](const std::string &line) {
+            std::string reply;
+            written.push_back(line);
+            if(line.compare(0, 9, "udp send ") == 0) {
+                reply = udpReply + "\r\n";
+            } else {
+                auto it = output.find(line);
+                auto error = errors.find(line);
+                reply = (it != output.end() ? it->second + "\r\n" : "") +
+                        (error != errors.end() ? error->second : "Done") + "\r\n";
+            }
+            pending.push_back(reply);
+        });
+    }
+
+    ~ScriptedCli() { OThreadCLI.reset(); }
+
+    void release() {
+        for(const std::string &reply : pending)
+            OThreadCLI.feed(reply);
+        pending.clear();
+    }
+};
+
+struct Reply {
+    bool called = false;
+    bool ok = false;
+    std::string response;
+};
+
+static std::function<void(bool, const String &)> into(Reply &reply) {
+    return [&reply](bool ok, const String &response) {
+        reply.called = true;
+        reply.ok = ok;
+        reply.response = response.c_str();
+    };
+}
+
+static void sendDatagram(LightThread &lt) {
+    CHECK(lt.sendUdp(kPeer, false, std::vector<uint8_t>{1, 2, 3}) == SendStatus::OK);
+}
+
+static void testUdpSendBeforeCommand() {
+    ScriptedCli cli;
+    cli.output["state"] = "child";
+    LightThread lt;
+    LightThreadTest::useBackend(lt, UdpBackend::CLI);
+    lt.update();
+
+    Reply state;
+    sendDatagram(lt);
+    LightThreadTest::execAsync(lt, "state", into(state));
+    lt.update();
+    cli.release();
+    lt.update();
+
+    CHECK(state.called && state.ok);
+    CHECK(state.response == "child\nDone\n");
+}
+
+static void testUdpSendsBetweenCommands() {
+    ScriptedCli cli;
+    cli.output["state"] = "child";
+    cli.output["mode"] = "rdn";
+    LightThread lt;
+    LightThreadTest::useBackend(lt, UdpBackend::CLI);
+    lt.update();
+
+    Reply state, mode;
+    LightThreadTest::execAsync(lt, "state", into(state));
+    lt.update();
+    sendDatagram(lt);
+    sendDatagram(lt);
+    LightThreadTest::execAsync(lt, "mode", into(mode));
+    lt.update();
+    sendDatagram(lt);
+    cli.release();
+    lt.update();
+
+    CHECK(state.called && state.response == "child\nDone\n");
+    CHECK(mode.called && mode.response == "rdn\nDone\n");
+
+    // The trailing udp send's reply is gone too, not waiting for the next command
+    Reply again;
+    LightThreadTest::execAsync(lt, "mode", into(again));
+    lt.update();
+    cli.release();
+    lt.update();
+    CHECK(again.called && again.response == "rdn\nDone\n");
+}
+
+// A failed udp send must not fail the command behind it
+static void testUdpSendError() {
+    ScriptedCli cli;
+    cli.udpReply = "Error 7: InvalidArgs";
+    cli.output["state"] = "child";
+    LightThread lt;
+    LightThreadTest::useBackend(lt, UdpBackend::CLI);
+    lt.update();
+
+    Reply state;
+    sendDatagram(lt);
+    LightThreadTest::execAsync(lt, "state", into(state));
+    lt.update();
+    cli.release();
+    lt.update();
+
+    CHECK(state.called && state.ok && state.response == "child\nDone\n");
+}
+
+// Only a line that is exactly "Done", or starts "Error <n>:", ends a command's output
+static void testTerminatorLinesOnly() {
+    ScriptedCli cli;
+    cli.output["joiner state"] = "Done joining\r\nError count 0";
+    LightThread lt;
+    LightThreadTest::useBackend(lt, UdpBackend::CLI);
+    lt.update();
+
+    Reply state;
+    LightThreadTest::execAsync(lt, "joiner state", into(state));
+    lt.update();
+    cli.release();
+    lt.update();
+
+    CHECK(state.called && state.ok);
+    CHECK(state.response == "Done joining\nError count 0\nDone\n");
+}
+
+// Steps the leader bootstrap through the scripted CLI, answering one command per update()
+static void runBootstrap(ScriptedCli &cli, LightThread &lt) {
+    LightThreadTest::bootstrapLeaderNetwork(lt);
+    for(int i = 0; i < 20; ++i) {
+        lt.update();
+        cli.release();
+    }
+}
+
+// The leader's commands go out one at a time and it waits for the network once all are done
+static void testLeaderBootstrap() {
+    ScriptedCli cli;
+    LightThread lt;
+    LightThreadTest::useBackend(lt, UdpBackend::CLI);
+    runBootstrap(cli, lt);
+
+    CHECK(lt.inState(State::LEADER_WAIT_NETWORK));
+    REQUIRE(cli.written.size() >= 8);
+    CHECK(cli.written[0] == "dataset init new");
+    CHECK(cli.written[5] == "dataset commit active");
+    CHECK(cli.written[7] == "thread start");
+}
+
+// A rejected dataset stops the bootstrap in ERROR; Thread is never started on it
+static void testLeaderBootstrapError() {
+    ScriptedCli cli;
+    cli.errors["dataset commit active"] = "Error 7: InvalidArgs";
+    LightThread lt;
+    LightThreadTest::useBackend(lt, UdpBackend::CLI);
+    runBootstrap(cli, lt);
+
+    CHECK(lt.inState(State::ERROR));
+    CHECK(cli.written.back() == "dataset commit active");
+    CHECK(std::count(cli.written.begin(), cli.written.end(), "ifconfig up") == 0);
+    CHECK(std::count(cli.written.begin(), cli.written.end(), "thread start") == 0);
+}
+
+// The late reply of a timed-out command, and those of udp sends written before it, are
+// skipped; the next command still gets its own
+static void testTimeoutWithUdpSendsAhead() {
+    host::useSimulatedClock();
+    ScriptedCli cli;
+    cli.output["state"] = "child";
+    cli.output["mode"] = "rdn";
+    LightThread lt;
+    LightThreadTest::useBackend(lt, UdpBackend::CLI);
+    lt.update();
+
+    Reply state, mode;
+    sendDatagram(lt);
+    LightThreadTest::execAsync(lt, "state", into(state), 100);
+    lt.update();
+    host::advance(150);
+    lt.update();
+    CHECK(state.called && !state.ok);
+
+    sendDatagram(lt);
+    LightThreadTest::execAsync(lt, "mode", into(mode));
+    lt.update();
+    cli.release();
+    lt.update();
+    CHECK(mode.called && mode.ok && mode.response == "rdn\nDone\n");
+}
+
+// A paired joiner's "state" poll falls due with a heartbeat, so the heartbeat's udp send
+// is written just ahead of the poll. Seeing "child", the joiner checks its mode and
+// escalates to rdn; with the poll answered by the udp send's Done it would not.
+static void testPairedPollBehindHeartbeat() {
+    host::useSimulatedClock(10000);
+    ScriptedCli cli;
+    cli.output["state"] = "child";
+    cli.output["mode"] = "rn";
+    LightThread lt;
+    LightThreadTest::useBackend(lt, UdpBackend::CLI);
+    LightThreadTest::setLeader(lt, kPeer);
+    LightThreadTest::setHeartbeatTimes(lt, 10000, 10000);
+    LightThreadTest::enterState(lt, Role::JOINER, State::JOINER_PAIRED);
+    lt.update(); // the poll is now due 5 s after 10000
+    host::advance(10);
+    LightThreadTest::setHeartbeatTimes(lt, 10010, 10000); // and the heartbeat with it
+
+    for(int i = 0; i < 600; ++i) {
+        lt.update();
+        cli.release();
+        host::advance(10);
+    }
+    CHECK(std::count(cli.written.begin(), cli.written.end(), "mode rdn") == 1);
+}
+
+// However long the CLI takes, update() only writes commands and reads what has arrived
+static void testUpdateNeverWaitsForCli() {
+    host::useSimulatedClock();
+    ScriptedCli cli; // never released: the CLI stays silent
+    LightThread lt;
+    LightThreadTest::useBackend(lt, UdpBackend::CLI);
+    lt.update();
+
+    const int kCommands = 16;
+    int failed = 0;
+    for(int i = 0; i < kCommands; ++i)
+        LightThreadTest::execAsync(
+            lt, "dataset init new", [&](bool ok, const String &) { failed += !ok; }, 1000);
+
+    double worstUs = 0;
+    for(int i = 0; i < 5000 && failed < kCommands; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        lt.update();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        worstUs = std::max(worstUs, std::chrono::duration<double, std::micro>(elapsed).count());
+        host::advance(5);
+    }
+
+    CHECK(failed == kCommands);
+    CHECK(worstUs < 5000);
+    printf("  worst update() with %d commands timing out: %.1f us\n", kCommands, worstUs);
+}
+
+// On the native backend the joiner opens its socket once "ifconfig up" has answered, not
+// while the commands ahead of it are still queued
+static void testJoinerSocketAfterIfconfigUp() {
+    ScriptedCli cli;
+    LightThread lt;
+    LightThreadTest::useBackend(lt, UdpBackend::NATIVE, false);
+    otUdpSocket &socket = LightThreadTest::socket(lt);
+    otIp6Address peer = kPeer.toOt();
+    uint8_t frame[] = {AckType::NONE, MessageType::NORMAL, 1};
+
+    LightThreadTest::setupJoinerThreadDefaults(lt);
+    for(int i = 0; i < 20; ++i) {
+        lt.update();
+        if(std::count(cli.written.begin(), cli.written.end(), "ifconfig up"))
+            break;
+        cli.release();
+    }
+    REQUIRE(std::count(cli.written.begin(), cli.written.end(), "ifconfig up") == 1);
+    CHECK(!host::deliver(socket, peer, frame, sizeof(frame)));
+
+    cli.release();
+    lt.update();
+    CHECK(host::deliver(socket, peer, frame, sizeof(frame)));
+}
+
+int main() {
+    RUN_TEST(testUdpSendBeforeCommand);
+    RUN_TEST(testUdpSendsBetweenCommands);
+    RUN_TEST(testUdpSendError);
+    RUN_TEST(testTerminatorLinesOnly);
+    RUN_TEST(testLeaderBootstrap);
+    RUN_TEST(testLeaderBootstrapError);
+    RUN_TEST(testTimeoutWithUdpSendsAhead);
+    RUN_TEST(testPairedPollBehindHeartbeat);
+    RUN_TEST(testUpdateNeverWaitsForCli);
+    RUN_TEST(testJoinerSocketAfterIfconfigUp);
+    return testResult();
+}
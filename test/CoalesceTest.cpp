@@ -0,0 +1,231 @@
+// Coalescing of small unreliable sends between two nodes on TestMesh: a batch is packed,
+// sent as one BATCH datagram and unpacked into its records, once each and in order; it
+// goes out when its window has passed, when flush() is called, when the flush threshold is
+// reached, or ahead of a send too large to join it. Then one sender's 4-20 byte readings
+// over 10 s at several rates and windows: frames/s, payload efficiency and the latency the
+// window adds. "eff" is payload bytes over frame bytes; the second figure adds an assumed
+// 25 B per frame of MAC and 6LoWPAN overhead.
+#include "LightThreadTest.h"
+#include <random>
+
+static const size_t kMacOverhead = 25;
+
+struct Pair {
+    TestMesh mesh;
+    LightThread a, b;
+    size_t nodeA, nodeB;
+    std::vector<host::Datagram> frames; // as sent by a
+    std::vector<std::vector<uint8_t>> records; // as delivered to b
+    std::vector<unsigned long> deliveredAt;
+
+    Pair() {
+        nodeA = mesh.add(a, "fd00::a");
+        nodeB = mesh.add(b, "fd00::b");
+        mesh.drop = [this](const host::Datagram &datagram, size_t from, size_t) {
+            if(from == nodeA)
+                frames.push_back(datagram);
+            return false;
+        };
+        b.registerUdpViewCallback([this](const Ip6Address &, bool, const uint8_t *data,
+                                         size_t length) {
+            records.emplace_back(data, data + length);
+            deliveredAt.push_back(millis());
+        });
+    }
+
+    SendStatus send(const std::vector<uint8_t> &payload) {
+        return mesh.as(nodeA).sendUdp(mesh.addressOf(nodeB), false, payload);
+    }
+};
+
+static std::vector<uint8_t> reading(int i, size_t length) {
+    std::vector<uint8_t> payload(length);
+    for(size_t j = 0; j < length; ++j)
+        payload[j] = static_cast<uint8_t>(i * 7 + j);
+    return payload;
+}
+
+static void testBatchRoundTrip() {
+    Pair p;
+    p.a.setUdpCoalescing(50);
+    std::vector<std::vector<uint8_t>> sent;
+    for(int i = 0; i < 10; ++i) {
+        sent.push_back(reading(i, 4 + i));
+        CHECK(p.send(sent.back()) == SendStatus::OK);
+    }
+    p.mesh.run(60);
+
+    REQUIRE(p.frames.size() == 1);
+    CHECK(p.frames[0].data[0] == AckType::NONE);
+    CHECK(p.frames[0].data[1] == MessageType::BATCH);
+    CHECK(p.records == sent);
+    CHECK(p.a.getStats().batchesSent == 1);
+    CHECK(p.a.getStats().recordsBatched == 10);
+}
+
+static void testFlushTimer() {
+    const unsigned long kWindow = 50;
+    Pair p;
+    p.a.setUdpCoalescing(kWindow);
+    unsigned long start = millis();
+    CHECK(p.send(reading(0, 8)) == SendStatus::OK);
+    CHECK(p.send(reading(1, 8)) == SendStatus::OK);
+
+    // Held for the window from the first record, not the last
+    p.mesh.run(kWindow / 2);
+    CHECK(p.send(reading(2, 8)) == SendStatus::OK);
+    CHECK(p.a.msUntilNextDeadline() <= kWindow - kWindow / 2);
+    while(millis() - start < kWindow) {
+        p.mesh.step();
+        if(millis() - start < kWindow)
+            CHECK(p.frames.empty());
+    }
+    p.mesh.run(2);
+    REQUIRE(p.frames.size() == 1);
+    REQUIRE(p.deliveredAt.size() == 3);
+    CHECK(p.deliveredAt[0] - start == kWindow);
+
+    // flush() sends at once; a lone record goes out as a plain NORMAL message
+    CHECK(p.send(reading(3, 8)) == SendStatus::OK);
+    CHECK(p.frames.size() == 1);
+    p.a.flush();
+    p.mesh.step();
+    REQUIRE(p.frames.size() == 2);
+    CHECK(p.frames[1].data[1] == MessageType::NORMAL);
+    CHECK(p.records.size() == 4 && p.records[3] == reading(3, 8));
+    CHECK(p.a.getStats().batchesSent == 1);
+}
+
+static void testFlushBytes() {
+    Pair p;
+    p.a.setUdpCoalescing(1000, 40);
+    // Four 9-byte records make 40 bytes with their length bytes: no room for a fifth
+    for(int i = 0; i < 4; ++i) {
+        CHECK(p.send(reading(i, 9)) == SendStatus::OK);
+        p.mesh.step();
+        CHECK(p.frames.size() == (i == 3 ? 1u : 0u));
+    }
+    REQUIRE(p.frames.size() == 1);
+    CHECK(p.frames[0].data.size() == 2 + 40);
+
+    // A record that does not fit sends the batch ahead of it
+    CHECK(p.send(reading(4, 20)) == SendStatus::OK);
+    CHECK(p.send(reading(5, 20)) == SendStatus::OK);
+    p.mesh.step();
+    CHECK(p.frames.size() == 2);
+    CHECK(p.records.size() == 5);
+    p.mesh.run(1000);
+    CHECK(p.frames.size() == 3);
+    REQUIRE(p.records.size() == 6);
+    for(int i = 0; i < 6; ++i)
+        CHECK(p.records[i] == reading(i, i < 4 ? 9 : 20));
+}
+
+// A send that cannot be coalesced, reliable or too large, is not overtaken by the batch
+static void testBypassKeepsOrder() {
+    Pair p;
+    p.a.setUdpCoalescing(1000);
+    CHECK(p.send(reading(0, 8)) == SendStatus::OK);
+    CHECK(p.send(reading(1, 8)) == SendStatus::OK);
+    CHECK(p.send(reading(2, 300)) == SendStatus::OK);
+    p.mesh.run(5);
+    REQUIRE(p.records.size() == 3);
+    CHECK(p.records[0] == reading(0, 8));
+    CHECK(p.records[2] == reading(2, 300));
+    REQUIRE(p.frames.size() > 2); // the batch, then the fragments
+    CHECK(p.frames[0].data[1] == MessageType::BATCH);
+}
+
+// Records up to a truncated one are delivered; the rest of the batch is dropped
+static void testTruncatedBatch() {
+    Pair p;
+    const uint8_t frame[] = {AckType::NONE, MessageType::BATCH, 2, 0xA1, 0xA2, 1, 0xB1, 9, 0xC1};
+    LightThreadTest::receive(p.b, p.mesh.addressOf(p.nodeA), frame, sizeof(frame));
+    REQUIRE(p.records.size() == 2);
+    CHECK(p.records[0] == std::vector<uint8_t>({0xA1, 0xA2}));
+    CHECK(p.records[1] == std::vector<uint8_t>({0xB1}));
+}
+
+struct Load {
+    double framesPerSecond;
+    double efficiency;
+    double efficiencyOnAir;
+    unsigned long p50LatencyMs;
+};
+
+// One reading of 4-20 bytes every 1000/rate ms for 10 s; each carries its send time
+static Load runLoad(int rate, unsigned long windowMs) {
+    const unsigned long kSeconds = 10;
+    Pair p;
+    p.a.setUdpCoalescing(windowMs);
+    std::mt19937 rng(10);
+    std::vector<std::vector<uint8_t>> sent;
+    size_t payloadBytes = 0;
+
+    unsigned long start = millis();
+    for(int i = 0; i < rate * static_cast<int>(kSeconds); ++i) {
+        unsigned long due = start + i * 1000UL / rate;
+        while(millis() < due)
+            p.mesh.step();
+        std::vector<uint8_t> payload = reading(i, 4 + rng() % 17);
+        uint32_t now = millis();
+        memcpy(payload.data(), &now, sizeof(now));
+        CHECK(p.send(payload) == SendStatus::OK);
+        sent.push_back(payload);
+        payloadBytes += payload.size();
+    }
+    p.mesh.run(windowMs + 2);
+
+    CHECK(p.records == sent);
+    std::vector<unsigned long> latencies;
+    for(size_t i = 0; i < p.records.size() && i < p.deliveredAt.size(); ++i) {
+        uint32_t sentAt;
+        memcpy(&sentAt, p.records[i].data(), sizeof(sentAt));
+        latencies.push_back(p.deliveredAt[i] - sentAt);
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    size_t frameBytes = 0;
+    for(const host::Datagram &frame : p.frames)
+        frameBytes += frame.data.size();
+    Load load;
+    load.framesPerSecond = double(p.frames.size()) / kSeconds;
+    load.efficiency = 100.0 * payloadBytes / frameBytes;
+    load.efficiencyOnAir = 100.0 * payloadBytes / (frameBytes + kMacOverhead * p.frames.size());
+    load.p50LatencyMs = latencies.empty() ? 0 : latencies[latencies.size() / 2];
+    return load;
+}
+
+static void testFramesPerSecond() {
+    printf("  rate    window  frames/s  eff          p50 latency\n");
+    for(int rate : {5, 20, 50, 100}) {
+        Load off = runLoad(rate, 0);
+        for(unsigned long windowMs : {0UL, 50UL, 200UL}) {
+            Load load = windowMs ? runLoad(rate, windowMs) : off;
+            char window[24] = "off";
+            if(windowMs)
+                snprintf(window, sizeof(window), "%lu ms", windowMs);
+            printf("  %3d/s   %-6s  %6.1f    %4.1f/%4.1f%%  %5lu ms\n", rate, window,
+                   load.framesPerSecond, load.efficiency, load.efficiencyOnAir,
+                   load.p50LatencyMs);
+            // A window shorter than the send interval has nothing to coalesce
+            if(windowMs < 1000UL / rate)
+                continue;
+            // Fewer frames, more payload per byte on air, no more delay than the window
+            CHECK(load.framesPerSecond < off.framesPerSecond);
+            CHECK(load.efficiencyOnAir > off.efficiencyOnAir);
+            CHECK(load.p50LatencyMs <= windowMs + 1);
+        }
+        CHECK(off.framesPerSecond == rate);
+    }
+}
+
+int main() {
+    RUN_TEST(testBatchRoundTrip);
+    RUN_TEST(testFlushTimer);
+    RUN_TEST(testFlushBytes);
+    RUN_TEST(testBypassKeepsOrder);
+    RUN_TEST(testTruncatedBatch);
+    RUN_TEST(testFramesPerSecond);
+    return testResult();
+}
@@ -0,0 +1,235 @@
+// The LZF codec behind setUdpCompression(): round trips over every length up to a few
+// hundred bytes and over the largest message, malformed input rejected without writing
+// past the output, and compression end to end between two nodes. A benchmark prints the
+// ratio, host ns/byte and datagrams saved on representative payloads.
+#include "LightThreadTest.h"
+#include <chrono>
+#include <random>
+
+// Worst case: every 32 literals need a run length byte; the encoder keeps one byte spare
+static size_t bound(size_t length) { return length + length / 32 + 2; }
+
+static std::vector<uint8_t> bytes(const std::string &text) {
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+static std::vector<uint8_t> randomBytes(size_t length, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> data(length);
+    for(uint8_t &byte : data)
+        byte = static_cast<uint8_t>(rng());
+    return data;
+}
+
+// A joiner's status: a few fields and a list of sensors sharing their keys
+static std::vector<uint8_t> statusJson(int i) {
+    std::string text = "{\"id\":\"40:4c:ca:01:02:" + std::to_string(10 + i % 80) +
+                       "\",\"role\":\"joiner\",\"state\":\"JOINER_PAIRED\",\"rssi\":-" +
+                       std::to_string(40 + i % 30) + ",\"uptime\":" +
+                       std::to_string(1000 + i * 17) + ",\"sensors\":[";
+    for(int s = 0; s < 4; ++s)
+        text += std::string(s ? "," : "") + "{\"name\":\"sensor" + std::to_string(s) +
+                "\",\"value\":" + std::to_string((i * 7 + s * 13) % 100) +
+                ",\"unit\":\"C\",\"ok\":true}";
+    return bytes(text + "]}");
+}
+
+static std::vector<uint8_t> telemetry(int i) {
+    std::string text;
+    for(int s = 0; s < 8; ++s)
+        text += "t=" + std::to_string(1700000000 + i * 8 + s) +
+                ",temp=" + std::to_string(21 + (i + s) % 3) + ".5,hum=4" +
+                std::to_string((i * s) % 10) + ",vbat=3.3" + std::to_string(s % 2) + "\n";
+    return bytes(text);
+}
+
+static bool roundTrips(const std::vector<uint8_t> &data) {
+    std::vector<uint8_t> packed(bound(data.size()) + 1), unpacked(data.size() + 1);
+    size_t n = LightThreadTest::lzCompress(data.data(), data.size(), packed.data(), packed.size());
+    if(n == 0)
+        return data.empty();
+    size_t m = LightThreadTest::lzDecompress(packed.data(), n, unpacked.data(), unpacked.size());
+    unpacked.resize(m);
+    return unpacked == data;
+}
+
+static void testRoundTrip() {
+    for(size_t length = 1; length <= 300; ++length) {
+        REQUIRE(roundTrips(randomBytes(length, length)));
+        REQUIRE(roundTrips(std::vector<uint8_t>(length, 0x5A)));
+        std::vector<uint8_t> pattern(length);
+        for(size_t i = 0; i < length; ++i)
+            pattern[i] = "abcabcabd"[i % 9];
+        REQUIRE(roundTrips(pattern));
+    }
+
+    // Largest message: long runs (past the longest match), repeats far back, and noise
+    std::vector<uint8_t> mixed = randomBytes(LT_MAX_MESSAGE_SIZE, 7);
+    std::fill(mixed.begin() + 100, mixed.begin() + 900, 0);
+    std::copy(mixed.begin() + 1000, mixed.begin() + 1400, mixed.end() - 400);
+    CHECK(roundTrips(mixed));
+    CHECK(roundTrips(std::vector<uint8_t>(LT_MAX_MESSAGE_SIZE, 0)));
+    for(int i = 0; i < 100; ++i) {
+        CHECK(roundTrips(statusJson(i)));
+        CHECK(roundTrips(telemetry(i)));
+    }
+}
+
+// A capacity below the input keeps only real gains
+static void testNoGainRejected() {
+    std::vector<uint8_t> noise = randomBytes(200, 3);
+    uint8_t out[256];
+    CHECK(LightThreadTest::lzCompress(noise.data(), noise.size(), out, noise.size() - 1) == 0);
+    std::vector<uint8_t> json = statusJson(1);
+    CHECK(LightThreadTest::lzCompress(json.data(), json.size(), out, json.size() - 1) > 0);
+}
+
+// Truncated, corrupted or oversized encodings return 0 and stay inside `out`
+static void testMalformedRejected() {
+    std::vector<uint8_t> data = telemetry(3);
+    std::vector<uint8_t> packed(bound(data.size()));
+    size_t n = LightThreadTest::lzCompress(data.data(), data.size(), packed.data(), packed.size());
+    REQUIRE(n > 0);
+
+    std::vector<uint8_t> out(data.size() + 16);
+    const uint8_t kGuard = 0xA5;
+    for(size_t cut = 1; cut < n; ++cut) {
+        std::fill(out.begin(), out.end(), kGuard);
+        size_t m = LightThreadTest::lzDecompress(packed.data(), cut, out.data(), data.size());
+        CHECK(m <= data.size());
+        CHECK(out[data.size()] == kGuard);
+    }
+
+    // Output capacity one short
+    CHECK(LightThreadTest::lzDecompress(packed.data(), n, out.data(), data.size() - 1) == 0);
+
+    // A reference before the start of the output
+    const uint8_t backward[] = {0x00, 'x', 0x20, 0x05};
+    CHECK(LightThreadTest::lzDecompress(backward, sizeof(backward), out.data(), out.size()) == 0);
+
+    std::mt19937 rng(11);
+    for(int i = 0; i < 20000; ++i) {
+        std::vector<uint8_t> junk = randomBytes(1 + rng() % 64, rng());
+        std::fill(out.begin(), out.end(), kGuard);
+        LightThreadTest::lzDecompress(junk.data(), junk.size(), out.data(), data.size());
+        REQUIRE(out[data.size()] == kGuard);
+    }
+}
+
+// Compressed payloads reach the receiver's callback as sent, reliable and not
+static void testEndToEnd() {
+    TestMesh mesh;
+    LightThread a, b;
+    mesh.add(a, "fd00::a");
+    size_t nodeB = mesh.add(b, "fd00::b");
+    a.setUdpCompression(true);
+
+    std::vector<std::vector<uint8_t>> received;
+    b.registerUdpViewCallback(
+        [&](const Ip6Address &, bool, const uint8_t *payload, size_t length) {
+            received.emplace_back(payload, payload + length);
+        });
+
+    std::vector<std::vector<uint8_t>> sent = {statusJson(0), telemetry(0), randomBytes(60, 1),
+                                              std::vector<uint8_t>(3000, 'z')};
+    for(size_t i = 0; i < sent.size(); ++i) {
+        REQUIRE(a.sendUdp(mesh.addressOf(nodeB), i % 2 == 0, sent[i]) == SendStatus::OK);
+        CHECK(mesh.runUntil([&] { return received.size() > i; }, 2000));
+    }
+    CHECK(received == sent);
+    CHECK(a.getStats().messagesCompressed == 3); // not the random bytes
+    CHECK(a.getStats().compressionSaved > 3000 - 100);
+}
+
+struct Payloads {
+    const char *name;
+    std::vector<std::vector<uint8_t>> items;
+};
+
+// Datagrams reliable sends of `payloads` take between two nodes, ACKs included
+static size_t datagramsFor(const Payloads &payloads, bool compression) {
+    TestMesh mesh;
+    LightThread a, b;
+    mesh.add(a, "fd00::a");
+    size_t nodeB = mesh.add(b, "fd00::b");
+    a.setUdpCompression(compression);
+    size_t received = 0;
+    b.registerUdpViewCallback([&](const Ip6Address &, bool, const uint8_t *, size_t) {
+        received++;
+    });
+    for(const std::vector<uint8_t> &payload : payloads.items) {
+        size_t before = received;
+        CHECK(a.sendUdp(mesh.addressOf(nodeB), true, payload) == SendStatus::OK);
+        CHECK(mesh.runUntil(
+            [&] { return received > before && a.freeReliableSlots() == LT_RELIABLE_SLOTS; },
+            2000));
+    }
+    return mesh.delivered;
+}
+
+static void testBenchmark() {
+    std::vector<Payloads> sets = {{"status JSON", {}}, {"telemetry", {}}, {"random", {}}};
+    for(int i = 0; i < 64; ++i) {
+        sets[0].items.push_back(statusJson(i));
+        sets[1].items.push_back(telemetry(i));
+        sets[2].items.push_back(randomBytes(200, i));
+    }
+
+    printf("  %-12s %6s %10s %10s %18s\n", "payload", "ratio", "enc ns/B", "dec ns/B",
+           "datagrams off/on");
+    for(const Payloads &set : sets) {
+        size_t in = 0, out = 0;
+        uint8_t packed[LT_MAX_MESSAGE_SIZE + LT_MAX_MESSAGE_SIZE / 32 + 1];
+        uint8_t unpacked[LT_MAX_MESSAGE_SIZE];
+        std::vector<size_t> sizes;
+        const int kRounds = 50;
+
+        auto start = std::chrono::steady_clock::now();
+        for(int r = 0; r < kRounds; ++r) {
+            for(const std::vector<uint8_t> &item : set.items) {
+                size_t n = LightThreadTest::lzCompress(item.data(), item.size(), packed,
+                                                       bound(item.size()));
+                if(r == 0) {
+                    in += item.size();
+                    out += n;
+                }
+            }
+        }
+        double encodeNs = std::chrono::duration<double, std::nano>(
+                              std::chrono::steady_clock::now() - start)
+                              .count() /
+                          (in * kRounds);
+
+        std::vector<std::vector<uint8_t>> encoded;
+        for(const std::vector<uint8_t> &item : set.items) {
+            size_t n = LightThreadTest::lzCompress(item.data(), item.size(), packed,
+                                                   bound(item.size()));
+            encoded.emplace_back(packed, packed + n);
+        }
+        start = std::chrono::steady_clock::now();
+        for(int r = 0; r < kRounds; ++r) {
+            for(const std::vector<uint8_t> &item : encoded)
+                CHECK(LightThreadTest::lzDecompress(item.data(), item.size(), unpacked,
+                                                    sizeof(unpacked)) > 0);
+        }
+        double decodeNs = std::chrono::duration<double, std::nano>(
+                              std::chrono::steady_clock::now() - start)
+                              .count() /
+                          (in * kRounds);
+
+        size_t off = datagramsFor(set, false);
+        size_t on = datagramsFor(set, true);
+        CHECK(on <= off);
+        printf("  %-12s %6.2f %10.2f %10.2f %11zu/%zu\n", set.name, double(in) / out, encodeNs,
+               decodeNs, off, on);
+    }
+}
+
+int main() {
+    RUN_TEST(testRoundTrip);
+    RUN_TEST(testNoGainRejected);
+    RUN_TEST(testMalformedRejected);
+    RUN_TEST(testEndToEnd);
+    RUN_TEST(testBenchmark);
+    return testResult();
+}
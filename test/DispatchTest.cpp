@@ -0,0 +1,214 @@
+// Dispatch of received frames through kRoutes: every message type, with every ack byte, on a
+// leader and on a joiner in every state, either reaches its handler or is dropped and
+// counted in Stats::framesDropped. The expected routing is written out here independently
+// of the table. A byte in the ack position that is no AckType is dropped whatever the type.
+// Then the time handleUdpPacket() takes for the common cases on the host.
+#include "LightThreadTest.h"
+#include <chrono>
+
+static const Ip6Address kPeer = address("fd00::2");
+static const uint8_t kUserType = MessageType::USER_FIRST;     // has a handler
+static const uint8_t kUnclaimedType = MessageType::USER_FIRST + 1;
+static const uint8_t kStrayAck = 0x42;
+static const uint8_t kAcks[] = {AckType::NONE, AckType::REQUEST, AckType::RESPONSE, kStrayAck};
+
+static const State kStates[] = {State::INIT,
+                                State::STANDBY,
+                                State::JOINER_START,
+                                State::JOINER_SCAN,
+                                State::JOINER_WAIT_BROADCAST,
+                                State::JOINER_WAIT_ACK,
+                                State::JOINER_PAIRED,
+                                State::JOINER_RECONNECT,
+                                State::JOINER_SEEKING_LEADER,
+                                State::LEADER_WAIT_NETWORK,
+                                State::COMMISSIONER_START,
+                                State::COMMISSIONER_ACTIVE,
+                                State::ERROR};
+
+// Whether a frame of `type` with `ack` is for a node in `role` and `state`
+static bool expectHandled(uint8_t type, uint8_t ack, Role role, State state) {
+    bool leader = role == Role::LEADER, joiner = role == Role::JOINER;
+    bool none = ack == AckType::NONE, request = ack == AckType::REQUEST,
+         response = ack == AckType::RESPONSE;
+    if(!none && !request && !response)
+        return false;
+    switch(type) {
+    case MessageType::NORMAL:
+    case MessageType::FRAGMENT:
+    case MessageType::GROUP:
+        return true;
+    case MessageType::PAIRING:
+        return (none && state == State::JOINER_WAIT_BROADCAST) ||
+               (request && state == State::COMMISSIONER_ACTIVE) ||
+               (response && state == State::JOINER_WAIT_ACK);
+    case MessageType::RECONNECT:
+        return (request && leader && state == State::STANDBY) || (response && joiner);
+    case MessageType::HEARTBEAT:
+        return (none && leader) || (response && joiner);
+    case MessageType::BATCH:
+        return none;
+    case MessageType::BEACON:
+        return none && joiner;
+    case MessageType::SUBSCRIBE:
+        return (none && joiner && state == State::JOINER_PAIRED) || (request && leader) ||
+               (response && joiner);
+    case MessageType::PUBLISH:
+        return (none && joiner) || (request && leader);
+    case kUserType:
+        return true;
+    }
+    return false; // CHANNEL without its envelope, unassigned and unclaimed codes
+}
+
+// A node in `role` and `state` with a handler for kUserType
+static void prepare(LightThread &lt, Role role, State state) {
+    LightThreadTest::useBackend(lt, UdpBackend::NATIVE);
+    lt.setLogLevel(LT_LOG_NONE);
+    lt.registerMessageHandler(kUserType, [](const Ip6Address &, AckType, const uint8_t *,
+                                            size_t) {});
+    LightThreadTest::enterState(lt, role, state);
+}
+
+// Frames dropped by a fresh node in `role` and `state` receiving `frame`
+static uint32_t dropped(Role role, State state, const std::vector<uint8_t> &frame) {
+    LightThread lt;
+    prepare(lt, role, state);
+    LightThreadTest::receive(lt, kPeer, frame.data(), frame.size());
+    return lt.getStats().framesDropped;
+}
+
+static void testRoutingMatrix() {
+    host::useSimulatedClock();
+    host::setSendHandler([](const host::Datagram &) {});
+    std::vector<uint8_t> types;
+    for(uint8_t type = MessageType::NORMAL; type <= MessageType::PUBLISH; ++type)
+        types.push_back(type);
+    for(uint8_t type : {0x0B, 0x3F, 0x7F})
+        types.push_back(type);
+    types.push_back(kUserType);
+    types.push_back(kUnclaimedType);
+
+    size_t cases = 0, handled = 0, mismatches = 0;
+    for(uint8_t type : types) {
+        for(uint8_t ack : kAcks) {
+            for(Role role : {Role::LEADER, Role::JOINER}) {
+                for(State state : kStates) {
+                    std::vector<uint8_t> frame = {ack, type, 0, 0, 0, 0, 0, 0, 0, 0};
+                    bool expected = expectHandled(type, ack, role, state);
+                    uint32_t drops = dropped(role, state, frame);
+                    if(drops != (expected ? 0u : 1u)) {
+                        mismatches++;
+                        printf("  type %02x ack %02x role %d state %d: %u dropped\n", type, ack,
+                               static_cast<int>(role), static_cast<int>(state), drops);
+                    }
+                    cases++;
+                    handled += expected;
+                }
+            }
+        }
+    }
+    host::setSendHandler(nullptr);
+    printf("  %zu combinations, %zu reach a handler\n", cases, handled);
+    CHECK(mismatches == 0);
+}
+
+// The channel envelope routes NORMAL and FRAGMENT only, on a channel other than 0
+static void testChannelEnvelope() {
+    host::useSimulatedClock();
+    host::setSendHandler([](const host::Datagram &) {});
+    for(Role role : {Role::LEADER, Role::JOINER}) {
+        const uint8_t channel = 1;
+        CHECK(dropped(role, State::STANDBY, {AckType::NONE, MessageType::CHANNEL, channel,
+                                             MessageType::NORMAL, 0x11}) == 0);
+        CHECK(dropped(role, State::STANDBY, {AckType::REQUEST, MessageType::CHANNEL, channel,
+                                             MessageType::NORMAL, 0, 0, 0x11}) == 0);
+        CHECK(dropped(role, State::STANDBY, {AckType::NONE, MessageType::CHANNEL, 0,
+                                             MessageType::NORMAL, 0x11}) == 1);
+        CHECK(dropped(role, State::STANDBY, {AckType::NONE, MessageType::CHANNEL, channel,
+                                             MessageType::HEARTBEAT, 0x11}) == 1);
+        CHECK(dropped(role, State::STANDBY, {kStrayAck, MessageType::CHANNEL, channel,
+                                             MessageType::NORMAL, 0x11}) == 1);
+        CHECK(dropped(role, State::STANDBY, {AckType::NONE, MessageType::CHANNEL, channel}) ==
+              1);
+        CHECK(dropped(role, State::STANDBY, {AckType::NONE}) == 1);
+    }
+    host::setSendHandler(nullptr);
+}
+
+// What a handler that is reached does, and that a stray ack byte does none of it
+static void testHandlersReached() {
+    host::useSimulatedClock();
+    host::setSendHandler([](const host::Datagram &) {});
+    LightThread leader;
+    prepare(leader, Role::LEADER, State::STANDBY);
+    size_t received = 0, handled = 0;
+    leader.registerUdpViewCallback(
+        [&](const Ip6Address &, bool, const uint8_t *, size_t) { received++; });
+    leader.registerMessageHandler(kUserType, [&](const Ip6Address &src, AckType ack,
+                                                 const uint8_t *payload, size_t length) {
+        handled++;
+        CHECK(src == kPeer && ack == AckType::NONE);
+        CHECK(length == 1 && payload[0] == 0x11);
+    });
+
+    for(uint8_t ack : {kStrayAck, static_cast<uint8_t>(AckType::NONE)}) {
+        const uint8_t normal[] = {ack, MessageType::NORMAL, 0x11};
+        const uint8_t user[] = {ack, kUserType, 0x11};
+        const uint8_t heartbeat[] = {ack, MessageType::HEARTBEAT, 1, 2, 3, 4, 5, 6, 7, 8};
+        LightThreadTest::receive(leader, kPeer, normal, sizeof(normal));
+        LightThreadTest::receive(leader, kPeer, user, sizeof(user));
+        LightThreadTest::receive(leader, kPeer, heartbeat, sizeof(heartbeat));
+        size_t expected = ack == AckType::NONE ? 1 : 0;
+        CHECK(received == expected);
+        CHECK(handled == expected);
+        CHECK(leader.joinerCount() == expected);
+    }
+    CHECK(leader.getStats().framesDropped == 3);
+    host::setSendHandler(nullptr);
+}
+
+static void testDispatchCost() {
+    using Clock = std::chrono::steady_clock;
+    const int kFrames = 200000;
+    host::useSimulatedClock();
+    host::setSendHandler([](const host::Datagram &) {});
+    LightThread leader;
+    prepare(leader, Role::LEADER, State::STANDBY);
+    leader.registerUdpViewCallback([](const Ip6Address &, bool, const uint8_t *, size_t) {});
+
+    struct Case {
+        const char *name;
+        std::vector<uint8_t> frame;
+    };
+    const Case cases[] = {
+        {"PAIRING, not commissioning", {AckType::NONE, MessageType::PAIRING, 0, 0, 0, 0}},
+        {"BEACON on a leader", {AckType::NONE, MessageType::BEACON, 0, 0, 0, 0}},
+        {"unassigned type", {AckType::NONE, 0x0B, 0, 0, 0, 0}},
+        {"stray ack byte", {kStrayAck, MessageType::NORMAL, 0, 0, 0, 0}},
+        {"NORMAL to the callback", {AckType::NONE, MessageType::NORMAL, 0, 0, 0, 0}},
+        {"user type to its handler", {AckType::NONE, kUserType, 0, 0, 0, 0}},
+        {"HEARTBEAT, known joiner", {AckType::NONE, MessageType::HEARTBEAT, 1, 2, 3, 4, 5, 6,
+                                     7, 8}},
+    };
+    printf("  %-28s  ns/frame\n", "frame");
+    for(const Case &c : cases) {
+        uint32_t before = leader.getStats().framesDropped;
+        auto start = Clock::now();
+        for(int i = 0; i < kFrames; ++i)
+            LightThreadTest::receive(leader, kPeer, c.frame.data(), c.frame.size());
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        uint32_t drops = leader.getStats().framesDropped - before;
+        printf("  %-28s  %8.1f\n", c.name, ns / kFrames);
+        CHECK(drops == 0 || drops == kFrames);
+    }
+    host::setSendHandler(nullptr);
+}
+
+int main() {
+    RUN_TEST(testRoutingMatrix);
+    RUN_TEST(testChannelEnvelope);
+    RUN_TEST(testHandlersReached);
+    RUN_TEST(testDispatchCost);
+    return testResult();
+}
@@ -0,0 +1,191 @@
+// Deferred delivery: events keep their order and payloads as the data ring wraps, a full
+// queue drops and counts rather than overwrites, and with a slow receive handler the ACK
+// latency a sender sees stays flat when the handler runs in poll() from another thread,
+// while inline it grows with the handler. The queue is only allocated once deferred
+// delivery is turned on.
+#include "LightThreadTest.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+static const Ip6Address kPeer = address("fd00::2");
+
+static std::vector<uint8_t> payloadOf(int i, size_t length) {
+    std::vector<uint8_t> payload(length);
+    for(size_t j = 0; j < length; ++j)
+        payload[j] = static_cast<uint8_t>(i * 31 + j);
+    return payload;
+}
+
+// An unreliable datagram from kPeer, as the receive path hands it on
+static void receive(LightThread &lt, const std::vector<uint8_t> &payload) {
+    std::vector<uint8_t> frame = {AckType::NONE, MessageType::NORMAL};
+    frame.insert(frame.end(), payload.begin(), payload.end());
+    LightThreadTest::receive(lt, kPeer, frame.data(), frame.size());
+}
+
+static void testRingWrap() {
+    LightThread lt;
+    LightThreadTest::useBackend(lt, UdpBackend::NATIVE);
+    CHECK(!LightThreadTest::hasEventQueue(lt));
+    CHECK(lt.setDeferredDelivery(true));
+    CHECK(LightThreadTest::hasEventQueue(lt));
+
+    std::vector<std::vector<uint8_t>> got;
+    lt.registerUdpViewCallback([&](const Ip6Address &src, bool, const uint8_t *data, size_t n) {
+        CHECK(src == kPeer);
+        got.emplace_back(data, data + n);
+    });
+
+    // Odd sizes, a few queued per round and fewer polled, so both rings wrap many times
+    // with data at every offset
+    int sent = 0;
+    size_t queued = 0;
+    for(int round = 0; round < 400; ++round) {
+        for(int k = 0; k < 3 && queued < 8; ++k, ++sent, ++queued)
+            receive(lt, payloadOf(sent, 1 + (sent * 211) % 700));
+        queued -= lt.poll(2);
+    }
+    lt.poll();
+
+    REQUIRE(got.size() == static_cast<size_t>(sent));
+    for(int i = 0; i < sent; ++i)
+        CHECK(got[i] == payloadOf(i, 1 + (i * 211) % 700));
+    CHECK(lt.getStats().eventsDropped == 0);
+}
+
+static void testFullQueueDrops() {
+    LightThread lt;
+    LightThreadTest::useBackend(lt, UdpBackend::NATIVE);
+    lt.setDeferredDelivery(true);
+
+    std::vector<uint8_t> order;
+    lt.registerUdpViewCallback(
+        [&](const Ip6Address &, bool, const uint8_t *data, size_t) { order.push_back(data[0]); });
+
+    // Out of event slots: one stays empty to tell a full ring from an empty one
+    for(int i = 0; i < LT_EVENT_SLOTS + 3; ++i)
+        receive(lt, {static_cast<uint8_t>(i)});
+    CHECK(lt.getStats().eventsDropped == 4);
+    CHECK(lt.getStats().eventQueueHighWater == LT_EVENT_SLOTS - 1);
+
+    CHECK(lt.poll() == LT_EVENT_SLOTS - 1);
+    REQUIRE(order.size() == LT_EVENT_SLOTS - 1);
+    for(size_t i = 0; i < order.size(); ++i)
+        CHECK(order[i] == i);
+
+    // Out of data bytes: the second half-ring payload does not fit behind the first
+    const size_t half = LT_EVENT_BYTES / 2 + 1;
+    order.clear();
+    receive(lt, payloadOf(0, half));
+    receive(lt, payloadOf(1, half));
+    CHECK(lt.getStats().eventsDropped == 5);
+    CHECK(lt.poll() == 1);
+
+    // Space freed by poll() is used again
+    receive(lt, payloadOf(2, half));
+    CHECK(lt.poll() == 1);
+    CHECK(order.size() == 2 && order[1] == payloadOf(2, 1)[0]);
+    CHECK(lt.getStats().eventsDropped == 5);
+}
+
+struct Latency {
+    double medianUs;
+    double worstUs;
+    size_t acked;
+    size_t handled;
+    uint32_t dropped;
+};
+
+// Node 0 sends bursts of reliable messages to node 1, whose receive handler takes
+// `handlerMs` per message, and measures how long each ACK takes to come back. Deferred,
+// node 1's handler runs in poll() on a consumer thread; inline, inside update().
+static Latency measureAckLatency(bool deferred, int handlerMs) {
+    using Clock = std::chrono::steady_clock;
+    const int kBursts = 40, kPerBurst = 3;
+
+    TestMesh mesh;
+    host::useRealClock();
+    LightThread sender, receiver;
+    size_t a = mesh.add(sender, "fd00::1");
+    size_t b = mesh.add(receiver, "fd00::2");
+    receiver.setDeferredDelivery(deferred);
+
+    std::atomic<size_t> handled{0};
+    receiver.registerUdpViewCallback([&](const Ip6Address &, bool, const uint8_t *, size_t) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(handlerMs));
+        handled++;
+    });
+
+    std::atomic<bool> stop{false};
+    std::thread consumer([&] {
+        while(!stop) {
+            if(deferred && receiver.poll(1) > 0)
+                continue;
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    });
+
+    Clock::time_point burstStart;
+    std::vector<double> latencies;
+    sender.registerReliableUdpStatusCallback([&](uint16_t, const Ip6Address &, bool success) {
+        CHECK(success);
+        latencies.push_back(
+            std::chrono::duration<double, std::micro>(Clock::now() - burstStart).count());
+    });
+
+    for(int burst = 0; burst < kBursts; ++burst) {
+        burstStart = Clock::now();
+        for(int i = 0; i < kPerBurst; ++i) {
+            CHECK(mesh.as(a).sendUdp(mesh.addressOf(b), true, payloadOf(i, 20)) ==
+                  SendStatus::OK);
+        }
+        while(Clock::now() - burstStart < std::chrono::milliseconds(10))
+            mesh.step();
+    }
+    while(handled < static_cast<size_t>(kBursts * kPerBurst) &&
+          receiver.getStats().eventsDropped == 0)
+        mesh.step();
+    stop = true;
+    consumer.join();
+    host::useSimulatedClock();
+
+    Latency result = {};
+    result.acked = latencies.size();
+    result.handled = handled;
+    result.dropped = receiver.getStats().eventsDropped;
+    if(!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        result.medianUs = latencies[latencies.size() / 2];
+        result.worstUs = latencies.back();
+    }
+    return result;
+}
+
+static void testSlowConsumerAckLatency() {
+    const size_t kMessages = 40 * 3;
+    printf("  handler  inline median/worst    deferred median/worst  (ACK latency, us)\n");
+    for(int handlerMs : {0, 1, 2}) {
+        Latency inlined = measureAckLatency(false, handlerMs);
+        Latency deferred = measureAckLatency(true, handlerMs);
+        printf("  %4d ms  %8.0f / %-8.0f      %8.0f / %.0f\n", handlerMs, inlined.medianUs,
+               inlined.worstUs, deferred.medianUs, deferred.worstUs);
+
+        for(const Latency &run : {inlined, deferred}) {
+            CHECK(run.acked == kMessages);
+            CHECK(run.handled == kMessages);
+            CHECK(run.dropped == 0);
+        }
+        // Inline, the last ACK of a burst waits for the handler of every message before it
+        if(handlerMs > 0)
+            CHECK(inlined.medianUs >= 1000.0 * handlerMs);
+        CHECK(deferred.medianUs < 1000);
+    }
+}
+
+int main() {
+    RUN_TEST(testRingWrap);
+    RUN_TEST(testFullQueueDrops);
+    RUN_TEST(testSlowConsumerAckLatency);
+    return testResult();
+}
@@ -0,0 +1,250 @@
+// Group sends from a leader to its joiners on a TestMesh: one multicast copy, ACKs spread
+// over the window, unicast retransmission only to members that stayed silent, and one
+// status callback per member. Then a leader and 10, 50 and 200 joiners with 5% loss per
+// receiver, a 40-byte payload sent with sendGroup() and with a reliable sendUdp() loop:
+// frames, airtime at 250 kbit/s with (bytes + 25) * 32 us per frame, and the time until
+// every joiner has the payload and until every delivery is confirmed. Single hop; a real
+// mesh forwards ff03::1 with MPL, which this does not count. Joiners take part without
+// allocating the leader's registry or group send table. Built twice: with a registry for
+// 512 joiners, and with the default limits (GroupTestDefaultLimits), which skip the 200.
+#include "LightThreadTest.h"
+#include <random>
+
+// A leader (node 0) and `joinerCount` paired joiners, all registered with the leader. Each
+// joiner records when the payload reached it.
+struct GroupMesh {
+    TestMesh mesh;
+    LightThread leader;
+    std::vector<LightThread> joiners;
+    std::vector<std::vector<unsigned long>> deliveredAt; // per joiner
+
+    explicit GroupMesh(size_t joinerCount) : joiners(joinerCount), deliveredAt(joinerCount) {
+        mesh.add(leader, "fd00::1000");
+        LightThreadTest::makeLeader(leader);
+        for(size_t i = 0; i < joinerCount; ++i) {
+            std::string ip = "fd00::" + std::to_string(i + 1);
+            size_t node = mesh.add(joiners[i], ip.c_str());
+            LightThreadTest::makePairedJoiner(mesh.as(node), mesh.addressOf(0));
+            joiners[i].registerUdpViewCallback(
+                [this, i](const Ip6Address &, bool, const uint8_t *, size_t) {
+                    deliveredAt[i].push_back(millis());
+                });
+        }
+        mesh.run(10); // first heartbeats register the joiners
+        CHECK(leader.joinerCount() == joinerCount);
+    }
+
+    // Node index of joiner `i`
+    static size_t node(size_t i) { return i + 1; }
+};
+
+static bool isGroup(const host::Datagram &datagram, AckType ack) {
+    return datagram.data.size() >= 2 && datagram.data[0] == ack &&
+           datagram.data[1] == MessageType::GROUP;
+}
+
+static const std::vector<uint8_t> kPayload(40, 0x5C);
+
+static void testSilentMemberRetransmission() {
+    const size_t kJoiners = 4, kSilent = 2;
+    GroupMesh net(kJoiners);
+
+    // The multicast copy to one member is lost; everything else arrives
+    size_t multicasts = 0;
+    std::vector<size_t> retransmittedTo;
+    std::vector<std::pair<size_t, unsigned long>> acks; // member, ms after the send
+    unsigned long sentAt = millis();
+    net.mesh.drop = [&](const host::Datagram &datagram, size_t from, size_t to) {
+        if(isGroup(datagram, AckType::NONE)) {
+            multicasts += to == GroupMesh::node(0);
+            return to == GroupMesh::node(kSilent);
+        }
+        if(isGroup(datagram, AckType::REQUEST))
+            retransmittedTo.push_back(to);
+        if(isGroup(datagram, AckType::RESPONSE))
+            acks.push_back({from, millis() - sentAt});
+        return false;
+    };
+
+    std::vector<std::pair<Ip6Address, bool>> outcomes;
+    uint16_t callbackId = 0;
+    net.leader.registerGroupStatusCallback([&](uint16_t id, const Ip6Address &ip, bool ok) {
+        callbackId = id;
+        outcomes.push_back({ip, ok});
+    });
+
+    uint16_t groupId;
+    REQUIRE(net.leader.sendGroup(kPayload, &groupId) == SendStatus::OK);
+    const unsigned long ackWindow = kJoiners * LT_GROUP_ACK_SPACING;
+    CHECK(net.mesh.runUntil([&] { return outcomes.size() == kJoiners; }, 5000));
+
+    CHECK(multicasts == 1);
+    // Delayed ACKs, within the window and not all at once
+    REQUIRE(acks.size() >= kJoiners - 1);
+    bool spread = false;
+    for(size_t i = 0; i < kJoiners - 1; ++i) {
+        CHECK(acks[i].second <= ackWindow + 1);
+        spread = spread || acks[i].second != acks[0].second;
+    }
+    CHECK(spread);
+    // Only the silent member gets a unicast copy, once its ACK is overdue
+    REQUIRE(retransmittedTo.size() == 1);
+    CHECK(retransmittedTo[0] == GroupMesh::node(kSilent));
+    CHECK(acks.back().first == GroupMesh::node(kSilent));
+    CHECK(acks.back().second >= ackWindow + LT_RELIABLE_MIN_RTO);
+
+    // One successful outcome per member, for this group send
+    CHECK(callbackId == groupId);
+    for(size_t i = 0; i < kJoiners; ++i) {
+        CHECK(net.deliveredAt[i].size() == 1);
+        size_t reports = 0;
+        for(const auto &outcome : outcomes) {
+            if(outcome.first == net.mesh.addressOf(GroupMesh::node(i))) {
+                reports++;
+                CHECK(outcome.second);
+            }
+        }
+        CHECK(reports == 1);
+    }
+    net.mesh.run(LT_RELIABLE_MAX_RTO);
+    CHECK(outcomes.size() == kJoiners);
+    CHECK(retransmittedTo.size() == 1);
+}
+
+// A member that never answers is reported failed once, at the deadline; the rest succeed
+static void testUnreachableMemberFails() {
+    const size_t kJoiners = 3, kGone = 1;
+    GroupMesh net(kJoiners);
+    net.mesh.drop = [&](const host::Datagram &datagram, size_t, size_t to) {
+        return datagram.data[1] == MessageType::GROUP && to == GroupMesh::node(kGone);
+    };
+
+    std::vector<std::pair<Ip6Address, bool>> outcomes;
+    net.leader.registerGroupStatusCallback(
+        [&](uint16_t, const Ip6Address &ip, bool ok) { outcomes.push_back({ip, ok}); });
+    unsigned long sentAt = millis();
+    REQUIRE(net.leader.sendGroup(kPayload) == SendStatus::OK);
+    CHECK(net.mesh.runUntil([&] { return outcomes.size() == kJoiners; }, 20000));
+
+    REQUIRE(outcomes.size() == kJoiners);
+    CHECK(outcomes.back().first == net.mesh.addressOf(GroupMesh::node(kGone)));
+    CHECK(!outcomes.back().second);
+    CHECK(millis() - sentAt >= LT_RELIABLE_DEFAULT_DEADLINE);
+    for(size_t i = 0; i + 1 < outcomes.size(); ++i)
+        CHECK(outcomes[i].second);
+    net.mesh.run(LT_RELIABLE_MAX_RTO);
+    CHECK(outcomes.size() == kJoiners);
+}
+
+// The registry and group send table are allocated by the leader as it uses them; joiners
+// that receive and ACK a group message hold neither
+static void testLeaderTablesOnLeader() {
+    const size_t kJoiners = 3;
+    GroupMesh net(kJoiners);
+    size_t confirmed = 0;
+    net.leader.registerGroupStatusCallback(
+        [&](uint16_t, const Ip6Address &, bool ok) { confirmed += ok; });
+    CHECK(!LightThreadTest::hasGroupSends(net.leader));
+    REQUIRE(net.mesh.as(0).sendGroup(kPayload) == SendStatus::OK);
+    CHECK(net.mesh.runUntil([&] { return confirmed == kJoiners; }, 5000));
+
+    CHECK(LightThreadTest::hasGroupSends(net.leader));
+    for(LightThread &joiner : net.joiners) {
+        CHECK(!LightThreadTest::hasGroupSends(joiner));
+        CHECK(!LightThreadTest::hasEventQueue(joiner));
+        CHECK(joiner.joinerCount() == 0);
+    }
+    printf("  sizeof(LightThread) %zu bytes, %d group members\n", sizeof(LightThread),
+           LT_GROUP_MEMBERS);
+}
+
+struct Airtime {
+    size_t frames;
+    double airtimeMs;
+    unsigned long allDeliveredMs;
+    unsigned long allConfirmedMs;
+};
+
+static double frameAirtimeMs(const host::Datagram &datagram) {
+    return (datagram.data.size() + 25) * 32 / 1000.0;
+}
+
+// The payload to every joiner, by group send or by a reliable unicast loop; the loop waits
+// out QUEUE_FULL as an application would. Only data frames and their ACKs are counted.
+static Airtime simulate(size_t joinerCount, bool group, unsigned lossPercent) {
+    GroupMesh net(joinerCount);
+    std::mt19937 rng(12);
+    Airtime result = {};
+    net.mesh.drop = [&](const host::Datagram &datagram, size_t from, size_t to) {
+        uint8_t ack = datagram.data[0], type = datagram.data[1];
+        bool counted = type == MessageType::GROUP ||
+                       (type == MessageType::NORMAL && ack != AckType::NONE);
+        // A multicast is one frame on air however many receive it
+        bool first = !Ip6Address::fromOt(datagram.peer).isMulticast() || to == 1;
+        if(counted && first) {
+            result.frames++;
+            result.airtimeMs += frameAirtimeMs(datagram);
+        }
+        return rng() % 100 < lossPercent;
+    };
+
+    size_t confirmed = 0;
+    auto onStatus = [&](uint16_t, const Ip6Address &, bool ok) { confirmed += ok; };
+    net.leader.registerGroupStatusCallback(onStatus);
+    net.leader.registerReliableUdpStatusCallback(onStatus);
+
+    auto allDelivered = [&] {
+        for(const std::vector<unsigned long> &times : net.deliveredAt) {
+            if(times.empty())
+                return false;
+        }
+        return true;
+    };
+
+    unsigned long start = millis();
+    if(group) {
+        CHECK(net.mesh.as(0).sendGroup(kPayload) == SendStatus::OK);
+    } else {
+        for(size_t i = 0; i < joinerCount; ++i) {
+            const Ip6Address &dest = net.mesh.addressOf(GroupMesh::node(i));
+            while(net.mesh.as(0).sendUdp(dest, true, kPayload) == SendStatus::QUEUE_FULL)
+                net.mesh.step();
+        }
+    }
+    CHECK(net.mesh.runUntil([&] { return confirmed == joinerCount && allDelivered(); },
+                            4 * LT_RELIABLE_DEFAULT_DEADLINE));
+
+    for(const std::vector<unsigned long> &times : net.deliveredAt) {
+        CHECK(times.size() == 1);
+        if(!times.empty())
+            result.allDeliveredMs = std::max(result.allDeliveredMs, times[0] - start);
+    }
+    result.allConfirmedMs = millis() - start;
+    CHECK(confirmed == joinerCount);
+    return result;
+}
+
+static void testAirtime() {
+    printf("  N    mode     frames  airtime  all delivered  all confirmed\n");
+    for(size_t joiners : {10, 50, 200}) {
+        if(joiners > LT_MAX_JOINERS)
+            continue;
+        Airtime unicast = simulate(joiners, false, 5);
+        Airtime group = simulate(joiners, true, 5);
+        for(const Airtime *run : {&unicast, &group}) {
+            printf("  %-4zu %-7s  %5zu  %5.0f ms  %8lu ms  %10lu ms\n", joiners,
+                   run == &group ? "group" : "unicast", run->frames, run->airtimeMs,
+                   run->allDeliveredMs, run->allConfirmedMs);
+        }
+        CHECK(group.frames < unicast.frames);
+        CHECK(group.airtimeMs < unicast.airtimeMs);
+    }
+}
+
+int main() {
+    RUN_TEST(testSilentMemberRetransmission);
+    RUN_TEST(testUnreachableMemberFails);
+    RUN_TEST(testLeaderTablesOnLeader);
+    RUN_TEST(testAirtime);
+    return testResult();
+}
@@ -0,0 +1,148 @@
+// The hex codec of the CLI backend: exhaustive round trips over every byte value at every
+// offset of the 8-byte SWAR blocks and the scalar tail, rejection of every non-hex
+// character at every position, and a micro-benchmark against the strtol-based codec it
+// replaced.
+#include "LightThreadTest.h"
+#include <chrono>
+#include <random>
+
+static std::string encode(const std::vector<uint8_t> &data) {
+    std::string hex(data.size() * 2, '?');
+    CHECK(LightThreadTest::bytesToHex(data.data(), data.size(), &hex[0], hex.size()) ==
+          hex.size());
+    return hex;
+}
+
+static bool decode(const std::string &hex, std::vector<uint8_t> &out) {
+    out.assign(hex.size() / 2 + 1, 0xEE);
+    size_t length;
+    bool ok = LightThreadTest::hexToBytes(hex.data(), hex.size(), out.data(), out.size(), length);
+    out.resize(length);
+    return ok;
+}
+
+static std::string reference(const std::vector<uint8_t> &data) {
+    std::string hex;
+    char digits[3];
+    for(uint8_t byte : data) {
+        snprintf(digits, sizeof(digits), "%02x", byte);
+        hex += digits;
+    }
+    return hex;
+}
+
+static void testRoundTripEveryByteAtEveryOffset() {
+    std::vector<uint8_t> decoded;
+    for(size_t length = 1; length <= 40; ++length) {
+        for(size_t at = 0; at < length; ++at) {
+            for(int value = 0; value < 256; ++value) {
+                std::vector<uint8_t> data(length, static_cast<uint8_t>(at * 31 + length));
+                data[at] = static_cast<uint8_t>(value);
+                std::string hex = encode(data);
+                REQUIRE(hex == reference(data));
+                REQUIRE(decode(hex, decoded) && decoded == data);
+            }
+        }
+    }
+    CHECK(decode("", decoded) && decoded.empty());
+}
+
+static void testUppercaseAccepted() {
+    std::vector<uint8_t> decoded;
+    std::string hex = "0123456789ABCDEFabcdefABCDEF0a1B2c3D4e5F";
+    REQUIRE(decode(hex, decoded));
+    CHECK(reference(decoded) == "0123456789abcdefabcdefabcdef0a1b2c3d4e5f");
+}
+
+// strtol took "0x", " 1", "+f" and "zz" (as 0) without complaint
+static void testInvalidCharactersRejected() {
+    std::vector<uint8_t> decoded;
+    for(size_t length : {2, 16, 34}) {
+        for(size_t at = 0; at < length; ++at) {
+            for(int c = 0; c < 256; ++c) {
+                if(isxdigit(c))
+                    continue;
+                std::string hex(length, 'a');
+                hex[at] = static_cast<char>(c);
+                REQUIRE(!decode(hex, decoded));
+            }
+        }
+    }
+    CHECK(!decode("abc", decoded));             // odd length
+    CHECK(!decode("0x12", decoded));            // prefix
+    uint8_t one;
+    size_t length;
+    CHECK(!LightThreadTest::hexToBytes("abcd", 4, &one, 1, length)); // no room
+    char two[2];
+    CHECK(LightThreadTest::bytesToHex(&one, 2, two, sizeof(two)) == 0);
+}
+
+// The codec this replaced: a temporary String and strtol per byte, a String grown per
+// character on the way out
+static std::vector<uint8_t> strtolDecode(const String &hex) {
+    std::vector<uint8_t> out;
+    for(size_t i = 0; i < hex.length(); i += 2)
+        out.push_back(strtol((String("") + String(hex[i]) + String(hex[i + 1])).c_str(),
+                             nullptr, 16));
+    return out;
+}
+
+static String appendEncode(const uint8_t *data, size_t len) {
+    String hex;
+    const char hexChars[] = "0123456789abcdef";
+    for(size_t i = 0; i < len; ++i) {
+        hex += hexChars[(data[i] >> 4) & 0xF];
+        hex += hexChars[data[i] & 0xF];
+    }
+    return hex;
+}
+
+template <typename Fn> static double nsPerByte(size_t bytes, int rounds, Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < rounds; ++i)
+        fn();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / (bytes * rounds);
+}
+
+static void testBenchmark() {
+    std::mt19937 rng(4);
+    std::vector<uint8_t> data(LT_MAX_UDP_FRAME);
+    for(uint8_t &byte : data)
+        byte = static_cast<uint8_t>(rng());
+    std::string hex = encode(data);
+    const int kRounds = 20000;
+
+    std::vector<uint8_t> out(data.size());
+    std::string text(hex.size(), 0);
+    size_t length;
+    volatile uint8_t sink = 0;
+    double decodeNs = nsPerByte(data.size(), kRounds, [&] {
+        LightThreadTest::hexToBytes(hex.data(), hex.size(), out.data(), out.size(), length);
+        sink = sink + out[length - 1];
+    });
+    double encodeNs = nsPerByte(data.size(), kRounds, [&] {
+        LightThreadTest::bytesToHex(data.data(), data.size(), &text[0], text.size());
+        sink = sink + text[0];
+    });
+    String hexString(hex);
+    double oldDecodeNs = nsPerByte(data.size(), kRounds / 10, [&] {
+        sink = sink + strtolDecode(hexString).back();
+    });
+    double oldEncodeNs = nsPerByte(data.size(), kRounds / 10, [&] {
+        sink = sink + appendEncode(data.data(), data.size())[0];
+    });
+
+    CHECK(strtolDecode(hexString) == data);
+    CHECK(appendEncode(data.data(), data.size()).c_str() == hex);
+    printf("  decode: %.2f ns/byte (strtol: %.2f)\n", decodeNs, oldDecodeNs);
+    printf("  encode: %.2f ns/byte (String append: %.2f)\n", encodeNs, oldEncodeNs);
+}
+
+int main() {
+    RUN_TEST(testRoundTripEveryByteAtEveryOffset);
+    RUN_TEST(testUppercaseAccepted);
+    RUN_TEST(testInvalidCharactersRejected);
+    RUN_TEST(testBenchmark);
+    return testResult();
+}
@@ -0,0 +1,189 @@
+// Ip6Address text forms against the C library: format() must print what glibc's inet_ntop
+// prints, IPv4-mapped and -compatible tails included, and parse() must accept exactly what
+// inet_pton accepts, with the same result. On the data path addresses stay binary: once
+// warmed up, reliable and unreliable messages between two nodes of a TestMesh make no heap
+// allocation in the library.
+#include "AllocationCounter.h"
+#include "LightThreadTest.h"
+#include <arpa/inet.h>
+#include <random>
+
+static std::string formatted(const Ip6Address &addr) {
+    char text[Ip6Address::kStringSize];
+    CHECK(addr.format(text, sizeof(text)) == strlen(text));
+    return text;
+}
+
+static std::string ntop(const Ip6Address &addr) {
+    char text[INET6_ADDRSTRLEN];
+    inet_ntop(AF_INET6, addr.bytes, text, sizeof(text));
+    return text;
+}
+
+static Ip6Address fromGroups(const uint16_t (&groups)[8]) {
+    Ip6Address addr;
+    for(int g = 0; g < 8; ++g) {
+        addr.bytes[2 * g] = groups[g] >> 8;
+        addr.bytes[2 * g + 1] = groups[g] & 0xFF;
+    }
+    return addr;
+}
+
+static size_t formatMismatches = 0;
+
+static void checkFormat(const Ip6Address &addr) {
+    std::string ours = formatted(addr), theirs = ntop(addr);
+    if(ours != theirs && formatMismatches++ < 10)
+        printf("  format: %s, inet_ntop: %s\n", ours.c_str(), theirs.c_str());
+}
+
+static void testFormatKnown() {
+    const struct {
+        const char *text;
+        const char *expected;
+    } cases[] = {
+        {"::", "::"},
+        {"::1", "::1"},
+        {"::2", "::2"},
+        {"::ffff:192.0.2.1", "::ffff:192.0.2.1"},
+        {"::ffff:0:0", "::ffff:0.0.0.0"},
+        {"0:0:0:0:0:ffff:a00:1", "::ffff:10.0.0.1"},
+        {"::1.2.3.4", "::1.2.3.4"},
+        {"::0.1.0.0", "::0.1.0.0"},
+        {"::ffff:1:0:0", "::ffff:1:0:0"},
+        {"1::ffff:1.2.3.4", "1::ffff:102:304"},
+        {"fd00::ff:fe00:fc00", "fd00::ff:fe00:fc00"},
+        {"fd00:0:0:1:0:0:0:1", "fd00:0:0:1::1"},
+        {"1:0:0:2:0:0:3:4", "1::2:0:0:3:4"},
+        {"1:0:2:3:4:5:6:7", "1:0:2:3:4:5:6:7"},
+        {"ff03::1", "ff03::1"},
+        {"FFFF:ABCD::", "ffff:abcd::"},
+    };
+    for(const auto &c : cases) {
+        Ip6Address addr = {};
+        REQUIRE(Ip6Address::parse(c.text, addr));
+        CHECK(formatted(addr) == c.expected);
+        CHECK(ntop(addr) == c.expected);
+    }
+
+    // Too small a buffer writes nothing
+    char small[15];
+    Ip6Address mapped = address("::ffff:192.0.2.1");
+    CHECK(mapped.format(small, sizeof(small)) == 0);
+    char exact[17];
+    CHECK(mapped.format(exact, sizeof(exact)) == 16);
+}
+
+// Addresses built from zero, 0xffff, small and random groups, so zero runs of every
+// length and position, ties, and mapped prefixes all come up
+static void testFormatMatchesInetNtop() {
+    std::mt19937 rng(15);
+    const int kAddresses = 500000;
+    for(int i = 0; i < kAddresses; ++i) {
+        uint16_t groups[8];
+        for(uint16_t &group : groups) {
+            switch(rng() % 6) {
+            case 0:
+            case 1:
+            case 2:
+                group = 0;
+                break;
+            case 3:
+                group = 0xFFFF;
+                break;
+            case 4:
+                group = rng() % 16;
+                break;
+            default:
+                group = static_cast<uint16_t>(rng());
+            }
+        }
+        checkFormat(fromGroups(groups));
+    }
+    for(int v = 0; v < 65536; ++v) {
+        checkFormat(fromGroups({0, 0, 0, 0, 0, 0xFFFF, static_cast<uint16_t>(v), 0}));
+        checkFormat(fromGroups({0, 0, 0, 0, 0, 0, static_cast<uint16_t>(v), 1}));
+        checkFormat(fromGroups({0, 0, 0, 0, 0, 0, 0, static_cast<uint16_t>(v)}));
+    }
+    CHECK(formatMismatches == 0);
+    printf("  %zu format mismatches against inet_ntop\n", formatMismatches);
+}
+
+// inet_ntop's output, and single-character edits of it, parsed by both
+static void testParseMatchesInetPton() {
+    std::mt19937 rng(16);
+    const char kAlphabet[] = "0123456789abcdefABCDEFgx:.:.";
+    size_t mismatches = 0, accepted = 0, tried = 0;
+    for(int i = 0; i < 200000; ++i) {
+        uint16_t groups[8];
+        for(uint16_t &group : groups)
+            group = rng() % 3 == 0 ? 0 : rng() % 2 ? 0xFFFF : static_cast<uint16_t>(rng());
+        std::string text = ntop(fromGroups(groups));
+
+        switch(rng() % 4) {
+        case 0:
+            break;
+        case 1:
+            text[rng() % text.size()] = kAlphabet[rng() % (sizeof(kAlphabet) - 1)];
+            break;
+        case 2:
+            text.insert(rng() % (text.size() + 1), 1, kAlphabet[rng() % (sizeof(kAlphabet) - 1)]);
+            break;
+        default:
+            text.erase(rng() % text.size(), 1);
+        }
+
+        Ip6Address ours = {}, theirs = {};
+        bool ok = Ip6Address::parse(text.c_str(), ours);
+        bool expected = inet_pton(AF_INET6, text.c_str(), theirs.bytes) == 1;
+        tried++;
+        accepted += expected;
+        if(ok != expected || (ok && ours != theirs)) {
+            if(mismatches++ < 10)
+                printf("  \"%s\": parse %d, inet_pton %d\n", text.c_str(), ok, expected);
+        }
+    }
+    CHECK(mismatches == 0);
+    printf("  %zu of %zu texts valid, %zu parse mismatches against inet_pton\n", accepted, tried,
+           mismatches);
+}
+
+// Sends from a to b through sendUdp(Ip6Address), received by a view callback
+static void testDataPathAllocatesNothing() {
+    TestMesh mesh;
+    LightThread a, b;
+    mesh.add(a, "fd00::a");
+    size_t nodeB = mesh.add(b, "fd00::b");
+    a.setLogLevel(LT_LOG_NONE);
+    b.setLogLevel(LT_LOG_NONE);
+    size_t received = 0;
+    b.registerUdpViewCallback(
+        [&](const Ip6Address &, bool, const uint8_t *, size_t) { received++; });
+
+    const Ip6Address dest = mesh.addressOf(nodeB);
+    const std::vector<uint8_t> payload(32, 0x5A);
+    const int kMessages = 200;
+    auto exchange = [&] {
+        for(int i = 0; i < kMessages; ++i) {
+            size_t target = received + 2;
+            CHECK(a.sendUdp(dest, false, payload) == SendStatus::OK);
+            CHECK(a.sendUdp(dest, true, payload) == SendStatus::OK);
+            CHECK(mesh.runUntil([&] { return received >= target; }, 1000));
+        }
+    };
+
+    exchange(); // the reliable stream, and each node's own address
+    AllocationCount allocated = allocationsDuring(exchange);
+    CHECK(received == 4 * kMessages);
+    CHECK(allocated.count == 0);
+    printf("  %zu allocations, %zu bytes for %d messages\n", allocated.count, allocated.bytes,
+           2 * kMessages);
+}
+
+int main() {
+    RUN_TEST(testFormatKnown);
+    RUN_TEST(testFormatMatchesInetNtop);
+    RUN_TEST(testParseMatchesInetPton);
+    RUN_TEST(testDataPathAllocatesNothing);
+    return testResult();
+}
@@ -0,0 +1,335 @@
+// The leader's joiner registry, built for 512 joiners: random inserts, lookups and removals
+// checked against a std::map, and the cost of a steady-state heartbeat at 500 joiners
+// through the leader's handler, next to a replica of the String-keyed std::map it replaced.
+// Then expiry on the stub clock: each of 500 joiners that falls silent leaves exactly at
+// its last heartbeat plus its timeout, with one leave callback, also across a millis()
+// wrap; and what a heartbeat and an expiry pass cost at that size, next to a replica of the
+// full sweep expiry replaced. Logging is at WARN, so the per-heartbeat INFO line is not
+// formatted. Host figures only.
+#include "LightThreadTest.h"
+#include <chrono>
+#include <climits>
+#include <map>
+#include <random>
+
+static_assert(LT_MAX_JOINERS >= 500, "built with the large registry");
+
+static Ip6Address joinerAddress(size_t i) {
+    char text[32];
+    snprintf(text, sizeof(text), "fd00::%zx", i + 1);
+    return address(text);
+}
+
+// MAC hashes look random; spread evenly, they would never share a probe run
+static uint64_t joinerId(size_t i) {
+    uint64_t z = (i + 1) * 0x9E3779B97F4A7C15ULL; // splitmix64
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Removal happens only through expiry, so entries are given random timeouts and the clock
+// moves on; the model drops an entry at the same moment
+static void testMatchesMap() {
+    host::useSimulatedClock();
+    std::mt19937_64 rng(14);
+    JoinerRegistry registry;
+    struct Model {
+        Ip6Address addr;
+        unsigned long deadline;
+    };
+    std::map<uint64_t, Model> model;
+    size_t mismatches = 0, removed = 0, full = 0;
+
+    for(int round = 0; round < 4000; ++round) {
+        for(int op = 0; op < 20; ++op) {
+            size_t i = rng() % 700; // more ids than fit, so the registry fills up
+            uint64_t id = joinerId(i);
+            JoinerInfo *entry = registry.find(id);
+            mismatches += (entry != nullptr) != (model.count(id) != 0);
+            if(rng() % 2 == 0)
+                continue;
+
+            entry = registry.insert(id);
+            if(!entry) {
+                full++;
+                mismatches += model.count(id) != 0 || registry.size() != LT_MAX_JOINERS;
+                continue;
+            }
+            // As the heartbeat handler does: a new entry gets its timeout, a known one is
+            // only seen again
+            if(entry->lastSeen == 0)
+                entry->timeout = 1 + rng() % 400;
+            entry->addr = joinerAddress(i);
+            entry->lastSeen = millis();
+            model[id] = {entry->addr, entry->lastSeen + entry->timeout};
+        }
+
+        host::advance(1 + rng() % 5);
+        JoinerInfo gone;
+        while(registry.popExpired(millis(), gone)) {
+            auto it = model.find(gone.id);
+            mismatches += it == model.end() || it->second.deadline > millis();
+            if(it != model.end())
+                model.erase(it);
+            removed++;
+        }
+
+        mismatches += registry.size() != model.size();
+        for(const auto &entry : model) {
+            const JoinerInfo *joiner = registry.find(entry.first);
+            mismatches += !joiner || joiner->addr != entry.second.addr ||
+                          registry.findByAddress(entry.second.addr) != joiner;
+            mismatches += static_cast<long>(millis() - entry.second.deadline) >= 0;
+        }
+    }
+    printf("  %zu removals, %zu inserts refused as full, %zu left, %zu mismatches\n", removed,
+           full, model.size(), mismatches);
+    CHECK(mismatches == 0);
+    CHECK(removed > 10000);
+    CHECK(full > 0);
+}
+
+// What the handler did before the registry: the address as a String key, looked up twice
+struct MapReplica {
+    std::map<String, unsigned long> joinerHeartbeatMap;
+
+    bool heartbeat(const Ip6Address &src) {
+        String ip = src.text().c_str();
+        bool appeared = joinerHeartbeatMap.count(ip) == 0;
+        joinerHeartbeatMap[ip] = millis();
+        return appeared;
+    }
+};
+
+static std::vector<uint8_t> heartbeatFrame(uint64_t id) {
+    std::vector<uint8_t> frame = {AckType::NONE, MessageType::HEARTBEAT};
+    for(int i = 7; i >= 0; --i)
+        frame.push_back(static_cast<uint8_t>(id >> (i * 8)));
+    return frame;
+}
+
+static void testHeartbeatCost() {
+    using Clock = std::chrono::steady_clock;
+    const int kRounds = 400;
+    printf("  joiners  handler ns  registry ns  String map ns  (per heartbeat)\n");
+
+    double handlerFew = 0, handlerMany = 0;
+    for(size_t count : {10, 100, 500}) {
+        host::useSimulatedClock();
+        host::setSendHandler([](const host::Datagram &) {}); // echoes
+        LightThread leader;
+        LightThreadTest::useBackend(leader, UdpBackend::NATIVE);
+        LightThreadTest::makeLeader(leader);
+        leader.setLogLevel(LT_LOG_WARN);
+
+        std::vector<std::vector<uint8_t>> frames;
+        std::vector<Ip6Address> sources;
+        MapReplica replica;
+        for(size_t i = 0; i < count; ++i) {
+            frames.push_back(heartbeatFrame(joinerId(i)));
+            sources.push_back(joinerAddress(i));
+            LightThreadTest::receive(leader, sources[i], frames[i].data(), frames[i].size());
+            replica.heartbeat(sources[i]);
+        }
+        REQUIRE(leader.joinerCount() == count);
+
+        // Steady state: every joiner known, heartbeats arriving in a shuffled order
+        std::vector<size_t> order;
+        for(int round = 0; round < kRounds; ++round) {
+            for(size_t i = 0; i < count; ++i)
+                order.push_back(i);
+        }
+        std::shuffle(order.begin(), order.end(), std::mt19937(14));
+
+        auto time = [&](auto fn) {
+            auto start = Clock::now();
+            for(size_t i : order)
+                fn(i);
+            auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start);
+            return elapsed.count() / order.size();
+        };
+
+        double handlerNs = time([&](size_t i) {
+            LightThreadTest::receive(leader, sources[i], frames[i].data(), frames[i].size());
+        });
+        JoinerRegistry registry;
+        for(size_t i = 0; i < count; ++i)
+            registry.insert(joinerId(i))->addr = sources[i];
+        size_t appeared = 0;
+        double registryNs = time([&](size_t i) {
+            JoinerInfo *joiner = registry.insert(joinerId(i));
+            appeared += joiner->addr != sources[i];
+            joiner->lastSeen = millis();
+        });
+        double mapNs = time([&](size_t i) { appeared += replica.heartbeat(sources[i]); });
+        host::setSendHandler(nullptr);
+
+        CHECK(appeared == 0);
+        CHECK(leader.joinerCount() == count);
+        printf("  %7zu  %10.0f  %11.0f  %13.0f\n", count, handlerNs, registryNs, mapNs);
+        if(count == 10)
+            handlerFew = handlerNs;
+        handlerMany = handlerNs;
+        CHECK(registryNs < mapNs);
+    }
+    // A heartbeat costs about the same however many joiners there are
+    CHECK(handlerMany < 2 * handlerFew + 100);
+}
+
+struct Leave {
+    size_t joiner;
+    unsigned long at;
+};
+
+// 500 joiners heartbeat every 1-3.9 s with a timeout of LT_JOINER_TIMEOUT, 4 s or 30 s, the
+// last two set with setJoinerTimeout() once they are known; a third fall silent at a random
+// time in the first 20 s. The leader runs update() every ms.
+static void expiry(unsigned long startMs) {
+    const size_t kJoiners = 500;
+    const unsigned long kRunMs = 60000;
+    host::useSimulatedClock(startMs);
+    host::setSendHandler([](const host::Datagram &) {});
+    LightThread leader;
+    LightThreadTest::useBackend(leader, UdpBackend::NATIVE);
+    LightThreadTest::makeLeader(leader);
+    leader.setLogLevel(LT_LOG_WARN);
+
+    std::vector<Leave> leaves;
+    leader.registerLeaveCallback([&](const Ip6Address &ip, const String &) {
+        for(size_t i = 0; i < kJoiners; ++i) {
+            if(ip == joinerAddress(i))
+                leaves.push_back({i, millis()});
+        }
+    });
+
+    std::mt19937 rng(17);
+    std::vector<unsigned long> period(kJoiners), timeout(kJoiners), lastSeen(kJoiners);
+    std::vector<unsigned long> silentAfter(kJoiners, kRunMs), nextBeat(kJoiners);
+    std::vector<bool> seen(kJoiners, false);
+    std::vector<std::vector<uint8_t>> frames;
+    for(size_t i = 0; i < kJoiners; ++i) {
+        period[i] = 1000 + rng() % 2900;
+        timeout[i] = i % 3 == 0 ? 4000 : i % 3 == 1 ? 30000 : LT_JOINER_TIMEOUT;
+        if(rng() % 3 == 0)
+            silentAfter[i] = 1000 + rng() % 19000; // ms into the run
+        nextBeat[i] = startMs + rng() % period[i];
+        frames.push_back(heartbeatFrame(joinerId(i)));
+    }
+
+    for(unsigned long elapsed = 0; elapsed < kRunMs; ++elapsed) {
+        unsigned long now = millis();
+        for(size_t i = 0; i < kJoiners; ++i) {
+            if(now != nextBeat[i] || elapsed >= silentAfter[i])
+                continue;
+            bool known = leader.setJoinerTimeout(joinerId(i), timeout[i]);
+            LightThreadTest::receive(leader, joinerAddress(i), frames[i].data(), frames[i].size());
+            if(!known && timeout[i] != LT_JOINER_TIMEOUT)
+                CHECK(leader.setJoinerTimeout(joinerId(i), timeout[i]));
+            lastSeen[i] = now;
+            seen[i] = true;
+            nextBeat[i] = now + period[i];
+        }
+        leader.update();
+        host::advance(1);
+    }
+    host::setSendHandler(nullptr);
+
+    size_t early = 0, late = 0, silent = 0;
+    unsigned long worstLate = 0;
+    std::vector<size_t> count(kJoiners, 0);
+    for(const Leave &leave : leaves) {
+        count[leave.joiner]++;
+        unsigned long due = lastSeen[leave.joiner] + timeout[leave.joiner];
+        early += static_cast<long>(leave.at - due) < 0;
+        late += static_cast<long>(leave.at - due) > 0;
+        if(static_cast<long>(leave.at - due) > 0)
+            worstLate = std::max(worstLate, leave.at - due);
+    }
+    size_t wrong = 0;
+    for(size_t i = 0; i < kJoiners; ++i) {
+        // One that fell silent before its first heartbeat was never known
+        bool gone = seen[i] && silentAfter[i] < kRunMs;
+        silent += gone;
+        wrong += count[i] != (gone ? 1u : 0u);
+    }
+    printf("  start %20lu: %zu silent, %zu left, %zu early, %zu late (worst %lu ms), %zu "
+           "wrong count\n",
+           startMs, silent, leaves.size(), early, late, worstLate, wrong);
+    CHECK(early == 0 && late == 0);
+    CHECK(wrong == 0);
+    size_t known = std::count(seen.begin(), seen.end(), true);
+    CHECK(leader.joinerCount() == known - silent);
+}
+
+static void testExpiryExact() {
+    expiry(1000);
+    expiry(ULONG_MAX - 15000); // millis() wraps during the run
+}
+
+// What expiry did before the heap: every 5 s, the whole String-keyed map swept
+static size_t sweep(std::map<String, unsigned long> &joinerHeartbeatMap, unsigned long now) {
+    size_t removed = 0;
+    for(auto it = joinerHeartbeatMap.begin(); it != joinerHeartbeatMap.end();) {
+        if(now - it->second > LT_JOINER_TIMEOUT) {
+            it = joinerHeartbeatMap.erase(it);
+            removed++;
+        } else {
+            ++it;
+        }
+    }
+    return removed;
+}
+
+static void testExpiryCost() {
+    using Clock = std::chrono::steady_clock;
+    const size_t kJoiners = 500;
+    const int kPasses = 20000;
+    host::useSimulatedClock();
+    host::setSendHandler([](const host::Datagram &) {});
+    LightThread leader;
+    LightThreadTest::useBackend(leader, UdpBackend::NATIVE);
+    LightThreadTest::makeLeader(leader);
+    leader.setLogLevel(LT_LOG_WARN);
+
+    std::map<String, unsigned long> replica;
+    std::vector<std::vector<uint8_t>> frames;
+    std::vector<Ip6Address> sources;
+    for(size_t i = 0; i < kJoiners; ++i) {
+        frames.push_back(heartbeatFrame(joinerId(i)));
+        sources.push_back(joinerAddress(i));
+        LightThreadTest::receive(leader, sources[i], frames[i].data(), frames[i].size());
+        replica[sources[i].text().c_str()] = millis();
+        host::advance(10); // spread over 5 s, like heartbeats
+    }
+    LightThreadTest::expireJoiners(leader); // arms the new entries
+
+    auto nsPer = [](int n, auto fn) {
+        auto start = Clock::now();
+        for(int i = 0; i < n; ++i)
+            fn(i);
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / n;
+    };
+    double heartbeatNs = nsPer(kPasses, [&](int i) {
+        size_t j = i % kJoiners;
+        LightThreadTest::receive(leader, sources[j], frames[j].data(), frames[j].size());
+    });
+    double passNs = nsPer(kPasses, [&](int) { LightThreadTest::expireJoiners(leader); });
+    size_t removed = 0;
+    double sweepNs = nsPer(kPasses, [&](int) { removed += sweep(replica, millis()); });
+    host::setSendHandler(nullptr);
+
+    printf("  %zu joiners: heartbeat %.0f ns, expiry pass %.1f ns, full sweep %.0f ns\n",
+           kJoiners, heartbeatNs, passNs, sweepNs);
+    CHECK(removed == 0);
+    CHECK(leader.joinerCount() == kJoiners);
+    CHECK(passNs * 10 < sweepNs);
+}
+
+int main() {
+    RUN_TEST(testMatchesMap);
+    RUN_TEST(testHeartbeatCost);
+    RUN_TEST(testExpiryExact);
+    RUN_TEST(testExpiryCost);
+    return testResult();
+}
@@ -0,0 +1,291 @@
+// Shared helpers of the host tests. LightThreadTest is befriended by LightThread, so the
+// tests can drive the internals a device reaches through the CLI or the radio.
+#pragma once
+
+#include "Check.h"
+#include "Host.h"
+#include <LightThread.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+inline Ip6Address address(const char *text) {
+    Ip6Address out = {};
+    Ip6Address::parse(text, out);
+    return out;
+}
+
+struct LightThreadTest {
+    // Selects the UDP backend without begin(); on the host the state machine never gets
+    // past INIT, since there is no stored config. The native socket is opened unless
+    // `open` is false.
+    static void useBackend(LightThread &lt, UdpBackend backend, bool open = true) {
+        lt.udpBackend = backend;
+        if(backend == UdpBackend::NATIVE && open)
+            lt.openNativeUdp();
+    }
+
+    static otUdpSocket &socket(LightThread &lt) { return lt.nativeSocket; }
+
+    static void execAsync(LightThread &lt, const char *command,
+                          std::function<void(bool ok, const String &response)> done,
+                          unsigned long timeoutMs = 1000) {
+        lt.execAsync(command, done, timeoutMs);
+    }
+
+    // Puts the state machine where a test needs it, as if the path to it had been taken
+    static void enterState(LightThread &lt, Role role, State state) {
+        lt.role = role;
+        lt.setState(state);
+    }
+
+    static void setLeader(LightThread &lt, const Ip6Address &leader) { lt.leaderIp = leader; }
+
+    // A leader with its network up, waiting for joiners
+    static void makeLeader(LightThread &lt) { enterState(lt, Role::LEADER, State::STANDBY); }
+
+    // A joiner paired with `leader`, its first heartbeat due at once
+    static void makePairedJoiner(LightThread &lt, const Ip6Address &leader) {
+        setLeader(lt, leader);
+        setHeartbeatTimes(lt, millis() - 5000, millis());
+        enterState(lt, Role::JOINER, State::JOINER_PAIRED);
+    }
+
+    // Leader: the dataset and Thread start commands run from INIT, past the stored config
+    static void bootstrapLeaderNetwork(LightThread &lt) {
+        enterState(lt, Role::LEADER, State::INIT);
+        lt.justEntered = false;
+        lt.bootstrapLeaderNetwork();
+    }
+
+    // Joiner: the Thread settings and socket setup done before attaching
+    static void setupJoinerThreadDefaults(LightThread &lt) { lt.setupJoinerThreadDefaults(); }
+
+    static uint64_t macHash(LightThread &lt) { return lt.generateMacHash(); }
+
+    // Leader: the topics it holds for the joiner at `addr`; empty if it is unknown
+    static std::vector<uint16_t> joinerTopics(LightThread &lt, const Ip6Address &addr) {
+        const JoinerInfo *joiner = lt.joiners.findByAddress(addr);
+        if(!joiner)
+            return {};
+        return std::vector<uint16_t>(joiner->topics, joiner->topics + joiner->topicCount);
+    }
+
+    // The leader's group send table, allocated by the first sendGroup()
+    static bool hasGroupSends(LightThread &lt) { return lt.groupSends != nullptr; }
+
+    // The deferred event queue, allocated when deferred delivery is first turned on
+    static bool hasEventQueue(LightThread &lt) { return lt.eventRing != nullptr; }
+
+    // A LightThread making LT_LOG calls of its own, as its members do, at DEBUG and INFO on
+    // the UDP subsystem, and counting the evaluations of their argument
+    struct LogProbe : LightThread {
+        int evaluated = 0;
+
+        const char *argument() {
+            evaluated++;
+            return "argument";
+        }
+        void logDebug() { LT_LOG(UDP, LT_LOG_DEBUG, "Probe: debug %s", argument()); }
+        void logInfo() { LT_LOG(UDP, LT_LOG_INFO, "Probe: info %s", argument()); }
+    };
+
+    // Joiner: its topic list awaits the leader's confirmation
+    static bool subscriptionPending(LightThread &lt) { return lt.subscriptionPending; }
+
+    static void setHeartbeatTimes(LightThread &lt, unsigned long sent, unsigned long echo) {
+        lt.lastHeartbeatSent = sent;
+        lt.lastHeartbeatEcho = echo;
+    }
+
+    // Leader: one expiry pass, as update() makes
+    static void expireJoiners(LightThread &lt) { lt.expireJoiners(); }
+
+    // Joiner: when the leader last showed it still hears us, by echo or beacon
+    static unsigned long lastHeartbeatEcho(LightThread &lt) { return lt.lastHeartbeatEcho; }
+
+    // Whether a BEACON payload lists device `id`
+    static bool beaconLists(const uint8_t *payload, size_t length, uint64_t id) {
+        return LightThread::beaconLists(payload, length, id);
+    }
+
+    static bool hexToBytes(const char *hex, size_t hexLen, uint8_t *out, size_t outCap,
+                           size_t &outLen) {
+        return LightThread::convertHexToBytes(hex, hexLen, out, outCap, outLen);
+    }
+
+    static size_t bytesToHex(const uint8_t *data, size_t len, char *out, size_t outCap) {
+        return LightThread::convertBytesToHex(data, len, out, outCap);
+    }
+
+    static size_t lzCompress(const uint8_t *in, size_t inLen, uint8_t *out, size_t outCap) {
+        return LightThread::lzCompress(in, inLen, out, outCap);
+    }
+
+    static size_t lzDecompress(const uint8_t *in, size_t inLen, uint8_t *out, size_t outCap) {
+        return LightThread::lzDecompress(in, inLen, out, outCap);
+    }
+
+    // The sequence number the next reliable message to `dest` (channel 0) will carry
+    static void setNextSeq(LightThread &lt, const Ip6Address &dest, uint16_t seq) {
+        lt.reliablePeer(dest, 0)->nextSeq = seq;
+    }
+
+    // The next in-order sequence number `lt` expects from `src` (channel 0)
+    static uint16_t rcvNext(LightThread &lt, const Ip6Address &src) {
+        return lt.findReliablePeer(src, 0)->rcvNext;
+    }
+
+    // Whether `lt` keeps stream state for `addr` (channel 0)
+    static bool hasStream(LightThread &lt, const Ip6Address &addr) {
+        return lt.findReliablePeer(addr, 0) != nullptr;
+    }
+
+    // One pass of the reliable retry and deadline timers, as update() makes
+    static void updateReliable(LightThread &lt) { lt.updateReliableUdp(); }
+
+    // A datagram (frame header included) arriving from `src`
+    static void receive(LightThread &lt, const Ip6Address &src, const uint8_t *frame,
+                        size_t length) {
+        lt.handleUdpPacket(src, frame, length);
+    }
+};
+
+// Nodes on the native backend joined by a fake radio, on the simulated clock. Datagrams
+// sent are queued, then handed to their destination (every other node for multicast)
+// once per step(), which also runs each node's update() and moves the clock 1 ms. Each
+// node runs with its own address as host identity. A datagram for which `drop` returns
+// true is lost; one for which `latency` returns a number of ms arrives that much later.
+class TestMesh {
+  public:
+    std::function<bool(const host::Datagram &datagram, size_t from, size_t to)> drop;
+    std::function<unsigned long(const host::Datagram &datagram, size_t from, size_t to)> latency;
+    size_t delivered = 0;
+    size_t dropped = 0;
+
+    TestMesh() {
+        host::useSimulatedClock();
+        host::setSendHandler([this](const host::Datagram &datagram) { queue.push_back(datagram); });
+    }
+
+    ~TestMesh() { host::setSendHandler(nullptr); }
+
+    size_t add(LightThread &lt, const char *ip) {
+        LightThreadTest::useBackend(lt, UdpBackend::NATIVE);
+        nodes.push_back({&lt, address(ip)});
+        return nodes.size() - 1;
+    }
+
+    // A restarted device at the same address; what the old one had queued is lost
+    void replace(size_t node, LightThread &lt) {
+        const otUdpSocket *old = &LightThreadTest::socket(*nodes[node].lt);
+        queue.erase(std::remove_if(queue.begin(), queue.end(),
+                                   [old](const host::Datagram &d) { return d.socket == old; }),
+                    queue.end());
+        LightThreadTest::useBackend(lt, UdpBackend::NATIVE);
+        nodes[node].lt = &lt;
+    }
+
+    const Ip6Address &addressOf(size_t node) const { return nodes[node].addr; }
+
+    // Node `node`, with the host identity switched to it, for calls made outside step()
+    LightThread &as(size_t node) {
+        host::setIdentity(nodes[node].addr.toOt());
+        return *nodes[node].lt;
+    }
+
+    void step() {
+        for(Node &node : nodes) {
+            host::setIdentity(node.addr.toOt());
+            node.lt->update();
+        }
+        std::deque<host::Datagram> batch = takeQueue();
+        for(const host::Datagram &datagram : batch) {
+            size_t from = nodeOf(datagram.socket);
+            if(from == SIZE_MAX)
+                continue;
+            Ip6Address dest = Ip6Address::fromOt(datagram.peer);
+            for(size_t to = 0; to < nodes.size(); ++to) {
+                if(to == from || (!dest.isMulticast() && !(dest == nodes[to].addr)))
+                    continue;
+                unsigned long delay;
+                {
+                    host::HarnessScope harness;
+                    if(drop && drop(datagram, from, to)) {
+                        dropped++;
+                        continue;
+                    }
+                    delay = latency ? latency(datagram, from, to) : 0;
+                    if(delay > 0)
+                        inFlight.push_back({millis() + delay, from, to, datagram});
+                }
+                if(delay == 0)
+                    receive(from, to, datagram);
+            }
+        }
+        for(size_t i = 0; i < inFlight.size();) {
+            if(static_cast<long>(millis() - inFlight[i].due) < 0) {
+                ++i;
+                continue;
+            }
+            InFlight arrived = std::move(inFlight[i]);
+            inFlight.erase(inFlight.begin() + i);
+            receive(arrived.from, arrived.to, arrived.datagram);
+        }
+        host::advance(1);
+    }
+
+    void run(unsigned long ms) {
+        for(unsigned long i = 0; i < ms; ++i)
+            step();
+    }
+
+    // Steps until `done()` or `maxMs`; returns whether `done()` came true
+    bool runUntil(std::function<bool()> done, unsigned long maxMs) {
+        for(unsigned long i = 0; i < maxMs; ++i) {
+            if(done())
+                return true;
+            step();
+        }
+        return done();
+    }
+
+  private:
+    struct Node {
+        LightThread *lt;
+        Ip6Address addr;
+    };
+
+    struct InFlight {
+        unsigned long due;
+        size_t from;
+        size_t to;
+        host::Datagram datagram;
+    };
+
+    std::deque<host::Datagram> takeQueue() {
+        host::HarnessScope harness;
+        std::deque<host::Datagram> batch;
+        batch.swap(queue);
+        return batch;
+    }
+
+    void receive(size_t from, size_t to, const host::Datagram &datagram) {
+        delivered++;
+        host::setIdentity(nodes[to].addr.toOt());
+        LightThreadTest::receive(*nodes[to].lt, nodes[from].addr, datagram.data.data(),
+                                 datagram.data.size());
+    }
+
+    size_t nodeOf(const otUdpSocket *socket) const {
+        for(size_t i = 0; i < nodes.size(); ++i) {
+            if(&LightThreadTest::socket(*nodes[i].lt) == socket)
+                return i;
+        }
+        return SIZE_MAX;
+    }
+
+    std::vector<Node> nodes;
+    std::deque<host::Datagram> queue;
+    std::vector<InFlight> inFlight; // delayed by `latency`, in the order sent
+};
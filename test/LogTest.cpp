@@ -0,0 +1,144 @@
+// LT_LOG filtering, with the library built for LT_LOG_MIN_LEVEL=LT_LOG_INFO. A DEBUG call,
+// such as the per-retry and per-ACK lines of ReliableUDP, is compiled out: its arguments
+// are never evaluated and nothing is logged, whatever the runtime levels, and its format
+// string is not in the binary. An INFO call on a subsystem whose runtime level is above
+// INFO returns before evaluating its arguments or formatting, while the other subsystems
+// keep logging.
+#include "LightThreadTest.h"
+#include <fstream>
+#include <iterator>
+
+static_assert(LT_LOG_MIN_LEVEL == LT_LOG_INFO, "built with DEBUG and VERBOSE compiled out");
+
+static const Ip6Address kLeader = address("fd00::1");
+static const Ip6Address kJoiner = address("fd00::2");
+
+// The lines logged while a Capture exists
+struct Capture {
+    std::vector<std::string> lines;
+
+    Capture() {
+        host::setLogHandler([this](char level, const char *line) {
+            lines.push_back(std::string(1, level) + " " + line);
+        });
+    }
+    ~Capture() { host::setLogHandler(nullptr); }
+
+    size_t count(const std::string &text) const {
+        size_t n = 0;
+        for(const std::string &line : lines)
+            n += line.find(text) != std::string::npos;
+        return n;
+    }
+};
+
+// `text` with '#' for spaces, so the test's own literal does not match in the binary
+static std::string spaced(std::string text) {
+    for(char &c : text) {
+        if(c == '#')
+            c = ' ';
+    }
+    return text;
+}
+
+static bool inBinary(const std::string &text) {
+    std::ifstream file("/proc/self/exe", std::ios::binary);
+    std::string image((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return image.find(text) != std::string::npos;
+}
+
+static void testDebugCompiledOut() {
+    LightThreadTest::LogProbe probe;
+    probe.setLogLevel(LT_LOG_VERBOSE);
+    Capture capture;
+    for(int i = 0; i < 10; ++i)
+        probe.logDebug();
+    CHECK(probe.evaluated == 0);
+    CHECK(capture.lines.empty());
+    CHECK(!inBinary(spaced("Probe:#debug")));
+    CHECK(inBinary(spaced("Probe:#info")));
+}
+
+// An unanswered reliable send is retried until dropped: the INFO drop is logged, the DEBUG
+// retries are not, even with every subsystem at VERBOSE
+static void testRetriesNotLogged() {
+    host::useSimulatedClock();
+    host::setSendHandler([](const host::Datagram &) {});
+    LightThread lt;
+    LightThreadTest::useBackend(lt, UdpBackend::NATIVE);
+    lt.setLogLevel(LT_LOG_VERBOSE);
+
+    Capture capture;
+    REQUIRE(lt.sendUdp(kJoiner, true, {1, 2, 3}) == SendStatus::OK);
+    for(int i = 0; i < 2 * LT_RELIABLE_DEFAULT_DEADLINE; ++i) {
+        host::advance(1);
+        LightThreadTest::updateReliable(lt);
+    }
+
+    CHECK(lt.getStats().retransmissions > 0);
+    CHECK(capture.count("I [LightThread] ReliableUDP: Dropping msgId") == 1);
+    CHECK(capture.count("Retrying") == 0);
+    for(const std::string &line : capture.lines)
+        CHECK(line[0] != 'D' && line[0] != 'V');
+
+    CHECK(inBinary(spaced("ReliableUDP:#Dropping#msgId")));
+    CHECK(!inBinary(spaced("ReliableUDP:#Retrying#msgId")));
+    CHECK(!inBinary(spaced("ReliableUDP:#ACK#received#for#msgId")));
+}
+
+static void testRuntimeLevelSkipsFormatting() {
+    LightThreadTest::LogProbe probe;
+    Capture capture;
+    probe.logInfo();
+    CHECK(probe.evaluated == 1);
+    CHECK(capture.count("I [LightThread] Probe: info argument") == 1);
+
+    probe.setLogLevel(LogSubsystem::UDP, LT_LOG_WARN);
+    capture.lines.clear();
+    for(int i = 0; i < 10; ++i)
+        probe.logInfo();
+    CHECK(probe.evaluated == 1);
+    CHECK(capture.lines.empty());
+
+    probe.setLogLevel(LogSubsystem::UDP, LT_LOG_INFO);
+    probe.logInfo();
+    CHECK(probe.evaluated == 2);
+}
+
+// A leader's INFO line per heartbeat goes once UDP is at WARN; FSM still logs at INFO
+static void testSubsystemLevels() {
+    host::useSimulatedClock();
+    host::setSendHandler([](const host::Datagram &) {}); // echoes
+    host::setIdentity(kLeader.toOt());
+    LightThread leader;
+    LightThreadTest::useBackend(leader, UdpBackend::NATIVE);
+    LightThreadTest::makeLeader(leader);
+
+    std::vector<uint8_t> heartbeat = {AckType::NONE, MessageType::HEARTBEAT};
+    for(int i = 0; i < 8; ++i)
+        heartbeat.push_back(static_cast<uint8_t>(0x10 + i));
+
+    Capture capture;
+    LightThreadTest::receive(leader, kJoiner, heartbeat.data(), heartbeat.size());
+    CHECK(capture.count("I [LightThread] HEARTBEAT: Joiner fd00::2 [1011121314151617] is alive") ==
+          1);
+
+    leader.setLogLevel(LogSubsystem::UDP, LT_LOG_WARN);
+    capture.lines.clear();
+    for(int i = 0; i < 10; ++i) {
+        host::advance(100);
+        LightThreadTest::receive(leader, kJoiner, heartbeat.data(), heartbeat.size());
+    }
+    CHECK(capture.lines.empty());
+
+    LightThreadTest::enterState(leader, Role::LEADER, State::LEADER_WAIT_NETWORK);
+    CHECK(capture.count("I [LightThread] State transition") == 1);
+}
+
+int main() {
+    RUN_TEST(testDebugCompiledOut);
+    RUN_TEST(testRetriesNotLogged);
+    RUN_TEST(testRuntimeLevelSkipsFormatting);
+    RUN_TEST(testSubsystemLevels);
+    return testResult();
+}
@@ -0,0 +1,279 @@
+// Publish/subscribe through a leader on a TestMesh: topic lists applied in version order
+// and only from the joiner's own address, a restarted joiner renumbering past the list the
+// leader kept, a restarted leader asking for lists only once pub/sub is in use, a publisher
+// dropping its own multicast copy, relays bounded by the MTU, and publish latency and
+// datagrams per publish at different subscriber counts.
+#include "LightThreadTest.h"
+
+static const uint16_t kTopic = 7;
+
+// A leader (node 0) and `joiners` paired joiners, all registered with the leader
+struct PubSubMesh {
+    TestMesh mesh;
+    LightThread leader;
+    std::vector<LightThread> joiners;
+
+    explicit PubSubMesh(size_t joinerCount) : joiners(joinerCount) {
+        mesh.add(leader, "fd00::100");
+        LightThreadTest::makeLeader(leader);
+        for(size_t i = 0; i < joinerCount; ++i) {
+            std::string ip = "fd00::" + std::to_string(i + 1);
+            size_t node = mesh.add(joiners[i], ip.c_str());
+            LightThreadTest::makePairedJoiner(mesh.as(node), mesh.addressOf(0));
+        }
+        mesh.run(10); // first heartbeats register the joiners
+        CHECK(leader.joinerCount() == joinerCount);
+    }
+
+    LightThread &joiner(size_t i) { return mesh.as(i + 1); }
+    const Ip6Address &joinerAddress(size_t i) { return mesh.addressOf(i + 1); }
+    std::vector<uint16_t> topicsOf(size_t i) {
+        return LightThreadTest::joinerTopics(leader, joinerAddress(i));
+    }
+};
+
+// [REQUEST][SUBSCRIBE][id:64][version:8][topic:16]...
+static std::vector<uint8_t> subscribeFrame(uint64_t id, uint8_t version,
+                                           std::vector<uint16_t> topics) {
+    std::vector<uint8_t> frame = {AckType::REQUEST, MessageType::SUBSCRIBE};
+    for(int i = 7; i >= 0; --i)
+        frame.push_back(static_cast<uint8_t>(id >> (i * 8)));
+    frame.push_back(version);
+    for(uint16_t topic : topics) {
+        frame.push_back(topic >> 8);
+        frame.push_back(topic & 0xFF);
+    }
+    return frame;
+}
+
+static bool isSubscribe(const host::Datagram &datagram) {
+    return datagram.data.size() >= 2 && datagram.data[0] == AckType::REQUEST &&
+           datagram.data[1] == MessageType::SUBSCRIBE;
+}
+
+// A list delayed past the one that replaced it must not bring the old topics back
+static void testDelayedListIgnored() {
+    PubSubMesh net(1);
+    std::vector<host::Datagram> held;
+    net.mesh.drop = [&](const host::Datagram &datagram, size_t, size_t) {
+        if(!isSubscribe(datagram) || !held.empty())
+            return false;
+        held.push_back(datagram);
+        return true;
+    };
+
+    CHECK(net.joiner(0).subscribe(1)); // held back
+    CHECK(net.joiner(0).subscribe(2));
+    net.mesh.run(10);
+    CHECK(net.topicsOf(0) == std::vector<uint16_t>({1, 2}));
+    CHECK(!LightThreadTest::subscriptionPending(net.joiner(0)));
+
+    REQUIRE(held.size() == 1);
+    LightThreadTest::receive(net.leader, net.joinerAddress(0), held[0].data.data(),
+                             held[0].data.size());
+    net.mesh.run(10);
+    CHECK(net.topicsOf(0) == std::vector<uint16_t>({1, 2}));
+    CHECK(!LightThreadTest::subscriptionPending(net.joiner(0)));
+}
+
+// A list naming a joiner, sent from another address, changes nothing
+static void testListFromOtherAddressIgnored() {
+    PubSubMesh net(2);
+    CHECK(net.joiner(0).subscribe(1));
+    net.mesh.run(10);
+
+    uint64_t id = LightThreadTest::macHash(net.joiner(0));
+    std::vector<uint8_t> forged = subscribeFrame(id, 100, {9});
+    LightThreadTest::receive(net.leader, net.joinerAddress(1), forged.data(), forged.size());
+    CHECK(net.topicsOf(0) == std::vector<uint16_t>({1}));
+    CHECK(net.topicsOf(1).empty());
+
+    // From the joiner's own address it applies
+    LightThreadTest::receive(net.leader, net.joinerAddress(0), forged.data(), forged.size());
+    CHECK(net.topicsOf(0) == std::vector<uint16_t>({9}));
+}
+
+// A joiner that restarts numbers its lists from scratch while the leader still holds a
+// later version; it learns that version from the leader and goes past it
+static void testRestartedJoinerRenumbers() {
+    PubSubMesh net(1);
+    for(uint16_t topic = 1; topic <= 5; ++topic) {
+        CHECK(net.joiner(0).subscribe(topic));
+        net.mesh.run(10);
+        net.joiner(0).unsubscribe(topic);
+        net.mesh.run(10);
+    }
+    CHECK(net.joiner(0).subscribe(6));
+    net.mesh.run(10);
+    CHECK(net.topicsOf(0) == std::vector<uint16_t>({6})); // version 11
+
+    LightThread restarted;
+    net.mesh.replace(1, restarted);
+    LightThreadTest::makePairedJoiner(net.mesh.as(1), net.mesh.addressOf(0));
+    CHECK(net.mesh.as(1).subscribe(42));
+    net.mesh.run(10);
+
+    CHECK(net.topicsOf(0) == std::vector<uint16_t>({42}));
+    CHECK(!LightThreadTest::subscriptionPending(net.mesh.as(1)));
+}
+
+static bool isResync(const host::Datagram &datagram) {
+    return datagram.data.size() >= 2 && datagram.data[0] == AckType::NONE &&
+           datagram.data[1] == MessageType::SUBSCRIBE;
+}
+
+// A restarted leader has lost every topic list. Joiners registering again are not asked for
+// theirs while nothing uses pub/sub; the first publish to relay asks all of them at once,
+// by one multicast, and from then on a joiner new to the registry is asked by unicast.
+static void testLeaderRestartResync() {
+    PubSubMesh net(3);
+    CHECK(net.joiner(1).subscribe(kTopic));
+    CHECK(net.joiner(2).subscribe(kTopic));
+    net.mesh.run(10);
+
+    std::vector<host::Datagram> resyncs;
+    net.mesh.drop = [&](const host::Datagram &datagram, size_t from, size_t to) {
+        if(from == 0 && isResync(datagram) && to == 1)
+            resyncs.push_back(datagram);
+        return false;
+    };
+    LightThread restarted;
+    net.mesh.replace(0, restarted);
+    LightThreadTest::makeLeader(net.mesh.as(0));
+    net.mesh.run(LT_BEACON_INTERVAL + 10);
+    CHECK(restarted.joinerCount() == 3);
+    CHECK(resyncs.empty());
+    CHECK(LightThreadTest::joinerTopics(restarted, net.joinerAddress(1)).empty());
+
+    size_t received = 0;
+    for(size_t i : {1, 2}) {
+        net.joiner(i).registerPublishCallback(
+            [&](uint16_t, const Ip6Address &, const std::vector<uint8_t> &) { received++; });
+    }
+    REQUIRE(net.joiner(0).publish(kTopic, {1}) == SendStatus::OK);
+    net.mesh.run(10);
+    REQUIRE(resyncs.size() == 1);
+    CHECK(Ip6Address::fromOt(resyncs[0].peer).isMulticast());
+    CHECK(LightThreadTest::joinerTopics(restarted, net.joinerAddress(1)) ==
+          std::vector<uint16_t>({kTopic}));
+    CHECK(LightThreadTest::joinerTopics(restarted, net.joinerAddress(2)) ==
+          std::vector<uint16_t>({kTopic}));
+    REQUIRE(net.joiner(0).publish(kTopic, {2}) == SendStatus::OK);
+    net.mesh.run(10);
+    CHECK(received == 2);
+
+    // A joiner that expires and comes back is asked by unicast; nothing more is multicast
+    size_t asked = 0;
+    net.mesh.drop = [&](const host::Datagram &datagram, size_t from, size_t to) {
+        if(from == 0 && isResync(datagram)) {
+            if(Ip6Address::fromOt(datagram.peer).isMulticast())
+                resyncs.push_back(datagram);
+            else
+                asked += to == 3;
+        }
+        return from == 3 && datagram.data[1] == MessageType::HEARTBEAT && millis() < 30000;
+    };
+    CHECK(net.mesh.runUntil([&] { return restarted.joinerCount() == 2; }, 30000));
+    CHECK(net.mesh.runUntil([&] { return restarted.joinerCount() == 3; }, 30000));
+    net.mesh.run(10);
+    CHECK(resyncs.size() == 1);
+    CHECK(asked == 1);
+    CHECK(LightThreadTest::joinerTopics(restarted, net.joinerAddress(2)) ==
+          std::vector<uint16_t>({kTopic}));
+}
+
+// A publisher subscribed to its own topic does not get its publish back from the relay,
+// though the multicast copy reaches it
+static void testPublisherDropsOwnCopy() {
+    PubSubMesh net(LT_PUBSUB_MULTICAST_MIN + 1);
+    std::vector<size_t> received(net.joiners.size());
+    for(size_t i = 0; i < net.joiners.size(); ++i) {
+        CHECK(net.joiner(i).subscribe(kTopic));
+        net.joiner(i).registerPublishCallback(
+            [&, i](uint16_t, const Ip6Address &publisher, const std::vector<uint8_t> &) {
+                CHECK(publisher == net.joinerAddress(0));
+                received[i]++;
+            });
+    }
+    net.mesh.run(10);
+    for(int p = 0; p < 3; ++p) {
+        REQUIRE(net.joiner(0).publish(kTopic, {1, 2, 3}) == SendStatus::OK);
+        net.mesh.run(5);
+    }
+    CHECK(net.leader.getStats().publishesRelayed == 3);
+    CHECK(received[0] == 0);
+    for(size_t i = 1; i < received.size(); ++i)
+        CHECK(received[i] == 3);
+}
+
+// A publish the leader could not relay within its MTU is dropped, not sent oversized
+static void testRelayBoundedByMtu() {
+    PubSubMesh net(2);
+    CHECK(net.joiner(1).subscribe(kTopic));
+    net.mesh.run(10);
+    size_t received = 0;
+    net.joiner(1).registerPublishCallback(
+        [&](uint16_t, const Ip6Address &, const std::vector<uint8_t> &) { received++; });
+
+    const uint16_t kMtu = 128;
+    net.leader.setUdpMtu(kMtu);
+    size_t largest = kMtu - 2 - 10; // frame header, relay header
+    for(size_t size : {largest, largest + 1, size_t(LT_MAX_UDP_FRAME - 2 - 10)}) {
+        std::vector<uint8_t> frame = {AckType::REQUEST, MessageType::PUBLISH, 0, kTopic};
+        frame.resize(frame.size() + size, 0xAB);
+        LightThreadTest::receive(net.leader, net.joinerAddress(0), frame.data(), frame.size());
+        net.mesh.run(5);
+    }
+    CHECK(received == 1);
+    CHECK(net.leader.getStats().publishesRelayed == 1);
+}
+
+// Latency from publish() to the last subscriber's callback, and datagrams per publish. The
+// mesh moves a datagram one hop per 1 ms step, so latency counts hops and update() passes.
+static void testFanOut() {
+    printf("  %-12s %-10s %12s %18s\n", "subscribers", "relay", "latency ms", "datagrams/publish");
+    for(size_t subscribers : {1, 2, 3, 4, 8, 16}) {
+        PubSubMesh net(subscribers + 1); // joiner 0 publishes
+        for(size_t i = 1; i <= subscribers; ++i)
+            CHECK(net.joiner(i).subscribe(kTopic));
+        net.mesh.run(10);
+
+        size_t received = 0;
+        for(size_t i = 1; i <= subscribers; ++i) {
+            net.joiner(i).registerPublishCallback(
+                [&](uint16_t, const Ip6Address &publisher, const std::vector<uint8_t> &) {
+                    CHECK(publisher == net.joinerAddress(0));
+                    received++;
+                });
+        }
+
+        const int kPublishes = 20;
+        unsigned long latency = 0;
+        for(int p = 0; p < kPublishes; ++p) {
+            size_t target = received + subscribers;
+            unsigned long start = millis();
+            REQUIRE(net.joiner(0).publish(kTopic, {1, 2, 3}) == SendStatus::OK);
+            CHECK(net.mesh.runUntil([&] { return received >= target; }, 100));
+            latency += millis() - start;
+        }
+        // Datagrams sent per publish, a multicast counted once however many nodes it
+        // reached: the request to the leader plus one relay, or one per subscriber
+        uint32_t relayed = net.leader.getStats().publishesRelayed;
+        CHECK(received == subscribers * kPublishes);
+        CHECK(relayed == kPublishes * (subscribers >= LT_PUBSUB_MULTICAST_MIN ? 1 : subscribers));
+        printf("  %-12zu %-10s %12.1f %18.1f\n", subscribers,
+               subscribers >= LT_PUBSUB_MULTICAST_MIN ? "multicast" : "unicast",
+               double(latency) / kPublishes, 1.0 + double(relayed) / kPublishes);
+    }
+}
+
+int main() {
+    RUN_TEST(testDelayedListIgnored);
+    RUN_TEST(testListFromOtherAddressIgnored);
+    RUN_TEST(testRestartedJoinerRenumbers);
+    RUN_TEST(testLeaderRestartResync);
+    RUN_TEST(testPublisherDropsOwnCopy);
+    RUN_TEST(testRelayBoundedByMtu);
+    RUN_TEST(testFanOut);
+    return testResult();
+}
@@ -0,0 +1,100 @@
+// The fixed pool behind reliable sends: a steady reliable stream, lossy or not, makes no
+// heap allocation once its peers are set up, and a full pool turns sendUdp() away with
+// QUEUE_FULL rather than growing. Allocations by the fake radio and OpenThread messages
+// (host::HarnessScope) are not the library's and are not counted.
+#include "AllocationCounter.h"
+#include "LightThreadTest.h"
+#include <new>
+#include <random>
+
+static void steadyStream(unsigned lossPercent) {
+    TestMesh mesh;
+    LightThread a, b;
+    mesh.add(a, "fd00::a");
+    size_t nodeB = mesh.add(b, "fd00::b");
+    std::mt19937 rng(8);
+    mesh.drop = [&](const host::Datagram &, size_t, size_t) { return rng() % 100 < lossPercent; };
+
+    size_t received = 0, acked = 0;
+    b.registerUdpViewCallback(
+        [&](const Ip6Address &, bool, const uint8_t *, size_t) { received++; });
+    a.registerReliableUdpStatusCallback(
+        [&](uint16_t, const Ip6Address &, bool success) { acked += success; });
+
+    std::vector<std::vector<uint8_t>> payloads;
+    for(size_t length : {1, 20, 64, LT_RELIABLE_PAYLOAD_SIZE})
+        payloads.emplace_back(length, static_cast<uint8_t>(length));
+
+    // Waits out QUEUE_FULL, as an application would
+    auto send = [&](const std::vector<uint8_t> &payload) {
+        SendStatus status;
+        while((status = a.sendUdp(mesh.addressOf(nodeB), true, payload)) ==
+              SendStatus::QUEUE_FULL)
+            mesh.step();
+        CHECK(status == SendStatus::OK);
+        mesh.run(5);
+    };
+
+    // Peer state on both sides is set up by the first messages
+    const int kWarmUp = 50, kMessages = 2000;
+    for(int i = 0; i < kWarmUp; ++i)
+        send(payloads[i % payloads.size()]);
+
+    AllocationCount allocated = allocationsDuring([&] {
+        for(int i = 0; i < kMessages; ++i)
+            send(payloads[i % payloads.size()]);
+        mesh.runUntil([&] { return a.freeReliableSlots() == LT_RELIABLE_SLOTS; }, 30000);
+    });
+
+    printf("  %2u%% loss: %d messages, %zu delivered, %u retransmissions, %zu allocations\n",
+           lossPercent, kMessages, received - kWarmUp, a.getStats().retransmissions,
+           allocated.count);
+    CHECK(allocated.count == 0);
+    CHECK(received == kWarmUp + kMessages);
+    CHECK(acked == kWarmUp + kMessages);
+}
+
+static void testSteadyStreamAllocatesNothing() {
+    REQUIRE(allocationsDuring([] { ::operator delete(::operator new(8)); }).count == 1);
+    steadyStream(0);
+    steadyStream(10);
+}
+
+// The pool is shared by all peers; once it is full every peer is turned away until ACKs
+// free a slot
+static void testFullPoolQueueFull() {
+    TestMesh mesh;
+    LightThread a, b, c;
+    mesh.add(a, "fd00::a");
+    size_t nodeB = mesh.add(b, "fd00::b");
+    size_t nodeC = mesh.add(c, "fd00::c");
+    const std::vector<uint8_t> payload(16, 0x42);
+
+    size_t accepted = 0;
+    AllocationCount allocated = allocationsDuring([&] {
+        for(int i = 0; i < LT_RELIABLE_SLOTS; ++i) {
+            size_t to = i % 2 ? nodeB : nodeC;
+            accepted += a.sendUdp(mesh.addressOf(to), true, payload) == SendStatus::OK;
+        }
+    });
+    // Stream state for the two peers comes from a fixed table as well
+    CHECK(accepted == LT_RELIABLE_SLOTS);
+    CHECK(a.freeReliableSlots() == 0);
+    CHECK(a.sendUdp(mesh.addressOf(nodeB), true, payload) == SendStatus::QUEUE_FULL);
+    CHECK(a.sendUdp(mesh.addressOf(nodeC), true, payload) == SendStatus::QUEUE_FULL);
+    // Unreliable sends do not need a slot
+    CHECK(a.sendUdp(mesh.addressOf(nodeB), false, payload) == SendStatus::OK);
+
+    CHECK(mesh.runUntil([&] { return a.freeReliableSlots() == LT_RELIABLE_SLOTS; }, 30000));
+    CHECK(a.sendUdp(mesh.addressOf(nodeB), true, payload) == SendStatus::OK);
+    printf("  %d slots of %d payload bytes, sizeof(LightThread) %zu bytes, %zu allocations "
+           "filling the pool\n",
+           LT_RELIABLE_SLOTS, LT_RELIABLE_PAYLOAD_SIZE, sizeof(LightThread), allocated.count);
+    CHECK(allocated.count == 0);
+}
+
+int main() {
+    RUN_TEST(testSteadyStreamAllocatesNothing);
+    RUN_TEST(testFullPoolQueueFull);
+    return testResult();
+}
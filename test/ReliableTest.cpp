@@ -0,0 +1,298 @@
+// Reliable streams between nodes of a TestMesh: exactly-once delivery while ACKs are lost
+// (LT_TEST_ACK_LOSS percent, 30 by default), bounded per-peer receive state recycled least
+// recently used first, and a sender that restarts with a random initial sequence number
+// just behind the receiver's window, whose messages must not be taken for duplicates. Over
+// delayed and lossy links the retransmission timeout converges on the round trip, and
+// retransmitted messages give no round-trip sample (Karn's rule).
+#include "LightThreadTest.h"
+#include <random>
+#include <set>
+
+struct Received {
+    std::vector<std::vector<uint8_t>> payloads;
+
+    void attach(LightThread &lt) {
+        lt.registerUdpViewCallback([this](const Ip6Address &, bool reliable,
+                                          const uint8_t *payload, size_t length) {
+            CHECK(reliable);
+            payloads.emplace_back(payload, payload + length);
+        });
+    }
+};
+
+static std::vector<uint8_t> payloadOf(uint8_t i) { return {i, static_cast<uint8_t>(~i)}; }
+
+// Sends `count` messages numbered from `first` and waits until all are delivered
+static void sendAll(TestMesh &mesh, LightThread &from, size_t to, uint8_t first, int count,
+                    Received &received) {
+    size_t target = received.payloads.size() + count;
+    for(int i = 0; i < count; ++i)
+        CHECK(from.sendUdp(mesh.addressOf(to), true, payloadOf(first + i)) == SendStatus::OK);
+    CHECK(mesh.runUntil([&] { return received.payloads.size() >= target; }, 5000));
+}
+
+// The restarted sender's first sequence lands `offset` from the receiver's next expected one
+static void restartAt(int offset) {
+    TestMesh mesh;
+    LightThread a, b;
+    size_t nodeA = mesh.add(a, "fd00::a");
+    size_t nodeB = mesh.add(b, "fd00::b");
+    Received received;
+    received.attach(b);
+
+    sendAll(mesh, a, nodeB, 0, 10, received);
+    uint16_t next = LightThreadTest::rcvNext(b, mesh.addressOf(nodeA));
+
+    LightThread restarted;
+    mesh.replace(nodeA, restarted);
+    LightThreadTest::setNextSeq(restarted, mesh.addressOf(nodeB),
+                                static_cast<uint16_t>(next + offset));
+    sendAll(mesh, restarted, nodeB, 10, 5, received);
+
+    REQUIRE(received.payloads.size() == 15);
+    for(uint8_t i = 0; i < 15; ++i)
+        CHECK(received.payloads[i] == payloadOf(i));
+    CHECK(b.getStats().duplicatesSuppressed == 0);
+}
+
+static void testRestartJustBehindWindow() {
+    restartAt(-5);
+    restartAt(-1);
+    restartAt(-LT_RELIABLE_WINDOW_MAX + 1);
+}
+
+static void testRestartAtOrAheadOfWindow() {
+    restartAt(0);
+    restartAt(3);
+    restartAt(-1000);
+}
+
+// The receiver's ACK of the start frame is lost: the retry is a duplicate, delivered once
+static void testStartFrameRetried() {
+    TestMesh mesh;
+    LightThread a, b;
+    mesh.add(a, "fd00::a");
+    size_t nodeB = mesh.add(b, "fd00::b");
+    Received received;
+    received.attach(b);
+
+    bool ackLost = false;
+    mesh.drop = [&](const host::Datagram &, size_t from, size_t) {
+        if(from != nodeB || ackLost)
+            return false;
+        return ackLost = true;
+    };
+    sendAll(mesh, a, nodeB, 0, 3, received);
+    mesh.run(LT_RELIABLE_MAX_RTO);
+
+    CHECK(ackLost);
+    REQUIRE(received.payloads.size() == 3);
+    for(uint8_t i = 0; i < 3; ++i)
+        CHECK(received.payloads[i] == payloadOf(i));
+    CHECK(b.getStats().duplicatesSuppressed == 1);
+    CHECK(a.freeReliableSlots() == LT_RELIABLE_SLOTS);
+}
+
+static bool isAck(const host::Datagram &datagram) {
+    return !datagram.data.empty() && datagram.data[0] == AckType::RESPONSE;
+}
+
+// Every retry caused by a lost ACK is re-ACKed and suppressed, never delivered again
+static void testExactlyOnceUnderAckLoss() {
+    const char *env = getenv("LT_TEST_ACK_LOSS");
+    const unsigned lossPercent = env ? atoi(env) : 30;
+    const int kMessages = 500;
+
+    TestMesh mesh;
+    LightThread a, b;
+    mesh.add(a, "fd00::a");
+    size_t nodeB = mesh.add(b, "fd00::b");
+    std::mt19937 rng(13);
+    size_t acksLost = 0;
+    mesh.drop = [&](const host::Datagram &datagram, size_t, size_t) {
+        bool lost = isAck(datagram) && rng() % 100 < lossPercent;
+        acksLost += lost;
+        return lost;
+    };
+
+    std::vector<int> deliveries(kMessages);
+    b.registerUdpViewCallback([&](const Ip6Address &, bool, const uint8_t *payload, size_t) {
+        deliveries[(payload[0] << 8) | payload[1]]++;
+    });
+    size_t delivered = 0;
+    int settled = 0, acked = 0;
+    a.registerReliableUdpStatusCallback([&](uint16_t, const Ip6Address &, bool success) {
+        settled++;
+        acked += success;
+    });
+
+    // Short bursts, so a lost ACK is often the last one and the sender has to retry
+    for(int i = 0; i < kMessages;) {
+        for(int burst = 1 + rng() % 3; burst > 0 && i < kMessages; --burst, ++i) {
+            std::vector<uint8_t> payload = {static_cast<uint8_t>(i >> 8),
+                                            static_cast<uint8_t>(i)};
+            REQUIRE(a.sendUdp(mesh.addressOf(nodeB), true, payload) == SendStatus::OK);
+        }
+        REQUIRE(mesh.runUntil([&] { return settled == i; }, 60000));
+    }
+
+    // At heavy loss a message may run out of time with every ACK lost: delivered, but
+    // reported failed. Never is one delivered twice.
+    for(int count : deliveries) {
+        CHECK(count <= 1);
+        delivered += count;
+    }
+    const LightThread::Stats &stats = b.getStats();
+    CHECK(delivered >= static_cast<size_t>(acked));
+    if(lossPercent <= 30)
+        CHECK(acked == kMessages && delivered == kMessages);
+    if(lossPercent > 0)
+        CHECK(stats.duplicatesSuppressed > 0);
+    printf("  %u%% ACK loss: %zu ACKs lost, %u retransmissions, %u duplicates suppressed, "
+           "%d of %d ACKed\n",
+           lossPercent, acksLost, a.getStats().retransmissions, stats.duplicatesSuppressed, acked,
+           kMessages);
+}
+
+// Receive state is kept for LT_RELIABLE_PEERS streams; one more recycles the least
+// recently active, and its sender still gets through afterwards
+static void testIdlePeerRecycled() {
+    TestMesh mesh;
+    LightThread b;
+    size_t nodeB = mesh.add(b, "fd00::b");
+    Received received;
+    received.attach(b);
+
+    const int kSenders = LT_RELIABLE_PEERS + 1;
+    std::vector<LightThread> senders(kSenders);
+    std::vector<size_t> nodes;
+    for(int i = 0; i < kSenders; ++i)
+        nodes.push_back(mesh.add(senders[i], ("fd00::1:" + std::to_string(i)).c_str()));
+
+    for(int i = 0; i < kSenders; ++i) {
+        sendAll(mesh, senders[i], nodeB, i, 1, received);
+        mesh.run(10);
+    }
+    CHECK(!LightThreadTest::hasStream(b, mesh.addressOf(nodes[0])));
+    for(int i = 1; i < kSenders; ++i)
+        CHECK(LightThreadTest::hasStream(b, mesh.addressOf(nodes[i])));
+
+    sendAll(mesh, senders[0], nodeB, 100, 3, received);
+    REQUIRE(received.payloads.size() == kSenders + 3);
+    for(uint8_t i = 0; i < 3; ++i)
+        CHECK(received.payloads[kSenders + i] == payloadOf(100 + i));
+    CHECK(!LightThreadTest::hasStream(b, mesh.addressOf(nodes[1])));
+}
+
+struct LinkRun {
+    LightThread::PeerRtt rtt;
+    size_t delivered;
+    size_t frames; // datagrams put on the air, lost ones included
+    double p50Ms;
+    double p99Ms;
+};
+
+// 200 reliable messages 200 ms apart over a link `oneWayMs` long each way; `drop` decides
+// which datagrams are lost. Delivery latency runs from sendUdp() to the receive callback.
+static LinkRun runLink(unsigned long oneWayMs,
+                       std::function<bool(const host::Datagram &, size_t from)> drop) {
+    const int kMessages = 200;
+    TestMesh mesh;
+    LightThread a, b;
+    mesh.add(a, "fd00::a");
+    size_t nodeB = mesh.add(b, "fd00::b");
+    mesh.latency = [&](const host::Datagram &, size_t, size_t) { return oneWayMs; };
+    mesh.drop = [&](const host::Datagram &datagram, size_t from, size_t) {
+        return drop(datagram, from);
+    };
+
+    std::vector<unsigned long> sentAt(kMessages), latencies;
+    b.registerUdpViewCallback([&](const Ip6Address &, bool, const uint8_t *payload, size_t) {
+        latencies.push_back(millis() - sentAt[(payload[0] << 8) | payload[1]]);
+    });
+    for(int i = 0; i < kMessages; ++i) {
+        sentAt[i] = millis();
+        std::vector<uint8_t> payload = {static_cast<uint8_t>(i >> 8), static_cast<uint8_t>(i)};
+        CHECK(a.sendUdp(mesh.addressOf(nodeB), true, payload) == SendStatus::OK);
+        mesh.run(200);
+    }
+    mesh.runUntil([&] { return a.freeReliableSlots() == LT_RELIABLE_SLOTS; }, 30000);
+
+    LinkRun run = {};
+    CHECK(a.getPeerRtt(mesh.addressOf(nodeB), run.rtt));
+    run.delivered = latencies.size();
+    run.frames = mesh.delivered + mesh.dropped;
+    if(!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        run.p50Ms = latencies[latencies.size() / 2];
+        run.p99Ms = latencies[latencies.size() * 99 / 100];
+    }
+    return run;
+}
+
+// The sequence number of a reliable data frame on channel 0, -1 for anything else
+static int dataSeq(const host::Datagram &datagram) {
+    if(datagram.data.size() < 5 || datagram.data[0] != AckType::REQUEST)
+        return -1;
+    return (datagram.data[2] << 8) | datagram.data[3];
+}
+
+static std::function<bool(const host::Datagram &, size_t)> randomLoss(unsigned percent) {
+    auto rng = std::make_shared<std::mt19937>(6);
+    return [rng, percent](const host::Datagram &, size_t) { return (*rng)() % 100 < percent; };
+}
+
+// Whatever the loss, the smoothed RTT settles on the link's round trip (plus up to a step
+// per hop) and the timeout follows it down from LT_RELIABLE_INITIAL_RTO
+static void testRtoConverges() {
+    printf("  one-way  loss   srtt  rttVar    rto   p50 ms  p99 ms  frames\n");
+    for(auto [oneWayMs, lossPercent] : {std::make_pair(20ul, 0u), {100ul, 0u}, {20ul, 10u},
+                                        {20ul, 30u}, {200ul, 10u}}) {
+        LinkRun run = runLink(oneWayMs, randomLoss(lossPercent));
+        printf("  %4lu ms  %3u%%  %5u  %6u  %5u  %7.0f %7.0f  %6zu\n", oneWayMs, lossPercent,
+               run.rtt.srtt, run.rtt.rttVar, run.rtt.rto, run.p50Ms, run.p99Ms, run.frames);
+
+        uint32_t roundTrip = 2 * oneWayMs;
+        CHECK(run.delivered == 200);
+        CHECK(run.rtt.srtt >= roundTrip && run.rtt.srtt <= roundTrip + roundTrip / 10 + 4);
+        CHECK(run.rtt.rto >= LT_RELIABLE_MIN_RTO);
+        CHECK(run.rtt.rto < LT_RELIABLE_INITIAL_RTO);
+        if(lossPercent == 0)
+            CHECK(run.rtt.rto <= std::max<uint32_t>(LT_RELIABLE_MIN_RTO, 2 * run.rtt.srtt));
+    }
+}
+
+// Messages delivered only by a retransmission leave the estimate alone: their ACK cannot
+// tell which copy it answers
+static void testRetransmittedSamplesExcluded() {
+    // The first copy of every message is lost: no sample at all
+    std::set<int> seen;
+    LinkRun run = runLink(50, [&](const host::Datagram &datagram, size_t from) {
+        int seq = dataSeq(datagram);
+        return from == 0 && seq >= 0 && seen.insert(seq).second;
+    });
+    CHECK(run.delivered == 200);
+    CHECK(run.rtt.srtt == 0);
+
+    // The first copy of every other message is lost: the clean ones still keep it on the link
+    seen.clear();
+    run = runLink(50, [&](const host::Datagram &datagram, size_t from) {
+        int seq = dataSeq(datagram);
+        return from == 0 && seq >= 0 && seq % 2 == 0 && seen.insert(seq).second;
+    });
+    CHECK(run.delivered == 200);
+    CHECK(run.rtt.srtt >= 100 && run.rtt.srtt <= 114);
+    printf("  every other first copy lost: srtt %u ms, rto %u ms, p99 %.0f ms\n", run.rtt.srtt,
+           run.rtt.rto, run.p99Ms);
+}
+
+int main() {
+    RUN_TEST(testExactlyOnceUnderAckLoss);
+    RUN_TEST(testIdlePeerRecycled);
+    RUN_TEST(testRestartJustBehindWindow);
+    RUN_TEST(testRestartAtOrAheadOfWindow);
+    RUN_TEST(testStartFrameRetried);
+    RUN_TEST(testRtoConverges);
+    RUN_TEST(testRetransmittedSamplesExcluded);
+    return testResult();
+}
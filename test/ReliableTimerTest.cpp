@@ -0,0 +1,105 @@
+// The reliable timer heap at 10, 100 and 254 pending messages (the most slot indices
+// allow), spread over LT_RELIABLE_PEERS peers: the cost of a timer pass with nothing due,
+// next to a replica of the per-update walk over every queued message it replaced, and
+// msUntilNextDeadline() matching the first retry that actually goes out.
+#include "LightThreadTest.h"
+#include <chrono>
+#include <deque>
+
+static const int kPasses = 200000;
+
+static Ip6Address peerAddress(int i) {
+    return address(("fd00::" + std::to_string(i + 1)).c_str());
+}
+
+// What updateReliableUdp() did before the heap: every peer's queue walked on every call
+struct ScanReplica {
+    struct Message {
+        unsigned long deadline;
+        unsigned long retryAt;
+        bool sent;
+    };
+    std::vector<std::deque<Message>> peers{LT_RELIABLE_PEERS};
+
+    size_t pass(unsigned long now) {
+        size_t due = 0;
+        for(std::deque<Message> &queue : peers) {
+            while(!queue.empty() && static_cast<long>(now - queue.front().deadline) >= 0) {
+                queue.pop_front();
+                due++;
+            }
+            for(Message &msg : queue) {
+                if(!msg.sent || static_cast<long>(now - msg.retryAt) < 0)
+                    continue;
+                due++;
+            }
+        }
+        return due;
+    }
+};
+
+template <typename Pass> static double nsPerPass(Pass pass) {
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < kPasses; ++i)
+        pass();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / kPasses;
+}
+
+static void testIdlePassCost() {
+    printf("  pending   scan ns   heap ns\n");
+    double heapFirst = 0, heapLast = 0, scanLast = 0;
+    for(int pending : {10, 100, LT_RELIABLE_SLOTS}) {
+        host::useSimulatedClock();
+        size_t sent = 0;
+        host::setSendHandler([&](const host::Datagram &) { sent++; });
+        LightThread lt;
+        LightThreadTest::useBackend(lt, UdpBackend::NATIVE);
+
+        ScanReplica scan;
+        for(int i = 0; i < pending; ++i) {
+            int peer = i % LT_RELIABLE_PEERS;
+            REQUIRE(lt.sendUdp(peerAddress(peer), true, {static_cast<uint8_t>(i)}) ==
+                    SendStatus::OK);
+            // Until a peer ACKs, one message is in flight to it and the rest wait
+            bool first = scan.peers[peer].empty();
+            unsigned long now = millis();
+            scan.peers[peer].push_back(
+                {now + LT_RELIABLE_DEFAULT_DEADLINE, now + LT_RELIABLE_INITIAL_RTO, first});
+        }
+        CHECK(lt.freeReliableSlots() == LT_RELIABLE_SLOTS - pending);
+        size_t sentBefore = sent;
+
+        size_t due = 0;
+        double heapNs = nsPerPass([&] { LightThreadTest::updateReliable(lt); });
+        double scanNs = nsPerPass([&] { due += scan.pass(millis()); });
+        CHECK(due == 0);
+        CHECK(sent == sentBefore);
+        printf("  %7d  %8.1f  %8.1f\n", pending, scanNs, heapNs);
+
+        if(pending == 10)
+            heapFirst = heapNs;
+        heapLast = heapNs;
+        scanLast = scanNs;
+
+        // Nothing goes out before the reported deadline, and the first retry goes out on it
+        unsigned long wait = lt.msUntilNextDeadline();
+        CHECK(wait > 0 && wait <= LT_RELIABLE_INITIAL_RTO * 5 / 4);
+        host::advance(wait - 1);
+        LightThreadTest::updateReliable(lt);
+        CHECK(sent == sentBefore);
+        host::advance(1);
+        LightThreadTest::updateReliable(lt);
+        CHECK(sent > sentBefore);
+        host::setSendHandler(nullptr);
+    }
+
+    // The heap only looks at its top; the walk grows with the queue
+    CHECK(heapLast < 3 * heapFirst + 5);
+    CHECK(scanLast > heapLast);
+}
+
+int main() {
+    RUN_TEST(testIdlePassCost);
+    return testResult();
+}
@@ -0,0 +1,225 @@
+// sendUdp() from tasks other than the one running update(): 8 producer threads share the
+// lock-free send queue while the owner thread runs update() on the native backend, and
+// every datagram handed to the fake OpenThread socket is checked. None may be lost,
+// duplicated, reordered within its producer or mixed with another's bytes. Throughput and
+// how often producers found the queue full are printed; host figures only. Reliable sends
+// queued from other tasks, more than there are reliable slots, each get an outcome: they
+// wait in the send queue for a free slot, then are delivered or reported failed.
+#include "LightThreadTest.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+static const Ip6Address kPeer = address("fd00::2");
+static const int kProducers = 8;
+static const int kPerProducer = 20000;
+static const size_t kHeader = 2; // AckType, MessageType of an unreliable channel 0 frame
+
+// [producer][index:32][filler]; 5 to 104 bytes, well under one frame
+static std::vector<uint8_t> payloadOf(int producer, uint32_t index) {
+    std::vector<uint8_t> payload(5 + index % 100);
+    payload[0] = static_cast<uint8_t>(producer);
+    memcpy(&payload[1], &index, sizeof(index));
+    for(size_t j = 5; j < payload.size(); ++j)
+        payload[j] = static_cast<uint8_t>(producer * 31 + index + j);
+    return payload;
+}
+
+static void testProducersNeitherLostNorInterleaved() {
+    LightThread lt;
+    LightThreadTest::useBackend(lt, UdpBackend::NATIVE);
+
+    std::vector<std::vector<uint8_t>> sent;
+    host::setSendHandler([&](const host::Datagram &datagram) {
+        sent.emplace_back(datagram.data.begin() + kHeader, datagram.data.end());
+    });
+    lt.update(); // this thread now owns update(); others queue
+
+    std::atomic<bool> go{false};
+    std::atomic<uint64_t> wouldBlock{0};
+    std::atomic<int> otherStatus{0};
+    std::vector<std::thread> producers;
+    for(int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&, p] {
+            while(!go)
+                std::this_thread::yield();
+            for(uint32_t i = 0; i < kPerProducer; ++i) {
+                std::vector<uint8_t> payload = payloadOf(p, i);
+                SendStatus status;
+                while((status = lt.sendUdp(kPeer, false, payload)) == SendStatus::WOULD_BLOCK) {
+                    wouldBlock++;
+                    std::this_thread::yield();
+                }
+                otherStatus += status != SendStatus::OK;
+            }
+        });
+    }
+
+    const size_t total = static_cast<size_t>(kProducers) * kPerProducer;
+    auto start = std::chrono::steady_clock::now();
+    go = true;
+    while(sent.size() < total) {
+        size_t before = sent.size();
+        lt.update();
+        if(sent.size() == before) {
+            if(std::chrono::steady_clock::now() - start > std::chrono::seconds(60))
+                break;
+            std::this_thread::yield();
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    for(std::thread &producer : producers)
+        producer.join();
+    lt.update();
+    host::setSendHandler(nullptr);
+
+    CHECK(otherStatus == 0);
+    CHECK(lt.getStats().queuedSendsFailed == 0);
+    REQUIRE(sent.size() == total);
+
+    // Each producer's messages come out whole and in the order it sent them
+    std::vector<uint32_t> next(kProducers, 0);
+    size_t bad = 0, bytes = 0;
+    for(const std::vector<uint8_t> &payload : sent) {
+        bytes += payload.size();
+        if(payload.size() < 5 || payload[0] >= kProducers) {
+            bad++;
+            continue;
+        }
+        int p = payload[0];
+        uint32_t index;
+        memcpy(&index, &payload[1], sizeof(index));
+        if(index != next[p] || payload != payloadOf(p, index))
+            bad++;
+        next[p] = index + 1;
+    }
+    CHECK(bad == 0);
+    for(int p = 0; p < kProducers; ++p)
+        CHECK(next[p] == kPerProducer);
+
+    printf("  %d producers, %d slots: %.2f M messages/s, %.1f MB/s, %.2f WOULD_BLOCK per "
+           "message\n",
+           kProducers, LT_SEND_SLOTS, total / seconds / 1e6, bytes / seconds / 1e6,
+           double(wouldBlock) / total);
+}
+
+// A payload too large for a send slot goes out from the update() task, fragmented, but is
+// refused from any other
+static void testSlotLimitOnlyOffTask() {
+    LightThread lt;
+    LightThreadTest::useBackend(lt, UdpBackend::NATIVE);
+    host::setSendHandler([](const host::Datagram &) {});
+    lt.update();
+
+    std::vector<uint8_t> large(LT_SEND_SLOT_BYTES + 1, 0x5A);
+    SendStatus offTask;
+    std::thread([&] { offTask = lt.sendUdp(kPeer, false, large); }).join();
+    CHECK(offTask == SendStatus::TOO_LARGE);
+    CHECK(lt.sendUdp(kPeer, false, large) == SendStatus::OK);
+
+    std::vector<uint8_t> fits(LT_SEND_SLOT_BYTES, 0x5A);
+    std::thread([&] { offTask = lt.sendUdp(kPeer, false, fits); }).join();
+    CHECK(offTask == SendStatus::OK);
+    lt.update();
+    CHECK(lt.getStats().queuedSendsFailed == 0);
+    host::setSendHandler(nullptr);
+}
+
+// 4 producers queue 40 reliable sends each, half to a node of a TestMesh and half to an
+// address nobody answers, so the reliable slots stay full for a deadline at a time
+static void testReliableBeyondSlots() {
+    const int kReliableProducers = 4, kEach = 40;
+    const size_t total = kReliableProducers * kEach;
+    static_assert(total > LT_RELIABLE_SLOTS, "more sends than reliable slots");
+
+    TestMesh mesh;
+    LightThread a, b;
+    mesh.add(a, "fd00::a");
+    size_t nodeB = mesh.add(b, "fd00::b");
+    const Ip6Address reachable = mesh.addressOf(nodeB), silent = address("fd00::c");
+
+    std::vector<std::vector<uint8_t>> received;
+    b.registerUdpViewCallback([&](const Ip6Address &, bool, const uint8_t *data, size_t n) {
+        received.emplace_back(data, data + n);
+    });
+    size_t confirmed = 0, failed = 0, failedReachable = 0;
+    a.registerReliableUdpStatusCallback([&](uint16_t, const Ip6Address &addr, bool ok) {
+        confirmed += ok;
+        failed += !ok;
+        failedReachable += !ok && addr == reachable;
+    });
+    mesh.step(); // this thread now owns update() on both nodes
+
+    std::atomic<int> otherStatus{0};
+    std::atomic<bool> queueFull{false};
+    std::vector<std::thread> producers;
+    for(int p = 0; p < kReliableProducers; ++p) {
+        producers.emplace_back([&, p] {
+            for(uint32_t i = 0; i < kEach; ++i) {
+                std::vector<uint8_t> payload = payloadOf(p, i);
+                const Ip6Address &dest = i % 2 ? silent : reachable;
+                SendStatus status;
+                while((status = a.sendUdp(dest, true, payload)) == SendStatus::WOULD_BLOCK) {
+                    queueFull = true;
+                    std::this_thread::yield();
+                }
+                otherStatus += status != SendStatus::OK;
+            }
+        });
+    }
+
+    // Every update() then finds a full send queue, until the reliable slots fill up
+    while(!queueFull)
+        std::this_thread::yield();
+    auto start = std::chrono::steady_clock::now();
+    while(confirmed + failed < total &&
+          std::chrono::steady_clock::now() - start < std::chrono::seconds(60))
+        mesh.step();
+    for(std::thread &producer : producers)
+        producer.join();
+
+    CHECK(otherStatus == 0);
+    CHECK(confirmed + failed == total);
+    CHECK(failed == total / 2);
+    CHECK(failedReachable == 0);
+    CHECK(a.getStats().queuedSendsFailed == 0);
+
+    // Every send to b arrived once, in its producer's order
+    REQUIRE(received.size() == total / 2);
+    std::vector<uint32_t> next(kReliableProducers, 0);
+    for(const std::vector<uint8_t> &payload : received) {
+        int p = payload[0];
+        uint32_t index;
+        memcpy(&index, &payload[1], sizeof(index));
+        CHECK(p < kReliableProducers && index == next[p] && payload == payloadOf(p, index));
+        next[p] = index + 2;
+    }
+    printf("  %zu reliable sends through %d slots: %zu confirmed, %zu failed at the deadline\n",
+           total, LT_RELIABLE_SLOTS, confirmed, failed);
+}
+
+// Once begin() has run, a send from another task is queued, even before the first update()
+static void testQueuedFromBegin() {
+    LightThread lt;
+    size_t sent = 0;
+    host::setSendHandler([&](const host::Datagram &) { sent++; });
+    lt.begin(UdpBackend::NATIVE);
+    LightThreadTest::useBackend(lt, UdpBackend::NATIVE); // the socket, as once attached
+
+    SendStatus offTask;
+    std::thread([&] { offTask = lt.sendUdp(kPeer, false, {1, 2, 3}); }).join();
+    CHECK(offTask == SendStatus::OK);
+    CHECK(sent == 0);
+    lt.update();
+    CHECK(sent == 1);
+    host::setSendHandler(nullptr);
+}
+
+int main() {
+    RUN_TEST(testProducersNeitherLostNorInterleaved);
+    RUN_TEST(testSlotLimitOnlyOffTask);
+    RUN_TEST(testReliableBeyondSlots);
+    RUN_TEST(testQueuedFromBegin);
+    return testResult();
+}
@@ -0,0 +1,175 @@
+// Task mode on the host's std::thread emulation of FreeRTOS tasks, against the fake native
+// transport, next to the polled mode of the examples (update() then delay(10) in loop()).
+// Datagrams are delivered from the test thread, as the OpenThread task would, stamped with
+// their send time; the receive callback measures how long each took to reach it. Then
+// nothing arrives for a while, and the wakeups and process CPU time of the idle library
+// are counted. Host figures, for comparing the two modes, not a device measurement. Last,
+// end() stops the task: nothing is processed until the application calls update() again.
+#include "LightThreadTest.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <sys/resource.h>
+
+using Clock = std::chrono::steady_clock;
+
+static const Ip6Address kPeer = address("fd00::2");
+static const int kDatagrams = 100;
+static const int kSpacingMs = 7;
+static const int kIdleMs = 1000;
+static const int kPollPeriodMs = 10;
+
+struct Measurement {
+    std::vector<double> latenciesUs;
+    double idleWakeupsPerSecond;
+    double idleCpuMsPerSecond;
+};
+
+static double cpuMs() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+}
+
+static double percentile(std::vector<double> values, double p) {
+    std::sort(values.begin(), values.end());
+    return values[static_cast<size_t>(p * (values.size() - 1))];
+}
+
+// Records the delay of every datagram `lt` delivers to the application
+static void stampLatencies(LightThread &lt, Measurement &out, std::mutex &lock) {
+    lt.registerUdpViewCallback([&out, &lock](const Ip6Address &, bool, const uint8_t *data,
+                                             size_t length) {
+        int64_t sent;
+        if(length != sizeof(sent))
+            return;
+        memcpy(&sent, data, sizeof(sent));
+        int64_t now = Clock::now().time_since_epoch().count();
+        std::lock_guard<std::mutex> guard(lock);
+        out.latenciesUs.push_back((now - sent) / 1e3);
+    });
+}
+
+// Delivers kDatagrams to `lt` kSpacingMs apart, then stays silent for kIdleMs while
+// `wakeups()` and the process CPU time are sampled
+static void drive(LightThread &lt, Measurement &out, std::function<uint32_t()> wakeups) {
+    otIp6Address peer = kPeer.toOt();
+    for(int i = 0; i < kDatagrams; ++i) {
+        uint8_t frame[2 + sizeof(int64_t)] = {AckType::NONE, MessageType::NORMAL};
+        int64_t now = Clock::now().time_since_epoch().count();
+        memcpy(frame + 2, &now, sizeof(now));
+        CHECK(host::deliver(LightThreadTest::socket(lt), peer, frame, sizeof(frame)));
+        std::this_thread::sleep_for(std::chrono::milliseconds(kSpacingMs));
+    }
+
+    // Let the last datagram through and the task settle into its idle sleep
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    uint32_t wakeupsBefore = wakeups();
+    double cpuBefore = cpuMs();
+    std::this_thread::sleep_for(std::chrono::milliseconds(kIdleMs));
+    out.idleWakeupsPerSecond = (wakeups() - wakeupsBefore) * 1000.0 / kIdleMs;
+    out.idleCpuMsPerSecond = (cpuMs() - cpuBefore) * 1000.0 / kIdleMs;
+}
+
+static void report(const char *name, const Measurement &m) {
+    double mean = 0;
+    for(double us : m.latenciesUs)
+        mean += us / m.latenciesUs.size();
+    printf("  %-6s rx latency median %6.0f us, p99 %6.0f us, mean %6.0f us; idle %5.1f "
+           "wakeups/s, %.2f ms CPU/s\n",
+           name, percentile(m.latenciesUs, 0.5), percentile(m.latenciesUs, 0.99), mean,
+           m.idleWakeupsPerSecond, m.idleCpuMsPerSecond);
+}
+
+static Measurement polled, tasked;
+
+// The examples' loop(): update(), then delay(kPollPeriodMs), on an application thread
+static void testPolledMode() {
+    std::mutex lock;
+    LightThread lt;
+    LightThreadTest::useBackend(lt, UdpBackend::NATIVE);
+    stampLatencies(lt, polled, lock);
+
+    std::atomic<bool> stop{false};
+    std::atomic<uint32_t> loops{0};
+    std::thread app([&] {
+        while(!stop) {
+            lt.update();
+            loops++;
+            delay(kPollPeriodMs);
+        }
+    });
+    drive(lt, polled, [&] { return loops.load(); });
+    stop = true;
+    app.join();
+
+    std::lock_guard<std::mutex> guard(lock);
+    CHECK(polled.latenciesUs.size() == kDatagrams);
+    report("polled", polled);
+}
+
+// begin() with a TaskConfig: the task wakes on each datagram and otherwise sleeps until
+// its next deadline, at most LT_TASK_MAX_SLEEP. The LightThread ends it when destroyed.
+static void testTaskMode() {
+    std::mutex lock;
+    LightThread lt;
+    LightThreadTest::useBackend(lt, UdpBackend::NATIVE);
+    stampLatencies(lt, tasked, lock);
+    lt.begin(UdpBackend::NATIVE, LightThread::TaskConfig());
+
+    drive(lt, tasked, [] { return hostNotifyTakes.load(); });
+
+    std::lock_guard<std::mutex> guard(lock);
+    CHECK(tasked.latenciesUs.size() == kDatagrams);
+    report("task", tasked);
+    if(tasked.latenciesUs.empty() || polled.latenciesUs.empty())
+        return;
+
+    // Woken by each datagram rather than finding it on the next poll
+    CHECK(percentile(tasked.latenciesUs, 0.5) < 1000);
+    CHECK(percentile(tasked.latenciesUs, 0.5) < percentile(polled.latenciesUs, 0.5) / 4);
+    // Idle, the task only wakes for its capped sleep; the loop wakes every period
+    CHECK(tasked.idleWakeupsPerSecond <= 1.5 * 1000 / LT_TASK_MAX_SLEEP);
+    CHECK(tasked.idleWakeupsPerSecond < polled.idleWakeupsPerSecond / 2);
+}
+
+// end() returns once the task has exited: it no longer wakes, and a datagram waits for the
+// application's own update(). The task can be started again.
+static void testEnd() {
+    LightThread lt;
+    LightThreadTest::useBackend(lt, UdpBackend::NATIVE);
+    std::atomic<size_t> received{0};
+    lt.registerUdpViewCallback(
+        [&](const Ip6Address &, bool, const uint8_t *, size_t) { received++; });
+    const uint8_t frame[] = {AckType::NONE, MessageType::NORMAL, 0x42};
+    otIp6Address peer = kPeer.toOt();
+
+    lt.begin(UdpBackend::NATIVE, LightThread::TaskConfig());
+    CHECK(host::deliver(LightThreadTest::socket(lt), peer, frame, sizeof(frame)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(received == 1);
+    lt.end();
+    lt.end();
+
+    uint32_t takes = hostNotifyTakes;
+    CHECK(host::deliver(LightThreadTest::socket(lt), peer, frame, sizeof(frame)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(3 * LT_TASK_MAX_SLEEP));
+    CHECK(hostNotifyTakes == takes);
+    CHECK(received == 1);
+    lt.update();
+    CHECK(received == 2);
+
+    lt.begin(UdpBackend::NATIVE, LightThread::TaskConfig());
+    CHECK(host::deliver(LightThreadTest::socket(lt), peer, frame, sizeof(frame)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(received == 3);
+}
+
+int main() {
+    host::useRealClock();
+    RUN_TEST(testPolledMode);
+    RUN_TEST(testTaskMode);
+    RUN_TEST(testEnd);
+    return testResult();
+}
@@ -0,0 +1,147 @@
+// What reaching the application costs per received message on the native backend, for the
+// vector callbacks and their view forms: heap allocations and bytes allocated in the
+// library, whether the payload was copied before the callback saw it, and host ns. A view
+// callback gets the payload where it lies in the received frame, past the reliable header
+// or the relay header of a publish; in deferred mode it lies in the event ring, the one
+// copy that mode makes. Allocations by the fake radio (host::HarnessScope) are not counted.
+#include "AllocationCounter.h"
+#include "LightThreadTest.h"
+#include <chrono>
+
+static const Ip6Address kPeer = address("fd00::2");
+static const uint16_t kTopic = 7;
+static const size_t kPayload = 64;
+static const int kMessages = 2000;
+
+enum class Path { UNRELIABLE, RELIABLE, PUBLISH };
+
+// The frame of message `i` on `path`, and where its payload starts in it
+static std::vector<uint8_t> frameOf(Path path, int i, size_t &offset) {
+    std::vector<uint8_t> frame;
+    switch(path) {
+    case Path::UNRELIABLE:
+        frame = {AckType::NONE, MessageType::NORMAL};
+        break;
+    case Path::RELIABLE:
+        // [seq:16][flags:8], each frame the sender's oldest unacknowledged one
+        frame = {AckType::REQUEST, MessageType::NORMAL, static_cast<uint8_t>(i >> 8),
+                 static_cast<uint8_t>(i), static_cast<uint8_t>(i == 0 ? 0x05 : 0x01)};
+        break;
+    case Path::PUBLISH:
+        // [topic:16][publisher IID:64], relayed by the leader
+        frame = {AckType::NONE, MessageType::PUBLISH, 0, kTopic, 0, 0, 0, 0, 0, 0, 0, 2};
+        break;
+    }
+    offset = frame.size();
+    for(size_t j = 0; j < kPayload; ++j)
+        frame.push_back(static_cast<uint8_t>(i + j));
+    return frame;
+}
+
+struct Cost {
+    double allocations;
+    double bytes;
+    double copies;
+    double ns;
+};
+
+// kMessages frames on `path` into a paired joiner, through a vector or a view callback
+static Cost measure(Path path, bool view, bool deferred) {
+    using Clock = std::chrono::steady_clock;
+    host::useSimulatedClock();
+    host::setSendHandler([](const host::Datagram &) {});
+    host::setIdentity(address("fd00::1").toOt());
+    LightThread lt;
+    LightThreadTest::useBackend(lt, UdpBackend::NATIVE);
+    LightThreadTest::makePairedJoiner(lt, kPeer);
+    lt.setLogLevel(LT_LOG_NONE);
+    lt.setDeferredDelivery(deferred);
+    CHECK(lt.subscribe(kTopic));
+
+    std::vector<std::vector<uint8_t>> frames;
+    std::vector<size_t> offsets(kMessages);
+    for(int i = 0; i < kMessages; ++i)
+        frames.push_back(frameOf(path, i, offsets[i]));
+
+    // The message being received, and whether its payload reached the callback in place
+    int current = 0;
+    size_t delivered = 0, copied = 0;
+    auto check = [&](const uint8_t *payload, size_t length) {
+        const std::vector<uint8_t> &frame = frames[current];
+        const uint8_t *expected = frame.data() + offsets[current];
+        CHECK(length == kPayload && memcmp(payload, expected, kPayload) == 0);
+        copied += payload != expected;
+        delivered++;
+    };
+    if(path == Path::PUBLISH && view) {
+        lt.registerPublishViewCallback(
+            [&](uint16_t, const Ip6Address &, const uint8_t *payload, size_t length) {
+                check(payload, length);
+            });
+    } else if(path == Path::PUBLISH) {
+        lt.registerPublishCallback(
+            [&](uint16_t, const Ip6Address &, const std::vector<uint8_t> &payload) {
+                check(payload.data(), payload.size());
+            });
+    } else if(view) {
+        lt.registerUdpViewCallback(
+            [&](const Ip6Address &, bool, const uint8_t *payload, size_t length) {
+                check(payload, length);
+            });
+    } else {
+        lt.registerUdpReceiveCallback(
+            [&](const Ip6Address &, bool, const std::vector<uint8_t> &payload) {
+                check(payload.data(), payload.size());
+            });
+    }
+
+    // The first message sets up the reliable stream and reads the node's own address
+    LightThreadTest::receive(lt, kPeer, frames[0].data(), frames[0].size());
+    lt.poll();
+    copied = 0;
+    auto start = Clock::now();
+    AllocationCount allocated = allocationsDuring([&] {
+        for(current = 1; current < kMessages; ++current) {
+            LightThreadTest::receive(lt, kPeer, frames[current].data(), frames[current].size());
+            lt.poll();
+        }
+    });
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    host::setSendHandler(nullptr);
+
+    CHECK(delivered == kMessages);
+    const double n = kMessages - 1;
+    return {allocated.count / n, allocated.bytes / n, copied / n, ns / n};
+}
+
+static void testCostPerMessage() {
+    printf("  %-12s %-6s %-9s  allocs  bytes  copies  ns/msg\n", "message", "form", "delivery");
+    for(Path path : {Path::UNRELIABLE, Path::RELIABLE, Path::PUBLISH}) {
+        for(bool deferred : {false, true}) {
+            for(bool view : {false, true}) {
+                Cost cost = measure(path, view, deferred);
+                printf("  %-12s %-6s %-9s  %6.2f  %5.1f  %6.2f  %6.0f\n",
+                       path == Path::UNRELIABLE ? "unreliable"
+                       : path == Path::RELIABLE ? "reliable"
+                                                : "publish",
+                       view ? "view" : "vector", deferred ? "deferred" : "direct",
+                       cost.allocations, cost.bytes, cost.copies, cost.ns);
+                if(view) {
+                    // In place, or in the event ring
+                    CHECK(cost.allocations == 0);
+                    CHECK(cost.copies == (deferred ? 1 : 0));
+                } else {
+                    // The vector
+                    CHECK(cost.allocations == 1);
+                    CHECK(cost.bytes == kPayload);
+                    CHECK(cost.copies == 1);
+                }
+            }
+        }
+    }
+}
+
+int main() {
+    RUN_TEST(testCostPerMessage);
+    return testResult();
+}
@@ -0,0 +1,151 @@
+// Host stand-in for the parts of the Arduino core LightThread uses. Strings are backed by
+// std::string; logging goes to stderr only when LT_TEST_LOG is set in the environment.
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <freertos/task.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+#define HEX 16
+#define DEC 10
+#define INPUT_PULLUP 2
+#define LOW 0
+#define HIGH 1
+#define FILE_WRITE "w"
+
+class String {
+  public:
+    String() {}
+    String(const char *text) : s(text ? text : "") {}
+    String(const std::string &text) : s(text) {}
+    explicit String(char c) : s(1, c) {}
+    String(int v, int base = DEC) : s(format(base == HEX ? "%x" : "%d", v)) {}
+    String(unsigned v, int base = DEC) : s(format(base == HEX ? "%x" : "%u", v)) {}
+    String(long v, int base = DEC) : s(format(base == HEX ? "%lx" : "%ld", v)) {}
+    String(unsigned long v, int base = DEC) : s(format(base == HEX ? "%lx" : "%lu", v)) {}
+
+    unsigned length() const { return s.size(); }
+    const char *c_str() const { return s.c_str(); }
+    bool isEmpty() const { return s.empty(); }
+    int indexOf(const String &x, unsigned from = 0) const { return found(s.find(x.s, from)); }
+    int indexOf(char x, unsigned from = 0) const { return found(s.find(x, from)); }
+    int lastIndexOf(char x) const { return found(s.rfind(x)); }
+    String substring(unsigned from) const {
+        return String(s.substr(std::min<size_t>(from, s.size())));
+    }
+    String substring(unsigned from, unsigned to) const {
+        from = std::min<unsigned>(from, s.size());
+        return String(s.substr(from, std::max(from, to) - from));
+    }
+    void trim() {
+        size_t first = s.find_first_not_of(" \t\r\n");
+        size_t last = s.find_last_not_of(" \t\r\n");
+        s = first == std::string::npos ? "" : s.substr(first, last - first + 1);
+    }
+    void toLowerCase() {
+        for(char &c : s)
+            c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+    bool startsWith(const String &p) const { return s.compare(0, p.s.size(), p.s) == 0; }
+    bool endsWith(const String &p) const {
+        return s.size() >= p.s.size() && s.compare(s.size() - p.s.size(), p.s.size(), p.s) == 0;
+    }
+    bool concat(const char *c, unsigned n) {
+        s.append(c, n);
+        return true;
+    }
+    bool reserve(unsigned n) {
+        s.reserve(n);
+        return true;
+    }
+    char operator[](unsigned i) const { return s[i]; }
+    String &operator+=(const String &o) {
+        s += o.s;
+        return *this;
+    }
+    String &operator+=(const char *o) {
+        s += o;
+        return *this;
+    }
+    String &operator+=(char o) {
+        s += o;
+        return *this;
+    }
+    friend String operator+(const String &a, const String &b) { return String(a.s + b.s); }
+    friend String operator+(const String &a, const char *b) { return String(a.s + b); }
+    friend String operator+(const char *a, const String &b) { return String(a + b.s); }
+    bool operator==(const String &o) const { return s == o.s; }
+    bool operator!=(const String &o) const { return s != o.s; }
+    bool operator<(const String &o) const { return s < o.s; }
+
+  private:
+    static std::string format(const char *fmt, ...) {
+        char buf[40];
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(buf, sizeof(buf), fmt, args);
+        va_end(args);
+        return buf;
+    }
+    static int found(size_t pos) { return pos == std::string::npos ? -1 : static_cast<int>(pos); }
+
+    std::string s;
+};
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *b, size_t n) {
+        for(size_t i = 0; i < n; i++)
+            write(b[i]);
+        return n;
+    }
+    size_t write(const char *b, size_t n) { return write(reinterpret_cast<const uint8_t *>(b), n); }
+    size_t print(const String &s) { return write(s.c_str(), s.length()); }
+    size_t print(const char *s) { return write(s, strlen(s)); }
+    size_t print(char c) { return write(static_cast<uint8_t>(c)); }
+    size_t print(unsigned v, int = DEC) { return print(std::to_string(v).c_str()); }
+    size_t print(int v, int = DEC) { return print(std::to_string(v).c_str()); }
+    size_t println(const String &s) { return print(s) + println(); }
+    size_t println(const char *s) { return print(s) + println(); }
+    size_t println() { return print("\r\n"); }
+};
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual size_t readBytes(char *b, size_t n) {
+        size_t got = 0;
+        for(int c; got < n && (c = read()) >= 0;)
+            b[got++] = static_cast<char>(c);
+        return got;
+    }
+    size_t readBytes(uint8_t *b, size_t n) { return readBytes(reinterpret_cast<char *>(b), n); }
+    void setTimeout(unsigned long) {}
+};
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void pinMode(int pin, int mode);
+int digitalRead(int pin);
+long random(long max);
+long random(long min, long max);
+
+void hostLog(char level, const char *fmt, ...);
+#define log_v(...) hostLog('V', __VA_ARGS__)
+#define log_d(...) hostLog('D', __VA_ARGS__)
+#define log_i(...) hostLog('I', __VA_ARGS__)
+#define log_w(...) hostLog('W', __VA_ARGS__)
+#define log_e(...) hostLog('E', __VA_ARGS__)
@@ -0,0 +1,29 @@
+// Compile-only stand-in: the host has no SD card, so no document is ever parsed.
+#pragma once
+
+#include <Arduino.h>
+
+struct JsonVariant {
+    JsonVariant operator[](const char *) const { return {}; }
+    bool containsKey(const char *) const { return false; }
+    operator const char *() const { return nullptr; }
+    operator int() const { return 0; }
+    template <class T> JsonVariant &operator=(const T &) { return *this; }
+};
+
+struct JsonObject : JsonVariant {
+    JsonObject() {}
+    JsonObject(const JsonVariant &) {}
+};
+
+struct DeserializationError {
+    explicit operator bool() const { return true; }
+    const char *c_str() const { return "no JSON on the host"; }
+};
+
+template <int N> struct StaticJsonDocument : JsonVariant {
+    JsonObject createNestedObject(const char *) { return {}; }
+};
+
+template <class D, class S> DeserializationError deserializeJson(D &, const S &) { return {}; }
+template <class D, class S> size_t serializeJsonPretty(const D &, S &) { return 0; }
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <Arduino.h>
+
+// No file is ever open on the host
+class File : public Stream {
+  public:
+    explicit operator bool() const { return false; }
+    size_t write(uint8_t) override { return 0; }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    void close() {}
+};
@@ -0,0 +1,336 @@
+#include "Host.h"
+#include <OThreadCLI.h>
+#include <SD.h>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <esp_mac.h>
+#include <esp_openthread.h>
+#include <esp_openthread_lock.h>
+#include <esp_random.h>
+#include <mutex>
+#include <openthread/thread.h>
+#include <random>
+#include <thread>
+
+OpenThreadCLI OThreadCLI;
+OpenThread OThread;
+SDFS SD;
+
+// --- Clock ---
+
+static std::atomic<bool> simulated{true};
+static std::atomic<unsigned long> simulatedMs{1000};
+static const auto realStart = std::chrono::steady_clock::now();
+
+static uint64_t realMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                 realStart)
+        .count();
+}
+
+unsigned long millis() { return simulated ? simulatedMs.load() : realMicros() / 1000; }
+unsigned long micros() { return simulated ? simulatedMs.load() * 1000 : realMicros(); }
+
+void delay(unsigned long ms) {
+    if(simulated)
+        simulatedMs += ms;
+    else
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void host::useRealClock() { simulated = false; }
+
+void host::useSimulatedClock(unsigned long startMs) {
+    simulatedMs = startMs;
+    simulated = true;
+}
+
+void host::advance(unsigned long ms) { simulatedMs += ms; }
+
+// --- Board ---
+
+void pinMode(int, int) {}
+int digitalRead(int) { return HIGH; } // button never pressed
+
+static std::mutex randomLock;
+static std::mt19937 rng(1);
+
+void host::seedRandom(uint32_t seed) {
+    std::lock_guard<std::mutex> guard(randomLock);
+    rng.seed(seed);
+}
+
+uint32_t esp_random() {
+    std::lock_guard<std::mutex> guard(randomLock);
+    return rng();
+}
+
+long random(long max) { return max > 0 ? esp_random() % max : 0; }
+long random(long min, long max) { return max > min ? min + esp_random() % (max - min) : min; }
+
+// --- Node identity ---
+
+static uint8_t factoryMac[6] = {0x40, 0x4c, 0xca, 0x01, 0x02, 0x03};
+static otIp6Address meshLocalEid = {{{0xfd, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1}}};
+
+void host::setIdentity(const otIp6Address &eid) {
+    meshLocalEid = eid;
+    memcpy(factoryMac + 3, eid.mFields.m8 + 13, 3);
+}
+
+int esp_efuse_mac_get_default(uint8_t *mac) {
+    memcpy(mac, factoryMac, sizeof(factoryMac));
+    return 0;
+}
+
+static std::mutex logLock;
+static std::function<void(char, const char *)> logHandler;
+
+void host::setLogHandler(std::function<void(char level, const char *line)> handler) {
+    std::lock_guard<std::mutex> guard(logLock);
+    logHandler = handler;
+}
+
+void hostLog(char level, const char *fmt, ...) {
+    static const bool enabled = getenv("LT_TEST_LOG") != nullptr;
+    host::HarnessScope harness;
+    std::function<void(char, const char *)> handler;
+    {
+        std::lock_guard<std::mutex> guard(logLock);
+        handler = logHandler;
+    }
+    if(!enabled && !handler)
+        return;
+
+    char line[512];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if(enabled)
+        fprintf(stderr, "%c %s\n", level, line);
+    if(handler)
+        handler(level, line);
+}
+
+// --- CLI ---
+
+void OpenThreadCLI::onReceive(OnReceiveCb_t callback) {
+    std::lock_guard<std::mutex> guard(lock);
+    receiveCallback = callback;
+}
+
+void OpenThreadCLI::setLineHandler(LineHandler handler) {
+    std::lock_guard<std::mutex> guard(lock);
+    lineHandler = handler;
+}
+
+void OpenThreadCLI::feed(const std::string &text) {
+    OnReceiveCb_t callback;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        input.erase(0, inputPos);
+        inputPos = 0;
+        input += text;
+        callback = receiveCallback;
+    }
+    if(callback)
+        callback();
+}
+
+std::vector<std::string> OpenThreadCLI::takeWritten() {
+    std::lock_guard<std::mutex> guard(lock);
+    std::vector<std::string> lines;
+    lines.swap(written);
+    return lines;
+}
+
+void OpenThreadCLI::reset() {
+    std::lock_guard<std::mutex> guard(lock);
+    input.clear();
+    inputPos = 0;
+    partial.clear();
+    written.clear();
+    lineHandler = nullptr;
+}
+
+size_t OpenThreadCLI::write(uint8_t c) { return write(&c, 1); }
+
+size_t OpenThreadCLI::write(const uint8_t *data, size_t length) {
+    std::vector<std::string> lines;
+    LineHandler handler;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for(size_t i = 0; i < length; ++i) {
+            if(data[i] == '\r')
+                continue;
+            if(data[i] != '\n') {
+                partial += static_cast<char>(data[i]);
+                continue;
+            }
+            lines.push_back(partial);
+            partial.clear();
+        }
+        handler = lineHandler;
+        if(!handler)
+            written.insert(written.end(), lines.begin(), lines.end());
+    }
+    // Outside the lock: the handler usually feeds a reply
+    if(handler) {
+        for(const std::string &line : lines)
+            handler(line);
+    }
+    return length;
+}
+
+int OpenThreadCLI::available() {
+    std::lock_guard<std::mutex> guard(lock);
+    return static_cast<int>(input.size() - inputPos);
+}
+
+int OpenThreadCLI::read() {
+    std::lock_guard<std::mutex> guard(lock);
+    return inputPos < input.size() ? static_cast<unsigned char>(input[inputPos++]) : -1;
+}
+
+size_t OpenThreadCLI::readBytes(char *buffer, size_t length) {
+    std::lock_guard<std::mutex> guard(lock);
+    size_t got = std::min(length, input.size() - inputPos);
+    memcpy(buffer, input.data() + inputPos, got);
+    inputPos += got;
+    return got;
+}
+
+// --- OpenThread ---
+
+struct otInstance {};
+static otInstance instance;
+
+otInstance *esp_openthread_get_instance() { return &instance; }
+
+// Held by LightThread around every OpenThread call, and by deliver() as the OpenThread
+// task holds it while running socket callbacks
+static std::recursive_mutex stackLock;
+
+bool esp_openthread_lock_acquire(TickType_t) {
+    stackLock.lock();
+    return true;
+}
+
+void esp_openthread_lock_release() { stackLock.unlock(); }
+
+otError otIp6AddressFromString(const char *text, otIp6Address *addr) {
+    return inet_pton(AF_INET6, text, addr) == 1 ? OT_ERROR_NONE : OT_ERROR_INVALID_ARGS;
+}
+
+void otIp6AddressToString(const otIp6Address *addr, char *buffer, uint16_t size) {
+    inet_ntop(AF_INET6, addr, buffer, size);
+}
+
+const otIp6Address *otThreadGetMeshLocalEid(otInstance *) { return &meshLocalEid; }
+
+otDeviceRole otThreadGetDeviceRole(otInstance *) { return OT_DEVICE_ROLE_CHILD; }
+
+struct otMessage {
+    uint16_t length;
+    uint8_t data[1280];
+};
+
+otError otMessageAppend(otMessage *message, const void *data, uint16_t length) {
+    if(message->length + length > sizeof(message->data))
+        return OT_ERROR_NO_BUFS;
+    memcpy(message->data + message->length, data, length);
+    message->length += length;
+    return OT_ERROR_NONE;
+}
+
+uint16_t otMessageRead(const otMessage *message, uint16_t offset, void *buffer, uint16_t length) {
+    if(offset >= message->length)
+        return 0;
+    length = std::min<uint16_t>(length, message->length - offset);
+    memcpy(buffer, message->data + offset, length);
+    return length;
+}
+
+uint16_t otMessageGetLength(const otMessage *message) { return message->length; }
+uint16_t otMessageGetOffset(const otMessage *) { return 0; }
+void otMessageFree(otMessage *message) { delete message; }
+
+otError otUdpOpen(otInstance *, otUdpSocket *socket, otUdpReceive callback, void *context) {
+    socket->mHandler = callback;
+    socket->mContext = context;
+    socket->mHandle = socket;
+    return OT_ERROR_NONE;
+}
+
+bool otUdpIsOpen(otInstance *, const otUdpSocket *socket) { return socket->mHandle != nullptr; }
+
+otError otUdpClose(otInstance *, otUdpSocket *socket) {
+    socket->mHandle = nullptr;
+    return OT_ERROR_NONE;
+}
+
+otError otUdpBind(otInstance *, otUdpSocket *socket, const otSockAddr *name, otNetifIdentifier) {
+    socket->mSockName = *name;
+    return OT_ERROR_NONE;
+}
+
+otMessage *otUdpNewMessage(otInstance *, const otMessageSettings *) {
+    host::HarnessScope harness;
+    otMessage *message = new otMessage;
+    message->length = 0;
+    return message;
+}
+
+static std::mutex sendLock;
+static std::function<void(const host::Datagram &)> sendHandler;
+static std::vector<host::Datagram> sent;
+
+otError otUdpSend(otInstance *, otUdpSocket *socket, otMessage *message,
+                  const otMessageInfo *info) {
+    host::HarnessScope harness;
+    host::Datagram datagram{socket, info->mPeerAddr, info->mPeerPort,
+                            std::vector<uint8_t>(message->data, message->data + message->length)};
+    delete message;
+
+    std::function<void(const host::Datagram &)> handler;
+    {
+        std::lock_guard<std::mutex> guard(sendLock);
+        handler = sendHandler;
+        if(!handler)
+            sent.push_back(std::move(datagram));
+    }
+    if(handler)
+        handler(datagram);
+    return OT_ERROR_NONE;
+}
+
+void host::setSendHandler(std::function<void(const Datagram &)> handler) {
+    std::lock_guard<std::mutex> guard(sendLock);
+    sendHandler = handler;
+}
+
+std::vector<host::Datagram> host::takeSent() {
+    std::lock_guard<std::mutex> guard(sendLock);
+    std::vector<Datagram> taken;
+    taken.swap(sent);
+    return taken;
+}
+
+bool host::deliver(otUdpSocket &socket, const otIp6Address &src, const uint8_t *data,
+                   size_t length) {
+    if(!socket.mHandle || length > sizeof(otMessage::data))
+        return false;
+
+    otMessage message;
+    message.length = static_cast<uint16_t>(length);
+    memcpy(message.data, data, length);
+    otMessageInfo info = {};
+    info.mPeerAddr = src;
+    info.mPeerPort = 12345; // LT_UDP_PORT
+
+    std::lock_guard<std::recursive_mutex> guard(stackLock);
+    socket.mHandler(socket.mContext, &message, &info);
+    return true;
+}
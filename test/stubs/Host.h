@@ -0,0 +1,54 @@
+// Test-side controls of the host platform (Host.cpp): the clock, randomness, and the fake
+// Thread stack behind the native UDP socket API.
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <openthread/udp.h>
+#include <vector>
+
+namespace host {
+
+// millis()/micros() run on a simulated clock unless useRealClock() is called. The
+// simulated clock starts at 1000 ms and only moves with advance() or delay().
+void useRealClock();
+void useSimulatedClock(unsigned long startMs = 1000);
+void advance(unsigned long ms);
+
+void seedRandom(uint32_t seed); // esp_random() and random() sequence
+
+// The node the calling test is running as: its mesh-local EID, by default fd00::1, and a
+// factory MAC whose last 3 bytes are the EID's, so nodes hash to different IDs
+void setIdentity(const otIp6Address &meshLocalEid);
+
+// Marks heap use by the host stand-ins themselves, such as the copy of a datagram sent
+// or a test mesh's queues, which on a device lives in OpenThread's message pool or does
+// not exist. Tests counting the library's allocations skip those made inside a scope.
+inline thread_local int harnessDepth = 0;
+
+struct HarnessScope {
+    HarnessScope() { harnessDepth++; }
+    ~HarnessScope() { harnessDepth--; }
+};
+
+// Log lines (log_v() to log_e(), level 'V' to 'E') go to the handler if one is set, and to
+// stderr if LT_TEST_LOG is set
+void setLogHandler(std::function<void(char level, const char *line)> handler);
+
+// A datagram handed to otUdpSend()
+struct Datagram {
+    const otUdpSocket *socket; // sending socket, tells the nodes of a test apart
+    otIp6Address peer;
+    uint16_t port;
+    std::vector<uint8_t> data;
+};
+
+// Datagrams go to the handler if one is set, otherwise they are kept for takeSent()
+void setSendHandler(std::function<void(const Datagram &)> handler);
+std::vector<Datagram> takeSent();
+
+// Hands a datagram to the receive callback of an open socket, as the OpenThread task
+// would. Returns false if the socket is not open.
+bool deliver(otUdpSocket &socket, const otIp6Address &src, const uint8_t *data, size_t length);
+
+} // namespace host
@@ -0,0 +1,50 @@
+// Host stand-in for the OpenThread CLI stream. What LightThread writes is split into lines
+// and handed to the line handler, or kept for takeWritten(); what the CLI prints is pushed
+// with feed(). Safe to feed from another thread, as the OpenThread task does on a device.
+#pragma once
+
+#include <Arduino.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+typedef std::function<void(void)> OnReceiveCb_t;
+
+class OpenThreadCLI : public Stream {
+  public:
+    using LineHandler = std::function<void(const std::string &line)>;
+
+    void begin() {}
+    void onReceive(OnReceiveCb_t callback);
+
+    // Test side
+    void setLineHandler(LineHandler handler); // called for each line written, CR/LF stripped
+    void feed(const std::string &text);       // output of the CLI, read by LightThread
+    std::vector<std::string> takeWritten();   // lines written while no handler was set
+    void reset();
+
+    using Print::write;
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *data, size_t length) override;
+    int available() override;
+    int read() override;
+    size_t readBytes(char *buffer, size_t length) override;
+
+  private:
+    std::mutex lock;
+    std::string input;
+    size_t inputPos = 0;
+    std::string partial; // written, no newline yet
+    std::vector<std::string> written;
+    LineHandler lineHandler;
+    OnReceiveCb_t receiveCallback;
+};
+
+extern OpenThreadCLI OThreadCLI;
+
+class OpenThread {
+  public:
+    void begin(bool) {}
+};
+
+extern OpenThread OThread;
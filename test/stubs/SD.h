@@ -0,0 +1,16 @@
+// The host has no SD card: begin() fails, so LightThread stays without a stored config
+// unless a test sets its role and state itself.
+#pragma once
+
+#include <FS.h>
+
+class SDFS {
+  public:
+    bool begin() { return false; }
+    File open(const char *, const char * = "r") { return File(); }
+    bool exists(const char *) { return false; }
+    bool mkdir(const char *) { return false; }
+    bool remove(const char *) { return false; }
+};
+
+extern SDFS SD;
@@ -0,0 +1,5 @@
+#pragma once
+
+#include <cstdint>
+
+int esp_efuse_mac_get_default(uint8_t *mac);
@@ -0,0 +1,5 @@
+#pragma once
+
+#include <openthread/instance.h>
+
+otInstance *esp_openthread_get_instance(void);
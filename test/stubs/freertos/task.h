@@ -0,0 +1,105 @@
+// Host emulation of the FreeRTOS task API LightThread uses: a task is a detached
+// std::thread, its notification value a counter behind a condition variable.
+#pragma once
+
+#include "FreeRTOS.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef void (*TaskFunction_t)(void *);
+
+struct tskTaskControlBlock {
+    std::mutex lock;
+    std::condition_variable notified;
+    uint32_t count = 0;
+};
+typedef tskTaskControlBlock *TaskHandle_t;
+
+// Task control blocks, kept for the whole run. A thread's block goes back to the pool when
+// the thread exits and is handed to a later one, so a notification given to a task just
+// before it ended lands in valid memory; at worst it wakes the block's next task early.
+class HostTaskPool {
+  public:
+    TaskHandle_t acquire() {
+        std::lock_guard<std::mutex> guard(lock);
+        if(idle.empty())
+            return &blocks.emplace_back();
+        TaskHandle_t task = idle.back();
+        idle.pop_back();
+        std::lock_guard<std::mutex> taskGuard(task->lock);
+        task->count = 0;
+        return task;
+    }
+
+    void release(TaskHandle_t task) {
+        std::lock_guard<std::mutex> guard(lock);
+        idle.push_back(task);
+    }
+
+  private:
+    std::mutex lock;
+    std::deque<tskTaskControlBlock> blocks; // never moved, so handles stay valid
+    std::vector<TaskHandle_t> idle;
+};
+
+inline HostTaskPool hostTaskPool;
+
+// The calling thread's block, returned to the pool as the thread exits
+struct HostCurrentTask {
+    TaskHandle_t task = nullptr;
+    ~HostCurrentTask() {
+        if(task)
+            hostTaskPool.release(task);
+    }
+};
+
+inline thread_local HostCurrentTask hostCurrentTask;
+inline std::atomic<uint32_t> hostNotifyTakes{0}; // ulTaskNotifyTake() calls, all tasks
+
+inline BaseType_t xTaskCreate(TaskFunction_t fn, const char *, uint32_t, void *arg, UBaseType_t,
+                              TaskHandle_t *created) {
+    TaskHandle_t task = hostTaskPool.acquire();
+    *created = task;
+    std::thread([task, fn, arg] {
+        hostCurrentTask.task = task;
+        fn(arg);
+    }).detach();
+    return pdPASS;
+}
+
+// Every thread gets a handle on first use, as every FreeRTOS task has one
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+    if(!hostCurrentTask.task)
+        hostCurrentTask.task = hostTaskPool.acquire();
+    return hostCurrentTask.task;
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+    hostNotifyTakes++;
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> guard(task->lock);
+    if(task->count == 0 && ticks > 0)
+        task->notified.wait_for(guard, std::chrono::milliseconds(ticks),
+                                [task] { return task->count > 0; });
+    uint32_t value = task->count;
+    task->count = clearOnExit ? 0 : (value ? value - 1 : 0);
+    return value;
+}
+
+// A task deleting itself returns from its function next, which ends the thread and returns
+// its block to the pool.
+inline void vTaskDelete(TaskHandle_t) {}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    {
+        std::lock_guard<std::mutex> guard(task->lock);
+        task->count++;
+    }
+    task->notified.notify_one();
+    return pdPASS;
+}
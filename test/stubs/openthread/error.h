@@ -0,0 +1,8 @@
+#pragma once
+
+typedef enum {
+    OT_ERROR_NONE = 0,
+    OT_ERROR_FAILED = 1,
+    OT_ERROR_NO_BUFS = 3,
+    OT_ERROR_INVALID_ARGS = 7,
+} otError;
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <openthread/error.h>
+
+#define OT_IP6_ADDRESS_SIZE 16
+#define OT_IP6_ADDRESS_STRING_SIZE 40
+
+struct otIp6Address {
+    union {
+        uint8_t m8[16];
+        uint16_t m16[8];
+        uint32_t m32[4];
+    } mFields;
+};
+
+struct otSockAddr {
+    otIp6Address mAddress;
+    uint16_t mPort;
+};
+
+struct otMessageInfo {
+    otIp6Address mSockAddr;
+    otIp6Address mPeerAddr;
+    uint16_t mSockPort;
+    uint16_t mPeerPort;
+    uint8_t mHopLimit;
+};
+
+typedef enum {
+    OT_NETIF_UNSPECIFIED = 0,
+    OT_NETIF_THREAD,
+    OT_NETIF_BACKBONE,
+} otNetifIdentifier;
+
+otError otIp6AddressFromString(const char *aString, otIp6Address *aAddress);
+void otIp6AddressToString(const otIp6Address *aAddress, char *aBuffer, uint16_t aSize);
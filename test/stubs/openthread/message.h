@@ -0,0 +1,16 @@
+#pragma once
+
+#include <openthread/ip6.h>
+
+struct otMessage;
+
+struct otMessageSettings {
+    bool mLinkSecurityEnabled;
+    uint8_t mPriority;
+};
+
+otError otMessageAppend(otMessage *aMessage, const void *aBuf, uint16_t aLength);
+uint16_t otMessageRead(const otMessage *aMessage, uint16_t aOffset, void *aBuf, uint16_t aLength);
+uint16_t otMessageGetLength(const otMessage *aMessage);
+uint16_t otMessageGetOffset(const otMessage *aMessage);
+void otMessageFree(otMessage *aMessage);
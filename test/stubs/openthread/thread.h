@@ -0,0 +1,15 @@
+#pragma once
+
+#include <openthread/instance.h>
+#include <openthread/ip6.h>
+
+typedef enum {
+    OT_DEVICE_ROLE_DISABLED = 0,
+    OT_DEVICE_ROLE_DETACHED = 1,
+    OT_DEVICE_ROLE_CHILD = 2,
+    OT_DEVICE_ROLE_ROUTER = 3,
+    OT_DEVICE_ROLE_LEADER = 4,
+} otDeviceRole;
+
+const otIp6Address *otThreadGetMeshLocalEid(otInstance *aInstance);
+otDeviceRole otThreadGetDeviceRole(otInstance *aInstance);
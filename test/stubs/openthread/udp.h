@@ -0,0 +1,26 @@
+#pragma once
+
+#include <openthread/instance.h>
+#include <openthread/message.h>
+
+typedef void (*otUdpReceive)(void *aContext, otMessage *aMessage,
+                             const otMessageInfo *aMessageInfo);
+
+struct otUdpSocket {
+    otSockAddr mSockName;
+    otSockAddr mPeerName;
+    otUdpReceive mHandler;
+    void *mContext;
+    void *mHandle;
+    otUdpSocket *mNext;
+};
+
+otError otUdpOpen(otInstance *aInstance, otUdpSocket *aSocket, otUdpReceive aCallback,
+                  void *aContext);
+bool otUdpIsOpen(otInstance *aInstance, const otUdpSocket *aSocket);
+otError otUdpClose(otInstance *aInstance, otUdpSocket *aSocket);
+otError otUdpBind(otInstance *aInstance, otUdpSocket *aSocket, const otSockAddr *aSockName,
+                  otNetifIdentifier aNetif);
+otMessage *otUdpNewMessage(otInstance *aInstance, const otMessageSettings *aSettings);
+otError otUdpSend(otInstance *aInstance, otUdpSocket *aSocket, otMessage *aMessage,
+                  const otMessageInfo *aMessageInfo);